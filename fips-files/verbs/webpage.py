@@ -94,10 +94,12 @@ items = [
             [ 'grass-opaque', '4-3-1-grass-opaque', '1-grass-opaque.c', '1-grass-opaque.glsl'],
             [ 'grass-transparent', '4-3-2-grass-transparent', '2-grass-transparent.c', '2-grass-transparent.glsl'],
             [ 'blending', '4-3-3-blending', '3-blending.c', '3-blending.glsl'],
-            [ 'blending-sorted', '4-3-4-blending-sorted', '4-blending-sorted.c', '4-blending-sorted.glsl']
+            [ 'blending-sorted', '4-3-4-blending-sorted', '4-blending-sorted.c', '4-blending-sorted.glsl'],
+            [ 'transparency-sort', '4-3-5-transparency-sort', '5-transparency-sort.c', '5-transparency-sort.glsl']
         ]],
         [ 'Face Culling', 'https://learnopengl.com/Advanced-OpenGL/Face-culling', '4-4-face-culling', [
-            [ 'cull-front', '4-4-1-cull-front', '1-cull-front.c', '1-cull-front.glsl']
+            [ 'cull-front', '4-4-1-cull-front', '1-cull-front.c', '1-cull-front.glsl'],
+            [ 'occlusion-culling', '4-4-2-occlusion-culling', '2-occlusion-culling.c', '2-occlusion-culling.glsl']
         ]],
         [ 'Framebuffers', 'https://learnopengl.com/Advanced-OpenGL/Framebuffers', '4-5-framebuffers', [
             [ 'render-to-texture', '4-5-1-render-to-texture', '1-render-to-texture.c', '1-render-to-texture.glsl'],
@@ -131,6 +133,12 @@ items = [
             [ 'instanced-arrays', '4-10-2-instanced-arrays', '2-instanced-arrays.c', '2-instanced-arrays.glsl'],
             [ 'asteroid-field', '4-10-3-asteroid-field', '3-asteroid-field.c', '3-asteroid-field.glsl'],
             [ 'asteroid-field-instanced', '4-10-4-asteroid-field-instanced', '4-asteroid-field-instanced.c', '4-asteroid-field-instanced.glsl'],
+            [ 'batch-math', '4-10-5-batch-math', '5-batch-math.c', None],
+            [ 'asteroid-field-animated', '4-10-6-asteroid-field-animated', '6-asteroid-field-animated.c', '6-asteroid-field-animated.glsl'],
+            [ 'draw-queue-stress', '4-10-7-draw-queue-stress', '7-draw-queue-stress.c', '7-draw-queue-stress.glsl'],
+            [ 'stream-buffer', '4-10-8-stream-buffer', '8-stream-buffer.c', '8-stream-buffer.glsl'],
+            [ 'parallel-recording', '4-10-9-parallel-recording', '9-parallel-recording.c', '9-parallel-recording.glsl'],
+            [ 'bvh-queries', '4-10-10-bvh-queries', '10-bvh-queries.c', None],
         ]],
         [ 'Anti Aliasing', 'https://learnopengl.com/Advanced-OpenGL/Anti-Aliasing', '4-11-anti-aliasing', [
             [ 'msaa', '4-11-1-msaa', '1-msaa.c', '1-msaa.glsl'],
@@ -147,11 +155,14 @@ items = [
             [ 'mapping-depth', '5-3-1-mapping-depth', '1-mapping-depth.c', '1-mapping-depth.glsl'],
             [ 'rendering-shadows', '5-3-2-rendering-shadows', '2-rendering-shadows.c', '2-rendering-shadows.glsl'],
             [ 'improved-shadows', '5-3-3-improved-shadows', '3-improved-shadows.c', '3-improved-shadows.glsl'],
+            [ 'cascaded-shadows', '5-3-4-cascaded-shadows', '4-cascaded-shadows.c', '4-cascaded-shadows.glsl'],
         ]],
         [ 'Point Shadows', 'https://learnopengl.com/Advanced-Lighting/Shadows/Point-Shadows', '5-4-point-shadows', [
             [ 'omnidirectional-depth', '5-4-1-omnidirectional-depth', '1-omnidirectional-depth.c', '1-omnidirectional-depth.glsl'],
             [ 'omnidir-shadows', '5-4-2-omnidirectional-shadows', '2-omnidirectional-shadows.c', '2-omnidirectional-shadows.glsl'],
             [ 'omnidirectional-PCF', '5-4-3-omnidirectional-PCF', '3-omnidirectional-PCF.c', '3-omnidirectional-PCF.glsl'],
+            [ 'dual-paraboloid', '5-4-4-dual-paraboloid', '4-dual-paraboloid.c', '4-dual-paraboloid.glsl'],
+            [ 'shadow-atlas', '5-4-5-shadow-atlas', '5-shadow-atlas.c', '5-shadow-atlas.glsl'],
         ]],
         [ 'Normal Mapping', 'https://learnopengl.com/Advanced-Lighting/Normal-Mapping', '5-5-normal-mapping', [
             [ 'normal-mapping', '5-5-1-normal-mapping', '1-normal-mapping.c', '1-normal-mapping.glsl'],
@@ -0,0 +1,765 @@
+/*
+    lopgl_hmm_batch.h -- batch kernels for HandmadeMath types
+
+    Processes arrays of matrices and vectors with SSE2, AVX2 or NEON. The
+    instruction set is picked at runtime on first use, or forced with
+    HMM_BatchSetISA(). Every instruction set performs the same float operations
+    in the same order as the scalar kernels, which in turn match the scalar
+    HandmadeMath functions (as built with HANDMADE_MATH_NO_SSE), so results are
+    bit-identical regardless of which kernels run. The HandmadeMath functions
+    themselves only match if the compiler doesn't fuse their multiply-adds,
+    which GCC does by default when targeting FMA capable CPUs.
+
+    Include HandmadeMath.h before this header, and
+        #define HMM_BATCH_IMPLEMENTATION
+    in EXACTLY one C file before including it.
+
+    Matrices are read and written with unaligned loads and stores, and the
+    output may alias the input of all kernels.
+*/
+#ifndef LOPGL_HMM_BATCH_INCLUDED
+#define LOPGL_HMM_BATCH_INCLUDED
+
+#ifndef HANDMADE_MATH_H
+#error "Please include HandmadeMath.h before lopgl_hmm_batch.h"
+#endif
+
+#include <stdbool.h>
+
+typedef enum hmm_batch_isa {
+    HMM_BATCH_SCALAR,
+    HMM_BATCH_SSE2,
+    HMM_BATCH_AVX2,
+    HMM_BATCH_NEON,
+    HMM_BATCH_NUM_ISAS
+} hmm_batch_isa;
+
+/* structure of arrays input for HMM_BatchTRS(), quaternions have to be normalized */
+typedef struct hmm_batch_trs {
+    const float* px;
+    const float* py;
+    const float* pz;
+    const float* qx;
+    const float* qy;
+    const float* qz;
+    const float* qw;
+    const float* sx;
+    const float* sy;
+    const float* sz;
+} hmm_batch_trs;
+
+/* out[i] = left[i] * right[i] */
+void HMM_BatchMultiplyMat4(hmm_mat4* out, const hmm_mat4* left, const hmm_mat4* right, int count);
+
+/* out[i] = matrices[i] * vectors[i] */
+void HMM_BatchMultiplyMat4ByVec4(hmm_vec4* out, const hmm_mat4* matrices, const hmm_vec4* vectors, int count);
+
+/* out[i] = translate(p[i]) * rotate(q[i]) * scale(s[i]) */
+void HMM_BatchTRS(hmm_mat4* out, const hmm_batch_trs* trs, int count);
+
+/* inverse transpose of the upper 3x3 of each matrix, e.g. to transform normals,
+   the fourth row and column are set to identity */
+void HMM_BatchInverseTranspose(hmm_mat4* out, const hmm_mat4* matrices, int count);
+
+hmm_batch_isa HMM_BatchISA(void);
+
+bool HMM_BatchISASupported(hmm_batch_isa isa);
+
+/* returns false and keeps the current selection if isa isn't supported */
+bool HMM_BatchSetISA(hmm_batch_isa isa);
+
+const char* HMM_BatchISAName(hmm_batch_isa isa);
+
+#endif /* LOPGL_HMM_BATCH_INCLUDED */
+
+
+/*--- IMPLEMENTATION ---------------------------------------------------------*/
+#ifdef HMM_BATCH_IMPLEMENTATION
+
+#include <assert.h>
+
+#if !defined(__EMSCRIPTEN__) && (defined(__x86_64__) || defined(_M_X64))
+#define _HMM_BATCH_X64
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define _HMM_BATCH_AVX2_FUNC
+#else
+#define _HMM_BATCH_AVX2_FUNC __attribute__((target("avx2")))
+#endif
+#elif !defined(__EMSCRIPTEN__) && (defined(__aarch64__) || defined(_M_ARM64))
+#define _HMM_BATCH_NEON
+#include <arm_neon.h>
+#endif
+
+/* Fused multiply-adds round differently than a multiply followed by an add,
+   they would break bit-identical results between the kernels. */
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+/*=== SCALAR ===================================================================*/
+
+static void _hmm_batch_multiply_mat4_one(hmm_mat4* out, const hmm_mat4* left, const hmm_mat4* right) {
+    const hmm_mat4 l = *left;
+    const hmm_mat4 r = *right;
+    for (int col = 0; col < 4; ++col) {
+        for (int row = 0; row < 4; ++row) {
+            float sum = 0;
+            for (int k = 0; k < 4; ++k) {
+                sum += l.Elements[k][row] * r.Elements[col][k];
+            }
+            out->Elements[col][row] = sum;
+        }
+    }
+}
+
+static void _hmm_batch_multiply_mat4_vec4_one(hmm_vec4* out, const hmm_mat4* matrix, const hmm_vec4* vector) {
+    const hmm_vec4 v = *vector;
+    for (int row = 0; row < 4; ++row) {
+        float sum = 0;
+        for (int col = 0; col < 4; ++col) {
+            sum += matrix->Elements[col][row] * v.Elements[col];
+        }
+        out->Elements[row] = sum;
+    }
+}
+
+static void _hmm_batch_trs_one(hmm_mat4* out, const hmm_batch_trs* trs, int i) {
+    const float x = trs->qx[i], y = trs->qy[i], z = trs->qz[i], w = trs->qw[i];
+    const float sx = trs->sx[i], sy = trs->sy[i], sz = trs->sz[i];
+    const float xx = x * x, yy = y * y, zz = z * z;
+    const float xy = x * y, xz = x * z, yz = y * z;
+    const float wx = w * x, wy = w * y, wz = w * z;
+
+    out->Elements[0][0] = (1.0f - 2.0f * (yy + zz)) * sx;
+    out->Elements[0][1] = 2.0f * (xy + wz) * sx;
+    out->Elements[0][2] = 2.0f * (xz - wy) * sx;
+    out->Elements[0][3] = 0.0f;
+
+    out->Elements[1][0] = 2.0f * (xy - wz) * sy;
+    out->Elements[1][1] = (1.0f - 2.0f * (xx + zz)) * sy;
+    out->Elements[1][2] = 2.0f * (yz + wx) * sy;
+    out->Elements[1][3] = 0.0f;
+
+    out->Elements[2][0] = 2.0f * (xz + wy) * sz;
+    out->Elements[2][1] = 2.0f * (yz - wx) * sz;
+    out->Elements[2][2] = (1.0f - 2.0f * (xx + yy)) * sz;
+    out->Elements[2][3] = 0.0f;
+
+    out->Elements[3][0] = trs->px[i];
+    out->Elements[3][1] = trs->py[i];
+    out->Elements[3][2] = trs->pz[i];
+    out->Elements[3][3] = 1.0f;
+}
+
+/* the columns of the inverse transpose are b x c, c x a and a x b divided by the determinant */
+static void _hmm_batch_inverse_transpose_one(hmm_mat4* out, const hmm_mat4* matrix) {
+    const float ax = matrix->Elements[0][0], ay = matrix->Elements[0][1], az = matrix->Elements[0][2];
+    const float bx = matrix->Elements[1][0], by = matrix->Elements[1][1], bz = matrix->Elements[1][2];
+    const float cx = matrix->Elements[2][0], cy = matrix->Elements[2][1], cz = matrix->Elements[2][2];
+
+    const float bcx = by * cz - bz * cy, bcy = bz * cx - bx * cz, bcz = bx * cy - by * cx;
+    const float cax = cy * az - cz * ay, cay = cz * ax - cx * az, caz = cx * ay - cy * ax;
+    const float abx = ay * bz - az * by, aby = az * bx - ax * bz, abz = ax * by - ay * bx;
+    const float inv_det = 1.0f / (ax * bcx + ay * bcy + az * bcz);
+
+    out->Elements[0][0] = bcx * inv_det;
+    out->Elements[0][1] = bcy * inv_det;
+    out->Elements[0][2] = bcz * inv_det;
+    out->Elements[0][3] = 0.0f;
+
+    out->Elements[1][0] = cax * inv_det;
+    out->Elements[1][1] = cay * inv_det;
+    out->Elements[1][2] = caz * inv_det;
+    out->Elements[1][3] = 0.0f;
+
+    out->Elements[2][0] = abx * inv_det;
+    out->Elements[2][1] = aby * inv_det;
+    out->Elements[2][2] = abz * inv_det;
+    out->Elements[2][3] = 0.0f;
+
+    out->Elements[3][0] = 0.0f;
+    out->Elements[3][1] = 0.0f;
+    out->Elements[3][2] = 0.0f;
+    out->Elements[3][3] = 1.0f;
+}
+
+static void _hmm_batch_multiply_mat4_scalar(hmm_mat4* out, const hmm_mat4* left, const hmm_mat4* right, int count) {
+    for (int i = 0; i < count; ++i) {
+        _hmm_batch_multiply_mat4_one(&out[i], &left[i], &right[i]);
+    }
+}
+
+static void _hmm_batch_multiply_mat4_vec4_scalar(hmm_vec4* out, const hmm_mat4* matrices, const hmm_vec4* vectors, int count) {
+    for (int i = 0; i < count; ++i) {
+        _hmm_batch_multiply_mat4_vec4_one(&out[i], &matrices[i], &vectors[i]);
+    }
+}
+
+static void _hmm_batch_trs_scalar(hmm_mat4* out, const hmm_batch_trs* trs, int count) {
+    for (int i = 0; i < count; ++i) {
+        _hmm_batch_trs_one(&out[i], trs, i);
+    }
+}
+
+static void _hmm_batch_inverse_transpose_scalar(hmm_mat4* out, const hmm_mat4* matrices, int count) {
+    for (int i = 0; i < count; ++i) {
+        _hmm_batch_inverse_transpose_one(&out[i], &matrices[i]);
+    }
+}
+
+/*=== SSE2 =====================================================================*/
+#ifdef _HMM_BATCH_X64
+
+/* sum starts at zero like the scalar kernels, adding to +0 turns -0 into +0 */
+static void _hmm_batch_multiply_mat4_sse2(hmm_mat4* out, const hmm_mat4* left, const hmm_mat4* right, int count) {
+    for (int i = 0; i < count; ++i) {
+        const float* l = &left[i].Elements[0][0];
+        const float* r = &right[i].Elements[0][0];
+        const __m128 l0 = _mm_loadu_ps(l + 0);
+        const __m128 l1 = _mm_loadu_ps(l + 4);
+        const __m128 l2 = _mm_loadu_ps(l + 8);
+        const __m128 l3 = _mm_loadu_ps(l + 12);
+        __m128 cols[4];
+        for (int col = 0; col < 4; ++col) {
+            __m128 sum = _mm_setzero_ps();
+            sum = _mm_add_ps(sum, _mm_mul_ps(l0, _mm_set1_ps(r[col * 4 + 0])));
+            sum = _mm_add_ps(sum, _mm_mul_ps(l1, _mm_set1_ps(r[col * 4 + 1])));
+            sum = _mm_add_ps(sum, _mm_mul_ps(l2, _mm_set1_ps(r[col * 4 + 2])));
+            sum = _mm_add_ps(sum, _mm_mul_ps(l3, _mm_set1_ps(r[col * 4 + 3])));
+            cols[col] = sum;
+        }
+        float* o = &out[i].Elements[0][0];
+        _mm_storeu_ps(o + 0, cols[0]);
+        _mm_storeu_ps(o + 4, cols[1]);
+        _mm_storeu_ps(o + 8, cols[2]);
+        _mm_storeu_ps(o + 12, cols[3]);
+    }
+}
+
+static void _hmm_batch_multiply_mat4_vec4_sse2(hmm_vec4* out, const hmm_mat4* matrices, const hmm_vec4* vectors, int count) {
+    for (int i = 0; i < count; ++i) {
+        const float* m = &matrices[i].Elements[0][0];
+        const float* v = &vectors[i].Elements[0];
+        __m128 sum = _mm_setzero_ps();
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(m + 0), _mm_set1_ps(v[0])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(m + 4), _mm_set1_ps(v[1])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(m + 8), _mm_set1_ps(v[2])));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(m + 12), _mm_set1_ps(v[3])));
+        _mm_storeu_ps(&out[i].Elements[0], sum);
+    }
+}
+
+/* writes column col of four matrices from lanes holding its rows */
+static void _hmm_batch_store_column_sse2(hmm_mat4* out, int col, __m128 r0, __m128 r1, __m128 r2, __m128 r3) {
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(out[0].Elements[col], r0);
+    _mm_storeu_ps(out[1].Elements[col], r1);
+    _mm_storeu_ps(out[2].Elements[col], r2);
+    _mm_storeu_ps(out[3].Elements[col], r3);
+}
+
+/* loads column col of four matrices into lanes holding its rows */
+static void _hmm_batch_load_column_sse2(const hmm_mat4* matrices, int col, __m128* r0, __m128* r1, __m128* r2, __m128* r3) {
+    *r0 = _mm_loadu_ps(matrices[0].Elements[col]);
+    *r1 = _mm_loadu_ps(matrices[1].Elements[col]);
+    *r2 = _mm_loadu_ps(matrices[2].Elements[col]);
+    *r3 = _mm_loadu_ps(matrices[3].Elements[col]);
+    _MM_TRANSPOSE4_PS(*r0, *r1, *r2, *r3);
+}
+
+static void _hmm_batch_trs_sse2(hmm_mat4* out, const hmm_batch_trs* trs, int count) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 x = _mm_loadu_ps(trs->qx + i), y = _mm_loadu_ps(trs->qy + i);
+        const __m128 z = _mm_loadu_ps(trs->qz + i), w = _mm_loadu_ps(trs->qw + i);
+        const __m128 sx = _mm_loadu_ps(trs->sx + i), sy = _mm_loadu_ps(trs->sy + i), sz = _mm_loadu_ps(trs->sz + i);
+        const __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        const __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        const __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+        _hmm_batch_store_column_sse2(out + i, 0,
+            _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx),
+            zero);
+        _hmm_batch_store_column_sse2(out + i, 1,
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy),
+            _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy),
+            zero);
+        _hmm_batch_store_column_sse2(out + i, 2,
+            _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz),
+            _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz),
+            _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz),
+            zero);
+        _hmm_batch_store_column_sse2(out + i, 3,
+            _mm_loadu_ps(trs->px + i), _mm_loadu_ps(trs->py + i), _mm_loadu_ps(trs->pz + i), one);
+    }
+    _hmm_batch_trs_scalar(out + i, &(hmm_batch_trs){
+        trs->px + i, trs->py + i, trs->pz + i,
+        trs->qx + i, trs->qy + i, trs->qz + i, trs->qw + i,
+        trs->sx + i, trs->sy + i, trs->sz + i
+    }, count - i);
+}
+
+static void _hmm_batch_inverse_transpose_sse2(hmm_mat4* out, const hmm_mat4* matrices, int count) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 ax, ay, az, bx, by, bz, cx, cy, cz, unused;
+        _hmm_batch_load_column_sse2(matrices + i, 0, &ax, &ay, &az, &unused);
+        _hmm_batch_load_column_sse2(matrices + i, 1, &bx, &by, &bz, &unused);
+        _hmm_batch_load_column_sse2(matrices + i, 2, &cx, &cy, &cz, &unused);
+
+        const __m128 bcx = _mm_sub_ps(_mm_mul_ps(by, cz), _mm_mul_ps(bz, cy));
+        const __m128 bcy = _mm_sub_ps(_mm_mul_ps(bz, cx), _mm_mul_ps(bx, cz));
+        const __m128 bcz = _mm_sub_ps(_mm_mul_ps(bx, cy), _mm_mul_ps(by, cx));
+        const __m128 cax = _mm_sub_ps(_mm_mul_ps(cy, az), _mm_mul_ps(cz, ay));
+        const __m128 cay = _mm_sub_ps(_mm_mul_ps(cz, ax), _mm_mul_ps(cx, az));
+        const __m128 caz = _mm_sub_ps(_mm_mul_ps(cx, ay), _mm_mul_ps(cy, ax));
+        const __m128 abx = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by));
+        const __m128 aby = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz));
+        const __m128 abz = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx));
+        const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bcx), _mm_mul_ps(ay, bcy)), _mm_mul_ps(az, bcz));
+        const __m128 inv_det = _mm_div_ps(one, det);
+
+        _hmm_batch_store_column_sse2(out + i, 0, _mm_mul_ps(bcx, inv_det), _mm_mul_ps(bcy, inv_det), _mm_mul_ps(bcz, inv_det), zero);
+        _hmm_batch_store_column_sse2(out + i, 1, _mm_mul_ps(cax, inv_det), _mm_mul_ps(cay, inv_det), _mm_mul_ps(caz, inv_det), zero);
+        _hmm_batch_store_column_sse2(out + i, 2, _mm_mul_ps(abx, inv_det), _mm_mul_ps(aby, inv_det), _mm_mul_ps(abz, inv_det), zero);
+        _hmm_batch_store_column_sse2(out + i, 3, zero, zero, zero, one);
+    }
+    _hmm_batch_inverse_transpose_scalar(out + i, matrices + i, count - i);
+}
+
+/*=== AVX2 =====================================================================*/
+
+/* transposes the 4x4 blocks in the lower and upper 128 bits separately */
+_HMM_BATCH_AVX2_FUNC static void _hmm_batch_transpose4_avx2(__m256* r0, __m256* r1, __m256* r2, __m256* r3) {
+    const __m256 t0 = _mm256_unpacklo_ps(*r0, *r1);
+    const __m256 t1 = _mm256_unpackhi_ps(*r0, *r1);
+    const __m256 t2 = _mm256_unpacklo_ps(*r2, *r3);
+    const __m256 t3 = _mm256_unpackhi_ps(*r2, *r3);
+    *r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    *r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    *r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    *r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+/* writes column col of eight matrices from lanes holding its rows */
+_HMM_BATCH_AVX2_FUNC static void _hmm_batch_store_column_avx2(hmm_mat4* out, int col, __m256 r0, __m256 r1, __m256 r2, __m256 r3) {
+    _hmm_batch_transpose4_avx2(&r0, &r1, &r2, &r3);
+    _mm_storeu_ps(out[0].Elements[col], _mm256_castps256_ps128(r0));
+    _mm_storeu_ps(out[1].Elements[col], _mm256_castps256_ps128(r1));
+    _mm_storeu_ps(out[2].Elements[col], _mm256_castps256_ps128(r2));
+    _mm_storeu_ps(out[3].Elements[col], _mm256_castps256_ps128(r3));
+    _mm_storeu_ps(out[4].Elements[col], _mm256_extractf128_ps(r0, 1));
+    _mm_storeu_ps(out[5].Elements[col], _mm256_extractf128_ps(r1, 1));
+    _mm_storeu_ps(out[6].Elements[col], _mm256_extractf128_ps(r2, 1));
+    _mm_storeu_ps(out[7].Elements[col], _mm256_extractf128_ps(r3, 1));
+}
+
+_HMM_BATCH_AVX2_FUNC static __m256 _hmm_batch_load_pair_avx2(const float* lo, const float* hi) {
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(lo)), _mm_loadu_ps(hi), 1);
+}
+
+/* loads column col of eight matrices into lanes holding its rows */
+_HMM_BATCH_AVX2_FUNC static void _hmm_batch_load_column_avx2(const hmm_mat4* matrices, int col, __m256* r0, __m256* r1, __m256* r2, __m256* r3) {
+    *r0 = _hmm_batch_load_pair_avx2(matrices[0].Elements[col], matrices[4].Elements[col]);
+    *r1 = _hmm_batch_load_pair_avx2(matrices[1].Elements[col], matrices[5].Elements[col]);
+    *r2 = _hmm_batch_load_pair_avx2(matrices[2].Elements[col], matrices[6].Elements[col]);
+    *r3 = _hmm_batch_load_pair_avx2(matrices[3].Elements[col], matrices[7].Elements[col]);
+    _hmm_batch_transpose4_avx2(r0, r1, r2, r3);
+}
+
+/* computes two result columns per register, the left columns are repeated in both halves */
+_HMM_BATCH_AVX2_FUNC static void _hmm_batch_multiply_mat4_avx2(hmm_mat4* out, const hmm_mat4* left, const hmm_mat4* right, int count) {
+    for (int i = 0; i < count; ++i) {
+        const float* l = &left[i].Elements[0][0];
+        const float* r = &right[i].Elements[0][0];
+        const __m256 l0 = _mm256_broadcast_ps((const __m128*)(l + 0));
+        const __m256 l1 = _mm256_broadcast_ps((const __m128*)(l + 4));
+        const __m256 l2 = _mm256_broadcast_ps((const __m128*)(l + 8));
+        const __m256 l3 = _mm256_broadcast_ps((const __m128*)(l + 12));
+        const __m256 r01 = _mm256_loadu_ps(r + 0);
+        const __m256 r23 = _mm256_loadu_ps(r + 8);
+
+        __m256 sum01 = _mm256_setzero_ps();
+        sum01 = _mm256_add_ps(sum01, _mm256_mul_ps(l0, _mm256_permute_ps(r01, 0x00)));
+        sum01 = _mm256_add_ps(sum01, _mm256_mul_ps(l1, _mm256_permute_ps(r01, 0x55)));
+        sum01 = _mm256_add_ps(sum01, _mm256_mul_ps(l2, _mm256_permute_ps(r01, 0xAA)));
+        sum01 = _mm256_add_ps(sum01, _mm256_mul_ps(l3, _mm256_permute_ps(r01, 0xFF)));
+
+        __m256 sum23 = _mm256_setzero_ps();
+        sum23 = _mm256_add_ps(sum23, _mm256_mul_ps(l0, _mm256_permute_ps(r23, 0x00)));
+        sum23 = _mm256_add_ps(sum23, _mm256_mul_ps(l1, _mm256_permute_ps(r23, 0x55)));
+        sum23 = _mm256_add_ps(sum23, _mm256_mul_ps(l2, _mm256_permute_ps(r23, 0xAA)));
+        sum23 = _mm256_add_ps(sum23, _mm256_mul_ps(l3, _mm256_permute_ps(r23, 0xFF)));
+
+        float* o = &out[i].Elements[0][0];
+        _mm256_storeu_ps(o + 0, sum01);
+        _mm256_storeu_ps(o + 8, sum23);
+    }
+}
+
+/* two matrices per register */
+_HMM_BATCH_AVX2_FUNC static void _hmm_batch_multiply_mat4_vec4_avx2(hmm_vec4* out, const hmm_mat4* matrices, const hmm_vec4* vectors, int count) {
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const float* m0 = &matrices[i].Elements[0][0];
+        const float* m1 = &matrices[i + 1].Elements[0][0];
+        const __m256 v = _mm256_loadu_ps(&vectors[i].Elements[0]);
+        __m256 sum = _mm256_setzero_ps();
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(_hmm_batch_load_pair_avx2(m0 + 0, m1 + 0), _mm256_permute_ps(v, 0x00)));
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(_hmm_batch_load_pair_avx2(m0 + 4, m1 + 4), _mm256_permute_ps(v, 0x55)));
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(_hmm_batch_load_pair_avx2(m0 + 8, m1 + 8), _mm256_permute_ps(v, 0xAA)));
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(_hmm_batch_load_pair_avx2(m0 + 12, m1 + 12), _mm256_permute_ps(v, 0xFF)));
+        _mm256_storeu_ps(&out[i].Elements[0], sum);
+    }
+    _hmm_batch_multiply_mat4_vec4_scalar(out + i, matrices + i, vectors + i, count - i);
+}
+
+_HMM_BATCH_AVX2_FUNC static void _hmm_batch_trs_avx2(hmm_mat4* out, const hmm_batch_trs* trs, int count) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 x = _mm256_loadu_ps(trs->qx + i), y = _mm256_loadu_ps(trs->qy + i);
+        const __m256 z = _mm256_loadu_ps(trs->qz + i), w = _mm256_loadu_ps(trs->qw + i);
+        const __m256 sx = _mm256_loadu_ps(trs->sx + i), sy = _mm256_loadu_ps(trs->sy + i), sz = _mm256_loadu_ps(trs->sz + i);
+        const __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+        const __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+        const __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+        _hmm_batch_store_column_avx2(out + i, 0,
+            _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))), sx),
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), sx),
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), sx),
+            zero);
+        _hmm_batch_store_column_avx2(out + i, 1,
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), sy),
+            _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))), sy),
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), sy),
+            zero);
+        _hmm_batch_store_column_avx2(out + i, 2,
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), sz),
+            _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), sz),
+            _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))), sz),
+            zero);
+        _hmm_batch_store_column_avx2(out + i, 3,
+            _mm256_loadu_ps(trs->px + i), _mm256_loadu_ps(trs->py + i), _mm256_loadu_ps(trs->pz + i), one);
+    }
+    _hmm_batch_trs_sse2(out + i, &(hmm_batch_trs){
+        trs->px + i, trs->py + i, trs->pz + i,
+        trs->qx + i, trs->qy + i, trs->qz + i, trs->qw + i,
+        trs->sx + i, trs->sy + i, trs->sz + i
+    }, count - i);
+}
+
+_HMM_BATCH_AVX2_FUNC static void _hmm_batch_inverse_transpose_avx2(hmm_mat4* out, const hmm_mat4* matrices, int count) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 ax, ay, az, bx, by, bz, cx, cy, cz, unused;
+        _hmm_batch_load_column_avx2(matrices + i, 0, &ax, &ay, &az, &unused);
+        _hmm_batch_load_column_avx2(matrices + i, 1, &bx, &by, &bz, &unused);
+        _hmm_batch_load_column_avx2(matrices + i, 2, &cx, &cy, &cz, &unused);
+
+        const __m256 bcx = _mm256_sub_ps(_mm256_mul_ps(by, cz), _mm256_mul_ps(bz, cy));
+        const __m256 bcy = _mm256_sub_ps(_mm256_mul_ps(bz, cx), _mm256_mul_ps(bx, cz));
+        const __m256 bcz = _mm256_sub_ps(_mm256_mul_ps(bx, cy), _mm256_mul_ps(by, cx));
+        const __m256 cax = _mm256_sub_ps(_mm256_mul_ps(cy, az), _mm256_mul_ps(cz, ay));
+        const __m256 cay = _mm256_sub_ps(_mm256_mul_ps(cz, ax), _mm256_mul_ps(cx, az));
+        const __m256 caz = _mm256_sub_ps(_mm256_mul_ps(cx, ay), _mm256_mul_ps(cy, ax));
+        const __m256 abx = _mm256_sub_ps(_mm256_mul_ps(ay, bz), _mm256_mul_ps(az, by));
+        const __m256 aby = _mm256_sub_ps(_mm256_mul_ps(az, bx), _mm256_mul_ps(ax, bz));
+        const __m256 abz = _mm256_sub_ps(_mm256_mul_ps(ax, by), _mm256_mul_ps(ay, bx));
+        const __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bcx), _mm256_mul_ps(ay, bcy)), _mm256_mul_ps(az, bcz));
+        const __m256 inv_det = _mm256_div_ps(one, det);
+
+        _hmm_batch_store_column_avx2(out + i, 0, _mm256_mul_ps(bcx, inv_det), _mm256_mul_ps(bcy, inv_det), _mm256_mul_ps(bcz, inv_det), zero);
+        _hmm_batch_store_column_avx2(out + i, 1, _mm256_mul_ps(cax, inv_det), _mm256_mul_ps(cay, inv_det), _mm256_mul_ps(caz, inv_det), zero);
+        _hmm_batch_store_column_avx2(out + i, 2, _mm256_mul_ps(abx, inv_det), _mm256_mul_ps(aby, inv_det), _mm256_mul_ps(abz, inv_det), zero);
+        _hmm_batch_store_column_avx2(out + i, 3, zero, zero, zero, one);
+    }
+    _hmm_batch_inverse_transpose_sse2(out + i, matrices + i, count - i);
+}
+
+static bool _hmm_batch_cpu_has_avx2(void) {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif /* _HMM_BATCH_X64 */
+
+/*=== NEON =====================================================================*/
+#ifdef _HMM_BATCH_NEON
+
+static void _hmm_batch_transpose4_neon(float32x4_t* r0, float32x4_t* r1, float32x4_t* r2, float32x4_t* r3) {
+    const float32x4x2_t t01 = vtrnq_f32(*r0, *r1);
+    const float32x4x2_t t23 = vtrnq_f32(*r2, *r3);
+    *r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+    *r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+    *r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+    *r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+}
+
+static void _hmm_batch_store_column_neon(hmm_mat4* out, int col, float32x4_t r0, float32x4_t r1, float32x4_t r2, float32x4_t r3) {
+    _hmm_batch_transpose4_neon(&r0, &r1, &r2, &r3);
+    vst1q_f32(out[0].Elements[col], r0);
+    vst1q_f32(out[1].Elements[col], r1);
+    vst1q_f32(out[2].Elements[col], r2);
+    vst1q_f32(out[3].Elements[col], r3);
+}
+
+static void _hmm_batch_load_column_neon(const hmm_mat4* matrices, int col, float32x4_t* r0, float32x4_t* r1, float32x4_t* r2, float32x4_t* r3) {
+    *r0 = vld1q_f32(matrices[0].Elements[col]);
+    *r1 = vld1q_f32(matrices[1].Elements[col]);
+    *r2 = vld1q_f32(matrices[2].Elements[col]);
+    *r3 = vld1q_f32(matrices[3].Elements[col]);
+    _hmm_batch_transpose4_neon(r0, r1, r2, r3);
+}
+
+/* vmul and vadd instead of vmla, which may be fused depending on the compiler */
+static void _hmm_batch_multiply_mat4_neon(hmm_mat4* out, const hmm_mat4* left, const hmm_mat4* right, int count) {
+    for (int i = 0; i < count; ++i) {
+        const float* l = &left[i].Elements[0][0];
+        const float* r = &right[i].Elements[0][0];
+        const float32x4_t l0 = vld1q_f32(l + 0);
+        const float32x4_t l1 = vld1q_f32(l + 4);
+        const float32x4_t l2 = vld1q_f32(l + 8);
+        const float32x4_t l3 = vld1q_f32(l + 12);
+        float32x4_t cols[4];
+        for (int col = 0; col < 4; ++col) {
+            float32x4_t sum = vdupq_n_f32(0.0f);
+            sum = vaddq_f32(sum, vmulq_f32(l0, vdupq_n_f32(r[col * 4 + 0])));
+            sum = vaddq_f32(sum, vmulq_f32(l1, vdupq_n_f32(r[col * 4 + 1])));
+            sum = vaddq_f32(sum, vmulq_f32(l2, vdupq_n_f32(r[col * 4 + 2])));
+            sum = vaddq_f32(sum, vmulq_f32(l3, vdupq_n_f32(r[col * 4 + 3])));
+            cols[col] = sum;
+        }
+        float* o = &out[i].Elements[0][0];
+        vst1q_f32(o + 0, cols[0]);
+        vst1q_f32(o + 4, cols[1]);
+        vst1q_f32(o + 8, cols[2]);
+        vst1q_f32(o + 12, cols[3]);
+    }
+}
+
+static void _hmm_batch_multiply_mat4_vec4_neon(hmm_vec4* out, const hmm_mat4* matrices, const hmm_vec4* vectors, int count) {
+    for (int i = 0; i < count; ++i) {
+        const float* m = &matrices[i].Elements[0][0];
+        const float* v = &vectors[i].Elements[0];
+        float32x4_t sum = vdupq_n_f32(0.0f);
+        sum = vaddq_f32(sum, vmulq_f32(vld1q_f32(m + 0), vdupq_n_f32(v[0])));
+        sum = vaddq_f32(sum, vmulq_f32(vld1q_f32(m + 4), vdupq_n_f32(v[1])));
+        sum = vaddq_f32(sum, vmulq_f32(vld1q_f32(m + 8), vdupq_n_f32(v[2])));
+        sum = vaddq_f32(sum, vmulq_f32(vld1q_f32(m + 12), vdupq_n_f32(v[3])));
+        vst1q_f32(&out[i].Elements[0], sum);
+    }
+}
+
+static void _hmm_batch_trs_neon(hmm_mat4* out, const hmm_batch_trs* trs, int count) {
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t two = vdupq_n_f32(2.0f);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const float32x4_t x = vld1q_f32(trs->qx + i), y = vld1q_f32(trs->qy + i);
+        const float32x4_t z = vld1q_f32(trs->qz + i), w = vld1q_f32(trs->qw + i);
+        const float32x4_t sx = vld1q_f32(trs->sx + i), sy = vld1q_f32(trs->sy + i), sz = vld1q_f32(trs->sz + i);
+        const float32x4_t xx = vmulq_f32(x, x), yy = vmulq_f32(y, y), zz = vmulq_f32(z, z);
+        const float32x4_t xy = vmulq_f32(x, y), xz = vmulq_f32(x, z), yz = vmulq_f32(y, z);
+        const float32x4_t wx = vmulq_f32(w, x), wy = vmulq_f32(w, y), wz = vmulq_f32(w, z);
+
+        _hmm_batch_store_column_neon(out + i, 0,
+            vmulq_f32(vsubq_f32(one, vmulq_f32(two, vaddq_f32(yy, zz))), sx),
+            vmulq_f32(vmulq_f32(two, vaddq_f32(xy, wz)), sx),
+            vmulq_f32(vmulq_f32(two, vsubq_f32(xz, wy)), sx),
+            zero);
+        _hmm_batch_store_column_neon(out + i, 1,
+            vmulq_f32(vmulq_f32(two, vsubq_f32(xy, wz)), sy),
+            vmulq_f32(vsubq_f32(one, vmulq_f32(two, vaddq_f32(xx, zz))), sy),
+            vmulq_f32(vmulq_f32(two, vaddq_f32(yz, wx)), sy),
+            zero);
+        _hmm_batch_store_column_neon(out + i, 2,
+            vmulq_f32(vmulq_f32(two, vaddq_f32(xz, wy)), sz),
+            vmulq_f32(vmulq_f32(two, vsubq_f32(yz, wx)), sz),
+            vmulq_f32(vsubq_f32(one, vmulq_f32(two, vaddq_f32(xx, yy))), sz),
+            zero);
+        _hmm_batch_store_column_neon(out + i, 3,
+            vld1q_f32(trs->px + i), vld1q_f32(trs->py + i), vld1q_f32(trs->pz + i), one);
+    }
+    _hmm_batch_trs_scalar(out + i, &(hmm_batch_trs){
+        trs->px + i, trs->py + i, trs->pz + i,
+        trs->qx + i, trs->qy + i, trs->qz + i, trs->qw + i,
+        trs->sx + i, trs->sy + i, trs->sz + i
+    }, count - i);
+}
+
+static void _hmm_batch_inverse_transpose_neon(hmm_mat4* out, const hmm_mat4* matrices, int count) {
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t ax, ay, az, bx, by, bz, cx, cy, cz, unused;
+        _hmm_batch_load_column_neon(matrices + i, 0, &ax, &ay, &az, &unused);
+        _hmm_batch_load_column_neon(matrices + i, 1, &bx, &by, &bz, &unused);
+        _hmm_batch_load_column_neon(matrices + i, 2, &cx, &cy, &cz, &unused);
+
+        const float32x4_t bcx = vsubq_f32(vmulq_f32(by, cz), vmulq_f32(bz, cy));
+        const float32x4_t bcy = vsubq_f32(vmulq_f32(bz, cx), vmulq_f32(bx, cz));
+        const float32x4_t bcz = vsubq_f32(vmulq_f32(bx, cy), vmulq_f32(by, cx));
+        const float32x4_t cax = vsubq_f32(vmulq_f32(cy, az), vmulq_f32(cz, ay));
+        const float32x4_t cay = vsubq_f32(vmulq_f32(cz, ax), vmulq_f32(cx, az));
+        const float32x4_t caz = vsubq_f32(vmulq_f32(cx, ay), vmulq_f32(cy, ax));
+        const float32x4_t abx = vsubq_f32(vmulq_f32(ay, bz), vmulq_f32(az, by));
+        const float32x4_t aby = vsubq_f32(vmulq_f32(az, bx), vmulq_f32(ax, bz));
+        const float32x4_t abz = vsubq_f32(vmulq_f32(ax, by), vmulq_f32(ay, bx));
+        const float32x4_t det = vaddq_f32(vaddq_f32(vmulq_f32(ax, bcx), vmulq_f32(ay, bcy)), vmulq_f32(az, bcz));
+        /* vrecpeq is an estimate, a real division is needed to match the scalar kernel */
+        const float32x4_t inv_det = vdivq_f32(one, det);
+
+        _hmm_batch_store_column_neon(out + i, 0, vmulq_f32(bcx, inv_det), vmulq_f32(bcy, inv_det), vmulq_f32(bcz, inv_det), zero);
+        _hmm_batch_store_column_neon(out + i, 1, vmulq_f32(cax, inv_det), vmulq_f32(cay, inv_det), vmulq_f32(caz, inv_det), zero);
+        _hmm_batch_store_column_neon(out + i, 2, vmulq_f32(abx, inv_det), vmulq_f32(aby, inv_det), vmulq_f32(abz, inv_det), zero);
+        _hmm_batch_store_column_neon(out + i, 3, zero, zero, zero, one);
+    }
+    _hmm_batch_inverse_transpose_scalar(out + i, matrices + i, count - i);
+}
+
+#endif /* _HMM_BATCH_NEON */
+
+/*=== DISPATCH =================================================================*/
+
+typedef struct _hmm_batch_kernels_t {
+    void (*multiply_mat4)(hmm_mat4* out, const hmm_mat4* left, const hmm_mat4* right, int count);
+    void (*multiply_mat4_vec4)(hmm_vec4* out, const hmm_mat4* matrices, const hmm_vec4* vectors, int count);
+    void (*trs)(hmm_mat4* out, const hmm_batch_trs* trs, int count);
+    void (*inverse_transpose)(hmm_mat4* out, const hmm_mat4* matrices, int count);
+} _hmm_batch_kernels_t;
+
+static const _hmm_batch_kernels_t _hmm_batch_kernels[HMM_BATCH_NUM_ISAS] = {
+    [HMM_BATCH_SCALAR] = {
+        _hmm_batch_multiply_mat4_scalar, _hmm_batch_multiply_mat4_vec4_scalar,
+        _hmm_batch_trs_scalar, _hmm_batch_inverse_transpose_scalar
+    },
+#ifdef _HMM_BATCH_X64
+    [HMM_BATCH_SSE2] = {
+        _hmm_batch_multiply_mat4_sse2, _hmm_batch_multiply_mat4_vec4_sse2,
+        _hmm_batch_trs_sse2, _hmm_batch_inverse_transpose_sse2
+    },
+    [HMM_BATCH_AVX2] = {
+        _hmm_batch_multiply_mat4_avx2, _hmm_batch_multiply_mat4_vec4_avx2,
+        _hmm_batch_trs_avx2, _hmm_batch_inverse_transpose_avx2
+    },
+#endif
+#ifdef _HMM_BATCH_NEON
+    [HMM_BATCH_NEON] = {
+        _hmm_batch_multiply_mat4_neon, _hmm_batch_multiply_mat4_vec4_neon,
+        _hmm_batch_trs_neon, _hmm_batch_inverse_transpose_neon
+    },
+#endif
+};
+
+/* selected on first use, racing threads pick the same kernels */
+static const _hmm_batch_kernels_t* _hmm_batch_selected;
+static hmm_batch_isa _hmm_batch_selected_isa;
+
+bool HMM_BatchISASupported(hmm_batch_isa isa) {
+    switch (isa) {
+        case HMM_BATCH_SCALAR:
+            return true;
+#ifdef _HMM_BATCH_X64
+        case HMM_BATCH_SSE2:
+            return true;
+        case HMM_BATCH_AVX2:
+            return _hmm_batch_cpu_has_avx2();
+#endif
+#ifdef _HMM_BATCH_NEON
+        case HMM_BATCH_NEON:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+bool HMM_BatchSetISA(hmm_batch_isa isa) {
+    if (!HMM_BatchISASupported(isa)) {
+        return false;
+    }
+    _hmm_batch_selected_isa = isa;
+    _hmm_batch_selected = &_hmm_batch_kernels[isa];
+    return true;
+}
+
+static const _hmm_batch_kernels_t* _hmm_batch_get_kernels(void) {
+    if (!_hmm_batch_selected) {
+        for (int isa = HMM_BATCH_NUM_ISAS - 1; isa >= 0; --isa) {
+            if (HMM_BatchSetISA((hmm_batch_isa)isa)) {
+                break;
+            }
+        }
+    }
+    return _hmm_batch_selected;
+}
+
+hmm_batch_isa HMM_BatchISA(void) {
+    _hmm_batch_get_kernels();
+    return _hmm_batch_selected_isa;
+}
+
+const char* HMM_BatchISAName(hmm_batch_isa isa) {
+    switch (isa) {
+        case HMM_BATCH_SCALAR: return "scalar";
+        case HMM_BATCH_SSE2: return "sse2";
+        case HMM_BATCH_AVX2: return "avx2";
+        case HMM_BATCH_NEON: return "neon";
+        default: return "unknown";
+    }
+}
+
+void HMM_BatchMultiplyMat4(hmm_mat4* out, const hmm_mat4* left, const hmm_mat4* right, int count) {
+    _hmm_batch_get_kernels()->multiply_mat4(out, left, right, count);
+}
+
+void HMM_BatchMultiplyMat4ByVec4(hmm_vec4* out, const hmm_mat4* matrices, const hmm_vec4* vectors, int count) {
+    _hmm_batch_get_kernels()->multiply_mat4_vec4(out, matrices, vectors, count);
+}
+
+void HMM_BatchTRS(hmm_mat4* out, const hmm_batch_trs* trs, int count) {
+    _hmm_batch_get_kernels()->trs(out, trs, count);
+}
+
+void HMM_BatchInverseTranspose(hmm_mat4* out, const hmm_mat4* matrices, int count) {
+    _hmm_batch_get_kernels()->inverse_transpose(out, matrices, count);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
+
+#endif /* HMM_BATCH_IMPLEMENTATION */
@@ -15,3 +15,4 @@
 #include "sokol_glue.h"
 #include "sokol_time.h"
 #include "sokol_fetch.h"
+#include "sokol_args.h"
@@ -158,6 +158,7 @@ static void init(void) {
 
     lopgl_load_image(&(lopgl_image_request_t){
             .path = "container2_specular.png",
+            .channels = 1,
             .img_id = img_id_specular,
             .buffer_ptr = state.file_buffer,
             .buffer_size = sizeof(state.file_buffer),
@@ -58,7 +58,7 @@ uniform fs_light {
 } light;
 
 uniform sampler2D diffuse_texture;
-uniform sampler2D specular_texture;
+uniform sampler2D specular_texture;     // R8, gray in .r
 
 void main() {
     // ambient
@@ -74,7 +74,7 @@ void main() {
     vec3 viewDir = normalize(viewPos - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);  
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    vec3 specular = light.specular * spec * vec3(texture(specular_texture, TexCoords));
+    vec3 specular = light.specular * spec * vec3(texture(specular_texture, TexCoords).r);
 
     // attenuation
     float distance    = length(light.position - FragPos);
@@ -17,6 +17,7 @@ static struct {
     sg_pass_action pass_action;
     hmm_vec3 cube_positions[10];
     hmm_vec4 light_positions[4];
+    bool uniform_cache;
     uint8_t file_buffer[512 * 1024];
 } state;
 
@@ -29,6 +30,8 @@ static void fail_callback() {
 static void init(void) {
     lopgl_setup();
 
+    state.uniform_cache = true;
+
     state.bind_object.fs_images[SLOT_diffuse_texture] = sg_alloc_image();
     state.bind_object.fs_images[SLOT_specular_texture] = sg_alloc_image();
 
@@ -161,6 +164,7 @@ static void init(void) {
 
     lopgl_load_image(&(lopgl_image_request_t){
             .path = "container2_specular.png",
+            .channels = 1,
             .img_id = img_id_specular,
             .buffer_ptr = state.file_buffer,
             .buffer_size = sizeof(state.file_buffer),
@@ -168,19 +172,34 @@ static void init(void) {
     });
 }
 
+static void render_ui() {
+    lopgl_uniform_stats_t stats = lopgl_get_uniform_stats();
+
+    sdtx_canvas(sapp_width()*0.5f, sapp_height()*0.5f);
+    sdtx_origin(sapp_width()*0.5f/8.f - 24.f, 0.25f);       // each character occupies a grid fo 8x8
+    sdtx_home();
+
+    sdtx_color4b(0xff, 0x00, 0x00, 0xaf);
+    sdtx_printf("Uniform cache\t[%c]\n\n", state.uniform_cache ? '*': ' ');
+    sdtx_printf("Applied:\t%d (%u bytes)\n", stats.applied, stats.bytes_applied);
+    sdtx_printf("Skipped:\t%d (%u bytes)\n\n", stats.skipped, stats.bytes_skipped);
+    sdtx_puts("Toggle:\t'SPACE'");
+    sdtx_draw();
+}
+
 void frame(void) {
     lopgl_update();
 
     sg_begin_default_pass(&state.pass_action, sapp_width(), sapp_height());
 
-    sg_apply_pipeline(state.pip_object);
+    lopgl_apply_pipeline(state.pip_object);
     sg_apply_bindings(&state.bind_object);
 
     fs_params_t fs_params = {
         .view_pos = lopgl_camera_position(),
         .material_shininess = 32.0f,
     };
-    sg_apply_uniforms(SG_SHADERSTAGE_FS, SLOT_fs_params, &fs_params, sizeof(fs_params));
+    lopgl_apply_uniforms(SG_SHADERSTAGE_FS, SLOT_fs_params, &fs_params, sizeof(fs_params));
     
     fs_dir_light_t fs_dir_light = {
         .direction = HMM_Vec3(-0.2f, -1.0f, -0.3f),
@@ -188,7 +207,7 @@ void frame(void) {
         .diffuse = HMM_Vec3(0.4f, 0.4f, 0.4f),
         .specular = HMM_Vec3(0.5f, 0.5f, 0.5f)
     };
-    sg_apply_uniforms(SG_SHADERSTAGE_FS, SLOT_fs_dir_light, &fs_dir_light, sizeof(fs_dir_light));
+    lopgl_apply_uniforms(SG_SHADERSTAGE_FS, SLOT_fs_dir_light, &fs_dir_light, sizeof(fs_dir_light));
 
     fs_point_lights_t fs_point_lights = {
         .position[0]    = state.light_positions[0],
@@ -212,7 +231,7 @@ void frame(void) {
         .specular[3]    = HMM_Vec4(1.0f, 1.0f, 1.0f, 0.0f),
         .attenuation[3] = HMM_Vec4(1.0f, 0.09f, 0.032f, 0.0f)
     };
-    sg_apply_uniforms(SG_SHADERSTAGE_FS, SLOT_fs_point_lights, &fs_point_lights, sizeof(fs_point_lights_t));
+    lopgl_apply_uniforms(SG_SHADERSTAGE_FS, SLOT_fs_point_lights, &fs_point_lights, sizeof(fs_point_lights_t));
     
     fs_spot_light_t fs_spot_light = {
         .position = lopgl_camera_position(),
@@ -225,7 +244,7 @@ void frame(void) {
         .specular = HMM_Vec3(1.0f, 1.0f, 1.0f)
     };
 
-    sg_apply_uniforms(SG_SHADERSTAGE_FS, SLOT_fs_spot_light, &fs_spot_light, sizeof(fs_spot_light));
+    lopgl_apply_uniforms(SG_SHADERSTAGE_FS, SLOT_fs_spot_light, &fs_spot_light, sizeof(fs_spot_light));
 
     hmm_mat4 view = lopgl_view_matrix();
     hmm_mat4 projection = HMM_Perspective(lopgl_fov(), (float)sapp_width() / (float)sapp_height(), 0.1f, 100.0f);
@@ -240,12 +259,12 @@ void frame(void) {
         float angle = 20.0f * i; 
         model = HMM_MultiplyMat4(model, HMM_Rotate(angle, HMM_Vec3(1.0f, 0.3f, 0.5f)));
         vs_params.model = model;
-        sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &vs_params, sizeof(vs_params));
+        lopgl_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &vs_params, sizeof(vs_params));
 
         sg_draw(0, 36, 1);
     }
 
-    sg_apply_pipeline(state.pip_light);
+    lopgl_apply_pipeline(state.pip_light);
     sg_apply_bindings(&state.bind_light);
 
     hmm_mat4 scale = HMM_Scale(HMM_Vec3(0.2f, 0.2f, 0.2f));
@@ -254,11 +273,15 @@ void frame(void) {
         hmm_vec3 pos = HMM_Vec3(state.light_positions[i].X, state.light_positions[i].Y, state.light_positions[i].Z);
         vs_params.model = HMM_Translate(pos);
         vs_params.model = HMM_MultiplyMat4(vs_params.model, scale);
-        sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &vs_params, sizeof(vs_params));
+        lopgl_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &vs_params, sizeof(vs_params));
 
         sg_draw(0, 36, 1);
     }
 
+    if (lopgl_ui_visible()) {
+        render_ui();
+    }
+
     lopgl_render_help();
 
     sg_end_pass();
@@ -267,6 +290,13 @@ void frame(void) {
 
 void event(const sapp_event* e) {
     lopgl_handle_input(e);
+
+    if (e->type == SAPP_EVENTTYPE_KEY_DOWN) {
+        if (e->key_code == SAPP_KEYCODE_SPACE) {
+            state.uniform_cache = !state.uniform_cache;
+            lopgl_set_uniform_cache(state.uniform_cache);
+        }
+    }
 }
 
 void cleanup(void) {
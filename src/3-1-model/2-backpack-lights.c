@@ -72,6 +72,7 @@ static void load_obj_callback(lopgl_obj_response_t* response) {
 
     lopgl_load_image(&(lopgl_image_request_t){
         .path = mesh->materials[0].map_Ks.name,
+        .channels = 1,
         .img_id = img_id_specular,
         .buffer_ptr = state.file_buffer,
         .buffer_size = sizeof(state.file_buffer),
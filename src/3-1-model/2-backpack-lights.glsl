@@ -41,7 +41,7 @@ uniform fs_params {
 };
 
 uniform sampler2D diffuse_texture;
-uniform sampler2D specular_texture;
+uniform sampler2D specular_texture;     // R8, gray in .r
 
 uniform fs_dir_light {
     vec3 direction;
@@ -136,7 +136,7 @@ vec3 calc_dir_light(dir_light_t light, vec3 normal, vec3 view_dir) {
     // combine results
     vec3 ambient  = light.ambient  * vec3(texture(diffuse_texture, tex_coords));
     vec3 diffuse  = light.diffuse  * diff * vec3(texture(diffuse_texture, tex_coords));
-    vec3 specular = light.specular * spec * vec3(texture(specular_texture, tex_coords));
+    vec3 specular = light.specular * spec * vec3(texture(specular_texture, tex_coords).r);
     return (ambient + diffuse + specular);
 }
 
@@ -154,7 +154,7 @@ vec3 calc_point_light(point_light_t light, vec3 normal, vec3 frag_pos, vec3 view
     // combine results
     vec3 ambient  = light.ambient  * vec3(texture(diffuse_texture, tex_coords));
     vec3 diffuse  = light.diffuse  * diff * vec3(texture(diffuse_texture, tex_coords));
-    vec3 specular = light.specular * spec * vec3(texture(specular_texture, tex_coords));
+    vec3 specular = light.specular * spec * vec3(texture(specular_texture, tex_coords).r);
     ambient  *= attenuation;
     diffuse  *= attenuation;
     specular *= attenuation;
@@ -0,0 +1,364 @@
+//------------------------------------------------------------------------------
+//  Instancing (10)
+//------------------------------------------------------------------------------
+#include "sokol_app.h"
+#include "sokol_gfx.h"
+#include "hmm/HandmadeMath.h"
+#define LOPGL_APP_IMPL
+#include "../lopgl_app.h"
+#define LOPGL_BVH_IMPL
+#include "../lopgl_bvh.h"
+
+#define MAX_OBJECTS 1000000
+#define NUM_LOADS 3
+/* mouse picks and light volumes per query run */
+#define NUM_RAYS 64
+#define NUM_SPHERES 64
+#define LIGHT_RADIUS 5.f
+/* orbit step of the asteroids before each refit */
+#define ORBIT_STEP 0.01f
+
+static const int object_loads[NUM_LOADS] = { 10000, 100000, MAX_OBJECTS };
+static const char* load_names[NUM_LOADS] = { "10k", "100k", "1M" };
+
+typedef enum bench_kernel {
+    BENCH_BUILD,
+    BENCH_REFIT,
+    BENCH_FRUSTUM_BVH,
+    BENCH_FRUSTUM_SCAN,
+    BENCH_RAY_BVH,
+    BENCH_RAY_SCAN,
+    BENCH_SPHERE_BVH,
+    BENCH_SPHERE_SCAN,
+    BENCH_NUM_KERNELS
+} bench_kernel;
+
+static const char* kernel_names[BENCH_NUM_KERNELS] = {
+    "build", "refit", "frustum", "  scan", "ray x64", "  scan", "light x64", "  scan"
+};
+
+/* what a query found, the bvh and the scan have to agree on it */
+typedef struct query_result_t {
+    int64_t count;
+    int64_t index_sum;
+    double t_sum;
+} query_result_t;
+
+/* an asteroid of the field from the asteroid examples */
+typedef struct asteroid_t {
+    float angle;
+    float orbit_radius;
+    float orbit_speed;
+    float height;
+    float size;
+} asteroid_t;
+
+/* application state */
+static struct {
+    lopgl_bvh_t bvh;
+    int load;
+    int num_objects;
+    asteroid_t asteroids[MAX_OBJECTS];
+    lopgl_aabb_t bounds[MAX_OBJECTS];
+    int results[MAX_OBJECTS];
+    hmm_mat4 view_projection;
+    hmm_vec3 eye;
+    hmm_vec3 ray_directions[NUM_RAYS];
+    hmm_vec3 light_positions[NUM_SPHERES];
+    query_result_t bvh_results[BENCH_NUM_KERNELS];
+    /* best time in ms per kernel and load */
+    double best_ms[BENCH_NUM_KERNELS][NUM_LOADS];
+    bool identical[BENCH_NUM_KERNELS][NUM_LOADS];
+    int next_run;
+    int runs;
+    sg_pass_action pass_action;
+} state;
+
+static float random_float(float min, float max) {
+    return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+static void update_bounds(void) {
+    for (int i = 0; i < state.num_objects; ++i) {
+        const asteroid_t* a = &state.asteroids[i];
+        const hmm_vec3 center = HMM_Vec3(HMM_SinF(a->angle) * a->orbit_radius, a->height, HMM_CosF(a->angle) * a->orbit_radius);
+        const hmm_vec3 extent = HMM_Vec3(a->size, a->size, a->size);
+        state.bounds[i] = (lopgl_aabb_t){ HMM_SubtractVec3(center, extent), HMM_AddVec3(center, extent) };
+    }
+}
+
+/* the same ring of asteroids as the asteroid field examples, with more or fewer asteroids */
+static void set_load(int load) {
+    state.load = load;
+    state.num_objects = object_loads[load];
+
+    const float radius = 100.f;
+    const float offset = 25.f;
+    srand(42);
+    for (int i = 0; i < state.num_objects; ++i) {
+        const float orbit_radius = radius + random_float(-offset, offset);
+        state.asteroids[i] = (asteroid_t){
+            .angle = (float)i / (float)state.num_objects * 2.f * HMM_PI32 - HMM_PI32,
+            .orbit_radius = orbit_radius,
+            .orbit_speed = HMM_PowerF(radius / orbit_radius, 1.5f),
+            .height = random_float(-offset, offset) * 0.4f,
+            .size = random_float(0.05f, 0.25f)
+        };
+    }
+    update_bounds();
+}
+
+static void move_asteroids(void) {
+    for (int i = 0; i < state.num_objects; ++i) {
+        state.asteroids[i].angle += state.asteroids[i].orbit_speed * ORBIT_STEP;
+    }
+    update_bounds();
+}
+
+/* a camera flying along the ring, picking with rays through random pixels and lights scattered over the ring */
+static void init_queries(void) {
+    state.eye = HMM_Vec3(100.f, 2.f, 0.f);
+    const hmm_vec3 target = HMM_Vec3(70.f, 0.f, -70.f);
+    const hmm_vec3 world_up = HMM_Vec3(0.f, 1.f, 0.f);
+    const float aspect = 800.f / 600.f;
+    const hmm_mat4 view = HMM_LookAt(state.eye, target, world_up);
+    const hmm_mat4 projection = HMM_Perspective(45.f, aspect, 0.1f, 100.f);
+    state.view_projection = HMM_MultiplyMat4(projection, view);
+
+    const hmm_vec3 front = HMM_NormalizeVec3(HMM_SubtractVec3(target, state.eye));
+    const hmm_vec3 right = HMM_NormalizeVec3(HMM_Cross(front, world_up));
+    const hmm_vec3 up = HMM_Cross(right, front);
+    const float tan_half_fov = HMM_TanF(HMM_ToRadians(45.f) * 0.5f);
+    for (int i = 0; i < NUM_RAYS; ++i) {
+        const hmm_vec3 x = HMM_MultiplyVec3f(right, random_float(-1.f, 1.f) * tan_half_fov * aspect);
+        const hmm_vec3 y = HMM_MultiplyVec3f(up, random_float(-1.f, 1.f) * tan_half_fov);
+        state.ray_directions[i] = HMM_NormalizeVec3(HMM_AddVec3(front, HMM_AddVec3(x, y)));
+    }
+
+    for (int i = 0; i < NUM_SPHERES; ++i) {
+        const float angle = random_float(-HMM_PI32, HMM_PI32);
+        const float orbit_radius = random_float(75.f, 125.f);
+        state.light_positions[i] = HMM_Vec3(HMM_SinF(angle) * orbit_radius, random_float(-10.f, 10.f), HMM_CosF(angle) * orbit_radius);
+    }
+}
+
+static void add_indices(query_result_t* result, int count) {
+    result->count += count;
+    for (int i = 0; i < count; ++i) {
+        result->index_sum += state.results[i];
+    }
+}
+
+static query_result_t run_query(bench_kernel kernel) {
+    query_result_t result = { 0 };
+    const int n = state.num_objects;
+    hmm_vec4 planes[6];
+
+    switch (kernel) {
+        case BENCH_FRUSTUM_BVH:
+            add_indices(&result, lopgl_query_bvh_frustum(&state.bvh, state.view_projection, state.results, MAX_OBJECTS));
+            break;
+        case BENCH_FRUSTUM_SCAN: {
+            lopgl_frustum_planes(state.view_projection, planes);
+            int count = 0;
+            for (int i = 0; i < n; ++i) {
+                if (lopgl_aabb_in_frustum(&state.bounds[i], planes)) {
+                    state.results[count++] = i;
+                }
+            }
+            add_indices(&result, count);
+            break;
+        }
+        case BENCH_RAY_BVH:
+            for (int r = 0; r < NUM_RAYS; ++r) {
+                lopgl_bvh_hit_t hit;
+                if (lopgl_raycast_bvh(&state.bvh, state.eye, state.ray_directions[r], 100.f, &hit)) {
+                    result.count++;
+                    result.t_sum += hit.t;
+                }
+            }
+            break;
+        case BENCH_RAY_SCAN:
+            for (int r = 0; r < NUM_RAYS; ++r) {
+                const hmm_vec3 d = state.ray_directions[r];
+                const hmm_vec3 inv_direction = HMM_Vec3(1.f / d.X, 1.f / d.Y, 1.f / d.Z);
+                float nearest = -1.f;
+                for (int i = 0; i < n; ++i) {
+                    const float t = lopgl_ray_aabb(&state.bounds[i], state.eye, inv_direction, 100.f);
+                    if (t >= 0.f && (nearest < 0.f || t < nearest)) {
+                        nearest = t;
+                    }
+                }
+                if (nearest >= 0.f) {
+                    result.count++;
+                    result.t_sum += nearest;
+                }
+            }
+            break;
+        case BENCH_SPHERE_BVH:
+            for (int s = 0; s < NUM_SPHERES; ++s) {
+                add_indices(&result, lopgl_query_bvh_sphere(&state.bvh, state.light_positions[s], LIGHT_RADIUS, state.results, MAX_OBJECTS));
+            }
+            break;
+        default:
+            for (int s = 0; s < NUM_SPHERES; ++s) {
+                int count = 0;
+                for (int i = 0; i < n; ++i) {
+                    if (lopgl_aabb_in_sphere(&state.bounds[i], state.light_positions[s], LIGHT_RADIUS)) {
+                        state.results[count++] = i;
+                    }
+                }
+                add_indices(&result, count);
+            }
+            break;
+    }
+    return result;
+}
+
+/* times one kernel per frame so the window stays responsive, all kernels of a load run before the next load */
+static void run_next_benchmark(void) {
+    const int run = state.next_run;
+    state.next_run = (state.next_run + 1) % (BENCH_NUM_KERNELS * NUM_LOADS);
+    if (state.next_run == 0) {
+        state.runs++;
+    }
+
+    const int load = run / BENCH_NUM_KERNELS;
+    const bench_kernel kernel = run % BENCH_NUM_KERNELS;
+
+    if (kernel == BENCH_BUILD && load != state.load) {
+        set_load(load);
+    }
+    else if (kernel == BENCH_REFIT) {
+        move_asteroids();
+    }
+
+    query_result_t result = { 0 };
+    uint64_t start = stm_now();
+    if (kernel == BENCH_BUILD) {
+        lopgl_build_bvh(&state.bvh, state.bounds, state.num_objects);
+    }
+    else if (kernel == BENCH_REFIT) {
+        lopgl_refit_bvh(&state.bvh, state.bounds);
+    }
+    else {
+        result = run_query(kernel);
+    }
+    const double ms = stm_ms(stm_since(start));
+
+    double* best = &state.best_ms[kernel][load];
+    if (*best == 0.0 || ms < *best) {
+        *best = ms;
+    }
+
+    /* the scans run right after the bvh queries, on the same bounds */
+    if (kernel == BENCH_FRUSTUM_BVH || kernel == BENCH_RAY_BVH || kernel == BENCH_SPHERE_BVH) {
+        state.bvh_results[kernel] = result;
+    }
+    else if (kernel == BENCH_FRUSTUM_SCAN || kernel == BENCH_RAY_SCAN || kernel == BENCH_SPHERE_SCAN) {
+        const query_result_t* expected = &state.bvh_results[kernel - 1];
+        state.identical[kernel - 1][load] = expected->count == result.count &&
+                                            expected->index_sum == result.index_sum &&
+                                            expected->t_sum == result.t_sum;
+    }
+}
+
+static void init(void) {
+    lopgl_setup();
+
+    lopgl_init_bvh(&state.bvh, &(lopgl_bvh_desc_t){
+        .capacity = MAX_OBJECTS
+    });
+
+    init_queries();
+    state.load = -1;
+
+    for (int kernel = 0; kernel < BENCH_NUM_KERNELS; ++kernel) {
+        for (int load = 0; load < NUM_LOADS; ++load) {
+            state.identical[kernel][load] = true;
+        }
+    }
+
+    /* a pass action to clear framebuffer */
+    state.pass_action = (sg_pass_action) {
+        .colors[0] = { .action=SG_ACTION_CLEAR, .val={0.1f, 0.1f, 0.1f, 1.0f} }
+    };
+}
+
+static void render_ui() {
+    sdtx_canvas(sapp_width()*0.5f, sapp_height()*0.5f);
+    sdtx_origin(0.25f, sapp_height()*0.5f/8.f - 16.f);     // below the help text
+    sdtx_home();
+
+    sdtx_color4b(0xff, 0xff, 0xff, 0xaf);
+    sdtx_printf("Asteroids, best ms of %d runs\n\n", state.runs);
+    sdtx_printf("%-10s", "");
+    for (int load = 0; load < NUM_LOADS; ++load) {
+        sdtx_printf(" %8s", load_names[load]);
+    }
+    sdtx_puts("\n");
+
+    for (int kernel = 0; kernel < BENCH_NUM_KERNELS; ++kernel) {
+        sdtx_printf("%-10s", kernel_names[kernel]);
+        for (int load = 0; load < NUM_LOADS; ++load) {
+            const double ms = state.best_ms[kernel][load];
+            sdtx_color4b(0xff, 0xff, 0xff, 0xaf);
+            if (!state.identical[kernel][load]) {
+                /* the bvh found other objects than the scan */
+                sdtx_color4b(0xff, 0x00, 0x00, 0xaf);
+            }
+            if (ms > 0.0) {
+                sdtx_printf(" %8.3f", ms);
+            } else {
+                sdtx_printf(" %8s", "-");
+            }
+        }
+        sdtx_puts("\n");
+    }
+
+    sdtx_color4b(0xff, 0xff, 0xff, 0xaf);
+    if (state.bvh.num_nodes > 0) {
+        sdtx_printf("\n%d nodes, depth %d\n", state.bvh.num_nodes, state.bvh.depth);
+    }
+    sdtx_puts("Red: bvh differs from the scan");
+    sdtx_draw();
+}
+
+void frame(void) {
+    lopgl_update();
+
+    run_next_benchmark();
+
+    sg_begin_default_pass(&state.pass_action, sapp_width(), sapp_height());
+
+    lopgl_render_help();
+
+    if (lopgl_ui_visible()) {
+        render_ui();
+    }
+
+    sg_end_pass();
+    sg_commit();
+}
+
+void event(const sapp_event* e) {
+    lopgl_handle_input(e);
+}
+
+void cleanup(void) {
+    lopgl_destroy_bvh(&state.bvh);
+    lopgl_shutdown();
+}
+
+sapp_desc sokol_main(int argc, char* argv[]) {
+    return (sapp_desc){
+        .init_cb = init,
+        .frame_cb = frame,
+        .cleanup_cb = cleanup,
+        .event_cb = event,
+        .width = 800,
+        .height = 600,
+        .gl_force_gles2 = true,
+        .window_title = "BVH Queries (LearnOpenGL)",
+    };
+}
@@ -13,6 +13,7 @@
 
 typedef struct mesh_t {
     sg_pipeline pip;
+    sg_pipeline instanced_pip;
     sg_bindings bind;
     unsigned int face_count;
 } mesh_t;
@@ -22,6 +23,9 @@ static struct {
     mesh_t planet;
     mesh_t rock;
     hmm_mat4 rock_transforms[ASTEROID_COUNT];
+    bool batching;
+    double submit_ms;
+    int draw_calls;
     sg_pass_action pass_action;
     uint8_t file_buffer_planet[1024 * 1024];
     uint8_t file_buffer_rock[1024 * 1024];
@@ -129,6 +133,30 @@ static void init(void) {
         },
         .label = "rock-pipeline"
     });
+
+    /* the draw queue merges the asteroids with this pipeline, the model matrices come from a second buffer */
+    state.rock.instanced_pip = sg_make_pipeline(&(sg_pipeline_desc){
+        .shader = sg_make_shader(phong_instanced_shader_desc()),
+        .layout = {
+            .attrs = {
+                [ATTR_vs_instanced_a_pos] = { .format = SG_VERTEXFORMAT_FLOAT3, .buffer_index = 0 },
+                [ATTR_vs_instanced_a_tex_coords] = { .format = SG_VERTEXFORMAT_FLOAT2, .offset = 24, .buffer_index = 0 },
+                [ATTR_vs_instanced_instance_mat0] = { .format = SG_VERTEXFORMAT_FLOAT4, .offset = 0, .buffer_index = 1 },
+                [ATTR_vs_instanced_instance_mat1] = { .format = SG_VERTEXFORMAT_FLOAT4, .offset = 16, .buffer_index = 1 },
+                [ATTR_vs_instanced_instance_mat2] = { .format = SG_VERTEXFORMAT_FLOAT4, .offset = 32, .buffer_index = 1 },
+                [ATTR_vs_instanced_instance_mat3] = { .format = SG_VERTEXFORMAT_FLOAT4, .offset = 48, .buffer_index = 1 }
+            },
+            .buffers[0] = { .stride = 32, .step_func = SG_VERTEXSTEP_PER_VERTEX },
+            .buffers[1] = { .stride = 64, .step_func = SG_VERTEXSTEP_PER_INSTANCE }
+        },
+        .depth_stencil = {
+            .depth_compare_func = SG_COMPAREFUNC_LESS_EQUAL,
+            .depth_write_enabled = true,
+        },
+        .label = "rock-instanced-pipeline"
+    });
+
+    state.batching = true;
     
     /* a pass action to clear framebuffer */
     state.pass_action = (sg_pass_action) {
@@ -180,29 +208,18 @@ static void init(void) {
     }  
 }
 
-void frame(void) {
-    lopgl_update();
-
-    sg_begin_default_pass(&state.pass_action, sapp_width(), sapp_height());
-
-    hmm_mat4 view = lopgl_view_matrix();
-    hmm_mat4 projection = HMM_Perspective(lopgl_fov(), (float)sapp_width() / (float)sapp_height(), 0.1f, 1000.0f);
-
-    vs_params_t vs_params = {
-        .view = view,
-        .projection = projection
-    };
-
+static void draw_direct(vs_params_t* vs_params) {
     if (state.planet.face_count > 0) {
         sg_apply_pipeline(state.planet.pip);
         sg_apply_bindings(&state.planet.bind);
 
         hmm_mat4 model = HMM_Translate(HMM_Vec3(0.f, -3.f, 0.f));
         model = HMM_MultiplyMat4(model, HMM_Scale(HMM_Vec3(4.f, 4.f, 4.f)));
-        vs_params.model = model;
-        sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &vs_params, sizeof(vs_params));
+        vs_params->model = model;
+        sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, vs_params, sizeof(vs_params_t));
 
         sg_draw(0, state.planet.face_count * 3, 1);
+        state.draw_calls += 1;
     }
 
     if (state.rock.face_count > 0) {
@@ -210,20 +227,110 @@ void frame(void) {
         sg_apply_bindings(&state.rock.bind);
 
         for (size_t i = 0; i < ASTEROID_COUNT; ++i) {
-            vs_params.model = state.rock_transforms[i];
-            sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &vs_params, sizeof(vs_params));
+            vs_params->model = state.rock_transforms[i];
+            sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, vs_params, sizeof(vs_params_t));
             sg_draw(0, state.rock.face_count * 3, 1);
         }
+        state.draw_calls += ASTEROID_COUNT;
+    }
+}
+
+/* the same draws as above, merged by the draw queue */
+static void draw_queued(vs_params_t* vs_params) {
+    if (state.planet.face_count > 0) {
+        hmm_mat4 model = HMM_Translate(HMM_Vec3(0.f, -3.f, 0.f));
+        model = HMM_MultiplyMat4(model, HMM_Scale(HMM_Vec3(4.f, 4.f, 4.f)));
+
+        lopgl_queue_draw(&(lopgl_draw_mesh_t){
+            .bind = state.planet.bind,
+            .num_elements = state.planet.face_count * 3
+        }, &(lopgl_draw_material_t){
+            .pip = state.planet.pip,
+            .vs_uniform_slot = SLOT_vs_params,
+            .vs_uniforms = vs_params,
+            .vs_uniforms_size = sizeof(vs_params_t),
+            .model_offset = offsetof(vs_params_t, model)
+        }, model);
     }
 
+    if (state.rock.face_count > 0) {
+        const lopgl_draw_mesh_t mesh = {
+            .bind = state.rock.bind,
+            .num_elements = state.rock.face_count * 3
+        };
+        const lopgl_draw_material_t material = {
+            .pip = state.rock.pip,
+            .instanced_pip = state.rock.instanced_pip,
+            .instance_buffer_index = 1,
+            .vs_uniform_slot = SLOT_vs_params,
+            .vs_uniforms = vs_params,
+            .vs_uniforms_size = sizeof(vs_params_t),
+            .model_offset = offsetof(vs_params_t, model)
+        };
+
+        for (size_t i = 0; i < ASTEROID_COUNT; ++i) {
+            lopgl_queue_draw(&mesh, &material, state.rock_transforms[i]);
+        }
+    }
+
+    lopgl_flush_draws();
+}
+
+static void render_ui() {
+    sdtx_canvas(sapp_width()*0.5f, sapp_height()*0.5f);
+    sdtx_origin(sapp_width()*0.5f/8.f - 24.f, 0.25f);       // each character occupies a grid fo 8x8
+    sdtx_home();
+
+    sdtx_color4b(0xff, 0x00, 0x00, 0xaf);
+    sdtx_printf("Draw queue\t[%c]\n\n", state.batching ? '*': ' ');
+    sdtx_printf("Draw calls:\t%d\n", state.draw_calls);
+    sdtx_printf("Submit:\t%.3f ms\n\n", state.submit_ms);
+    sdtx_puts("Toggle:\t'SPACE'");
+    sdtx_draw();
+}
+
+void frame(void) {
+    lopgl_update();
+
+    sg_begin_default_pass(&state.pass_action, sapp_width(), sapp_height());
+
+    hmm_mat4 view = lopgl_view_matrix();
+    hmm_mat4 projection = HMM_Perspective(lopgl_fov(), (float)sapp_width() / (float)sapp_height(), 0.1f, 1000.0f);
+
+    vs_params_t vs_params = {
+        .view = view,
+        .projection = projection
+    };
+
+    const uint64_t submit_start = stm_now();
+    if (state.batching) {
+        draw_queued(&vs_params);
+        /* the draw queue reports the previous frame */
+        state.draw_calls = lopgl_get_draw_stats().draw_calls;
+    } else {
+        state.draw_calls = 0;
+        draw_direct(&vs_params);
+    }
+    state.submit_ms = state.submit_ms * 0.95 + stm_ms(stm_since(submit_start)) * 0.05;
+
     lopgl_render_help();
 
+    if (lopgl_ui_visible()) {
+        render_ui();
+    }
+
     sg_end_pass();
     sg_commit();
 }
 
 void event(const sapp_event* e) {
     lopgl_handle_input(e);
+
+    if (e->type == SAPP_EVENTTYPE_KEY_DOWN) {
+        if (e->key_code == SAPP_KEYCODE_SPACE) {
+            state.batching = !state.batching;
+        }
+    }
 }
 
 void cleanup(void) {
@@ -1,17 +1,21 @@
 @ctype vec3 hmm_vec3
 @ctype mat4 hmm_mat4
 
+@block vs_params
+uniform vs_params {
+    mat4 model;
+    mat4 view;
+    mat4 projection;
+};
+@end
+
 @vs vs
 in vec3 a_pos;
 in vec2 a_tex_coords;
 
 out vec2 tex_coords;
 
-uniform vs_params {
-    mat4 model;
-    mat4 view;
-    mat4 projection;
-};
+@include_block vs_params
 
 void main() {
     gl_Position = projection * view * model * vec4(a_pos, 1.0);
@@ -19,6 +23,26 @@ void main() {
 }
 @end
 
+@vs vs_instanced
+// used by the draw queue to merge the asteroids, the uniform model matrix is identity
+in vec3 a_pos;
+in vec2 a_tex_coords;
+in vec4 instance_mat0;
+in vec4 instance_mat1;
+in vec4 instance_mat2;
+in vec4 instance_mat3;
+
+out vec2 tex_coords;
+
+@include_block vs_params
+
+void main() {
+    mat4 instance_model = mat4(instance_mat0, instance_mat1, instance_mat2, instance_mat3);
+    gl_Position = projection * view * model * instance_model * vec4(a_pos, 1.0);
+    tex_coords = a_tex_coords;
+}
+@end
+
 @fs fs
 in vec2 tex_coords;
 
@@ -32,3 +56,4 @@ void main() {
 @end
 
 @program phong vs fs
+@program phong_instanced vs_instanced fs
@@ -15,41 +15,36 @@ typedef struct mesh_t {
     sg_pipeline pip;
     sg_bindings bind;
     unsigned int face_count;
+    lopgl_asset_handle obj;
+    lopgl_asset_handle texture;
 } mesh_t;
 
 /* application state */
 static struct {
     mesh_t planet;
     mesh_t rock;
+    lopgl_asset_handle objs;
+    lopgl_asset_handle textures;
     hmm_mat4 rock_transforms[ASTEROID_COUNT];
     sg_pass_action pass_action;
-    uint8_t file_buffer_planet[1024 * 1024];
-    uint8_t file_buffer_rock[1024 * 1024];
-    uint8_t file_buffer_img[3 * 1024 * 1024];
     float vertex_buffer[1024 * 8 * 3];
 } state;
 
-static void fail_callback() {
-    state.pass_action = (sg_pass_action) {
-        .colors[0] = { .action = SG_ACTION_CLEAR, .val = { 1.0f, 0.0f, 0.0f, 1.0f } }
-    };
-}
-
-static void load_obj_callback(lopgl_obj_response_t* response) {
-    mesh_t* mesh = (mesh_t*) response->user_data_ptr;
-    mesh->face_count = response->mesh->face_count;
+static void create_mesh(mesh_t* mesh) {
+    fastObjMesh* obj = lopgl_asset_mesh(mesh->obj);
+    mesh->face_count = obj->face_count;
 
     for (unsigned int i = 0; i < mesh->face_count * 3; ++i) {
-        fastObjIndex vertex = response->mesh->indices[i];
+        fastObjIndex vertex = obj->indices[i];
 
         unsigned int pos = i * 8;
         unsigned int v_pos = vertex.p * 3;
         unsigned int n_pos = vertex.n * 3;
         unsigned int t_pos = vertex.t * 2;
 
-        memcpy(state.vertex_buffer + pos, response->mesh->positions + v_pos, 3 * sizeof(float));
-        memcpy(state.vertex_buffer + pos + 3, response->mesh->normals + n_pos, 3 * sizeof(float));
-        memcpy(state.vertex_buffer + pos + 6, response->mesh->texcoords + t_pos, 2 * sizeof(float));
+        memcpy(state.vertex_buffer + pos, obj->positions + v_pos, 3 * sizeof(float));
+        memcpy(state.vertex_buffer + pos + 3, obj->normals + n_pos, 3 * sizeof(float));
+        memcpy(state.vertex_buffer + pos + 6, obj->texcoords + t_pos, 2 * sizeof(float));
     }
 
     sg_buffer cube_buffer = sg_make_buffer(&(sg_buffer_desc){
@@ -59,19 +54,39 @@ static void load_obj_callback(lopgl_obj_response_t* response) {
     });
     
     mesh->bind.vertex_buffers[0] = cube_buffer;
-    sg_image img_id = sg_alloc_image();
-    mesh->bind.fs_images[SLOT_diffuse_texture] = img_id;
 
-    lopgl_load_image(&(lopgl_image_request_t){
-        .path = response->mesh->materials[0].map_Kd.name,
-        .img_id = img_id,
+    mesh->texture = lopgl_request_asset(&(lopgl_asset_desc_t){
+        .type = LOPGL_ASSETTYPE_IMAGE,
+        .path = obj->materials[0].map_Kd.name,
         /* Webgl 1.0 does not support repeat for textures that are not a power of two in size */
         .wrap_u = SG_WRAP_CLAMP_TO_EDGE,
         .wrap_v = SG_WRAP_CLAMP_TO_EDGE,
-        .buffer_ptr = state.file_buffer_img,
-        .buffer_size = sizeof(state.file_buffer_img),
-        .fail_callback = fail_callback
+        /* the meshes are drawn with the small mip levels while the rest streams in */
+        .stream = true
     });
+
+    /* the de-indexed vertices live in the vertex buffer now */
+    lopgl_release_asset(mesh->obj);
+}
+
+/* creates the meshes once both objs are parsed, and waits for their textures */
+static void update_assets(void) {
+    lopgl_asset_state objs_state = lopgl_query_asset(state.objs);
+
+    if (objs_state == LOPGL_ASSET_READY) {
+        create_mesh(&state.planet);
+        create_mesh(&state.rock);
+        lopgl_release_asset(state.objs);
+
+        const lopgl_asset_handle textures[2] = { state.planet.texture, state.rock.texture };
+        state.textures = lopgl_when_all(textures, 2);
+    }
+
+    if (objs_state == LOPGL_ASSET_FAILED || lopgl_query_asset(state.textures) == LOPGL_ASSET_FAILED) {
+        state.pass_action = (sg_pass_action) {
+            .colors[0] = { .action = SG_ACTION_CLEAR, .val = { 1.0f, 0.0f, 0.0f, 1.0f } }
+        };
+    }
 }
 
 static void init(void) {
@@ -137,23 +152,13 @@ static void init(void) {
         .colors[0] = { .action=SG_ACTION_CLEAR, .val={0.1f, 0.1f, 0.1f, 1.0f} }
     };
 
-    lopgl_load_obj(&(lopgl_obj_request_t){
-        .path = "planet.obj",
-        .callback = load_obj_callback,
-        .fail_callback = fail_callback,
-        .buffer_ptr = state.file_buffer_planet,
-        .buffer_size = sizeof(state.file_buffer_planet),
-        .user_data_ptr = &state.planet
-    });
-
-    lopgl_load_obj(&(lopgl_obj_request_t){
-        .path = "rock.obj",
-        .callback = load_obj_callback,
-        .fail_callback = fail_callback,
-        .buffer_ptr = state.file_buffer_rock,
-        .buffer_size = sizeof(state.file_buffer_rock),
-        .user_data_ptr = &state.rock
-    });
+    lopgl_asset_handle objs[2];
+    state.objs = lopgl_request_assets((lopgl_asset_desc_t[]){
+        { .type = LOPGL_ASSETTYPE_OBJ, .path = "planet.obj" },
+        { .type = LOPGL_ASSETTYPE_OBJ, .path = "rock.obj" }
+    }, 2, objs);
+    state.planet.obj = objs[0];
+    state.rock.obj = objs[1];
 
     srand(stm_now()); // initialize random seed	
     float radius = 100.f;
@@ -190,15 +195,43 @@ static void init(void) {
     state.rock.bind.vertex_buffers[1] = transform_buffer;
 }
 
+static void render_stream_stats(const char* name, lopgl_asset_handle texture) {
+    lopgl_stream_stats_t stats = lopgl_stream_stats(texture);
+    sdtx_printf("%s %dx%d\n", name, stats.width, stats.height);
+    sdtx_printf("Mip level:\t%d/%d\n", stats.resident_level, stats.num_levels);
+    sdtx_printf("Resident:\t%.1f/%.1f MB\n", stats.resident_bytes / (1024.f * 1024.f), stats.total_bytes / (1024.f * 1024.f));
+    sdtx_printf("Uploaded:\t%.1f MB\n", stats.uploaded_bytes / (1024.f * 1024.f));
+    sdtx_printf("Largest step:\t%.1f MB\n", stats.max_frame_bytes / (1024.f * 1024.f));
+    sdtx_printf("Frames:\t%d\n\n", stats.stream_frames);
+}
+
+static void render_ui() {
+    sdtx_canvas(sapp_width()*0.5f, sapp_height()*0.5f);
+    sdtx_origin(sapp_width()*0.5f/8.f - 24.f, 0.25f);       // each character occupies a grid fo 8x8
+    sdtx_home();
+
+    sdtx_color4b(0xff, 0x00, 0x00, 0xaf);
+    render_stream_stats("Planet", state.planet.texture);
+    render_stream_stats("Rock", state.rock.texture);
+    sdtx_draw();
+}
+
 void frame(void) {
     lopgl_update();
+    update_assets();
 
     sg_begin_default_pass(&state.pass_action, sapp_width(), sapp_height());
 
     hmm_mat4 view = lopgl_view_matrix();
     hmm_mat4 projection = HMM_Perspective(lopgl_fov(), (float)sapp_width() / (float)sapp_height(), 0.1f, 1000.0f);
 
-    if (state.planet.face_count > 0) {
+    const bool loaded = lopgl_query_asset(state.textures) == LOPGL_ASSET_READY;
+
+    if (loaded) {
+        /* streamed images change while mip levels are promoted */
+        state.planet.bind.fs_images[SLOT_diffuse_texture] = lopgl_asset_image(state.planet.texture);
+        state.rock.bind.fs_images[SLOT_diffuse_texture] = lopgl_asset_image(state.rock.texture);
+
         sg_apply_pipeline(state.planet.pip);
         sg_apply_bindings(&state.planet.bind);
 
@@ -216,7 +249,7 @@ void frame(void) {
         sg_draw(0, state.planet.face_count * 3, 1);
     }
 
-    if (state.rock.face_count > 0) {
+    if (loaded) {
         sg_apply_pipeline(state.rock.pip);
         sg_apply_bindings(&state.rock.bind);
 
@@ -231,6 +264,10 @@ void frame(void) {
 
     lopgl_render_help();
 
+    if (lopgl_ui_visible()) {
+        render_ui();
+    }
+
     sg_end_pass();
     sg_commit();
 }
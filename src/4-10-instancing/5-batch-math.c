@@ -0,0 +1,259 @@
+//------------------------------------------------------------------------------
+//  Instancing (5)
+//------------------------------------------------------------------------------
+#include "sokol_app.h"
+#include "sokol_gfx.h"
+#include "hmm/HandmadeMath.h"
+#define LOPGL_APP_IMPL
+#include "../lopgl_app.h"
+#define HMM_BATCH_IMPLEMENTATION
+#include "hmm/lopgl_hmm_batch.h"
+
+#define BENCH_COUNT 100000
+/* the first column times the HandmadeMath functions called once per element */
+#define BENCH_HMM_CALLS (-1)
+
+typedef enum bench_kernel {
+    BENCH_MULTIPLY_MAT4,
+    BENCH_MULTIPLY_MAT4_VEC4,
+    BENCH_TRS,
+    BENCH_INVERSE_TRANSPOSE,
+    BENCH_NUM_KERNELS
+} bench_kernel;
+
+static const char* kernel_names[BENCH_NUM_KERNELS] = {
+    "mat4*mat4", "mat4*vec4", "trs", "inv-trans"
+};
+
+/* application state */
+static struct {
+    hmm_mat4 left[BENCH_COUNT];
+    hmm_mat4 right[BENCH_COUNT];
+    hmm_vec4 vectors[BENCH_COUNT];
+    float trs_data[10][BENCH_COUNT];
+    hmm_batch_trs trs;
+    hmm_mat4 out[BENCH_COUNT];
+    hmm_vec4 out_vectors[BENCH_COUNT];
+    hmm_mat4 expected[BENCH_NUM_KERNELS][BENCH_COUNT];
+    /* best time in ms per kernel, column 0 is for the HandmadeMath calls */
+    double best_ms[BENCH_NUM_KERNELS][HMM_BATCH_NUM_ISAS + 1];
+    bool identical[BENCH_NUM_KERNELS][HMM_BATCH_NUM_ISAS];
+    int next_run;
+    int runs;
+    sg_pass_action pass_action;
+} state;
+
+static float random_float(float min, float max) {
+    return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+static void init_data(void) {
+    for (int i = 0; i < BENCH_COUNT; ++i) {
+        for (int col = 0; col < 4; ++col) {
+            for (int row = 0; row < 4; ++row) {
+                state.left[i].Elements[col][row] = random_float(-2.f, 2.f);
+                state.right[i].Elements[col][row] = random_float(-2.f, 2.f);
+            }
+            state.vectors[i].Elements[col] = random_float(-2.f, 2.f);
+        }
+
+        hmm_quaternion q = HMM_NormalizeQuaternion(HMM_Quaternion(random_float(-1.f, 1.f),
+            random_float(-1.f, 1.f), random_float(-1.f, 1.f), random_float(-1.f, 1.f)));
+        const float values[10] = {
+            random_float(-100.f, 100.f), random_float(-10.f, 10.f), random_float(-100.f, 100.f),
+            q.X, q.Y, q.Z, q.W,
+            random_float(0.05f, 0.25f), random_float(0.05f, 0.25f), random_float(0.05f, 0.25f)
+        };
+        for (int c = 0; c < 10; ++c) {
+            state.trs_data[c][i] = values[c];
+        }
+    }
+
+    state.trs = (hmm_batch_trs){
+        state.trs_data[0], state.trs_data[1], state.trs_data[2],
+        state.trs_data[3], state.trs_data[4], state.trs_data[5], state.trs_data[6],
+        state.trs_data[7], state.trs_data[8], state.trs_data[9]
+    };
+}
+
+static void run_hmm_calls(bench_kernel kernel) {
+    const hmm_batch_trs* trs = &state.trs;
+
+    switch (kernel) {
+        case BENCH_MULTIPLY_MAT4:
+            for (int i = 0; i < BENCH_COUNT; ++i) {
+                state.out[i] = HMM_MultiplyMat4(state.left[i], state.right[i]);
+            }
+            break;
+        case BENCH_MULTIPLY_MAT4_VEC4:
+            for (int i = 0; i < BENCH_COUNT; ++i) {
+                state.out_vectors[i] = HMM_MultiplyMat4ByVec4(state.left[i], state.vectors[i]);
+            }
+            break;
+        case BENCH_TRS:
+            /* the way the examples build model matrices so far */
+            for (int i = 0; i < BENCH_COUNT; ++i) {
+                hmm_mat4 model = HMM_Translate(HMM_Vec3(trs->px[i], trs->py[i], trs->pz[i]));
+                model = HMM_MultiplyMat4(model, HMM_QuaternionToMat4(HMM_Quaternion(trs->qx[i], trs->qy[i], trs->qz[i], trs->qw[i])));
+                state.out[i] = HMM_MultiplyMat4(model, HMM_Scale(HMM_Vec3(trs->sx[i], trs->sy[i], trs->sz[i])));
+            }
+            break;
+        default:
+            /* HandmadeMath has no matrix inverse */
+            break;
+    }
+}
+
+static void run_batch(bench_kernel kernel) {
+    switch (kernel) {
+        case BENCH_MULTIPLY_MAT4:
+            HMM_BatchMultiplyMat4(state.out, state.left, state.right, BENCH_COUNT);
+            break;
+        case BENCH_MULTIPLY_MAT4_VEC4:
+            HMM_BatchMultiplyMat4ByVec4(state.out_vectors, state.left, state.vectors, BENCH_COUNT);
+            break;
+        case BENCH_TRS:
+            HMM_BatchTRS(state.out, &state.trs, BENCH_COUNT);
+            break;
+        default:
+            HMM_BatchInverseTranspose(state.out, state.left, BENCH_COUNT);
+            break;
+    }
+}
+
+/* the scalar results are the reference all other instruction sets have to match */
+static void check_results(bench_kernel kernel, hmm_batch_isa isa) {
+    const void* result = state.out;
+    size_t size = sizeof(state.out);
+    if (kernel == BENCH_MULTIPLY_MAT4_VEC4) {
+        result = state.out_vectors;
+        size = sizeof(state.out_vectors);
+    }
+
+    if (isa == HMM_BATCH_SCALAR) {
+        memcpy(state.expected[kernel], result, size);
+    }
+    state.identical[kernel][isa] = memcmp(state.expected[kernel], result, size) == 0;
+}
+
+/* times one kernel per frame so the window stays responsive */
+static void run_next_benchmark(void) {
+    const int columns = HMM_BATCH_NUM_ISAS + 1;
+    const int run = state.next_run;
+    state.next_run = (state.next_run + 1) % (BENCH_NUM_KERNELS * columns);
+    if (state.next_run == 0) {
+        state.runs++;
+    }
+
+    const bench_kernel kernel = run / columns;
+    const int isa = run % columns + BENCH_HMM_CALLS;
+
+    if (isa == BENCH_HMM_CALLS && kernel == BENCH_INVERSE_TRANSPOSE) {
+        return;
+    }
+    if (isa != BENCH_HMM_CALLS && !HMM_BatchSetISA(isa)) {
+        return;
+    }
+
+    uint64_t start = stm_now();
+    if (isa == BENCH_HMM_CALLS) {
+        run_hmm_calls(kernel);
+    } else {
+        run_batch(kernel);
+    }
+    const double ms = stm_ms(stm_since(start));
+
+    double* best = &state.best_ms[kernel][isa - BENCH_HMM_CALLS];
+    if (*best == 0.0 || ms < *best) {
+        *best = ms;
+    }
+
+    if (isa != BENCH_HMM_CALLS) {
+        check_results(kernel, isa);
+    }
+}
+
+static void init(void) {
+    lopgl_setup();
+
+    init_data();
+
+    /* a pass action to clear framebuffer */
+    state.pass_action = (sg_pass_action) {
+        .colors[0] = { .action=SG_ACTION_CLEAR, .val={0.1f, 0.1f, 0.1f, 1.0f} }
+    };
+}
+
+static void render_ui() {
+    sdtx_canvas(sapp_width()*0.5f, sapp_height()*0.5f);
+    sdtx_origin(0.25f, sapp_height()*0.5f/8.f - 10.f);     // below the help text
+    sdtx_home();
+
+    sdtx_color4b(0xff, 0xff, 0xff, 0xaf);
+    sdtx_printf("%d elements, best ms of %d runs\n\n", BENCH_COUNT, state.runs);
+    sdtx_printf("%-10s %7s", "", "hmm");
+    for (int isa = 0; isa < HMM_BATCH_NUM_ISAS; ++isa) {
+        sdtx_printf(" %7s", HMM_BatchISAName(isa));
+    }
+    sdtx_puts("\n");
+
+    for (int kernel = 0; kernel < BENCH_NUM_KERNELS; ++kernel) {
+        sdtx_printf("%-10s", kernel_names[kernel]);
+        for (int column = 0; column <= HMM_BATCH_NUM_ISAS; ++column) {
+            const double ms = state.best_ms[kernel][column];
+            sdtx_color4b(0xff, 0xff, 0xff, 0xaf);
+            if (column > 0 && ms > 0.0 && !state.identical[kernel][column - 1]) {
+                /* results differ from the scalar kernel */
+                sdtx_color4b(0xff, 0x00, 0x00, 0xaf);
+            }
+            if (ms > 0.0) {
+                sdtx_printf(" %7.3f", ms);
+            } else {
+                sdtx_printf(" %7s", "-");
+            }
+        }
+        sdtx_puts("\n");
+    }
+
+    sdtx_color4b(0xff, 0xff, 0xff, 0xaf);
+    sdtx_puts("\nRed: not bit-identical to scalar");
+    sdtx_draw();
+}
+
+void frame(void) {
+    lopgl_update();
+
+    run_next_benchmark();
+
+    sg_begin_default_pass(&state.pass_action, sapp_width(), sapp_height());
+
+    lopgl_render_help();
+
+    if (lopgl_ui_visible()) {
+        render_ui();
+    }
+
+    sg_end_pass();
+    sg_commit();
+}
+
+void event(const sapp_event* e) {
+    lopgl_handle_input(e);
+}
+
+void cleanup(void) {
+    lopgl_shutdown();
+}
+
+sapp_desc sokol_main(int argc, char* argv[]) {
+    return (sapp_desc){
+        .init_cb = init,
+        .frame_cb = frame,
+        .cleanup_cb = cleanup,
+        .event_cb = event,
+        .width = 800,
+        .height = 600,
+        .gl_force_gles2 = true,
+        .window_title = "Batch Math (LearnOpenGL)",
+    };
+}
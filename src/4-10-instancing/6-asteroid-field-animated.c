@@ -0,0 +1,471 @@
+//------------------------------------------------------------------------------
+//  Instancing (6)
+//------------------------------------------------------------------------------
+#include "sokol_app.h"
+#include "sokol_gfx.h"
+#include "sokol_args.h"
+#include "hmm/HandmadeMath.h"
+#include "6-asteroid-field-animated.glsl.h"
+#define LOPGL_APP_IMPL
+#include "../lopgl_app.h"
+#define LOPGL_TRANSFORMS_IMPL
+#include "../lopgl_transforms.h"
+#include "fast_obj/lopgl_fast_obj.h"
+
+#define ASTEROID_COUNT 1000000
+/* bounds of the asteroid positions and scales for the 16 byte encoding */
+#define ASTEROID_POSITION_RANGE 130.f
+#define ASTEROID_SCALE_RANGE 0.25f
+
+static const char* encoding_names[LOPGL_NUM_INSTANCE_ENCODINGS] = {
+    "mat4", "compact24", "compact16"
+};
+
+typedef struct mesh_t {
+    sg_pipeline pip;
+    sg_bindings bind;
+    unsigned int face_count;
+    float radius;               /* bounding sphere around the origin */
+    lopgl_asset_handle obj;
+    lopgl_asset_handle texture;
+} mesh_t;
+
+/* application state */
+static struct {
+    mesh_t planet;
+    mesh_t rock;
+    lopgl_asset_handle objs;
+    lopgl_asset_handle textures;
+    lopgl_transforms_t rock_animation;
+    /* selected at startup with encoding=mat4|compact24|compact16 */
+    lopgl_instance_format_t rock_format;
+    /* staging memory for the stream buffer, rewritten every frame, large enough for all encodings */
+    hmm_mat4 rock_transforms[ASTEROID_COUNT];
+    uint64_t time_stamp;
+    bool culling;
+    int visible_rocks;
+    /* smoothed cpu time of the update, cull and upload stages */
+    double update_ms;
+    double cull_ms;
+    double upload_ms;
+    int upload_bytes;
+    /* smoothed frame time with culling off and on */
+    double frame_ms[2];
+    sg_pass_action pass_action;
+    float vertex_buffer[1024 * 8 * 3];
+} state;
+
+static void create_mesh(mesh_t* mesh) {
+    fastObjMesh* obj = lopgl_asset_mesh(mesh->obj);
+    mesh->face_count = obj->face_count;
+
+    /* the sphere has to contain the AABB in any orientation */
+    hmm_vec3 extent = HMM_Vec3(0.f, 0.f, 0.f);
+    for (unsigned int i = 0; i < obj->position_count; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            extent.Elements[j] = HMM_MAX(extent.Elements[j], HMM_ABS(obj->positions[i * 3 + j]));
+        }
+    }
+    mesh->radius = HMM_LengthVec3(extent);
+
+    for (unsigned int i = 0; i < mesh->face_count * 3; ++i) {
+        fastObjIndex vertex = obj->indices[i];
+
+        unsigned int pos = i * 8;
+        unsigned int v_pos = vertex.p * 3;
+        unsigned int n_pos = vertex.n * 3;
+        unsigned int t_pos = vertex.t * 2;
+
+        memcpy(state.vertex_buffer + pos, obj->positions + v_pos, 3 * sizeof(float));
+        memcpy(state.vertex_buffer + pos + 3, obj->normals + n_pos, 3 * sizeof(float));
+        memcpy(state.vertex_buffer + pos + 6, obj->texcoords + t_pos, 2 * sizeof(float));
+    }
+
+    sg_buffer cube_buffer = sg_make_buffer(&(sg_buffer_desc){
+        .size = mesh->face_count * 3 * 8 * sizeof(float),
+        .content = state.vertex_buffer,
+        .label = "mesh-vertices"
+    });
+    
+    mesh->bind.vertex_buffers[0] = cube_buffer;
+
+    mesh->texture = lopgl_request_asset(&(lopgl_asset_desc_t){
+        .type = LOPGL_ASSETTYPE_IMAGE,
+        .path = obj->materials[0].map_Kd.name,
+        /* Webgl 1.0 does not support repeat for textures that are not a power of two in size */
+        .wrap_u = SG_WRAP_CLAMP_TO_EDGE,
+        .wrap_v = SG_WRAP_CLAMP_TO_EDGE,
+        /* the meshes are drawn with the small mip levels while the rest streams in */
+        .stream = true
+    });
+
+    /* the de-indexed vertices live in the vertex buffer now */
+    lopgl_release_asset(mesh->obj);
+}
+
+/* creates the meshes once both objs are parsed, and waits for their textures */
+static void update_assets(void) {
+    lopgl_asset_state objs_state = lopgl_query_asset(state.objs);
+
+    if (objs_state == LOPGL_ASSET_READY) {
+        create_mesh(&state.planet);
+        create_mesh(&state.rock);
+        lopgl_release_asset(state.objs);
+
+        const lopgl_asset_handle textures[2] = { state.planet.texture, state.rock.texture };
+        state.textures = lopgl_when_all(textures, 2);
+    }
+
+    if (objs_state == LOPGL_ASSET_FAILED || lopgl_query_asset(state.textures) == LOPGL_ASSET_FAILED) {
+        state.pass_action = (sg_pass_action) {
+            .colors[0] = { .action = SG_ACTION_CLEAR, .val = { 1.0f, 0.0f, 0.0f, 1.0f } }
+        };
+    }
+}
+
+static lopgl_instance_encoding select_encoding(void) {
+    for (int i = 0; i < LOPGL_NUM_INSTANCE_ENCODINGS; ++i) {
+        if (sargs_equals("encoding", encoding_names[i])) {
+            return (lopgl_instance_encoding)i;
+        }
+    }
+    return LOPGL_INSTANCE_MAT4;
+}
+
+static sg_pipeline make_rock_pipeline(lopgl_instance_encoding encoding) {
+    if (encoding == LOPGL_INSTANCE_MAT4) {
+        sg_shader rock_shd = sg_make_shader(rock_shader_desc());
+
+        /* create a pipeline object for the asteroids  */
+        return sg_make_pipeline(&(sg_pipeline_desc){
+            .shader = rock_shd,
+            /* if the vertex layout doesn't have gaps, don't need to provide strides and offsets */
+            .layout = {
+                .attrs = {
+                    [ATTR_vs_rock_a_pos] = {.format = SG_VERTEXFORMAT_FLOAT3, .buffer_index = 0 },
+                    [ATTR_vs_rock_a_tex_coords] = {.format = SG_VERTEXFORMAT_FLOAT2, .offset = 24, .buffer_index = 0 },
+                    [ATTR_vs_rock_instance_mat0] = {.format = SG_VERTEXFORMAT_FLOAT4, .offset = 0, .buffer_index = 1},
+                    [ATTR_vs_rock_instance_mat1] = {.format = SG_VERTEXFORMAT_FLOAT4, .offset = 16, .buffer_index = 1},
+                    [ATTR_vs_rock_instance_mat2] = {.format = SG_VERTEXFORMAT_FLOAT4, .offset = 32, .buffer_index = 1},
+                    [ATTR_vs_rock_instance_mat3] = {.format = SG_VERTEXFORMAT_FLOAT4, .offset = 48, .buffer_index = 1},
+                },
+                .buffers[0] = {.stride = 32, .step_func = SG_VERTEXSTEP_PER_VERTEX },
+                /* vertex buffer at slot 1 must step per instance */
+                .buffers[1] = {.stride = 64, .step_func = SG_VERTEXSTEP_PER_INSTANCE }
+            },
+            .depth_stencil = {
+                .depth_compare_func = SG_COMPAREFUNC_LESS_EQUAL,
+                .depth_write_enabled = true,
+            },
+            .label = "rock-pipeline"
+        });
+    }
+
+    /* the compact encodings share the shader and only differ in the vertex formats */
+    const bool compact16 = encoding == LOPGL_INSTANCE_COMPACT16;
+    sg_shader rock_compact_shd = sg_make_shader(rock_compact_shader_desc());
+
+    return sg_make_pipeline(&(sg_pipeline_desc){
+        .shader = rock_compact_shd,
+        .layout = {
+            .attrs = {
+                [ATTR_vs_rock_compact_a_pos] = {.format = SG_VERTEXFORMAT_FLOAT3, .buffer_index = 0 },
+                [ATTR_vs_rock_compact_a_tex_coords] = {.format = SG_VERTEXFORMAT_FLOAT2, .offset = 24, .buffer_index = 0 },
+                [ATTR_vs_rock_compact_instance_position_scale] = {
+                    .format = compact16 ? SG_VERTEXFORMAT_SHORT4N : SG_VERTEXFORMAT_FLOAT4,
+                    .offset = 0,
+                    .buffer_index = 1
+                },
+                [ATTR_vs_rock_compact_instance_rotation] = {
+                    .format = SG_VERTEXFORMAT_SHORT4N,
+                    .offset = compact16 ? 8 : 16,
+                    .buffer_index = 1
+                },
+            },
+            .buffers[0] = {.stride = 32, .step_func = SG_VERTEXSTEP_PER_VERTEX },
+            .buffers[1] = {.stride = lopgl_instance_size(encoding), .step_func = SG_VERTEXSTEP_PER_INSTANCE }
+        },
+        .depth_stencil = {
+            .depth_compare_func = SG_COMPAREFUNC_LESS_EQUAL,
+            .depth_write_enabled = true,
+        },
+        .label = "rock-compact-pipeline"
+    });
+}
+
+static void init(void) {
+    lopgl_setup();
+
+    lopgl_orbital_cam_desc_t orbital_desc = lopgl_get_orbital_cam_desc();
+    orbital_desc.distance = 155.f;
+    lopgl_set_orbital_cam(&orbital_desc);
+
+    lopgl_fp_cam_desc_t fp_desc = lopgl_get_fp_cam_desc();
+    fp_desc.position.Z = 150.f;
+    lopgl_set_fp_cam(&fp_desc);
+
+    /* create shader from code-generated sg_shader_desc */
+    sg_shader planet_shd = sg_make_shader(planet_shader_desc());
+
+    /* create a pipeline object for the planet  */
+    state.planet.pip = sg_make_pipeline(&(sg_pipeline_desc){
+        .shader = planet_shd,
+        /* if the vertex layout doesn't have gaps, don't need to provide strides and offsets */
+        .layout = {
+            .attrs = {
+                [ATTR_vs_planet_a_pos].format = SG_VERTEXFORMAT_FLOAT3,
+                [ATTR_vs_planet_a_tex_coords] = {.format = SG_VERTEXFORMAT_FLOAT2, .offset = 24 }
+            },
+            .buffers[0].stride = 32
+        },
+        .depth_stencil = {
+            .depth_compare_func = SG_COMPAREFUNC_LESS_EQUAL,
+            .depth_write_enabled = true,
+        },
+        .label = "planet-pipeline"
+    });
+
+    state.rock_format = (lopgl_instance_format_t){
+        .encoding = select_encoding(),
+        .position_range = ASTEROID_POSITION_RANGE,
+        .scale_range = ASTEROID_SCALE_RANGE
+    };
+    state.rock.pip = make_rock_pipeline(state.rock_format.encoding);
+    
+    /* a pass action to clear framebuffer */
+    state.pass_action = (sg_pass_action) {
+        .colors[0] = { .action=SG_ACTION_CLEAR, .val={0.1f, 0.1f, 0.1f, 1.0f} }
+    };
+
+    lopgl_asset_handle objs[2];
+    state.objs = lopgl_request_assets((lopgl_asset_desc_t[]){
+        { .type = LOPGL_ASSETTYPE_OBJ, .path = "planet.obj" },
+        { .type = LOPGL_ASSETTYPE_OBJ, .path = "rock.obj" }
+    }, 2, objs);
+    state.planet.obj = objs[0];
+    state.rock.obj = objs[1];
+
+    lopgl_init_transforms(&state.rock_animation, &(lopgl_transforms_desc_t){
+        .capacity = ASTEROID_COUNT
+    });
+
+    srand(stm_now()); // initialize random seed	
+    float radius = 100.f;
+    float offset = 25.f;
+    for(unsigned int i = 0; i < ASTEROID_COUNT; i++) {
+        // 1. orbit: displace along circle with 'radius' in range [-offset, offset]
+        float angle = (float)i / (float)ASTEROID_COUNT * 2.f * HMM_PI32 - HMM_PI32;
+        float displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
+        float orbit_radius = radius + displacement;
+        displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
+        float height = displacement * 0.4f; // keep height of field smaller compared to width of x and z
+        // inner asteroids orbit faster, like they would around a real planet
+        float orbit_speed = 0.05f * HMM_PowerF(radius / orbit_radius, 1.5f);
+
+        // 2. scale: scale between 0.05 and 0.25f
+        float scale = (rand() % 20) / 100.0f + 0.05;
+
+        // 3. rotation: spin around a random axis with random speed
+        hmm_vec3 axis = HMM_Vec3((rand() % 200) / 100.f - 1.f, (rand() % 200) / 100.f - 1.f, (rand() % 200) / 100.f - 1.f);
+        if (HMM_LengthSquaredVec3(axis) < 0.01f) {
+            axis = HMM_Vec3(0.4f, 0.6f, 0.8f);
+        }
+        float spin_angle = (rand() % 360) / 360.f * 2.f * HMM_PI32 - HMM_PI32;
+        float spin_speed = (rand() % 200) / 100.f - 1.f;
+
+        lopgl_add_transform(&state.rock_animation, &(lopgl_transform_desc_t){
+            .orbit_radius = orbit_radius,
+            .orbit_angle = angle,
+            .orbit_speed = orbit_speed,
+            .height = height,
+            .spin_axis = HMM_NormalizeVec3(axis),
+            .spin_angle = spin_angle,
+            .spin_speed = spin_speed,
+            .scale = HMM_Vec3(scale, scale, scale)
+        });
+    }
+
+    /* the transforms are rewritten every frame */
+    sg_buffer transform_buffer = sg_make_buffer(&(sg_buffer_desc){
+        .size = ASTEROID_COUNT * lopgl_instance_size(state.rock_format.encoding),
+        .usage = SG_USAGE_STREAM,
+        .label = "rock-transforms"
+    });
+    
+    state.rock.bind.vertex_buffers[1] = transform_buffer;
+    state.culling = true;
+}
+
+static void render_ui() {
+    sdtx_canvas(sapp_width()*0.5f, sapp_height()*0.5f);
+    sdtx_origin(sapp_width()*0.5f/8.f - 24.f, 0.25f);       // each character occupies a grid fo 8x8
+    sdtx_home();
+
+    sdtx_color4b(0xff, 0x00, 0x00, 0xaf);
+    sdtx_printf("Asteroids:\t%d\n", state.rock_animation.count);
+    sdtx_printf("Threads:\t%d (%s)\n", state.rock_animation.num_threads, HMM_BatchISAName(HMM_BatchISA()));
+    sdtx_printf("Encoding:\t%s (%d bytes)\n", encoding_names[state.rock_format.encoding], lopgl_instance_size(state.rock_format.encoding));
+    sdtx_printf("Update:\t%.2f ms\n", state.update_ms);
+    if (state.culling) {
+        sdtx_printf("Cull:\t\t%.2f ms (%.3f ms/100k)\n", state.cull_ms, state.cull_ms * 100000.0 / ASTEROID_COUNT);
+    }
+    sdtx_printf("Upload:\t%.2f ms (%.1f MB)\n", state.upload_ms, state.upload_bytes / (1024.f * 1024.f));
+    sdtx_printf("Bandwidth:\t%.1f MB/s\n", state.upload_bytes / (1024.f * 1024.f) * 1000.f / state.frame_ms[state.culling]);
+    sdtx_printf("Visible:\t%d\n\n", state.visible_rocks);
+    sdtx_printf("Frame:\t%.2f ms (culled)\n", state.frame_ms[1]);
+    sdtx_printf("Frame:\t%.2f ms (all)\n\n", state.frame_ms[0]);
+    sdtx_printf("Culling\t[%c]\n\n", state.culling ? '*': ' ');
+    sdtx_puts("Toggle:\t'SPACE'");
+    sdtx_draw();
+}
+
+/* moves the asteroids and uploads the transforms of the visible ones to the stream buffer */
+static void update_rocks(const hmm_mat4* view_projection) {
+    const uint64_t frame_time = stm_laptime(&state.time_stamp);
+    const float dt = (float)stm_sec(frame_time);
+    state.frame_ms[state.culling] = state.frame_ms[state.culling] * 0.95 + stm_ms(frame_time) * 0.05;
+
+    uint64_t start = stm_now();
+    if (state.culling) {
+        lopgl_animate_transforms(&state.rock_animation, dt, NULL);
+        const double update_ms = stm_ms(stm_since(start));
+        state.update_ms = state.update_ms * 0.95 + update_ms * 0.05;
+
+        start = stm_now();
+        state.visible_rocks = lopgl_cull_transforms(&state.rock_animation, &(lopgl_cull_desc_t){
+            .view_projection = *view_projection,
+            .radius = state.rock.radius,
+            .format = state.rock_format
+        }, state.rock_transforms);
+        const double cull_ms = stm_ms(stm_since(start));
+        state.cull_ms = state.cull_ms * 0.95 + cull_ms * 0.05;
+    }
+    else if (state.rock_format.encoding == LOPGL_INSTANCE_MAT4) {
+        lopgl_animate_transforms(&state.rock_animation, dt, state.rock_transforms);
+        const double update_ms = stm_ms(stm_since(start));
+        state.update_ms = state.update_ms * 0.95 + update_ms * 0.05;
+        state.visible_rocks = state.rock_animation.count;
+    }
+    else {
+        lopgl_animate_transforms(&state.rock_animation, dt, NULL);
+        lopgl_write_instances(&state.rock_animation, &state.rock_format, state.rock_transforms);
+        const double update_ms = stm_ms(stm_since(start));
+        state.update_ms = state.update_ms * 0.95 + update_ms * 0.05;
+        state.visible_rocks = state.rock_animation.count;
+    }
+
+    state.upload_bytes = state.visible_rocks * lopgl_instance_size(state.rock_format.encoding);
+    if (state.visible_rocks > 0) {
+        start = stm_now();
+        sg_update_buffer(state.rock.bind.vertex_buffers[1], state.rock_transforms, state.upload_bytes);
+        const double upload_ms = stm_ms(stm_since(start));
+        state.upload_ms = state.upload_ms * 0.95 + upload_ms * 0.05;
+    }
+}
+
+void frame(void) {
+    lopgl_update();
+    update_assets();
+
+    sg_begin_default_pass(&state.pass_action, sapp_width(), sapp_height());
+
+    hmm_mat4 view = lopgl_view_matrix();
+    hmm_mat4 projection = HMM_Perspective(lopgl_fov(), (float)sapp_width() / (float)sapp_height(), 0.1f, 1000.0f);
+
+    const bool loaded = lopgl_query_asset(state.textures) == LOPGL_ASSET_READY;
+
+    if (loaded) {
+        const hmm_mat4 view_projection = HMM_MultiplyMat4(projection, view);
+        update_rocks(&view_projection);
+    }
+
+    if (loaded) {
+        /* streamed images change while mip levels are promoted */
+        state.planet.bind.fs_images[SLOT_diffuse_texture] = lopgl_asset_image(state.planet.texture);
+        state.rock.bind.fs_images[SLOT_diffuse_texture] = lopgl_asset_image(state.rock.texture);
+
+        sg_apply_pipeline(state.planet.pip);
+        sg_apply_bindings(&state.planet.bind);
+
+        hmm_mat4 model = HMM_Translate(HMM_Vec3(0.f, -3.f, 0.f));
+        model = HMM_MultiplyMat4(model, HMM_Scale(HMM_Vec3(4.f, 4.f, 4.f)));
+
+        vs_params_planet_t vs_params = {
+            .model = model,
+            .view = view,
+            .projection = projection
+        };
+
+        sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params_planet, &vs_params, sizeof(vs_params));
+
+        sg_draw(0, state.planet.face_count * 3, 1);
+    }
+
+    if (loaded) {
+        sg_apply_pipeline(state.rock.pip);
+        sg_apply_bindings(&state.rock.bind);
+
+        if (state.rock_format.encoding == LOPGL_INSTANCE_MAT4) {
+            vs_params_rock_t vs_params = {
+                .view = view,
+                .projection = projection
+            };
+            sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params_rock, &vs_params, sizeof(vs_params));
+        }
+        else {
+            const bool compact16 = state.rock_format.encoding == LOPGL_INSTANCE_COMPACT16;
+            const float position_range = compact16 ? ASTEROID_POSITION_RANGE : 1.f;
+            vs_params_rock_compact_t vs_params = {
+                .view = view,
+                .projection = projection,
+                .instance_range = HMM_Vec4(position_range, position_range, position_range, compact16 ? ASTEROID_SCALE_RANGE : 1.f)
+            };
+            sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params_rock_compact, &vs_params, sizeof(vs_params));
+        }
+        sg_draw(0, state.rock.face_count * 3, state.visible_rocks);
+    }
+
+    lopgl_render_help();
+
+    if (lopgl_ui_visible()) {
+        render_ui();
+    }
+
+    sg_end_pass();
+    sg_commit();
+}
+
+void event(const sapp_event* e) {
+    lopgl_handle_input(e);
+
+    if (e->type == SAPP_EVENTTYPE_KEY_DOWN) {
+        if (e->key_code == SAPP_KEYCODE_SPACE) {
+            state.culling = !state.culling;
+        }
+    }
+}
+
+void cleanup(void) {
+    lopgl_destroy_transforms(&state.rock_animation);
+    lopgl_shutdown();
+    sargs_shutdown();
+}
+
+sapp_desc sokol_main(int argc, char* argv[]) {
+    /* native: encoding=compact16 on the command line, web: ?encoding=compact16 in the url */
+    sargs_setup(&(sargs_desc){
+        .argc = argc,
+        .argv = argv
+    });
+
+    return (sapp_desc){
+        .init_cb = init,
+        .frame_cb = frame,
+        .cleanup_cb = cleanup,
+        .event_cb = event,
+        .width = 800,
+        .height = 600,
+        .gl_force_gles2 = true,
+        .window_title = "Asteroid Field Animated (LearnOpenGL)",
+    };
+}
@@ -0,0 +1,94 @@
+@ctype mat4 hmm_mat4
+@ctype vec4 hmm_vec4
+
+@vs vs_planet
+in vec3 a_pos;
+in vec2 a_tex_coords;
+out vec2 tex_coords;
+
+uniform vs_params_planet {
+    mat4 model;
+    mat4 view;
+    mat4 projection;
+};
+
+void main() {
+    gl_Position = projection * view * model * vec4(a_pos, 1.0);
+    tex_coords = a_tex_coords;
+}
+@end
+
+@vs vs_rock
+in vec3 a_pos;
+in vec2 a_tex_coords;
+in vec4 instance_mat0;
+in vec4 instance_mat1;
+in vec4 instance_mat2;
+in vec4 instance_mat3;
+out vec2 tex_coords;
+
+uniform vs_params_rock {
+    mat4 view;
+    mat4 projection;
+};
+
+void main() {
+    mat4 instance_matrix = mat4(instance_mat0, instance_mat1, instance_mat2, instance_mat3);
+    gl_Position = projection * view * instance_matrix * vec4(a_pos, 1.0);
+    tex_coords = a_tex_coords;
+}
+@end
+
+@vs vs_rock_compact
+in vec3 a_pos;
+in vec2 a_tex_coords;
+in vec4 instance_position_scale;
+in vec4 instance_rotation;
+out vec2 tex_coords;
+
+uniform vs_params_rock_compact {
+    mat4 view;
+    mat4 projection;
+    // undoes the division by the position and scale ranges of the 16 byte encoding
+    vec4 instance_range;
+};
+
+// same as HMM_QuaternionToMat4, for normalized quaternions
+mat3 rotation_matrix(vec4 q) {
+    float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+    return mat3(
+        1.0 - 2.0 * (yy + zz), 2.0 * (xy + wz), 2.0 * (xz - wy),
+        2.0 * (xy - wz), 1.0 - 2.0 * (xx + zz), 2.0 * (yz + wx),
+        2.0 * (xz + wy), 2.0 * (yz - wx), 1.0 - 2.0 * (xx + yy));
+}
+
+void main() {
+    vec4 position_scale = instance_position_scale * instance_range;
+    // the quantized quaternion is slightly off unit length
+    mat3 rotation = rotation_matrix(normalize(instance_rotation));
+    mat4 instance_matrix = mat4(
+        vec4(rotation[0] * position_scale.w, 0.0),
+        vec4(rotation[1] * position_scale.w, 0.0),
+        vec4(rotation[2] * position_scale.w, 0.0),
+        vec4(position_scale.xyz, 1.0));
+    gl_Position = projection * view * instance_matrix * vec4(a_pos, 1.0);
+    tex_coords = a_tex_coords;
+}
+@end
+
+@fs fs
+in vec2 tex_coords;
+out vec4 frag_color;
+
+uniform sampler2D diffuse_texture;
+
+void main() {
+    frag_color = texture(diffuse_texture, tex_coords);
+}
+@end
+
+@program planet vs_planet fs
+@program rock vs_rock fs
+@program rock_compact vs_rock_compact fs
@@ -0,0 +1,369 @@
+//------------------------------------------------------------------------------
+//  Instancing (7)
+//------------------------------------------------------------------------------
+#include "sokol_app.h"
+#include "sokol_gfx.h"
+#include "hmm/HandmadeMath.h"
+#include "7-draw-queue-stress.glsl.h"
+#define LOPGL_APP_IMPL
+#include "../lopgl_app.h"
+
+#define OBJECT_COUNT 50000
+#define NUM_COLORS 8
+
+typedef enum mesh_type {
+    MESH_CUBE,
+    MESH_PYRAMID,
+    MESH_QUAD,
+    NUM_MESHES
+} mesh_type;
+
+/* quads are drawn without culling, every tenth object is transparent */
+typedef enum pipeline_type {
+    PIPELINE_OPAQUE,
+    PIPELINE_DOUBLE_SIDED,
+    PIPELINE_TRANSPARENT,
+    NUM_PIPELINES
+} pipeline_type;
+
+typedef enum submit_mode {
+    SUBMIT_DIRECT,          /* applies all state for every draw in scene order */
+    SUBMIT_SORTED,          /* draw queue without instancing */
+    SUBMIT_INSTANCED,       /* draw queue */
+    NUM_SUBMIT_MODES
+} submit_mode;
+
+static const char* submit_mode_names[NUM_SUBMIT_MODES] = {
+    "direct", "sorted", "instanced"
+};
+
+typedef struct object_t {
+    mesh_type mesh;
+    pipeline_type pipeline;
+    int color;
+    hmm_mat4 model;
+} object_t;
+
+/* application state */
+static struct {
+    lopgl_draw_mesh_t meshes[NUM_MESHES];
+    sg_pipeline pipelines[NUM_PIPELINES];
+    sg_pipeline instanced_pipelines[NUM_PIPELINES];
+    fs_params_t colors[NUM_COLORS];
+    fs_params_t transparent_colors[NUM_COLORS];
+    object_t objects[OBJECT_COUNT];
+    submit_mode mode;
+    double submit_ms;
+    lopgl_draw_stats_t stats;
+    sg_pass_action pass_action;
+} state;
+
+static float random_float(float min, float max) {
+    return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+/* positions and flat normals of the triangles */
+static lopgl_draw_mesh_t make_mesh(const float* positions, int num_vertices, const char* label) {
+    float vertices[36 * 6];
+    assert(num_vertices <= 36);
+
+    for (int i = 0; i < num_vertices; i += 3) {
+        const float* p = positions + i * 3;
+        hmm_vec3 a = HMM_Vec3(p[0], p[1], p[2]);
+        hmm_vec3 b = HMM_Vec3(p[3], p[4], p[5]);
+        hmm_vec3 c = HMM_Vec3(p[6], p[7], p[8]);
+        hmm_vec3 normal = HMM_NormalizeVec3(HMM_Cross(HMM_SubtractVec3(b, a), HMM_SubtractVec3(c, a)));
+
+        for (int v = 0; v < 3; ++v) {
+            memcpy(vertices + (i + v) * 6, p + v * 3, 3 * sizeof(float));
+            memcpy(vertices + (i + v) * 6 + 3, normal.Elements, 3 * sizeof(float));
+        }
+    }
+
+    return (lopgl_draw_mesh_t){
+        .bind.vertex_buffers[0] = sg_make_buffer(&(sg_buffer_desc){
+            .size = num_vertices * 6 * sizeof(float),
+            .content = vertices,
+            .label = label
+        }),
+        .num_elements = num_vertices
+    };
+}
+
+static void init_meshes(void) {
+    const float cube_positions[] = {
+        -0.5f, -0.5f, -0.5f,   0.5f,  0.5f, -0.5f,   0.5f, -0.5f, -0.5f,
+         0.5f,  0.5f, -0.5f,  -0.5f, -0.5f, -0.5f,  -0.5f,  0.5f, -0.5f,
+        -0.5f, -0.5f,  0.5f,   0.5f, -0.5f,  0.5f,   0.5f,  0.5f,  0.5f,
+         0.5f,  0.5f,  0.5f,  -0.5f,  0.5f,  0.5f,  -0.5f, -0.5f,  0.5f,
+        -0.5f,  0.5f,  0.5f,  -0.5f,  0.5f, -0.5f,  -0.5f, -0.5f, -0.5f,
+        -0.5f, -0.5f, -0.5f,  -0.5f, -0.5f,  0.5f,  -0.5f,  0.5f,  0.5f,
+         0.5f,  0.5f,  0.5f,   0.5f, -0.5f, -0.5f,   0.5f,  0.5f, -0.5f,
+         0.5f, -0.5f, -0.5f,   0.5f,  0.5f,  0.5f,   0.5f, -0.5f,  0.5f,
+        -0.5f, -0.5f, -0.5f,   0.5f, -0.5f, -0.5f,   0.5f, -0.5f,  0.5f,
+         0.5f, -0.5f,  0.5f,  -0.5f, -0.5f,  0.5f,  -0.5f, -0.5f, -0.5f,
+        -0.5f,  0.5f, -0.5f,   0.5f,  0.5f,  0.5f,   0.5f,  0.5f, -0.5f,
+         0.5f,  0.5f,  0.5f,  -0.5f,  0.5f, -0.5f,  -0.5f,  0.5f,  0.5f
+    };
+
+    const float pyramid_positions[] = {
+        -0.5f, -0.5f, -0.5f,   0.5f, -0.5f, -0.5f,   0.5f, -0.5f,  0.5f,
+         0.5f, -0.5f,  0.5f,  -0.5f, -0.5f,  0.5f,  -0.5f, -0.5f, -0.5f,
+        -0.5f, -0.5f,  0.5f,   0.5f, -0.5f,  0.5f,   0.0f,  0.5f,  0.0f,
+         0.5f, -0.5f,  0.5f,   0.5f, -0.5f, -0.5f,   0.0f,  0.5f,  0.0f,
+         0.5f, -0.5f, -0.5f,  -0.5f, -0.5f, -0.5f,   0.0f,  0.5f,  0.0f,
+        -0.5f, -0.5f, -0.5f,  -0.5f, -0.5f,  0.5f,   0.0f,  0.5f,  0.0f
+    };
+
+    const float quad_positions[] = {
+        -0.5f, -0.5f,  0.0f,   0.5f, -0.5f,  0.0f,   0.5f,  0.5f,  0.0f,
+         0.5f,  0.5f,  0.0f,  -0.5f,  0.5f,  0.0f,  -0.5f, -0.5f,  0.0f
+    };
+
+    state.meshes[MESH_CUBE] = make_mesh(cube_positions, 36, "cube-vertices");
+    state.meshes[MESH_PYRAMID] = make_mesh(pyramid_positions, 18, "pyramid-vertices");
+    state.meshes[MESH_QUAD] = make_mesh(quad_positions, 6, "quad-vertices");
+}
+
+static sg_pipeline make_pipeline(sg_shader shader, bool instanced, pipeline_type type) {
+    sg_pipeline_desc desc = {
+        .shader = shader,
+        .layout = {
+            .attrs = {
+                [ATTR_vs_a_pos] = { .format = SG_VERTEXFORMAT_FLOAT3, .buffer_index = 0 },
+                [ATTR_vs_a_normal] = { .format = SG_VERTEXFORMAT_FLOAT3, .offset = 12, .buffer_index = 0 }
+            },
+            .buffers[0].stride = 24
+        },
+        .depth_stencil = {
+            .depth_compare_func = SG_COMPAREFUNC_LESS_EQUAL,
+            .depth_write_enabled = type != PIPELINE_TRANSPARENT,
+        },
+        .rasterizer = {
+            .cull_mode = type == PIPELINE_OPAQUE ? SG_CULLMODE_BACK : SG_CULLMODE_NONE,
+            .face_winding = SG_FACEWINDING_CCW
+        },
+        .label = "object-pipeline"
+    };
+
+    /* both vertex shaders declare a_pos and a_normal first, so they share these locations */
+    if (instanced) {
+        desc.layout.attrs[ATTR_vs_instanced_instance_mat0] = (sg_vertex_attr_desc){ .format = SG_VERTEXFORMAT_FLOAT4, .offset = 0, .buffer_index = 1 };
+        desc.layout.attrs[ATTR_vs_instanced_instance_mat1] = (sg_vertex_attr_desc){ .format = SG_VERTEXFORMAT_FLOAT4, .offset = 16, .buffer_index = 1 };
+        desc.layout.attrs[ATTR_vs_instanced_instance_mat2] = (sg_vertex_attr_desc){ .format = SG_VERTEXFORMAT_FLOAT4, .offset = 32, .buffer_index = 1 };
+        desc.layout.attrs[ATTR_vs_instanced_instance_mat3] = (sg_vertex_attr_desc){ .format = SG_VERTEXFORMAT_FLOAT4, .offset = 48, .buffer_index = 1 };
+        desc.layout.buffers[1] = (sg_buffer_layout_desc){ .stride = 64, .step_func = SG_VERTEXSTEP_PER_INSTANCE };
+        desc.label = "object-instanced-pipeline";
+    }
+
+    if (type == PIPELINE_TRANSPARENT) {
+        desc.blend = (sg_blend_state){
+            .enabled = true,
+            .src_factor_rgb = SG_BLENDFACTOR_SRC_ALPHA,
+            .dst_factor_rgb = SG_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+            .op_rgb = SG_BLENDOP_ADD,
+            .src_factor_alpha = SG_BLENDFACTOR_SRC_ALPHA,
+            .dst_factor_alpha = SG_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+            .op_alpha = SG_BLENDOP_ADD
+        };
+    }
+
+    return sg_make_pipeline(&desc);
+}
+
+static void init_objects(void) {
+    for (int i = 0; i < NUM_COLORS; ++i) {
+        state.colors[i].color = HMM_Vec4(random_float(0.2f, 1.f), random_float(0.2f, 1.f), random_float(0.2f, 1.f), 1.f);
+        state.transparent_colors[i].color = state.colors[i].color;
+        state.transparent_colors[i].color.W = 0.4f;
+    }
+
+    for (int i = 0; i < OBJECT_COUNT; ++i) {
+        object_t* object = &state.objects[i];
+        object->mesh = rand() % NUM_MESHES;
+        object->pipeline = object->mesh == MESH_QUAD ? PIPELINE_DOUBLE_SIDED : PIPELINE_OPAQUE;
+        if (i % 10 == 0) {
+            object->pipeline = PIPELINE_TRANSPARENT;
+        }
+        object->color = rand() % NUM_COLORS;
+
+        hmm_vec3 position = HMM_Vec3(random_float(-40.f, 40.f), random_float(-40.f, 40.f), random_float(-40.f, 40.f));
+        hmm_mat4 model = HMM_Translate(position);
+        model = HMM_MultiplyMat4(model, HMM_Rotate(random_float(0.f, 360.f), HMM_Vec3(0.4f, 0.6f, 0.8f)));
+        object->model = HMM_MultiplyMat4(model, HMM_Scale(HMM_Vec3(0.5f, 0.5f, 0.5f)));
+    }
+}
+
+static void init(void) {
+    lopgl_setup();
+
+    lopgl_orbital_cam_desc_t orbital_desc = lopgl_get_orbital_cam_desc();
+    orbital_desc.distance = 90.f;
+    orbital_desc.max_dist = 200.f;
+    lopgl_set_orbital_cam(&orbital_desc);
+
+    lopgl_fp_cam_desc_t fp_desc = lopgl_get_fp_cam_desc();
+    fp_desc.position.Z = 90.f;
+    lopgl_set_fp_cam(&fp_desc);
+
+    init_meshes();
+
+    sg_shader shader = sg_make_shader(simple_shader_desc());
+    sg_shader instanced_shader = sg_make_shader(simple_instanced_shader_desc());
+    for (int i = 0; i < NUM_PIPELINES; ++i) {
+        state.pipelines[i] = make_pipeline(shader, false, i);
+        /* transparent draws are never merged */
+        if (i != PIPELINE_TRANSPARENT) {
+            state.instanced_pipelines[i] = make_pipeline(instanced_shader, true, i);
+        }
+    }
+
+    srand(42);
+    init_objects();
+
+    state.mode = SUBMIT_INSTANCED;
+
+    /* a pass action to clear framebuffer */
+    state.pass_action = (sg_pass_action) {
+        .colors[0] = { .action=SG_ACTION_CLEAR, .val={0.1f, 0.1f, 0.1f, 1.0f} }
+    };
+}
+
+static const fs_params_t* object_color(const object_t* object) {
+    if (object->pipeline == PIPELINE_TRANSPARENT) {
+        return &state.transparent_colors[object->color];
+    }
+    return &state.colors[object->color];
+}
+
+/* the way the examples submit their draws, opaque objects first */
+static void draw_direct(vs_params_t* vs_params) {
+    memset(&state.stats, 0, sizeof(state.stats));
+
+    /* through the uniform cache, so that it knows what the queued modes find applied, but without skipping */
+    lopgl_set_uniform_cache(false);
+    for (int transparent = 0; transparent < 2; ++transparent) {
+        for (int i = 0; i < OBJECT_COUNT; ++i) {
+            const object_t* object = &state.objects[i];
+            if ((object->pipeline == PIPELINE_TRANSPARENT) != transparent) {
+                continue;
+            }
+
+            lopgl_apply_pipeline(state.pipelines[object->pipeline]);
+            ++state.stats.pipeline_changes;
+            sg_apply_bindings(&state.meshes[object->mesh].bind);
+            ++state.stats.binding_changes;
+            vs_params->model = object->model;
+            state.stats.uniform_updates += lopgl_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, vs_params, sizeof(vs_params_t));
+            state.stats.uniform_updates += lopgl_apply_uniforms(SG_SHADERSTAGE_FS, SLOT_fs_params, object_color(object), sizeof(fs_params_t));
+            sg_draw(0, state.meshes[object->mesh].num_elements, 1);
+            ++state.stats.draw_calls;
+            ++state.stats.queued_draws;
+        }
+    }
+    lopgl_set_uniform_cache(true);
+}
+
+static void draw_queued(vs_params_t* vs_params) {
+    lopgl_draw_material_t materials[NUM_PIPELINES][NUM_COLORS];
+    for (int pip = 0; pip < NUM_PIPELINES; ++pip) {
+        for (int color = 0; color < NUM_COLORS; ++color) {
+            materials[pip][color] = (lopgl_draw_material_t){
+                .pip = state.pipelines[pip],
+                .instanced_pip = state.mode == SUBMIT_INSTANCED ? state.instanced_pipelines[pip] : (sg_pipeline){ SG_INVALID_ID },
+                .instance_buffer_index = 1,
+                .vs_uniform_slot = SLOT_vs_params,
+                .vs_uniforms = vs_params,
+                .vs_uniforms_size = sizeof(vs_params_t),
+                .model_offset = offsetof(vs_params_t, model),
+                .fs_uniform_slot = SLOT_fs_params,
+                .fs_uniforms = pip == PIPELINE_TRANSPARENT ? &state.transparent_colors[color] : &state.colors[color],
+                .fs_uniforms_size = sizeof(fs_params_t),
+                .transparent = pip == PIPELINE_TRANSPARENT
+            };
+        }
+    }
+
+    for (int i = 0; i < OBJECT_COUNT; ++i) {
+        const object_t* object = &state.objects[i];
+        lopgl_queue_draw(&state.meshes[object->mesh], &materials[object->pipeline][object->color], object->model);
+    }
+
+    lopgl_flush_draws();
+
+    /* the draw queue reports the previous frame */
+    state.stats = lopgl_get_draw_stats();
+}
+
+static void render_ui() {
+    sdtx_canvas(sapp_width()*0.5f, sapp_height()*0.5f);
+    sdtx_origin(sapp_width()*0.5f/8.f - 24.f, 0.25f);       // each character occupies a grid fo 8x8
+    sdtx_home();
+
+    sdtx_color4b(0xff, 0x00, 0x00, 0xaf);
+    sdtx_printf("Submit:\t%s\n\n", submit_mode_names[state.mode]);
+    sdtx_printf("Draws:\t\t%d\n", state.stats.queued_draws);
+    sdtx_printf("Draw calls:\t%d\n", state.stats.draw_calls);
+    sdtx_printf("Pipelines:\t%d\n", state.stats.pipeline_changes);
+    sdtx_printf("Bindings:\t%d\n", state.stats.binding_changes);
+    sdtx_printf("Uniforms:\t%d\n", state.stats.uniform_updates);
+    sdtx_printf("Sort:\t\t%.2f ms\n", state.stats.sort_ms);
+    sdtx_printf("Submit:\t%.2f ms\n\n", state.submit_ms);
+    sdtx_puts("Mode:\t'SPACE'");
+    sdtx_draw();
+}
+
+void frame(void) {
+    lopgl_update();
+
+    sg_begin_default_pass(&state.pass_action, sapp_width(), sapp_height());
+
+    vs_params_t vs_params = {
+        .view = lopgl_view_matrix(),
+        .projection = HMM_Perspective(lopgl_fov(), (float)sapp_width() / (float)sapp_height(), 0.1f, 1000.0f)
+    };
+
+    const uint64_t submit_start = stm_now();
+    if (state.mode == SUBMIT_DIRECT) {
+        draw_direct(&vs_params);
+    } else {
+        draw_queued(&vs_params);
+    }
+    state.submit_ms = state.submit_ms * 0.95 + stm_ms(stm_since(submit_start)) * 0.05;
+
+    lopgl_render_help();
+
+    if (lopgl_ui_visible()) {
+        render_ui();
+    }
+
+    sg_end_pass();
+    sg_commit();
+}
+
+void event(const sapp_event* e) {
+    lopgl_handle_input(e);
+
+    if (e->type == SAPP_EVENTTYPE_KEY_DOWN) {
+        if (e->key_code == SAPP_KEYCODE_SPACE) {
+            state.mode = (state.mode + 1) % NUM_SUBMIT_MODES;
+        }
+    }
+}
+
+void cleanup(void) {
+    lopgl_shutdown();
+}
+
+sapp_desc sokol_main(int argc, char* argv[]) {
+    return (sapp_desc){
+        .init_cb = init,
+        .frame_cb = frame,
+        .cleanup_cb = cleanup,
+        .event_cb = event,
+        .width = 800,
+        .height = 600,
+        .gl_force_gles2 = true,
+        .window_title = "Draw Queue Stress (LearnOpenGL)",
+    };
+}
@@ -0,0 +1,63 @@
+@ctype vec4 hmm_vec4
+@ctype mat4 hmm_mat4
+
+@block vs_params
+uniform vs_params {
+    mat4 model;
+    mat4 view;
+    mat4 projection;
+};
+@end
+
+@vs vs
+in vec3 a_pos;
+in vec3 a_normal;
+
+out vec3 normal;
+
+@include_block vs_params
+
+void main() {
+    gl_Position = projection * view * model * vec4(a_pos, 1.0);
+    normal = mat3(model) * a_normal;
+}
+@end
+
+@vs vs_instanced
+// the draw queue sets the uniform model matrix to identity when drawing instanced
+in vec3 a_pos;
+in vec3 a_normal;
+in vec4 instance_mat0;
+in vec4 instance_mat1;
+in vec4 instance_mat2;
+in vec4 instance_mat3;
+
+out vec3 normal;
+
+@include_block vs_params
+
+void main() {
+    mat4 instance_model = model * mat4(instance_mat0, instance_mat1, instance_mat2, instance_mat3);
+    gl_Position = projection * view * instance_model * vec4(a_pos, 1.0);
+    normal = mat3(instance_model) * a_normal;
+}
+@end
+
+@fs fs
+in vec3 normal;
+
+out vec4 frag_color;
+
+uniform fs_params {
+    vec4 color;
+};
+
+void main() {
+    // the objects are only scaled uniformly
+    float diffuse = abs(dot(normalize(normal), normalize(vec3(0.3, 1.0, 0.5))));
+    frag_color = vec4(color.rgb * (0.3 + 0.7 * diffuse), color.a);
+}
+@end
+
+@program simple vs fs
+@program simple_instanced vs_instanced fs
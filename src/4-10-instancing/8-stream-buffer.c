@@ -0,0 +1,289 @@
+//------------------------------------------------------------------------------
+//  Instancing (8)
+//------------------------------------------------------------------------------
+#include "sokol_app.h"
+#include "sokol_gfx.h"
+#include "hmm/HandmadeMath.h"
+#include "8-stream-buffer.glsl.h"
+#define LOPGL_APP_IMPL
+#include "../lopgl_app.h"
+
+#define MAX_PARTICLES (512 * 1024)
+#define NUM_EMITTERS 64
+#define NUM_LOADS 4
+#define PARTICLE_LIFETIME 3.f
+/* small enough to grow a few times when switching to the higher loads */
+#define INITIAL_STREAM_SIZE (256 * 1024)
+
+static const int particle_loads[NUM_LOADS] = {
+    8 * 1024, 32 * 1024, 128 * 1024, MAX_PARTICLES
+};
+
+/* per-instance vertex data, 20 bytes */
+typedef struct particle_t {
+    float position[3];
+    float size;
+    uint32_t color;
+} particle_t;
+
+typedef struct emitter_t {
+    hmm_vec3 position;
+    uint32_t color;
+    float weight;           /* share of the particles, so that the chunks differ in size */
+} emitter_t;
+
+/* application state */
+static struct {
+    sg_pipeline pip;
+    sg_bindings bind;
+    lopgl_stream_buffer_t stream;
+    emitter_t emitters[NUM_EMITTERS];
+    int chunk_sizes[NUM_EMITTERS];
+    lopgl_stream_range_t chunks[NUM_EMITTERS];
+    int load;
+    int num_particles;
+    uint64_t time_stamp;
+    float time;
+    /* smoothed cpu time spent generating and appending the particles */
+    double generate_ms;
+    double append_ms;
+    double append_mb_per_sec;
+    int appended_bytes;
+    sg_pass_action pass_action;
+    /* staging memory, all chunks are generated before they are appended */
+    particle_t particles[MAX_PARTICLES];
+} state;
+
+static float random_float(float min, float max) {
+    return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+/* cheap integer hash, the particles aren't stored between frames */
+static uint32_t hash_u32(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+static float hash_float(uint32_t x) {
+    return (hash_u32(x) & 0xffffff) / (float)0xffffff;
+}
+
+static void init_emitters(void) {
+    float total_weight = 0.f;
+    for (int i = 0; i < NUM_EMITTERS; ++i) {
+        emitter_t* emitter = &state.emitters[i];
+        const float angle = HMM_PI32 * 2.f * i / NUM_EMITTERS;
+        emitter->position = HMM_Vec3(HMM_CosF(angle) * 20.f, -5.f, HMM_SinF(angle) * 20.f);
+        emitter->color = 0xff000000 | (uint32_t)(rand() & 0xffffff);
+        emitter->weight = random_float(0.2f, 1.f);
+        total_weight += emitter->weight;
+    }
+    for (int i = 0; i < NUM_EMITTERS; ++i) {
+        state.emitters[i].weight /= total_weight;
+    }
+}
+
+static void set_load(int load) {
+    state.load = load;
+    state.num_particles = 0;
+    for (int i = 0; i < NUM_EMITTERS; ++i) {
+        state.chunk_sizes[i] = (int)(particle_loads[load] * state.emitters[i].weight);
+        state.num_particles += state.chunk_sizes[i];
+    }
+    assert(state.num_particles <= MAX_PARTICLES);
+}
+
+static void init(void) {
+    lopgl_setup();
+
+    lopgl_orbital_cam_desc_t orbital_desc = lopgl_get_orbital_cam_desc();
+    orbital_desc.distance = 60.f;
+    orbital_desc.max_dist = 150.f;
+    orbital_desc.pitch = 20.f;
+    lopgl_set_orbital_cam(&orbital_desc);
+
+    lopgl_fp_cam_desc_t fp_desc = lopgl_get_fp_cam_desc();
+    fp_desc.position = HMM_Vec3(0.f, 10.f, 60.f);
+    lopgl_set_fp_cam(&fp_desc);
+
+    float corners[] = {
+        -1.f, -1.f,   1.f, -1.f,   1.f,  1.f,
+        -1.f, -1.f,   1.f,  1.f,  -1.f,  1.f
+    };
+    state.bind.vertex_buffers[0] = sg_make_buffer(&(sg_buffer_desc){
+        .size = sizeof(corners),
+        .content = corners,
+        .label = "particle-corners"
+    });
+
+    lopgl_make_stream_buffer(&state.stream, &(lopgl_stream_buffer_desc_t){
+        .size = INITIAL_STREAM_SIZE,
+        .label = "particle-instances"
+    });
+
+    state.pip = sg_make_pipeline(&(sg_pipeline_desc){
+        .shader = sg_make_shader(particle_shader_desc()),
+        .layout = {
+            .attrs = {
+                [ATTR_vs_a_corner] = { .format = SG_VERTEXFORMAT_FLOAT2, .buffer_index = 0 },
+                [ATTR_vs_instance_position_size] = { .format = SG_VERTEXFORMAT_FLOAT4, .offset = 0, .buffer_index = 1 },
+                [ATTR_vs_instance_color] = { .format = SG_VERTEXFORMAT_UBYTE4N, .offset = 16, .buffer_index = 1 }
+            },
+            .buffers[1] = { .stride = sizeof(particle_t), .step_func = SG_VERTEXSTEP_PER_INSTANCE }
+        },
+        .depth_stencil = {
+            .depth_compare_func = SG_COMPAREFUNC_LESS_EQUAL,
+            .depth_write_enabled = true,
+        },
+        .label = "particle-pipeline"
+    });
+
+    srand(42);
+    init_emitters();
+    set_load(1);
+
+    /* a pass action to clear framebuffer */
+    state.pass_action = (sg_pass_action) {
+        .colors[0] = { .action=SG_ACTION_CLEAR, .val={0.1f, 0.1f, 0.1f, 1.0f} }
+    };
+}
+
+/* fountains, each particle is launched again when its lifetime is over */
+static void generate_particles(void) {
+    particle_t* particle = state.particles;
+    for (int e = 0; e < NUM_EMITTERS; ++e) {
+        const emitter_t* emitter = &state.emitters[e];
+        const int count = state.chunk_sizes[e];
+        for (int i = 0; i < count; ++i, ++particle) {
+            const uint32_t seed = (uint32_t)(e * MAX_PARTICLES + i) * 3;
+            const float t = fmodf(state.time + PARTICLE_LIFETIME * i / count, PARTICLE_LIFETIME);
+            const float vx = hash_float(seed) * 4.f - 2.f;
+            const float vy = hash_float(seed + 1) * 4.f + 10.f;
+            const float vz = hash_float(seed + 2) * 4.f - 2.f;
+            particle->position[0] = emitter->position.X + vx * t;
+            particle->position[1] = emitter->position.Y + vy * t - 4.9f * t * t;
+            particle->position[2] = emitter->position.Z + vz * t;
+            particle->size = 0.15f;
+            particle->color = emitter->color;
+        }
+    }
+}
+
+static void append_particles(void) {
+    const particle_t* particles = state.particles;
+    state.appended_bytes = 0;
+    for (int e = 0; e < NUM_EMITTERS; ++e) {
+        const int count = state.chunk_sizes[e];
+        if (count > 0) {
+            const int size = count * (int)sizeof(particle_t);
+            state.chunks[e] = lopgl_append_stream_buffer(&state.stream, particles, size);
+            state.appended_bytes += size;
+        }
+        particles += count;
+    }
+}
+
+static void render_ui() {
+    sdtx_canvas(sapp_width()*0.5f, sapp_height()*0.5f);
+    sdtx_origin(sapp_width()*0.5f/8.f - 24.f, 0.25f);       // each character occupies a grid fo 8x8
+    sdtx_home();
+
+    sdtx_color4b(0xff, 0x00, 0x00, 0xaf);
+    sdtx_printf("Particles:\t%d\n", state.num_particles);
+    sdtx_printf("Chunks:\t\t%d\n", NUM_EMITTERS);
+    sdtx_printf("Appended:\t%.2f MB\n\n", state.appended_bytes / (1024.0 * 1024.0));
+    sdtx_printf("Generate:\t%.3f ms\n", state.generate_ms);
+    sdtx_printf("Append:\t%.3f ms\n", state.append_ms);
+    sdtx_printf("Throughput:\t%.0f MB/s\n\n", state.append_mb_per_sec);
+    sdtx_printf("Buffer:\t%.2f MB\n", state.stream.size / (1024.0 * 1024.0));
+    sdtx_printf("Grown:\t%d times\n\n", state.stream.grow_count);
+    sdtx_puts("Load:\t'SPACE'");
+    sdtx_draw();
+}
+
+void frame(void) {
+    /* instanced drawing isn't available on every WebGL 1 implementation */
+    if (!sg_query_features().instancing) {
+        lopgl_render_gles2_fallback();
+        return;
+    }
+
+    lopgl_update();
+    /* the particles repeat after their lifetime, which keeps the time precise */
+    state.time = fmodf(state.time + (float)stm_sec(stm_laptime(&state.time_stamp)), PARTICLE_LIFETIME);
+
+    uint64_t start = stm_now();
+    generate_particles();
+    state.generate_ms = state.generate_ms * 0.95 + stm_ms(stm_since(start)) * 0.05;
+
+    start = stm_now();
+    append_particles();
+    const double append_ms = stm_ms(stm_since(start));
+    state.append_ms = state.append_ms * 0.95 + append_ms * 0.05;
+    if (append_ms > 0.0) {
+        const double mb_per_sec = (state.appended_bytes / (1024.0 * 1024.0)) / (append_ms / 1000.0);
+        state.append_mb_per_sec = state.append_mb_per_sec * 0.95 + mb_per_sec * 0.05;
+    }
+
+    sg_begin_default_pass(&state.pass_action, sapp_width(), sapp_height());
+
+    vs_params_t vs_params = {
+        .view = lopgl_view_matrix(),
+        .projection = HMM_Perspective(lopgl_fov(), (float)sapp_width() / (float)sapp_height(), 0.1f, 500.0f)
+    };
+
+    sg_apply_pipeline(state.pip);
+    sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &vs_params, sizeof(vs_params));
+
+    /* every chunk is drawn from where it was appended */
+    for (int e = 0; e < NUM_EMITTERS; ++e) {
+        if (state.chunk_sizes[e] == 0) {
+            continue;
+        }
+        state.bind.vertex_buffers[1] = state.chunks[e].buffer;
+        state.bind.vertex_buffer_offsets[1] = state.chunks[e].offset;
+        sg_apply_bindings(&state.bind);
+        sg_draw(0, 6, state.chunk_sizes[e]);
+    }
+
+    lopgl_render_help();
+
+    if (lopgl_ui_visible()) {
+        render_ui();
+    }
+
+    sg_end_pass();
+    sg_commit();
+}
+
+void event(const sapp_event* e) {
+    lopgl_handle_input(e);
+
+    if (e->type == SAPP_EVENTTYPE_KEY_DOWN) {
+        if (e->key_code == SAPP_KEYCODE_SPACE) {
+            set_load((state.load + 1) % NUM_LOADS);
+        }
+    }
+}
+
+void cleanup(void) {
+    lopgl_destroy_stream_buffer(&state.stream);
+    lopgl_shutdown();
+}
+
+sapp_desc sokol_main(int argc, char* argv[]) {
+    return (sapp_desc){
+        .init_cb = init,
+        .frame_cb = frame,
+        .cleanup_cb = cleanup,
+        .event_cb = event,
+        .width = 800,
+        .height = 600,
+        .gl_force_gles2 = true,
+        .window_title = "Stream Buffer (LearnOpenGL)",
+    };
+}
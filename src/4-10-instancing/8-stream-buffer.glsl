@@ -0,0 +1,41 @@
+@ctype mat4 hmm_mat4
+
+@vs vs
+in vec2 a_corner;
+in vec4 instance_position_size;
+in vec4 instance_color;
+
+out vec2 corner;
+out vec4 color;
+
+uniform vs_params {
+    mat4 view;
+    mat4 projection;
+};
+
+void main() {
+    // the quads are expanded in view space, so they always face the camera
+    vec4 view_pos = view * vec4(instance_position_size.xyz, 1.0);
+    view_pos.xy += a_corner * instance_position_size.w;
+    gl_Position = projection * view_pos;
+    corner = a_corner;
+    color = instance_color;
+}
+@end
+
+@fs fs
+in vec2 corner;
+in vec4 color;
+
+out vec4 frag_color;
+
+void main() {
+    float dist = dot(corner, corner);
+    if (dist > 1.0) {
+        discard;
+    }
+    frag_color = vec4(color.rgb * (1.0 - 0.5 * dist), 1.0);
+}
+@end
+
+@program particle vs fs
@@ -0,0 +1,318 @@
+//------------------------------------------------------------------------------
+//  Instancing (9)
+//------------------------------------------------------------------------------
+#include "sokol_app.h"
+#include "sokol_gfx.h"
+#include "hmm/HandmadeMath.h"
+#include "9-parallel-recording.glsl.h"
+#define LOPGL_APP_IMPL
+#include "../lopgl_app.h"
+#define LOPGL_DRAW_LISTS_IMPL
+#include "../lopgl_draw_lists.h"
+#include "../lopgl_transforms.h"
+
+#define OBJECT_COUNT 100000
+#define NUM_COLORS 8
+#define NUM_LIST_COUNTS 5
+
+static const int list_counts[NUM_LIST_COUNTS] = { 1, 2, 4, 8, 16 };
+
+typedef enum mesh_type {
+    MESH_CUBE,
+    MESH_PYRAMID,
+    NUM_MESHES
+} mesh_type;
+
+typedef struct mesh_t {
+    sg_bindings bind;
+    int num_elements;
+} mesh_t;
+
+/* the objects are sorted by mesh, so that the replay rarely changes bindings */
+typedef struct object_t {
+    hmm_vec3 position;
+    hmm_vec3 axis;
+    float speed;                /* degrees per second */
+    float scale;
+    mesh_type mesh;
+    int color;
+} object_t;
+
+/* what the recording threads share, read-only while recording */
+typedef struct frame_data_t {
+    hmm_mat4 view_projection;
+    hmm_vec4 planes[6];
+    float time;
+} frame_data_t;
+
+/* application state */
+static struct {
+    mesh_t meshes[NUM_MESHES];
+    sg_pipeline pip;
+    fs_params_t colors[NUM_COLORS];
+    object_t objects[OBJECT_COUNT];
+    lopgl_draw_lists_t draw_lists;
+    int list_count;
+    uint64_t time_stamp;
+    float time;
+    /* smoothed cpu time of the recording for each list count and of the replay */
+    double record_ms[NUM_LIST_COUNTS];
+    double replay_ms;
+    sg_pass_action pass_action;
+} state;
+
+static float random_float(float min, float max) {
+    return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+/* positions and flat normals of the triangles */
+static mesh_t make_mesh(const float* positions, int num_vertices, const char* label) {
+    float vertices[36 * 6];
+    assert(num_vertices <= 36);
+
+    for (int i = 0; i < num_vertices; i += 3) {
+        const float* p = positions + i * 3;
+        hmm_vec3 a = HMM_Vec3(p[0], p[1], p[2]);
+        hmm_vec3 b = HMM_Vec3(p[3], p[4], p[5]);
+        hmm_vec3 c = HMM_Vec3(p[6], p[7], p[8]);
+        hmm_vec3 normal = HMM_NormalizeVec3(HMM_Cross(HMM_SubtractVec3(b, a), HMM_SubtractVec3(c, a)));
+
+        for (int v = 0; v < 3; ++v) {
+            memcpy(vertices + (i + v) * 6, p + v * 3, 3 * sizeof(float));
+            memcpy(vertices + (i + v) * 6 + 3, normal.Elements, 3 * sizeof(float));
+        }
+    }
+
+    return (mesh_t){
+        .bind.vertex_buffers[0] = sg_make_buffer(&(sg_buffer_desc){
+            .size = num_vertices * 6 * sizeof(float),
+            .content = vertices,
+            .label = label
+        }),
+        .num_elements = num_vertices
+    };
+}
+
+static void init_meshes(void) {
+    const float cube_positions[] = {
+        -0.5f, -0.5f, -0.5f,   0.5f,  0.5f, -0.5f,   0.5f, -0.5f, -0.5f,
+         0.5f,  0.5f, -0.5f,  -0.5f, -0.5f, -0.5f,  -0.5f,  0.5f, -0.5f,
+        -0.5f, -0.5f,  0.5f,   0.5f, -0.5f,  0.5f,   0.5f,  0.5f,  0.5f,
+         0.5f,  0.5f,  0.5f,  -0.5f,  0.5f,  0.5f,  -0.5f, -0.5f,  0.5f,
+        -0.5f,  0.5f,  0.5f,  -0.5f,  0.5f, -0.5f,  -0.5f, -0.5f, -0.5f,
+        -0.5f, -0.5f, -0.5f,  -0.5f, -0.5f,  0.5f,  -0.5f,  0.5f,  0.5f,
+         0.5f,  0.5f,  0.5f,   0.5f, -0.5f, -0.5f,   0.5f,  0.5f, -0.5f,
+         0.5f, -0.5f, -0.5f,   0.5f,  0.5f,  0.5f,   0.5f, -0.5f,  0.5f,
+        -0.5f, -0.5f, -0.5f,   0.5f, -0.5f, -0.5f,   0.5f, -0.5f,  0.5f,
+         0.5f, -0.5f,  0.5f,  -0.5f, -0.5f,  0.5f,  -0.5f, -0.5f, -0.5f,
+        -0.5f,  0.5f, -0.5f,   0.5f,  0.5f,  0.5f,   0.5f,  0.5f, -0.5f,
+         0.5f,  0.5f,  0.5f,  -0.5f,  0.5f, -0.5f,  -0.5f,  0.5f,  0.5f
+    };
+
+    const float pyramid_positions[] = {
+        -0.5f, -0.5f, -0.5f,   0.5f, -0.5f, -0.5f,   0.5f, -0.5f,  0.5f,
+         0.5f, -0.5f,  0.5f,  -0.5f, -0.5f,  0.5f,  -0.5f, -0.5f, -0.5f,
+        -0.5f, -0.5f,  0.5f,   0.5f, -0.5f,  0.5f,   0.0f,  0.5f,  0.0f,
+         0.5f, -0.5f,  0.5f,   0.5f, -0.5f, -0.5f,   0.0f,  0.5f,  0.0f,
+         0.5f, -0.5f, -0.5f,  -0.5f, -0.5f, -0.5f,   0.0f,  0.5f,  0.0f,
+        -0.5f, -0.5f, -0.5f,  -0.5f, -0.5f,  0.5f,   0.0f,  0.5f,  0.0f
+    };
+
+    state.meshes[MESH_CUBE] = make_mesh(cube_positions, 36, "cube-vertices");
+    state.meshes[MESH_PYRAMID] = make_mesh(pyramid_positions, 18, "pyramid-vertices");
+}
+
+static void init_objects(void) {
+    for (int i = 0; i < NUM_COLORS; ++i) {
+        state.colors[i].color = HMM_Vec4(random_float(0.2f, 1.f), random_float(0.2f, 1.f), random_float(0.2f, 1.f), 1.f);
+    }
+
+    for (int i = 0; i < OBJECT_COUNT; ++i) {
+        object_t* object = &state.objects[i];
+        object->position = HMM_Vec3(random_float(-60.f, 60.f), random_float(-60.f, 60.f), random_float(-60.f, 60.f));
+        object->axis = HMM_NormalizeVec3(HMM_Vec3(random_float(-1.f, 1.f), random_float(0.1f, 1.f), random_float(-1.f, 1.f)));
+        object->speed = random_float(-90.f, 90.f);
+        object->scale = random_float(0.3f, 0.8f);
+        object->mesh = i < OBJECT_COUNT / 2 ? MESH_CUBE : MESH_PYRAMID;
+        object->color = rand() % NUM_COLORS;
+    }
+}
+
+static void init(void) {
+    lopgl_setup();
+
+    lopgl_orbital_cam_desc_t orbital_desc = lopgl_get_orbital_cam_desc();
+    orbital_desc.distance = 120.f;
+    orbital_desc.max_dist = 250.f;
+    lopgl_set_orbital_cam(&orbital_desc);
+
+    lopgl_fp_cam_desc_t fp_desc = lopgl_get_fp_cam_desc();
+    fp_desc.position.Z = 120.f;
+    lopgl_set_fp_cam(&fp_desc);
+
+    init_meshes();
+
+    state.pip = sg_make_pipeline(&(sg_pipeline_desc){
+        .shader = sg_make_shader(simple_shader_desc()),
+        .layout = {
+            .attrs = {
+                [ATTR_vs_a_pos].format = SG_VERTEXFORMAT_FLOAT3,
+                [ATTR_vs_a_normal].format = SG_VERTEXFORMAT_FLOAT3
+            }
+        },
+        .depth_stencil = {
+            .depth_compare_func = SG_COMPAREFUNC_LESS_EQUAL,
+            .depth_write_enabled = true,
+        },
+        .label = "object-pipeline"
+    });
+
+    srand(42);
+    init_objects();
+
+    /* all list counts are available, more lists than job threads only make the parts smaller */
+    lopgl_init_draw_lists(&state.draw_lists, &(lopgl_draw_lists_desc_t){
+        .max_threads = LOPGL_MAX_DRAW_LIST_THREADS
+    });
+
+    /* a pass action to clear framebuffer */
+    state.pass_action = (sg_pass_action) {
+        .colors[0] = { .action=SG_ACTION_CLEAR, .val={0.1f, 0.1f, 0.1f, 1.0f} }
+    };
+}
+
+static bool sphere_visible(const hmm_vec4 planes[6], hmm_vec3 center, float radius) {
+    for (int i = 0; i < 6; ++i) {
+        if (HMM_DotVec3(planes[i].XYZ, center) + planes[i].W < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* runs on the recording threads: culls the objects, builds their matrices and records the visible ones */
+static void record_objects(lopgl_draw_list_t* list, int begin, int end, void* user_data) {
+    const frame_data_t* frame_data = user_data;
+
+    for (int i = begin; i < end; ++i) {
+        const object_t* object = &state.objects[i];
+        /* the bounding sphere of the unit cube */
+        if (!sphere_visible(frame_data->planes, object->position, object->scale * 0.87f)) {
+            continue;
+        }
+
+        hmm_mat4 model = HMM_Translate(object->position);
+        model = HMM_MultiplyMat4(model, HMM_Rotate(object->speed * frame_data->time, object->axis));
+        model = HMM_MultiplyMat4(model, HMM_Scale(HMM_Vec3(object->scale, object->scale, object->scale)));
+        const vs_params_t vs_params = {
+            .mvp = HMM_MultiplyMat4(frame_data->view_projection, model),
+            .model = model
+        };
+
+        const mesh_t* mesh = &state.meshes[object->mesh];
+        lopgl_record_draw(list, &(lopgl_draw_desc_t){
+            .pip = state.pip,
+            .bindings = &mesh->bind,
+            .num_elements = mesh->num_elements,
+            .vs_uniform_slot = SLOT_vs_params,
+            .vs_uniforms = &vs_params,
+            .vs_uniforms_size = sizeof(vs_params),
+            .fs_uniform_slot = SLOT_fs_params,
+            .fs_uniforms = &state.colors[object->color],
+            .fs_uniforms_size = sizeof(fs_params_t)
+        });
+    }
+}
+
+static void render_ui() {
+    const lopgl_draw_list_stats_t* stats = &state.draw_lists.stats;
+
+    sdtx_canvas(sapp_width()*0.5f, sapp_height()*0.5f);
+    sdtx_origin(sapp_width()*0.5f/8.f - 24.f, 0.25f);       // each character occupies a grid fo 8x8
+    sdtx_home();
+
+    sdtx_color4b(0xff, 0x00, 0x00, 0xaf);
+    sdtx_printf("Objects:\t%d\n", OBJECT_COUNT);
+    sdtx_printf("Recorded:\t%d\n", stats->packets);
+    sdtx_printf("Packets:\t%.1f MB\n", stats->bytes / (1024.0 * 1024.0));
+    sdtx_printf("Job threads:\t%d\n\n", lopgl_job_threads());
+    sdtx_puts("Lists    Record\n");
+    for (int i = 0; i < NUM_LIST_COUNTS; ++i) {
+        if (list_counts[i] > state.draw_lists.max_threads) {
+            break;
+        }
+        const char marker = i == state.list_count ? '*' : ' ';
+        if (state.record_ms[i] > 0.0) {
+            sdtx_printf("%c%2d\t%6.2f ms\n", marker, list_counts[i], state.record_ms[i]);
+        } else {
+            sdtx_printf("%c%2d\t     -\n", marker, list_counts[i]);
+        }
+    }
+    sdtx_printf("\nReplay:\t%.2f ms\n", state.replay_ms);
+    sdtx_printf("Pipelines:\t%d\n", stats->pipeline_changes);
+    sdtx_printf("Bindings:\t%d\n", stats->binding_changes);
+    sdtx_printf("Uniforms:\t%d\n\n", stats->uniform_updates);
+    sdtx_puts("Lists:\t'SPACE'");
+    sdtx_draw();
+}
+
+void frame(void) {
+    lopgl_update();
+    state.time += (float)stm_sec(stm_laptime(&state.time_stamp));
+
+    const hmm_mat4 projection = HMM_Perspective(lopgl_fov(), (float)sapp_width() / (float)sapp_height(), 0.1f, 1000.0f);
+    frame_data_t frame_data = {
+        .view_projection = HMM_MultiplyMat4(projection, lopgl_view_matrix()),
+        .time = state.time
+    };
+    lopgl_frustum_planes(frame_data.view_projection, frame_data.planes);
+
+    state.draw_lists.num_threads = list_counts[state.list_count];
+    lopgl_record_draw_lists(&state.draw_lists, OBJECT_COUNT, record_objects, &frame_data);
+    state.record_ms[state.list_count] = state.record_ms[state.list_count] * 0.95 + state.draw_lists.stats.record_ms * 0.05;
+
+    sg_begin_default_pass(&state.pass_action, sapp_width(), sapp_height());
+
+    lopgl_replay_draw_lists(&state.draw_lists);
+    state.replay_ms = state.replay_ms * 0.95 + state.draw_lists.stats.replay_ms * 0.05;
+
+    lopgl_render_help();
+
+    if (lopgl_ui_visible()) {
+        render_ui();
+    }
+
+    sg_end_pass();
+    sg_commit();
+}
+
+void event(const sapp_event* e) {
+    lopgl_handle_input(e);
+
+    if (e->type == SAPP_EVENTTYPE_KEY_DOWN) {
+        if (e->key_code == SAPP_KEYCODE_SPACE) {
+            state.list_count = (state.list_count + 1) % NUM_LIST_COUNTS;
+            if (list_counts[state.list_count] > state.draw_lists.max_threads) {
+                state.list_count = 0;
+            }
+        }
+    }
+}
+
+void cleanup(void) {
+    lopgl_destroy_draw_lists(&state.draw_lists);
+    lopgl_shutdown();
+}
+
+sapp_desc sokol_main(int argc, char* argv[]) {
+    return (sapp_desc){
+        .init_cb = init,
+        .frame_cb = frame,
+        .cleanup_cb = cleanup,
+        .event_cb = event,
+        .width = 800,
+        .height = 600,
+        .gl_force_gles2 = true,
+        .window_title = "Parallel Recording (LearnOpenGL)",
+    };
+}
@@ -0,0 +1,38 @@
+@ctype vec4 hmm_vec4
+@ctype mat4 hmm_mat4
+
+@vs vs
+in vec3 a_pos;
+in vec3 a_normal;
+
+out vec3 normal;
+
+// both matrices are built by the recording threads
+uniform vs_params {
+    mat4 mvp;
+    mat4 model;
+};
+
+void main() {
+    gl_Position = mvp * vec4(a_pos, 1.0);
+    normal = mat3(model) * a_normal;
+}
+@end
+
+@fs fs
+in vec3 normal;
+
+out vec4 frag_color;
+
+uniform fs_params {
+    vec4 color;
+};
+
+void main() {
+    // the objects are only scaled uniformly
+    float diffuse = max(dot(normalize(normal), normalize(vec3(0.3, 1.0, 0.5))), 0.0);
+    frag_color = vec4(color.rgb * (0.3 + 0.7 * diffuse), 1.0);
+}
+@end
+
+@program simple vs fs
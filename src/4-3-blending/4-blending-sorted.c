@@ -7,6 +7,8 @@
 #include "4-blending-sorted.glsl.h"
 #define LOPGL_APP_IMPL
 #include "../lopgl_app.h"
+#define LOPGL_TRANSPARENCY_IMPL
+#include "../lopgl_transparency.h"
 
 /* application state */
 static struct {
@@ -16,6 +18,7 @@ static struct {
     sg_bindings bind_transparent;
     sg_pass_action pass_action;
     hmm_vec3 vegetation[5];
+    lopgl_transparency_t sorted_vegetation;
     uint8_t file_buffer[2 * 1024 * 1024];
 } state;
 
@@ -34,6 +37,10 @@ static void init(void) {
     state.vegetation[3] = HMM_Vec3(-0.3f,  0.0f, -2.3f);
     state.vegetation[4] = HMM_Vec3( 0.5f,  0.0f, -0.6f);
 
+    lopgl_init_transparency(&state.sorted_vegetation, &(lopgl_transparency_desc_t){
+        .capacity = 5
+    });
+
     float cube_vertices[] = {
         // positions          // texture Coords
         -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
@@ -225,25 +232,11 @@ void frame(void) {
 
     sg_apply_bindings(&state.bind_transparent);
 
-    hmm_vec3 position = lopgl_camera_position();
-    
-    // simple bubble sort algorithm to sort vegetation from furthest to nearest
-    for (int i = 1; i < 5; ++i) {
-        for (int j = i - 1; j >= 0; --j) {
-            hmm_vec3 translate0 = HMM_SubtractVec3(state.vegetation[j], position);
-            hmm_vec3 translate1 = HMM_SubtractVec3(state.vegetation[j + 1], position);
-
-            if (HMM_LengthSquaredVec3(translate0) < HMM_LengthSquaredVec3(translate1)) {
-                hmm_vec3 temp = state.vegetation[j];
-                state.vegetation[j] = state.vegetation[j + 1];
-                state.vegetation[j + 1] = temp;
-                break;
-            }
-        }
-    }
+    // sort vegetation from furthest to nearest
+    lopgl_sort_transparency(&state.sorted_vegetation, state.vegetation, 5, lopgl_camera_position());
 
     for(size_t i = 0; i < 5; i++) {
-        vs_params.model = HMM_Translate(state.vegetation[i]);
+        vs_params.model = HMM_Translate(state.vegetation[state.sorted_vegetation.order[i]]);
         sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &vs_params, sizeof(vs_params));
         sg_draw(0, 6, 1);
     }
@@ -259,6 +252,7 @@ void event(const sapp_event* e) {
 }
 
 void cleanup(void) {
+    lopgl_destroy_transparency(&state.sorted_vegetation);
     lopgl_shutdown();
 }
 
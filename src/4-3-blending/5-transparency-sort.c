@@ -0,0 +1,274 @@
+//------------------------------------------------------------------------------
+//  Blending (5)
+//------------------------------------------------------------------------------
+#include "sokol_app.h"
+#include "sokol_gfx.h"
+#include "hmm/HandmadeMath.h"
+#include "5-transparency-sort.glsl.h"
+#define LOPGL_APP_IMPL
+#include "../lopgl_app.h"
+#define LOPGL_TRANSPARENCY_IMPL
+#include "../lopgl_transparency.h"
+
+#define MAX_QUADS 100000
+#define NUM_LOADS 3
+
+static const int quad_loads[NUM_LOADS] = { 1000, 10000, MAX_QUADS };
+
+static const char* sort_mode_names[LOPGL_NUM_SORT_MODES] = { "Coherent", "Radix" };
+
+/* per-instance vertex data, the kind selects the grass or the window texture */
+typedef struct billboard_t {
+    float position[3];
+    float kind;
+} billboard_t;
+
+/* application state */
+static struct {
+    sg_pipeline pip;
+    sg_bindings bind;
+    lopgl_stream_buffer_t stream;
+    lopgl_transparency_t sort;
+    int load;
+    int num_quads;
+    hmm_vec3 positions[MAX_QUADS];
+    billboard_t quads[MAX_QUADS];
+    /* smoothed cpu time of the sort for each mode, and of computing the keys and gathering the instances */
+    double sort_ms[LOPGL_NUM_SORT_MODES];
+    double key_ms;
+    double gather_ms;
+    sg_pass_action pass_action;
+    uint8_t file_buffer[2 * 1024 * 1024];
+} state;
+
+static float random_float(float min, float max) {
+    return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+static void fail_callback() {
+    state.pass_action = (sg_pass_action) {
+        .colors[0] = { .action = SG_ACTION_CLEAR, .val = { 1.0f, 0.0f, 0.0f, 1.0f } }
+    };
+}
+
+/* scatters the quads over a square that grows with their number, so the density stays the same */
+static void set_load(int load) {
+    state.load = load;
+    state.num_quads = quad_loads[load];
+    const float half_size = HMM_SquareRootF((float)state.num_quads) * 0.75f;
+
+    srand(42);
+    for (int i = 0; i < state.num_quads; ++i) {
+        state.positions[i] = HMM_Vec3(random_float(-half_size, half_size), 0.f, random_float(-half_size, half_size));
+        state.quads[i] = (billboard_t){
+            .position = { state.positions[i].X, state.positions[i].Y, state.positions[i].Z },
+            .kind = (float)(rand() & 1)
+        };
+    }
+
+    for (int i = 0; i < LOPGL_NUM_SORT_MODES; ++i) {
+        state.sort_ms[i] = 0.0;
+    }
+}
+
+static void init(void) {
+    lopgl_setup();
+
+    lopgl_orbital_cam_desc_t orbital_desc = lopgl_get_orbital_cam_desc();
+    orbital_desc.distance = 20.f;
+    orbital_desc.max_dist = 300.f;
+    orbital_desc.pitch = 15.f;
+    lopgl_set_orbital_cam(&orbital_desc);
+
+    float transparent_vertices[] = {
+        // positions         // texture Coords (swapped y coordinates because texture is flipped upside down)
+        0.0f,  0.5f,  0.0f,  0.0f,  0.0f,
+        0.0f, -0.5f,  0.0f,  0.0f,  1.0f,
+        1.0f, -0.5f,  0.0f,  1.0f,  1.0f,
+
+        0.0f,  0.5f,  0.0f,  0.0f,  0.0f,
+        1.0f, -0.5f,  0.0f,  1.0f,  1.0f,
+        1.0f,  0.5f,  0.0f,  1.0f,  0.0f
+    };
+
+    state.bind.vertex_buffers[0] = sg_make_buffer(&(sg_buffer_desc){
+        .size = sizeof(transparent_vertices),
+        .content = transparent_vertices,
+        .label = "transparent-vertices"
+    });
+
+    lopgl_make_stream_buffer(&state.stream, &(lopgl_stream_buffer_desc_t){
+        .size = MAX_QUADS * sizeof(billboard_t),
+        .label = "sorted-instances"
+    });
+
+    lopgl_init_transparency(&state.sort, &(lopgl_transparency_desc_t){
+        .capacity = MAX_QUADS
+    });
+
+    state.pip = sg_make_pipeline(&(sg_pipeline_desc){
+        .shader = sg_make_shader(transparent_shader_desc()),
+        .layout = {
+            .attrs = {
+                [ATTR_vs_a_pos] = { .format = SG_VERTEXFORMAT_FLOAT3, .buffer_index = 0 },
+                [ATTR_vs_a_tex_coords] = { .format = SG_VERTEXFORMAT_FLOAT2, .buffer_index = 0 },
+                [ATTR_vs_instance_position_kind] = { .format = SG_VERTEXFORMAT_FLOAT4, .buffer_index = 1 }
+            },
+            .buffers[1] = { .stride = sizeof(billboard_t), .step_func = SG_VERTEXSTEP_PER_INSTANCE }
+        },
+        .depth_stencil = {
+            .depth_compare_func = SG_COMPAREFUNC_LESS,
+            .depth_write_enabled = true,
+        },
+        .blend = {
+            .enabled = true,
+            .src_factor_rgb = SG_BLENDFACTOR_SRC_ALPHA,
+            .dst_factor_rgb = SG_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+            .op_rgb = SG_BLENDOP_ADD,
+            .src_factor_alpha = SG_BLENDFACTOR_SRC_ALPHA,
+            .dst_factor_alpha = SG_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+            .op_alpha = SG_BLENDOP_ADD
+        },
+        .label = "transparent-pipeline"
+    });
+
+    set_load(NUM_LOADS - 1);
+
+    /* a pass action to clear framebuffer */
+    state.pass_action = (sg_pass_action) {
+        .colors[0] = { .action=SG_ACTION_CLEAR, .val={0.1f, 0.1f, 0.1f, 1.0f} }
+    };
+
+    sg_image grass_img_id = sg_alloc_image();
+    state.bind.fs_images[SLOT_grass_texture] = grass_img_id;
+    sg_image window_img_id = sg_alloc_image();
+    state.bind.fs_images[SLOT_window_texture] = window_img_id;
+
+    lopgl_load_image(&(lopgl_image_request_t){
+            .path = "grass.png",
+            .img_id = grass_img_id,
+            .wrap_u = SG_WRAP_CLAMP_TO_EDGE,
+            .wrap_v = SG_WRAP_CLAMP_TO_EDGE,
+            .buffer_ptr = state.file_buffer,
+            .buffer_size = sizeof(state.file_buffer),
+            .fail_callback = fail_callback
+    });
+
+    lopgl_load_image(&(lopgl_image_request_t){
+            .path = "transparent_window.png",
+            .img_id = window_img_id,
+            .wrap_u = SG_WRAP_CLAMP_TO_EDGE,
+            .wrap_v = SG_WRAP_CLAMP_TO_EDGE,
+            .buffer_ptr = state.file_buffer,
+            .buffer_size = sizeof(state.file_buffer),
+            .fail_callback = fail_callback
+    });
+}
+
+static void render_ui() {
+    const lopgl_transparency_stats_t* stats = &state.sort.stats;
+
+    sdtx_canvas(sapp_width()*0.5f, sapp_height()*0.5f);
+    sdtx_origin(sapp_width()*0.5f/8.f - 24.f, 0.25f);       // each character occupies a grid fo 8x8
+    sdtx_home();
+
+    sdtx_color4b(0xff, 0x00, 0x00, 0xaf);
+    sdtx_printf("Quads:\t\t%d\n", state.num_quads);
+    sdtx_printf("Refined:\t%s\n", stats->refined ? "yes" : "no");
+    sdtx_printf("Shifts:\t\t%d\n", stats->shifts);
+    sdtx_printf("Fallbacks:\t%d\n\n", stats->fallbacks);
+    sdtx_puts("Sort\t\tTime\n");
+    for (int i = 0; i < LOPGL_NUM_SORT_MODES; ++i) {
+        const char marker = i == (int)state.sort.mode ? '*' : ' ';
+        if (state.sort_ms[i] > 0.0) {
+            sdtx_printf("%c%-9s\t%6.3f ms\n", marker, sort_mode_names[i], state.sort_ms[i]);
+        } else {
+            sdtx_printf("%c%-9s\t     -\n", marker, sort_mode_names[i]);
+        }
+    }
+    sdtx_printf("\nKeys:\t\t%.3f ms\n", state.key_ms);
+    sdtx_printf("Gather:\t%.3f ms\n\n", state.gather_ms);
+    sdtx_puts("Sort:\t'SPACE'\n");
+    sdtx_puts("Quads:\t'N'");
+    sdtx_draw();
+}
+
+void frame(void) {
+    /* instanced drawing isn't available on every WebGL 1 implementation */
+    if (!sg_query_features().instancing) {
+        lopgl_render_gles2_fallback();
+        return;
+    }
+
+    lopgl_update();
+
+    lopgl_sort_transparency(&state.sort, state.positions, state.num_quads, lopgl_camera_position());
+    const lopgl_transparency_stats_t* stats = &state.sort.stats;
+    state.sort_ms[state.sort.mode] = state.sort_ms[state.sort.mode] * 0.95 + stats->sort_ms * 0.05;
+    state.key_ms = state.key_ms * 0.95 + stats->key_ms * 0.05;
+
+    /* the sorted instances are only needed until they are appended to the stream buffer */
+    const uint64_t start = stm_now();
+    const int num_bytes = state.num_quads * (int)sizeof(billboard_t);
+    billboard_t* sorted = lopgl_frame_alloc((size_t)num_bytes, 0);
+    assert(sorted);
+    lopgl_gather_transparency(&state.sort, state.quads, sizeof(billboard_t), sorted);
+    const lopgl_stream_range_t range = lopgl_append_stream_buffer(&state.stream, sorted, num_bytes);
+    state.gather_ms = state.gather_ms * 0.95 + stm_ms(stm_since(start)) * 0.05;
+
+    sg_begin_default_pass(&state.pass_action, sapp_width(), sapp_height());
+
+    vs_params_t vs_params = {
+        .view = lopgl_view_matrix(),
+        .projection = HMM_Perspective(lopgl_fov(), (float)sapp_width() / (float)sapp_height(), 0.1f, 500.0f)
+    };
+
+    state.bind.vertex_buffers[1] = range.buffer;
+    state.bind.vertex_buffer_offsets[1] = range.offset;
+
+    sg_apply_pipeline(state.pip);
+    sg_apply_bindings(&state.bind);
+    sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &vs_params, sizeof(vs_params));
+    sg_draw(0, 6, state.num_quads);
+
+    lopgl_render_help();
+
+    if (lopgl_ui_visible()) {
+        render_ui();
+    }
+
+    sg_end_pass();
+    sg_commit();
+}
+
+void event(const sapp_event* e) {
+    lopgl_handle_input(e);
+
+    if (e->type == SAPP_EVENTTYPE_KEY_DOWN) {
+        if (e->key_code == SAPP_KEYCODE_SPACE) {
+            state.sort.mode = (state.sort.mode + 1) % LOPGL_NUM_SORT_MODES;
+        }
+        else if (e->key_code == SAPP_KEYCODE_N) {
+            set_load((state.load + 1) % NUM_LOADS);
+        }
+    }
+}
+
+void cleanup(void) {
+    lopgl_destroy_transparency(&state.sort);
+    lopgl_destroy_stream_buffer(&state.stream);
+    lopgl_shutdown();
+}
+
+sapp_desc sokol_main(int argc, char* argv[]) {
+    return (sapp_desc){
+        .init_cb = init,
+        .frame_cb = frame,
+        .cleanup_cb = cleanup,
+        .event_cb = event,
+        .width = 800,
+        .height = 600,
+        .gl_force_gles2 = true,
+        .window_title = "Transparency Sort (LearnOpenGL)",
+    };
+}
@@ -0,0 +1,40 @@
+@ctype mat4 hmm_mat4
+
+@vs vs
+in vec3 a_pos;
+in vec2 a_tex_coords;
+in vec4 instance_position_kind;
+
+out vec2 tex_coords;
+out float kind;
+
+uniform vs_params {
+    mat4 view;
+    mat4 projection;
+};
+
+void main() {
+    gl_Position = projection * view * vec4(a_pos + instance_position_kind.xyz, 1.0);
+    tex_coords = a_tex_coords;
+    kind = instance_position_kind.w;
+}
+@end
+
+@fs fs
+in vec2 tex_coords;
+in float kind;
+
+out vec4 frag_color;
+
+uniform sampler2D grass_texture;
+uniform sampler2D window_texture;
+
+void main() {
+    // all quads are in one draw, so both textures are bound and the instance picks one
+    vec4 grass_color = texture(grass_texture, tex_coords);
+    vec4 window_color = texture(window_texture, tex_coords);
+    frag_color = kind < 0.5 ? grass_color : window_color;
+}
+@end
+
+@program transparent vs fs
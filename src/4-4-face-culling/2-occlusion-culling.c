@@ -0,0 +1,335 @@
+//------------------------------------------------------------------------------
+//  Face Culling (2)
+//------------------------------------------------------------------------------
+#include "sokol_app.h"
+#include "sokol_gfx.h"
+#include "hmm/HandmadeMath.h"
+#include "2-occlusion-culling.glsl.h"
+#define LOPGL_APP_IMPL
+#include "../lopgl_app.h"
+#define LOPGL_OCCLUSION_IMPL
+#include "../lopgl_occlusion.h"
+
+/* city blocks along each side, one building per block */
+#define CITY_SIZE 64
+#define BLOCK_SIZE 4.f
+#define NUM_BUILDINGS (CITY_SIZE * CITY_SIZE)
+/* the buildings that cover most of the screen are rasterized as occluders */
+#define MAX_OCCLUDERS 32
+#define MIN_OCCLUDER_SIZE 0.1f
+
+/* per-instance vertex data, the box is the unit cube scaled by the half size */
+typedef struct instance_t {
+    float center_shade[4];
+    float half_size[4];
+} instance_t;
+
+/* application state */
+static struct {
+    sg_pipeline pip;
+    sg_bindings bind;
+    lopgl_stream_buffer_t stream;
+    lopgl_occlusion_t occlusion;
+    bool occlusion_enabled;
+    float cube_vertices[36 * 8];
+    instance_t ground;
+    instance_t buildings[NUM_BUILDINGS];
+    hmm_vec3 building_min[NUM_BUILDINGS];
+    hmm_vec3 building_max[NUM_BUILDINGS];
+    /* occluders of the current frame, largest first */
+    int occluders[MAX_OCCLUDERS];
+    float occluder_sizes[MAX_OCCLUDERS];
+    int num_occluders;
+    int num_drawn;
+    /* smoothed cpu time of the occluder selection and rasterization, and of the box tests */
+    double raster_ms;
+    double test_ms;
+    sg_pass_action pass_action;
+} state;
+
+static float random_float(float min, float max) {
+    return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+/* a grid of blocks with streets in between, most buildings are low and a few are towers */
+static void init_city(void) {
+    srand(42);
+    for (int z = 0; z < CITY_SIZE; ++z) {
+        for (int x = 0; x < CITY_SIZE; ++x) {
+            const int i = z * CITY_SIZE + x;
+            const float t = random_float(0.5f, 1.f);
+            const float height = t * t * t * 12.f + 1.f;
+            const hmm_vec3 center = HMM_Vec3(((float)(x - CITY_SIZE / 2) + 0.5f) * BLOCK_SIZE, height * 0.5f,
+                                             ((float)(z - CITY_SIZE / 2) + 0.5f) * BLOCK_SIZE);
+            const hmm_vec3 half_size = HMM_Vec3(random_float(1.f, 1.6f), height * 0.5f, random_float(1.f, 1.6f));
+
+            state.buildings[i] = (instance_t){
+                .center_shade = { center.X, center.Y, center.Z, random_float(0.5f, 0.9f) },
+                .half_size = { half_size.X, half_size.Y, half_size.Z, 0.f }
+            };
+            state.building_min[i] = HMM_SubtractVec3(center, half_size);
+            state.building_max[i] = HMM_AddVec3(center, half_size);
+        }
+    }
+
+    const float half_city = CITY_SIZE * BLOCK_SIZE * 0.5f;
+    state.ground = (instance_t){
+        .center_shade = { 0.f, -0.05f, 0.f, 0.3f },
+        .half_size = { half_city, 0.05f, half_city, 0.f }
+    };
+}
+
+static void init(void) {
+    lopgl_setup();
+
+    /* at eye height, looking down a street */
+    lopgl_orbital_cam_desc_t orbital_desc = lopgl_get_orbital_cam_desc();
+    orbital_desc.target = HMM_Vec3(0.f, 1.7f, 0.f);
+    orbital_desc.distance = 30.f;
+    orbital_desc.max_dist = 200.f;
+    orbital_desc.pitch = 0.f;
+    lopgl_set_orbital_cam(&orbital_desc);
+
+    lopgl_fp_cam_desc_t fp_desc = lopgl_get_fp_cam_desc();
+    fp_desc.position = HMM_Vec3(0.f, 1.7f, 20.f);
+    fp_desc.movement_speed = 0.02f;
+    lopgl_set_fp_cam(&fp_desc);
+
+    float cube_vertices[] = {
+        // back face
+        -1.f, -1.f, -1.f,  0.f,  0.f, -1.f, 0.f, 0.f, // bottom-left
+         1.f,  1.f, -1.f,  0.f,  0.f, -1.f, 1.f, 1.f, // top-right
+         1.f, -1.f, -1.f,  0.f,  0.f, -1.f, 1.f, 0.f, // bottom-right         
+         1.f,  1.f, -1.f,  0.f,  0.f, -1.f, 1.f, 1.f, // top-right
+        -1.f, -1.f, -1.f,  0.f,  0.f, -1.f, 0.f, 0.f, // bottom-left
+        -1.f,  1.f, -1.f,  0.f,  0.f, -1.f, 0.f, 1.f, // top-left
+        // front face
+        -1.f, -1.f,  1.f,  0.f,  0.f,  1.f, 0.f, 0.f, // bottom-left
+         1.f, -1.f,  1.f,  0.f,  0.f,  1.f, 1.f, 0.f, // bottom-right
+         1.f,  1.f,  1.f,  0.f,  0.f,  1.f, 1.f, 1.f, // top-right
+         1.f,  1.f,  1.f,  0.f,  0.f,  1.f, 1.f, 1.f, // top-right
+        -1.f,  1.f,  1.f,  0.f,  0.f,  1.f, 0.f, 1.f, // top-left
+        -1.f, -1.f,  1.f,  0.f,  0.f,  1.f, 0.f, 0.f, // bottom-left
+        // left face
+        -1.f,  1.f,  1.f, -1.f,  0.f,  0.f, 1.f, 0.f, // top-right
+        -1.f,  1.f, -1.f, -1.f,  0.f,  0.f, 1.f, 1.f, // top-left
+        -1.f, -1.f, -1.f, -1.f,  0.f,  0.f, 0.f, 1.f, // bottom-left
+        -1.f, -1.f, -1.f, -1.f,  0.f,  0.f, 0.f, 1.f, // bottom-left
+        -1.f, -1.f,  1.f, -1.f,  0.f,  0.f, 0.f, 0.f, // bottom-right
+        -1.f,  1.f,  1.f, -1.f,  0.f,  0.f, 1.f, 0.f, // top-right
+        // right face
+         1.f,  1.f,  1.f,  1.f,  0.f,  0.f, 1.f, 0.f, // top-left
+         1.f, -1.f, -1.f,  1.f,  0.f,  0.f, 0.f, 1.f, // bottom-right
+         1.f,  1.f, -1.f,  1.f,  0.f,  0.f, 1.f, 1.f, // top-right         
+         1.f, -1.f, -1.f,  1.f,  0.f,  0.f, 0.f, 1.f, // bottom-right
+         1.f,  1.f,  1.f,  1.f,  0.f,  0.f, 1.f, 0.f, // top-left
+         1.f, -1.f,  1.f,  1.f,  0.f,  0.f, 0.f, 0.f, // bottom-left     
+        // bottom face
+        -1.f, -1.f, -1.f,  0.f, -1.f,  0.f, 0.f, 1.f, // top-right
+         1.f, -1.f, -1.f,  0.f, -1.f,  0.f, 1.f, 1.f, // top-left
+         1.f, -1.f,  1.f,  0.f, -1.f,  0.f, 1.f, 0.f, // bottom-left
+         1.f, -1.f,  1.f,  0.f, -1.f,  0.f, 1.f, 0.f, // bottom-left
+        -1.f, -1.f,  1.f,  0.f, -1.f,  0.f, 0.f, 0.f, // bottom-right
+        -1.f, -1.f, -1.f,  0.f, -1.f,  0.f, 0.f, 1.f, // top-right
+        // top face
+        -1.f,  1.f, -1.f,  0.f,  1.f,  0.f, 0.f, 1.f, // top-left
+         1.f,  1.f , 1.f,  0.f,  1.f,  0.f, 1.f, 0.f, // bottom-right
+         1.f,  1.f, -1.f,  0.f,  1.f,  0.f, 1.f, 1.f, // top-right     
+         1.f,  1.f,  1.f,  0.f,  1.f,  0.f, 1.f, 0.f, // bottom-right
+        -1.f,  1.f, -1.f,  0.f,  1.f,  0.f, 0.f, 1.f, // top-left
+        -1.f,  1.f,  1.f,  0.f,  1.f,  0.f, 0.f, 0.f  // bottom-left        
+    };
+    /* the same triangles are rasterized as occluders */
+    memcpy(state.cube_vertices, cube_vertices, sizeof(cube_vertices));
+
+    state.bind.vertex_buffers[0] = sg_make_buffer(&(sg_buffer_desc){
+        .size = sizeof(cube_vertices),
+        .content = cube_vertices,
+        .label = "cube-vertices"
+    });
+
+    lopgl_make_stream_buffer(&state.stream, &(lopgl_stream_buffer_desc_t){
+        .size = (NUM_BUILDINGS + 1) * sizeof(instance_t),
+        .label = "box-instances"
+    });
+
+    lopgl_init_occlusion(&state.occlusion, &(lopgl_occlusion_desc_t){
+        .width = 256,
+        .height = 128
+    });
+    state.occlusion_enabled = true;
+
+    state.pip = sg_make_pipeline(&(sg_pipeline_desc){
+        .shader = sg_make_shader(box_shader_desc()),
+        .layout = {
+            /* the texture coords of the cube are skipped */
+            .buffers[0].stride = 8 * sizeof(float),
+            .buffers[1] = { .stride = sizeof(instance_t), .step_func = SG_VERTEXSTEP_PER_INSTANCE },
+            .attrs = {
+                [ATTR_vs_a_pos] = { .format = SG_VERTEXFORMAT_FLOAT3, .offset = 0, .buffer_index = 0 },
+                [ATTR_vs_a_normal] = { .format = SG_VERTEXFORMAT_FLOAT3, .offset = 12, .buffer_index = 0 },
+                [ATTR_vs_instance_center_shade] = { .format = SG_VERTEXFORMAT_FLOAT4, .offset = 0, .buffer_index = 1 },
+                [ATTR_vs_instance_half_size] = { .format = SG_VERTEXFORMAT_FLOAT4, .offset = 16, .buffer_index = 1 }
+            }
+        },
+        .depth_stencil = {
+            .depth_compare_func = SG_COMPAREFUNC_LESS_EQUAL,
+            .depth_write_enabled = true,
+        },
+        .rasterizer = {
+            .cull_mode = SG_CULLMODE_BACK,
+            .face_winding = SG_FACEWINDING_CCW
+        },
+        .label = "box-pipeline"
+    });
+
+    init_city();
+
+    /* a pass action to clear framebuffer */
+    state.pass_action = (sg_pass_action) {
+        .colors[0] = { .action=SG_ACTION_CLEAR, .val={0.6f, 0.7f, 0.8f, 1.0f} }
+    };
+}
+
+/* keeps the buildings that appear largest from the camera, the size is the half extent over the distance */
+static void select_occluders(hmm_vec3 camera_pos) {
+    state.num_occluders = 0;
+    for (int i = 0; i < NUM_BUILDINGS; ++i) {
+        const instance_t* building = &state.buildings[i];
+        const hmm_vec3 center = HMM_Vec3(building->center_shade[0], building->center_shade[1], building->center_shade[2]);
+        const float half_extent = HMM_MAX(HMM_MAX(building->half_size[0], building->half_size[2]), building->half_size[1]);
+        const float size = half_extent / HMM_LengthVec3(HMM_SubtractVec3(center, camera_pos));
+        if (size < MIN_OCCLUDER_SIZE) {
+            continue;
+        }
+        if (state.num_occluders == MAX_OCCLUDERS && size <= state.occluder_sizes[MAX_OCCLUDERS - 1]) {
+            continue;
+        }
+
+        int slot = state.num_occluders < MAX_OCCLUDERS ? state.num_occluders++ : MAX_OCCLUDERS - 1;
+        while (slot > 0 && state.occluder_sizes[slot - 1] < size) {
+            state.occluders[slot] = state.occluders[slot - 1];
+            state.occluder_sizes[slot] = state.occluder_sizes[slot - 1];
+            --slot;
+        }
+        state.occluders[slot] = i;
+        state.occluder_sizes[slot] = size;
+    }
+}
+
+static void rasterize_occluders(void) {
+    select_occluders(lopgl_camera_position());
+    for (int i = 0; i < state.num_occluders; ++i) {
+        const instance_t* building = &state.buildings[state.occluders[i]];
+        const hmm_mat4 model = HMM_MultiplyMat4(
+            HMM_Translate(HMM_Vec3(building->center_shade[0], building->center_shade[1], building->center_shade[2])),
+            HMM_Scale(HMM_Vec3(building->half_size[0], building->half_size[1], building->half_size[2])));
+        lopgl_rasterize_occluder(&state.occlusion, state.cube_vertices, 8 * sizeof(float), 36, model);
+    }
+}
+
+static void render_ui() {
+    const lopgl_occlusion_stats_t* stats = &state.occlusion.stats;
+
+    sdtx_canvas(sapp_width()*0.5f, sapp_height()*0.5f);
+    sdtx_origin(sapp_width()*0.5f/8.f - 26.f, 0.25f);       // each character occupies a grid fo 8x8
+    sdtx_home();
+
+    sdtx_color4b(0xff, 0x00, 0x00, 0xaf);
+    sdtx_printf("Buildings:\t%d\n", NUM_BUILDINGS);
+    sdtx_printf("Occluders:\t%d\n", stats->occluders);
+    sdtx_printf("Triangles:\t%d\n", stats->triangles);
+    sdtx_printf("Frustum:\t%d culled\n", stats->frustum_culled);
+    sdtx_printf("Occlusion:\t%d culled\n", stats->occluded);
+    sdtx_printf("Drawn:\t\t%d\n\n", state.num_drawn);
+    sdtx_printf("Raster:\t%.3f ms\n", state.raster_ms);
+    sdtx_printf("Test:\t\t%.3f ms\n\n", state.test_ms);
+    sdtx_printf("Occlusion:\t%s\n", state.occlusion_enabled ? "on" : "off");
+    sdtx_puts("Toggle:\t'SPACE'");
+    sdtx_draw();
+}
+
+void frame(void) {
+    /* instanced drawing isn't available on every WebGL 1 implementation */
+    if (!sg_query_features().instancing) {
+        lopgl_render_gles2_fallback();
+        return;
+    }
+
+    lopgl_update();
+
+    const hmm_mat4 projection = HMM_Perspective(lopgl_fov(), (float)sapp_width() / (float)sapp_height(), 0.1f, 500.0f);
+    const hmm_mat4 view_projection = HMM_MultiplyMat4(projection, lopgl_view_matrix());
+
+    /* without occluders the boxes are only tested against the frustum */
+    uint64_t start = stm_now();
+    lopgl_begin_occlusion(&state.occlusion, view_projection);
+    if (state.occlusion_enabled) {
+        rasterize_occluders();
+    }
+    state.raster_ms = state.raster_ms * 0.95 + stm_ms(stm_since(start)) * 0.05;
+
+    start = stm_now();
+    instance_t* instances = lopgl_frame_alloc((NUM_BUILDINGS + 1) * sizeof(instance_t), 0);
+    assert(instances);
+    instances[0] = state.ground;
+    int num_instances = 1;
+    for (int i = 0; i < NUM_BUILDINGS; ++i) {
+        if (lopgl_test_occlusion(&state.occlusion, state.building_min[i], state.building_max[i])) {
+            instances[num_instances++] = state.buildings[i];
+        }
+    }
+    state.test_ms = state.test_ms * 0.95 + stm_ms(stm_since(start)) * 0.05;
+    state.num_drawn = num_instances - 1;
+
+    const lopgl_stream_range_t range = lopgl_append_stream_buffer(&state.stream, instances, num_instances * (int)sizeof(instance_t));
+    state.bind.vertex_buffers[1] = range.buffer;
+    state.bind.vertex_buffer_offsets[1] = range.offset;
+
+    sg_begin_default_pass(&state.pass_action, sapp_width(), sapp_height());
+
+    vs_params_t vs_params = {
+        .view_projection = view_projection
+    };
+
+    sg_apply_pipeline(state.pip);
+    sg_apply_bindings(&state.bind);
+    sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &vs_params, sizeof(vs_params));
+    sg_draw(0, 36, num_instances);
+
+    lopgl_render_help();
+
+    if (lopgl_ui_visible()) {
+        render_ui();
+    }
+
+    sg_end_pass();
+    sg_commit();
+}
+
+void event(const sapp_event* e) {
+    lopgl_handle_input(e);
+
+    if (e->type == SAPP_EVENTTYPE_KEY_DOWN && e->key_code == SAPP_KEYCODE_SPACE) {
+        state.occlusion_enabled = !state.occlusion_enabled;
+    }
+}
+
+void cleanup(void) {
+    lopgl_destroy_occlusion(&state.occlusion);
+    lopgl_destroy_stream_buffer(&state.stream);
+    lopgl_shutdown();
+}
+
+sapp_desc sokol_main(int argc, char* argv[]) {
+    return (sapp_desc){
+        .init_cb = init,
+        .frame_cb = frame,
+        .cleanup_cb = cleanup,
+        .event_cb = event,
+        .width = 800,
+        .height = 600,
+        .gl_force_gles2 = true,
+        .window_title = "Occlusion Culling (LearnOpenGL)",
+    };
+}
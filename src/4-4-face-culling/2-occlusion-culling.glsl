@@ -0,0 +1,38 @@
+@ctype vec4 hmm_vec4
+@ctype mat4 hmm_mat4
+
+@vs vs
+in vec3 a_pos;
+in vec3 a_normal;
+in vec4 instance_center_shade;
+in vec4 instance_half_size;
+
+out vec3 normal;
+out float shade;
+
+uniform vs_params {
+    mat4 view_projection;
+};
+
+void main() {
+    // the cube spans -1 to 1, the boxes are only scaled so the normals stay the same
+    vec3 world_pos = instance_center_shade.xyz + a_pos * instance_half_size.xyz;
+    gl_Position = view_projection * vec4(world_pos, 1.0);
+    normal = a_normal;
+    shade = instance_center_shade.w;
+}
+@end
+
+@fs fs
+in vec3 normal;
+in float shade;
+
+out vec4 frag_color;
+
+void main() {
+    float diffuse = max(dot(normalize(normal), normalize(vec3(0.3, 1.0, 0.5))), 0.0);
+    frag_color = vec4(vec3(shade) * (0.3 + 0.7 * diffuse), 1.0);
+}
+@end
+
+@program box vs fs
@@ -0,0 +1,166 @@
+//------------------------------------------------------------------------------
+//  Occlusion culling test
+//
+//  Runs lopgl_occlusion.h headless and checks that it never culls a box
+//  that is visible: boxes that an occluder only partly covers, and random
+//  boxes and occluders checked against a ray cast with 4x4 rays per pixel.
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#define HANDMADE_MATH_IMPLEMENTATION
+#include "hmm/HandmadeMath.h"
+#undef HANDMADE_MATH_IMPLEMENTATION
+#define LOPGL_OCCLUSION_IMPL
+#include "../lopgl_occlusion.h"
+
+#define WIDTH 256
+#define HEIGHT 128
+/* 90 degrees vertical field of view */
+#define TAN_HALF_FOV 1.f
+#define ASPECT ((float)WIDTH / (float)HEIGHT)
+#define NUM_RANDOM_TESTS 2000
+#define RAYS_PER_AXIS 4
+
+/* the unit cube with counter clockwise front faces */
+static const float cube_positions[] = {
+    // back face
+    -1.f, -1.f, -1.f,   1.f,  1.f, -1.f,   1.f, -1.f, -1.f,
+     1.f,  1.f, -1.f,  -1.f, -1.f, -1.f,  -1.f,  1.f, -1.f,
+    // front face
+    -1.f, -1.f,  1.f,   1.f, -1.f,  1.f,   1.f,  1.f,  1.f,
+     1.f,  1.f,  1.f,  -1.f,  1.f,  1.f,  -1.f, -1.f,  1.f,
+    // left face
+    -1.f,  1.f,  1.f,  -1.f,  1.f, -1.f,  -1.f, -1.f, -1.f,
+    -1.f, -1.f, -1.f,  -1.f, -1.f,  1.f,  -1.f,  1.f,  1.f,
+    // right face
+     1.f,  1.f,  1.f,   1.f, -1.f, -1.f,   1.f,  1.f, -1.f,
+     1.f, -1.f, -1.f,   1.f,  1.f,  1.f,   1.f, -1.f,  1.f,
+    // bottom face
+    -1.f, -1.f, -1.f,   1.f, -1.f, -1.f,   1.f, -1.f,  1.f,
+     1.f, -1.f,  1.f,  -1.f, -1.f,  1.f,  -1.f, -1.f, -1.f,
+    // top face
+    -1.f,  1.f, -1.f,   1.f,  1.f,  1.f,   1.f,  1.f, -1.f,
+     1.f,  1.f,  1.f,  -1.f,  1.f, -1.f,  -1.f,  1.f,  1.f
+};
+
+static float random_float(float min, float max) {
+    return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+/* the camera at the origin looking down -z */
+static void begin(lopgl_occlusion_t* occlusion) {
+    const hmm_mat4 projection = HMM_Perspective(90.f, ASPECT, .1f, 100.f);
+    const hmm_mat4 view = HMM_LookAt(HMM_Vec3(0.f, 0.f, 0.f), HMM_Vec3(0.f, 0.f, -1.f), HMM_Vec3(0.f, 1.f, 0.f));
+    lopgl_begin_occlusion(occlusion, HMM_MultiplyMat4(projection, view));
+}
+
+static void rasterize_box(lopgl_occlusion_t* occlusion, hmm_vec3 min, hmm_vec3 max) {
+    const hmm_vec3 center = HMM_MultiplyVec3f(HMM_AddVec3(min, max), .5f);
+    const hmm_vec3 half_size = HMM_MultiplyVec3f(HMM_SubtractVec3(max, min), .5f);
+    const hmm_mat4 model = HMM_MultiplyMat4(HMM_Translate(center), HMM_Scale(half_size));
+    lopgl_rasterize_occluder(occlusion, cube_positions, 3 * sizeof(float), 36, model);
+}
+
+/* the world x that lands on the screen x of the buffer at the depth */
+static float world_x(float screen_x, float depth) {
+    return (screen_x / (float)WIDTH * 2.f - 1.f) * TAN_HALF_FOV * ASPECT * depth;
+}
+
+/* distance along the ray to the box, or -1 when the ray misses it */
+static float ray_box(hmm_vec3 dir, hmm_vec3 min, hmm_vec3 max) {
+    float t_near = 0.f;
+    float t_far = 1e30f;
+    for (int i = 0; i < 3; ++i) {
+        const float t0 = min.Elements[i] / dir.Elements[i];
+        const float t1 = max.Elements[i] / dir.Elements[i];
+        t_near = HMM_MAX(t_near, HMM_MIN(t0, t1));
+        t_far = HMM_MIN(t_far, HMM_MAX(t0, t1));
+    }
+    return t_near <= t_far ? t_near : -1.f;
+}
+
+/* fraction of the rays over the screen rectangle of the box that hit it in front of the occluder */
+static float visible_fraction(hmm_vec3 box_min, hmm_vec3 box_max, hmm_vec3 occluder_min, hmm_vec3 occluder_max) {
+    int hits = 0;
+    int visible = 0;
+    for (int y = 0; y < HEIGHT * RAYS_PER_AXIS; ++y) {
+        for (int x = 0; x < WIDTH * RAYS_PER_AXIS; ++x) {
+            const float ndc_x = ((float)x + .5f) / (float)(WIDTH * RAYS_PER_AXIS) * 2.f - 1.f;
+            const float ndc_y = ((float)y + .5f) / (float)(HEIGHT * RAYS_PER_AXIS) * 2.f - 1.f;
+            const hmm_vec3 dir = HMM_Vec3(ndc_x * TAN_HALF_FOV * ASPECT, ndc_y * TAN_HALF_FOV, -1.f);
+            const float t_box = ray_box(dir, box_min, box_max);
+            if (t_box < 0.f) {
+                continue;
+            }
+            ++hits;
+            const float t_occluder = ray_box(dir, occluder_min, occluder_max);
+            if (t_occluder < 0.f || t_box < t_occluder) {
+                ++visible;
+            }
+        }
+    }
+    return hits > 0 ? (float)visible / (float)hits : 0.f;
+}
+
+static int check(bool ok, const char* name) {
+    printf("%s: %s\n", name, ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    lopgl_occlusion_t occlusion;
+    lopgl_init_occlusion(&occlusion, &(lopgl_occlusion_desc_t){ .width = WIDTH, .height = HEIGHT });
+    int failed = 0;
+
+    /* a thin wall at a depth of 4 whose right edge is at 140.6 pixels, over the center of the column 140 */
+    const float wall_depth = 4.f;
+    const hmm_vec3 wall_min = HMM_Vec3(-20.f, -20.f, -wall_depth - .01f);
+    const hmm_vec3 wall_max = HMM_Vec3(world_x(140.6f, wall_depth), 20.f, -wall_depth);
+
+    /* the box reaches to 140.8 pixels behind the wall, visible in a fifth of the column 140 */
+    begin(&occlusion);
+    rasterize_box(&occlusion, wall_min, wall_max);
+    const float box_depth = 8.f;
+    hmm_vec3 box_min = HMM_Vec3(-3.f, -1.f, -box_depth - .1f);
+    hmm_vec3 box_max = HMM_Vec3(world_x(140.8f, box_depth), 1.f, -box_depth);
+    failed += check(visible_fraction(box_min, box_max, wall_min, wall_max) > 0.f, "partly covered box is visible in the ray cast");
+    failed += check(lopgl_test_occlusion(&occlusion, box_min, box_max), "partly covered box is not culled");
+
+    /* a few pixels further left the wall covers the box, across the diagonals of the wall's faces */
+    box_max.X = world_x(137.f, box_depth);
+    failed += check(visible_fraction(box_min, box_max, wall_min, wall_max) == 0.f, "covered box is hidden in the ray cast");
+    failed += check(!lopgl_test_occlusion(&occlusion, box_min, box_max), "covered box is culled");
+
+    /* random boxes behind random occluders, culled boxes must be hidden from every ray */
+    srand(42);
+    int culled = 0;
+    int wrongly_culled = 0;
+    float worst = 0.f;
+    for (int i = 0; i < NUM_RANDOM_TESTS; ++i) {
+        const hmm_vec3 occluder_center = HMM_Vec3(random_float(-6.f, 6.f), random_float(-3.f, 3.f), random_float(-10.f, -5.f));
+        const hmm_vec3 occluder_half = HMM_Vec3(random_float(.3f, 3.f), random_float(.3f, 3.f), random_float(.3f, 3.f));
+        const hmm_vec3 box_center = HMM_Vec3(random_float(-6.f, 6.f), random_float(-3.f, 3.f), random_float(-20.f, -11.f));
+        const hmm_vec3 box_half = HMM_Vec3(random_float(.1f, 1.5f), random_float(.1f, 1.5f), random_float(.1f, 1.5f));
+        const hmm_vec3 occluder_min = HMM_SubtractVec3(occluder_center, occluder_half);
+        const hmm_vec3 occluder_max = HMM_AddVec3(occluder_center, occluder_half);
+        box_min = HMM_SubtractVec3(box_center, box_half);
+        box_max = HMM_AddVec3(box_center, box_half);
+
+        begin(&occlusion);
+        rasterize_box(&occlusion, occluder_min, occluder_max);
+        if (lopgl_test_occlusion(&occlusion, box_min, box_max)) {
+            continue;
+        }
+        ++culled;
+        const float visible = visible_fraction(box_min, box_max, occluder_min, occluder_max);
+        if (visible > 0.f) {
+            ++wrongly_culled;
+            worst = HMM_MAX(worst, visible);
+        }
+    }
+    printf("random boxes: %d of %d culled, %d of them visible, up to %.1f%%\n", culled, NUM_RANDOM_TESTS, wrongly_culled, 100.f * worst);
+    failed += check(culled > 0 && wrongly_culled == 0, "culled random boxes are hidden in the ray cast");
+
+    lopgl_destroy_occlusion(&occlusion);
+    return failed > 0 ? 1 : 0;
+}
@@ -7,6 +7,10 @@
 #include "1-mapping-depth.glsl.h"
 #define LOPGL_APP_IMPL
 #include "../lopgl_app.h"
+#define LOPGL_SHADOW_FORMAT_IMPL
+#include "../lopgl_shadow_format.h"
+
+#define SHADOW_MAP_SIZE 1024
 
 /* application state */
 static struct {
@@ -23,11 +27,15 @@ static struct {
         sg_bindings bind;
     } quad;
     hmm_mat4 light_space_matrix;
+    const lopgl_shadow_format_t* shadow_format;
 } state;
 
 static void init(void) {
     lopgl_setup();
 
+    state.shadow_format = lopgl_shadow_format();
+    const bool packed = state.shadow_format->packed;
+
     // compute light space matrix
     hmm_vec3 light_pos = HMM_Vec3(-2.f, 4.65f, -1.f);
     float near_plane = 1.f;
@@ -39,9 +47,9 @@ static void init(void) {
      /* a render pass with one color- and one depth-attachment image */
     sg_image_desc img_desc = {
         .render_target = true,
-        .width = 1024,
-        .height = 1024,
-        .pixel_format = SG_PIXELFORMAT_RGBA8,
+        .width = SHADOW_MAP_SIZE,
+        .height = SHADOW_MAP_SIZE,
+        .pixel_format = state.shadow_format->pixel_format,
         .min_filter = SG_FILTER_NEAREST,
         .mag_filter = SG_FILTER_NEAREST,
         .sample_count = 1,
@@ -149,7 +157,7 @@ static void init(void) {
     
     state.quad.bind.vertex_buffers[0] = quad_buffer;
 
-    sg_shader shd_depth = sg_make_shader(depth_shader_desc());
+    sg_shader shd_depth = sg_make_shader(packed ? depth_shader_desc() : depth_float_shader_desc());
 
     state.depth.pip = sg_make_pipeline(&(sg_pipeline_desc){
         .shader = shd_depth,
@@ -163,13 +171,13 @@ static void init(void) {
             .depth_write_enabled = true,
         },
         .blend = {
-            .color_format = SG_PIXELFORMAT_RGBA8,
+            .color_format = state.shadow_format->pixel_format,
             .depth_format = SG_PIXELFORMAT_DEPTH
         },
         .label = "depth-pipeline"
     });
 
-    sg_shader shd_quad = sg_make_shader(quad_shader_desc());
+    sg_shader shd_quad = sg_make_shader(packed ? quad_shader_desc() : quad_float_shader_desc());
 
     state.quad.pip = sg_make_pipeline(&(sg_pipeline_desc){
         .shader = shd_quad,
@@ -192,6 +200,16 @@ static void init(void) {
     };
 }
 
+static void render_ui() {
+    sdtx_canvas(sapp_width()*0.5f, sapp_height()*0.5f);
+    sdtx_origin(sapp_width()*0.5f/8.f - 24.f, 0.25f);       // each character occupies a grid fo 8x8
+    sdtx_home();
+
+    sdtx_color4b(0xff, 0x00, 0x00, 0xaf);
+    lopgl_print_shadow_formats(state.shadow_format, SHADOW_MAP_SIZE * SHADOW_MAP_SIZE, 1);
+    sdtx_draw();
+}
+
 void frame(void) {
     lopgl_update();
 
@@ -238,6 +256,10 @@ void frame(void) {
 
     lopgl_render_help();
 
+    if (lopgl_ui_visible()) {
+        render_ui();
+    }
+
     sg_end_pass();
     sg_commit();
 }
@@ -5,9 +5,36 @@
 //
 //  http://aras-p.info/blog/2009/07/30/encoding-floats-to-rgba-the-final/
 //
+//  The programs with the _float suffix define FLOAT_DEPTH and are used where
+//  floating point render targets are supported, without the packing.
+//
 
 @ctype mat4 hmm_mat4
 
+@block depth_packing
+#ifdef FLOAT_DEPTH
+// the float render target holds the depth as it is
+vec4 encodeDepth(float v) {
+    return vec4(v, 0.0, 0.0, 1.0);
+}
+
+float decodeDepth(vec4 rgba) {
+    return rgba.r;
+}
+#else
+vec4 encodeDepth(float v) {
+    vec4 enc = vec4(1.0, 255.0, 65025.0, 16581375.0) * v;
+    enc = fract(enc);
+    enc -= enc.yzww * vec4(1.0/255.0,1.0/255.0,1.0/255.0,0.0);
+    return enc;
+}
+
+float decodeDepth(vec4 rgba) {
+    return dot(rgba, vec4(1.0, 1.0/255.0, 1.0/65025.0, 1.0/16581375.0));
+}
+#endif
+@end
+
 @vs vs_depth
 in vec3 a_pos;
 
@@ -21,16 +48,10 @@ void main() {
 }
 @end
 
-@fs fs_depth
+@block fs_depth_body
+@include_block depth_packing
 out vec4 frag_color;
 
-vec4 encodeDepth(float v) {
-    vec4 enc = vec4(1.0, 255.0, 65025.0, 16581375.0) * v;
-    enc = fract(enc);
-    enc -= enc.yzww * vec4(1.0/255.0,1.0/255.0,1.0/255.0,0.0);
-    return enc;
-}
-
 void main() {             
     // sokol and webgl 1 do not support using the depth map as texture
     // so instead we write the depth value to the color map
@@ -38,6 +59,15 @@ void main() {
 }
 @end
 
+@fs fs_depth
+@include_block fs_depth_body
+@end
+
+@fs fs_depth_float
+#define FLOAT_DEPTH
+@include_block fs_depth_body
+@end
+
 @vs vs_quad 
 in vec3 a_pos;
 in vec2 a_tex_coords;
@@ -49,21 +79,29 @@ void main() {
 }
 @end
 
-@fs fs_quad
+@block fs_quad_body
+@include_block depth_packing
 out vec4 frag_color;
 in vec2 tex_coords;
 
 uniform sampler2D depth_map;
 
-float decodeDepth(vec4 rgba) {
-    return dot(rgba, vec4(1.0, 1.0/255.0, 1.0/65025.0, 1.0/16581375.0));
-}
-
 void main() {             
     float depth_value = decodeDepth(texture(depth_map, tex_coords));
     frag_color = vec4(vec3(depth_value), 1.0); 
 }
 @end
 
+@fs fs_quad
+@include_block fs_quad_body
+@end
+
+@fs fs_quad_float
+#define FLOAT_DEPTH
+@include_block fs_quad_body
+@end
+
 @program depth vs_depth fs_depth
+@program depth_float vs_depth fs_depth_float
 @program quad vs_quad fs_quad
+@program quad_float vs_quad fs_quad_float
@@ -7,6 +7,12 @@
 #include "2-rendering-shadows.glsl.h"
 #define LOPGL_APP_IMPL
 #include "../lopgl_app.h"
+#define LOPGL_SHADOW_FORMAT_IMPL
+#include "../lopgl_shadow_format.h"
+
+#define SHADOW_MAP_SIZE 1024
+/* shadow map lookups per shaded fragment */
+#define SHADOW_LOOKUPS 1
 
 /* application state */
 static struct {
@@ -25,6 +31,7 @@ static struct {
     } shadows;
     hmm_vec3 light_pos;
     hmm_mat4 light_space_matrix;
+    const lopgl_shadow_format_t* shadow_format;
     uint8_t file_buffer[2 * 1024 * 1024];
 } state;
 
@@ -37,6 +44,9 @@ static void fail_callback() {
 static void init(void) {
     lopgl_setup();
 
+    state.shadow_format = lopgl_shadow_format();
+    const bool packed = state.shadow_format->packed;
+
     // compute light space matrix
     state.light_pos = HMM_Vec3(-2.f, 4.f, -1.f);
     float near_plane = 1.f;
@@ -48,9 +58,9 @@ static void init(void) {
      /* a render pass with one color- and one depth-attachment image */
     sg_image_desc img_desc = {
         .render_target = true,
-        .width = 1024,
-        .height = 1024,
-        .pixel_format = SG_PIXELFORMAT_RGBA8,
+        .width = SHADOW_MAP_SIZE,
+        .height = SHADOW_MAP_SIZE,
+        .pixel_format = state.shadow_format->pixel_format,
         .min_filter = SG_FILTER_NEAREST,
         .mag_filter = SG_FILTER_NEAREST,
         .sample_count = 1,
@@ -145,7 +155,7 @@ static void init(void) {
     state.depth.bind_plane.vertex_buffers[0] = plane_buffer;
     state.shadows.bind_plane.vertex_buffers[0] = plane_buffer;
 
-    sg_shader shd_depth = sg_make_shader(depth_shader_desc());
+    sg_shader shd_depth = sg_make_shader(packed ? depth_shader_desc() : depth_float_shader_desc());
 
     state.depth.pip = sg_make_pipeline(&(sg_pipeline_desc){
         .shader = shd_depth,
@@ -161,13 +171,13 @@ static void init(void) {
             .depth_write_enabled = true,
         },
         .blend = {
-            .color_format = SG_PIXELFORMAT_RGBA8,
+            .color_format = state.shadow_format->pixel_format,
             .depth_format = SG_PIXELFORMAT_DEPTH
         },
         .label = "depth-pipeline"
     });
 
-    sg_shader shd_shadows = sg_make_shader(shadows_shader_desc());
+    sg_shader shd_shadows = sg_make_shader(packed ? shadows_shader_desc() : shadows_float_shader_desc());
 
     state.shadows.pip = sg_make_pipeline(&(sg_pipeline_desc){
         .shader = shd_shadows,
@@ -230,6 +240,16 @@ void draw_cubes() {
     sg_draw(0, 36, 1);
 }
 
+static void render_ui() {
+    sdtx_canvas(sapp_width()*0.5f, sapp_height()*0.5f);
+    sdtx_origin(sapp_width()*0.5f/8.f - 24.f, 0.25f);       // each character occupies a grid fo 8x8
+    sdtx_home();
+
+    sdtx_color4b(0xff, 0x00, 0x00, 0xaf);
+    lopgl_print_shadow_formats(state.shadow_format, SHADOW_MAP_SIZE * SHADOW_MAP_SIZE, SHADOW_LOOKUPS);
+    sdtx_draw();
+}
+
 void frame(void) {
     lopgl_update();
 
@@ -286,6 +306,10 @@ void frame(void) {
 
     lopgl_render_help();
 
+    if (lopgl_ui_visible()) {
+        render_ui();
+    }
+
     sg_end_pass();
     sg_commit();
 }
@@ -5,11 +5,38 @@
 //
 //  http://aras-p.info/blog/2009/07/30/encoding-floats-to-rgba-the-final/
 //
+//  The programs with the _float suffix define FLOAT_DEPTH and are used where
+//  floating point render targets are supported, without the packing.
+//
 
 @ctype vec2 hmm_vec2
 @ctype vec3 hmm_vec3
 @ctype mat4 hmm_mat4
 
+@block depth_packing
+#ifdef FLOAT_DEPTH
+// the float render target holds the depth as it is
+vec4 encodeDepth(float v) {
+    return vec4(v, 0.0, 0.0, 1.0);
+}
+
+float decodeDepth(vec4 rgba) {
+    return rgba.r;
+}
+#else
+vec4 encodeDepth(float v) {
+    vec4 enc = vec4(1.0, 255.0, 65025.0, 16581375.0) * v;
+    enc = fract(enc);
+    enc -= enc.yzww * vec4(1.0/255.0,1.0/255.0,1.0/255.0,0.0);
+    return enc;
+}
+
+float decodeDepth(vec4 rgba) {
+    return dot(rgba, vec4(1.0, 1.0/255.0, 1.0/65025.0, 1.0/16581375.0));
+}
+#endif
+@end
+
 @block vs_params
 uniform vs_params {
     mat4 light_space_matrix;
@@ -26,16 +53,10 @@ void main() {
 }
 @end
 
-@fs fs_depth
+@block fs_depth_body
+@include_block depth_packing
 out vec4 frag_color;
 
-vec4 encodeDepth(float v) {
-    vec4 enc = vec4(1.0, 255.0, 65025.0, 16581375.0) * v;
-    enc = fract(enc);
-    enc -= enc.yzww * vec4(1.0/255.0,1.0/255.0,1.0/255.0,0.0);
-    return enc;
-}
-
 void main() {             
     // sokol and webgl 1 do not support using the depth map as texture
     // so instead we write the depth value to the color map
@@ -43,6 +64,15 @@ void main() {
 }
 @end
 
+@fs fs_depth
+@include_block fs_depth_body
+@end
+
+@fs fs_depth_float
+#define FLOAT_DEPTH
+@include_block fs_depth_body
+@end
+
 @vs vs_shadows
 @include_block vs_params
 in vec3 a_pos;
@@ -73,7 +103,8 @@ void main() {
 }
 @end
 
-@fs fs_shadows
+@block fs_shadows_body
+@include_block depth_packing
 in INTERFACE {
     vec3 frag_pos;
     vec3 normal;
@@ -92,10 +123,6 @@ uniform fs_params_shadows {
     vec2 shadow_map_size;
 };
 
-float decodeDepth(vec4 rgba) {
-    return dot(rgba, vec4(1.0, 1.0/255.0, 1.0/65025.0, 1.0/16581375.0));
-}
-
 float shadowCalculation(vec4 frag_pos_light_space) {
     // perform perspective divide
     vec3 proj_coords = frag_pos_light_space.xyz / frag_pos_light_space.w;
@@ -151,5 +178,16 @@ void main() {
 }
 @end
 
+@fs fs_shadows
+@include_block fs_shadows_body
+@end
+
+@fs fs_shadows_float
+#define FLOAT_DEPTH
+@include_block fs_shadows_body
+@end
+
 @program depth vs_depth fs_depth
+@program depth_float vs_depth fs_depth_float
 @program shadows vs_shadows fs_shadows
+@program shadows_float vs_shadows fs_shadows_float
@@ -0,0 +1,411 @@
+//------------------------------------------------------------------------------
+//  Shadow Mapping (4)
+//------------------------------------------------------------------------------
+#include "sokol_app.h"
+#include "sokol_gfx.h"
+#include "hmm/HandmadeMath.h"
+#include "4-cascaded-shadows.glsl.h"
+#define LOPGL_APP_IMPL
+#include "../lopgl_app.h"
+#define LOPGL_CASCADES_IMPL
+#include "../lopgl_cascades.h"
+#define LOPGL_SHADOW_FORMAT_IMPL
+#include "../lopgl_shadow_format.h"
+
+/* cubes on a grid over the floor besides the three of the previous examples */
+#define GRID_SIZE 6
+#define NUM_CUBES (3 + GRID_SIZE * GRID_SIZE)
+#define SHADOW_DISTANCE 60.f
+/* bytes per texel of the depth buffer, the color bytes depend on the shadow format */
+#define DEPTH_TEXEL_BYTES 4
+/* shadow map lookups per shaded fragment */
+#define SHADOW_LOOKUPS 9
+/* the largest textures most GPUs can create */
+#define MAX_TEXTURE_SIZE 16384
+
+/* application state */
+static struct {
+    struct {
+        sg_pass_action pass_action;
+        sg_pass pass;
+        sg_pipeline pip;
+        sg_bindings bind_cube;
+        sg_bindings bind_plane;
+    } depth;
+    struct {
+        sg_pass_action pass_action;
+        sg_pipeline pip;
+        sg_bindings bind_cube;
+        sg_bindings bind_plane;
+    } shadows;
+    lopgl_cascades_t cascades;
+    hmm_vec3 light_dir;
+    hmm_mat4 cube_models[NUM_CUBES];
+    bool show_cascades;
+    const lopgl_shadow_format_t* shadow_format;
+    uint8_t file_buffer[2 * 1024 * 1024];
+} state;
+
+static void fail_callback() {
+    state.shadows.pass_action = (sg_pass_action) {
+        .colors[0] = { .action = SG_ACTION_CLEAR, .val = { 1.0f, 0.0f, 0.0f, 1.0f } }
+    };
+}
+
+static void init_cubes(void) {
+    state.cube_models[0] = HMM_MultiplyMat4(HMM_Translate(HMM_Vec3(0.f, 1.5f, 0.f)), HMM_Scale(HMM_Vec3(.5f, .5f, .5f)));
+    state.cube_models[1] = HMM_MultiplyMat4(HMM_Translate(HMM_Vec3(2.f, 0.f, 1.f)), HMM_Scale(HMM_Vec3(.5f, .5f, .5f)));
+    hmm_mat4 rotate = HMM_Rotate(60.f, HMM_NormalizeVec3(HMM_Vec3(1.f, 0.f, 1.f)));
+    state.cube_models[2] = HMM_MultiplyMat4(HMM_MultiplyMat4(HMM_Translate(HMM_Vec3(-1.f, 0.f, 2.f)), rotate), HMM_Scale(HMM_Vec3(.25f, .25f, .25f)));
+
+    for (int i = 0; i < GRID_SIZE * GRID_SIZE; ++i) {
+        const float x = -20.f + 8.f * (float)(i % GRID_SIZE);
+        const float z = -20.f + 8.f * (float)(i / GRID_SIZE);
+        /* a few heights, standing on the floor */
+        const float height = 0.5f + 0.25f * (float)((i * 7) % 5);
+        const hmm_mat4 translate = HMM_Translate(HMM_Vec3(x, height - .5f, z));
+        state.cube_models[3 + i] = HMM_MultiplyMat4(translate, HMM_Scale(HMM_Vec3(.5f, height, .5f)));
+    }
+}
+
+static void init(void) {
+    lopgl_setup();
+
+    state.shadow_format = lopgl_shadow_format();
+    const bool packed = state.shadow_format->packed;
+
+    lopgl_orbital_cam_desc_t orbital_desc = lopgl_get_orbital_cam_desc();
+    orbital_desc.distance = 12.f;
+    orbital_desc.pitch = 15.f;
+    lopgl_set_orbital_cam(&orbital_desc);
+
+    /* the light direction of the previous examples, from (-2, 4, -1) to the origin */
+    state.light_dir = HMM_NormalizeVec3(HMM_Vec3(2.f, -4.f, 1.f));
+
+    lopgl_init_cascades(&state.cascades, &(lopgl_cascades_desc_t){
+        .num_cascades = LOPGL_MAX_CASCADES,
+        .tile_size = 1024,
+        .split_lambda = 0.75f
+    });
+
+    init_cubes();
+
+    /* all cascades in one atlas with a color- and a depth-attachment image */
+    sg_image_desc img_desc = {
+        .render_target = true,
+        .width = state.cascades.atlas_width,
+        .height = state.cascades.atlas_height,
+        .pixel_format = state.shadow_format->pixel_format,
+        .min_filter = SG_FILTER_NEAREST,
+        .mag_filter = SG_FILTER_NEAREST,
+        .wrap_u = SG_WRAP_CLAMP_TO_EDGE,
+        .wrap_v = SG_WRAP_CLAMP_TO_EDGE,
+        .sample_count = 1,
+        .label = "shadow-atlas-color-image"
+    };
+    sg_image color_img = sg_make_image(&img_desc);
+    img_desc.pixel_format = SG_PIXELFORMAT_DEPTH;
+    img_desc.label = "shadow-atlas-depth-image";
+    sg_image depth_img = sg_make_image(&img_desc);
+    state.depth.pass = sg_make_pass(&(sg_pass_desc){
+        .color_attachments[0].image = color_img,
+        .depth_stencil_attachment.image = depth_img,
+        .label = "shadow-atlas-pass"
+    });
+
+    // sokol and webgl 1 do not support using the depth map as texture map
+    // so instead we write the depth value to the color map
+    state.shadows.bind_cube.fs_images[SLOT_shadow_map] = color_img;
+    state.shadows.bind_plane.fs_images[SLOT_shadow_map] = color_img;
+
+    float cube_vertices[] = {
+        // back face
+        -1.f, -1.f, -1.f,  0.f,  0.f, -1.f, 0.f, 0.f, // bottom-left
+         1.f,  1.f, -1.f,  0.f,  0.f, -1.f, 1.f, 1.f, // top-right
+         1.f, -1.f, -1.f,  0.f,  0.f, -1.f, 1.f, 0.f, // bottom-right
+         1.f,  1.f, -1.f,  0.f,  0.f, -1.f, 1.f, 1.f, // top-right
+        -1.f, -1.f, -1.f,  0.f,  0.f, -1.f, 0.f, 0.f, // bottom-left
+        -1.f,  1.f, -1.f,  0.f,  0.f, -1.f, 0.f, 1.f, // top-left
+        // front face
+        -1.f, -1.f,  1.f,  0.f,  0.f,  1.f, 0.f, 0.f, // bottom-left
+         1.f, -1.f,  1.f,  0.f,  0.f,  1.f, 1.f, 0.f, // bottom-right
+         1.f,  1.f,  1.f,  0.f,  0.f,  1.f, 1.f, 1.f, // top-right
+         1.f,  1.f,  1.f,  0.f,  0.f,  1.f, 1.f, 1.f, // top-right
+        -1.f,  1.f,  1.f,  0.f,  0.f,  1.f, 0.f, 1.f, // top-left
+        -1.f, -1.f,  1.f,  0.f,  0.f,  1.f, 0.f, 0.f, // bottom-left
+        // left face
+        -1.f,  1.f,  1.f, -1.f,  0.f,  0.f, 1.f, 0.f, // top-right
+        -1.f,  1.f, -1.f, -1.f,  0.f,  0.f, 1.f, 1.f, // top-left
+        -1.f, -1.f, -1.f, -1.f,  0.f,  0.f, 0.f, 1.f, // bottom-left
+        -1.f, -1.f, -1.f, -1.f,  0.f,  0.f, 0.f, 1.f, // bottom-left
+        -1.f, -1.f,  1.f, -1.f,  0.f,  0.f, 0.f, 0.f, // bottom-right
+        -1.f,  1.f,  1.f, -1.f,  0.f,  0.f, 1.f, 0.f, // top-right
+        // right face
+         1.f,  1.f,  1.f,  1.f,  0.f,  0.f, 1.f, 0.f, // top-left
+         1.f, -1.f, -1.f,  1.f,  0.f,  0.f, 0.f, 1.f, // bottom-right
+         1.f,  1.f, -1.f,  1.f,  0.f,  0.f, 1.f, 1.f, // top-right
+         1.f, -1.f, -1.f,  1.f,  0.f,  0.f, 0.f, 1.f, // bottom-right
+         1.f,  1.f,  1.f,  1.f,  0.f,  0.f, 1.f, 0.f, // top-left
+         1.f, -1.f,  1.f,  1.f,  0.f,  0.f, 0.f, 0.f, // bottom-left
+        // bottom face
+        -1.f, -1.f, -1.f,  0.f, -1.f,  0.f, 0.f, 1.f, // top-right
+         1.f, -1.f, -1.f,  0.f, -1.f,  0.f, 1.f, 1.f, // top-left
+         1.f, -1.f,  1.f,  0.f, -1.f,  0.f, 1.f, 0.f, // bottom-left
+         1.f, -1.f,  1.f,  0.f, -1.f,  0.f, 1.f, 0.f, // bottom-left
+        -1.f, -1.f,  1.f,  0.f, -1.f,  0.f, 0.f, 0.f, // bottom-right
+        -1.f, -1.f, -1.f,  0.f, -1.f,  0.f, 0.f, 1.f, // top-right
+        // top face
+        -1.f,  1.f, -1.f,  0.f,  1.f,  0.f, 0.f, 1.f, // top-left
+         1.f,  1.f , 1.f,  0.f,  1.f,  0.f, 1.f, 0.f, // bottom-right
+         1.f,  1.f, -1.f,  0.f,  1.f,  0.f, 1.f, 1.f, // top-right
+         1.f,  1.f,  1.f,  0.f,  1.f,  0.f, 1.f, 0.f, // bottom-right
+        -1.f,  1.f, -1.f,  0.f,  1.f,  0.f, 0.f, 1.f, // top-left
+        -1.f,  1.f,  1.f,  0.f,  1.f,  0.f, 0.f, 0.f  // bottom-left
+    };
+
+    sg_buffer cube_buffer = sg_make_buffer(&(sg_buffer_desc){
+        .size = sizeof(cube_vertices),
+        .content = cube_vertices,
+        .label = "cube-vertices"
+    });
+
+    state.depth.bind_cube.vertex_buffers[0] = cube_buffer;
+    state.shadows.bind_cube.vertex_buffers[0] = cube_buffer;
+
+    float plane_vertices[] = {
+        // positions         // normals      // texcoords
+         25.f, -.5f,  25.f,  0.f, 1.f, 0.f,  25.f,  0.f,
+        -25.f, -.5f,  25.f,  0.f, 1.f, 0.f,   0.f,  0.f,
+        -25.f, -.5f, -25.f,  0.f, 1.f, 0.f,   0.f, 25.f,
+
+         25.f, -.5f,  25.f,  0.f, 1.f, 0.f,  25.f,  0.f,
+        -25.f, -.5f, -25.f,  0.f, 1.f, 0.f,   0.f, 25.f,
+         25.f, -.5f, -25.f,  0.f, 1.f, 0.f,  25.f, 25.f
+    };
+
+    sg_buffer plane_buffer = sg_make_buffer(&(sg_buffer_desc){
+        .size = sizeof(plane_vertices),
+        .content = plane_vertices,
+        .label = "plane-vertices"
+    });
+
+    state.depth.bind_plane.vertex_buffers[0] = plane_buffer;
+    state.shadows.bind_plane.vertex_buffers[0] = plane_buffer;
+
+    sg_shader shd_depth = sg_make_shader(packed ? depth_shader_desc() : depth_float_shader_desc());
+
+    state.depth.pip = sg_make_pipeline(&(sg_pipeline_desc){
+        .shader = shd_depth,
+        .layout = {
+            /* Buffer's normal and texture coords are skipped */
+            .buffers[0].stride = 8 * sizeof(float),
+            .attrs = {
+                [ATTR_vs_depth_a_pos].format = SG_VERTEXFORMAT_FLOAT3,
+            }
+        },
+        .depth_stencil = {
+            .depth_compare_func = SG_COMPAREFUNC_LESS_EQUAL,
+            .depth_write_enabled = true,
+        },
+        .blend = {
+            .color_format = state.shadow_format->pixel_format,
+            .depth_format = SG_PIXELFORMAT_DEPTH
+        },
+        .label = "depth-pipeline"
+    });
+
+    sg_shader shd_shadows = sg_make_shader(packed ? shadows_shader_desc() : shadows_float_shader_desc());
+
+    state.shadows.pip = sg_make_pipeline(&(sg_pipeline_desc){
+        .shader = shd_shadows,
+        .layout = {
+            .attrs = {
+                [ATTR_vs_shadows_a_pos].format = SG_VERTEXFORMAT_FLOAT3,
+                [ATTR_vs_shadows_a_normal].format = SG_VERTEXFORMAT_FLOAT3,
+                [ATTR_vs_shadows_a_tex_coords].format = SG_VERTEXFORMAT_FLOAT2
+            }
+        },
+        .depth_stencil = {
+            .depth_compare_func = SG_COMPAREFUNC_LESS_EQUAL,
+            .depth_write_enabled = true,
+        },
+        .label = "shadows-pipeline"
+    });
+
+    state.depth.pass_action = (sg_pass_action) {
+        .colors[0] = { .action=SG_ACTION_CLEAR, .val={1.f, 1.f, 1.f, 1.0f} }
+    };
+
+    state.shadows.pass_action = (sg_pass_action) {
+        .colors[0] = { .action=SG_ACTION_CLEAR, .val={0.1f, 0.1f, 0.1f, 1.0f} }
+    };
+
+    sg_image img_id_diffuse = sg_alloc_image();
+    state.shadows.bind_cube.fs_images[SLOT_diffuse_texture] = img_id_diffuse;
+    state.shadows.bind_plane.fs_images[SLOT_diffuse_texture] = img_id_diffuse;
+
+    lopgl_load_image(&(lopgl_image_request_t){
+            .path = "wood.png",
+            .img_id = img_id_diffuse,
+            .buffer_ptr = state.file_buffer,
+            .buffer_size = sizeof(state.file_buffer),
+            .fail_callback = fail_callback
+    });
+}
+
+void draw_depth(hmm_mat4 light_space_matrix) {
+    vs_params_depth_t vs_params = {
+        .light_space_matrix = light_space_matrix,
+        .model = HMM_Mat4d(1.f)
+    };
+
+    sg_apply_bindings(&state.depth.bind_plane);
+    sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params_depth, &vs_params, sizeof(vs_params));
+    sg_draw(0, 6, 1);
+
+    sg_apply_bindings(&state.depth.bind_cube);
+    for (int i = 0; i < NUM_CUBES; ++i) {
+        vs_params.model = state.cube_models[i];
+        sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params_depth, &vs_params, sizeof(vs_params));
+        sg_draw(0, 36, 1);
+    }
+}
+
+static void render_ui() {
+    const lopgl_cascades_t* cascades = &state.cascades;
+    const lopgl_cascades_stats_t* stats = &cascades->stats;
+    const double mb = 1.0 / (1024.0 * 1024.0);
+    const int texel_bytes = state.shadow_format->texel_bytes + DEPTH_TEXEL_BYTES;
+
+    sdtx_canvas(sapp_width()*0.5f, sapp_height()*0.5f);
+    sdtx_origin(sapp_width()*0.5f/8.f - 24.f, 0.25f);       // each character occupies a grid fo 8x8
+    sdtx_home();
+
+    sdtx_color4b(0xff, 0x00, 0x00, 0xaf);
+    sdtx_printf("Cascades:\t%d\n", cascades->num_cascades);
+    sdtx_printf("Snapping:\t%s\n", cascades->snap ? "on" : "off");
+    for (int i = 0; i < cascades->num_cascades; ++i) {
+        const lopgl_cascade_t* cascade = &cascades->cascades[i];
+        sdtx_printf("%d: %5.1f-%5.1f %.3f/tx\n", i, cascade->split_near, cascade->split_far, cascade->texel_size);
+    }
+    sdtx_printf("\nAtlas:\t%dx%d\n", cascades->atlas_width, cascades->atlas_height);
+    sdtx_printf("Memory:\t%.0f MB\n", stats->atlas_texels * (double)texel_bytes * mb);
+    sdtx_printf("Fill:\t%.1f Mtx\n", stats->fill_texels / 1e6);
+    sdtx_printf("\nOne map:\t%dx%d%s\n", stats->single_map_size, stats->single_map_size,
+                stats->single_map_size > MAX_TEXTURE_SIZE ? " (too large)" : "");
+    sdtx_printf("Memory:\t%.0f MB\n", stats->single_map_texels * texel_bytes * mb);
+    sdtx_printf("Fill:\t%.1f Mtx\n\n", stats->single_map_texels / 1e6);
+    lopgl_print_shadow_formats(state.shadow_format, stats->atlas_texels, SHADOW_LOOKUPS);
+    sdtx_puts("\nCascades:\t'SPACE'\n");
+    sdtx_puts("Show:\t\t'V'\n");
+    sdtx_puts("Snapping:\t'T'");
+    sdtx_draw();
+}
+
+void frame(void) {
+    lopgl_update();
+
+    const float aspect = (float)sapp_width() / (float)sapp_height();
+    hmm_mat4 view = lopgl_view_matrix();
+    hmm_mat4 projection = HMM_Perspective(lopgl_fov(), aspect, 0.1f, 100.0f);
+
+    lopgl_update_cascades(&state.cascades, view, lopgl_fov(), aspect, 0.1f, SHADOW_DISTANCE, state.light_dir);
+
+    /* 1. render depth of scene to the tile of each cascade (from light's perspective) */
+    sg_begin_pass(state.depth.pass, &state.depth.pass_action);
+    sg_apply_pipeline(state.depth.pip);
+    for (int i = 0; i < state.cascades.num_cascades; ++i) {
+        const lopgl_cascade_t* cascade = &state.cascades.cascades[i];
+        sg_apply_viewport(cascade->x, cascade->y, state.cascades.tile_size, state.cascades.tile_size, false);
+        draw_depth(cascade->light_space_matrix);
+    }
+    sg_end_pass();
+
+    /* 2. render scene as normal using the generated depth/shadow map */
+    sg_begin_default_pass(&state.shadows.pass_action, sapp_width(), sapp_height());
+    sg_apply_pipeline(state.shadows.pip);
+
+    fs_params_shadows_t fs_params_shadows = {
+        .light_dir = state.light_dir,
+        .view_pos = lopgl_camera_position(),
+        .atlas_texel_size = HMM_Vec2(1.f / (float)state.cascades.atlas_width, 1.f / (float)state.cascades.atlas_height),
+        /* fragments beyond the last cascade aren't shadowed */
+        .cascade_splits = HMM_Vec4(1e30f, 1e30f, 1e30f, 1e30f),
+        .show_cascades = state.show_cascades ? 1.f : 0.f
+    };
+    for (int i = 0; i < state.cascades.num_cascades; ++i) {
+        const lopgl_cascade_t* cascade = &state.cascades.cascades[i];
+        fs_params_shadows.cascade_splits.Elements[i] = cascade->split_far;
+        /* one and a half texels, in the depth of the cascade */
+        fs_params_shadows.cascade_bias.Elements[i] = 1.5f * cascade->texel_size / cascade->depth_range;
+        for (int col = 0; col < 4; ++col) {
+            const float* column = cascade->atlas_matrix.Elements[col];
+            fs_params_shadows.cascade_matrices[i * 4 + col] = HMM_Vec4(column[0], column[1], column[2], column[3]);
+        }
+    }
+
+    sg_apply_uniforms(SG_SHADERSTAGE_FS, SLOT_fs_params_shadows, &fs_params_shadows, sizeof(fs_params_shadows));
+
+    vs_params_shadows_t vs_params_shadows = {
+        .projection = projection,
+        .view = view,
+        .model = HMM_Mat4d(1.f)
+    };
+
+    /* plane */
+    sg_apply_bindings(&state.shadows.bind_plane);
+    sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params_shadows, &vs_params_shadows, sizeof(vs_params_shadows));
+    sg_draw(0, 6, 1);
+
+    /* cubes */
+    sg_apply_bindings(&state.shadows.bind_cube);
+    for (int i = 0; i < NUM_CUBES; ++i) {
+        vs_params_shadows.model = state.cube_models[i];
+        sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params_shadows, &vs_params_shadows, sizeof(vs_params_shadows));
+        sg_draw(0, 36, 1);
+    }
+
+    lopgl_render_help();
+
+    if (lopgl_ui_visible()) {
+        render_ui();
+    }
+
+    sg_end_pass();
+    sg_commit();
+}
+
+void event(const sapp_event* e) {
+    lopgl_handle_input(e);
+
+    if (e->type == SAPP_EVENTTYPE_KEY_DOWN) {
+        if (e->key_code == SAPP_KEYCODE_SPACE) {
+            /* 2 to 4 cascades in the atlas made for 4 */
+            const int num_cascades = state.cascades.num_cascades;
+            state.cascades.num_cascades = num_cascades == LOPGL_MAX_CASCADES ? 2 : num_cascades + 1;
+        }
+        else if (e->key_code == SAPP_KEYCODE_V) {
+            state.show_cascades = !state.show_cascades;
+        }
+        else if (e->key_code == SAPP_KEYCODE_T) {
+            state.cascades.snap = !state.cascades.snap;
+        }
+    }
+}
+
+void cleanup(void) {
+    lopgl_shutdown();
+}
+
+sapp_desc sokol_main(int argc, char* argv[]) {
+    return (sapp_desc){
+        .init_cb = init,
+        .frame_cb = frame,
+        .cleanup_cb = cleanup,
+        .event_cb = event,
+        .width = 800,
+        .height = 600,
+        .gl_force_gles2 = true,
+        .window_title = "Cascaded Shadows (LearnOpenGL)",
+    };
+}
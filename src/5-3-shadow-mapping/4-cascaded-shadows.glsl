@@ -0,0 +1,209 @@
+//------------------------------------------------------------------------------
+//  float/rgba8 encoding/decoding so that we can use an RGBA8
+//  shadow map instead of floating point render targets which might
+//  not be supported everywhere
+//
+//  http://aras-p.info/blog/2009/07/30/encoding-floats-to-rgba-the-final/
+//
+//  The programs with the _float suffix define FLOAT_DEPTH and are used where
+//  floating point render targets are supported, without the packing.
+//
+
+@ctype vec2 hmm_vec2
+@ctype vec3 hmm_vec3
+@ctype vec4 hmm_vec4
+@ctype mat4 hmm_mat4
+
+@block depth_packing
+#ifdef FLOAT_DEPTH
+// the float render target holds the depth as it is
+vec4 encodeDepth(float v) {
+    return vec4(v, 0.0, 0.0, 1.0);
+}
+
+float decodeDepth(vec4 rgba) {
+    return rgba.r;
+}
+#else
+vec4 encodeDepth(float v) {
+    vec4 enc = vec4(1.0, 255.0, 65025.0, 16581375.0) * v;
+    enc = fract(enc);
+    enc -= enc.yzww * vec4(1.0/255.0,1.0/255.0,1.0/255.0,0.0);
+    return enc;
+}
+
+float decodeDepth(vec4 rgba) {
+    return dot(rgba, vec4(1.0, 1.0/255.0, 1.0/65025.0, 1.0/16581375.0));
+}
+#endif
+@end
+
+@vs vs_depth
+in vec3 a_pos;
+
+uniform vs_params_depth {
+    mat4 light_space_matrix;
+    mat4 model;
+};
+
+void main() {
+    gl_Position = light_space_matrix * model * vec4(a_pos, 1.0);
+}
+@end
+
+@block fs_depth_body
+@include_block depth_packing
+out vec4 frag_color;
+
+void main() {
+    // sokol and webgl 1 do not support using the depth map as texture
+    // so instead we write the depth value to the color map
+    frag_color = encodeDepth(gl_FragCoord.z);
+}
+@end
+
+@fs fs_depth
+@include_block fs_depth_body
+@end
+
+@fs fs_depth_float
+#define FLOAT_DEPTH
+@include_block fs_depth_body
+@end
+
+@vs vs_shadows
+in vec3 a_pos;
+in vec3 a_normal;
+in vec2 a_tex_coords;
+
+out INTERFACE {
+    vec3 frag_pos;
+    vec3 normal;
+    vec2 tex_coords;
+    float view_depth;
+} inter;
+
+uniform vs_params_shadows {
+    mat4 projection;
+    mat4 view;
+    mat4 model;
+};
+
+void main() {
+    inter.frag_pos = vec3(model * vec4(a_pos, 1.0));
+    // inverse tranpose is left out because:
+    // (a) glsl es 1.0 (webgl 1.0) doesn't have inverse and transpose functions
+    // (b) we're not performing non-uniform scale
+    inter.normal = mat3(model) * a_normal;
+    inter.tex_coords = a_tex_coords;
+    vec4 view_pos = view * vec4(inter.frag_pos, 1.0);
+    inter.view_depth = -view_pos.z;
+    gl_Position = projection * view_pos;
+}
+@end
+
+@block fs_shadows_body
+@include_block depth_packing
+in INTERFACE {
+    vec3 frag_pos;
+    vec3 normal;
+    vec2 tex_coords;
+    float view_depth;
+} inter;
+
+out vec4 frag_color;
+
+uniform sampler2D diffuse_texture;
+uniform sampler2D shadow_map;
+
+// using arrays of vec4 to avoid alignment issues with cross shader compilation,
+// four columns per cascade matrix
+uniform fs_params_shadows {
+    vec3 light_dir;
+    vec3 view_pos;
+    vec2 atlas_texel_size;
+    // far view depth of each cascade, unused cascades are beyond the shadow distance
+    vec4 cascade_splits;
+    // depth bias of each cascade in the [0;1] depth of its tile
+    vec4 cascade_bias;
+    vec4 cascade_matrices[16];
+    float show_cascades;
+};
+
+float shadowCalculation(float cascade, vec3 normal, vec3 to_light) {
+    // webgl 1 can only index uniform arrays with loop indices
+    vec3 atlas_coords = vec3(2.0);
+    float bias = 0.0;
+    for (int i = 0; i < 4; ++i) {
+        if (float(i) == cascade) {
+            mat4 atlas_matrix = mat4(cascade_matrices[i * 4], cascade_matrices[i * 4 + 1],
+                                     cascade_matrices[i * 4 + 2], cascade_matrices[i * 4 + 3]);
+            atlas_coords = (atlas_matrix * vec4(inter.frag_pos, 1.0)).xyz;
+            bias = cascade_bias[i];
+        }
+    }
+    // keep the shadow at 0.0 beyond the last cascade
+    if (atlas_coords.z > 1.0)
+        return 0.0;
+
+    // the bias grows with the slope
+    bias *= 1.0 + 2.0 * (1.0 - dot(normal, to_light));
+    // PCF, the cascades leave room for the taps around their tiles
+    float shadow = 0.0;
+    for(int x = -1; x <= 1; ++x) {
+        for(int y = -1; y <= 1; ++y) {
+            float pcf_depth = decodeDepth(texture(shadow_map, atlas_coords.xy + vec2(x, y) * atlas_texel_size));
+            shadow += atlas_coords.z - bias > pcf_depth  ? 1.0 : 0.0;
+        }
+    }
+    return shadow / 9.0;
+}
+
+void main() {
+    vec3 color = texture(diffuse_texture, inter.tex_coords).rgb;
+    vec3 normal = normalize(inter.normal);
+    vec3 light_color = vec3(0.3);
+    // ambient
+    vec3 ambient = 0.3 * color;
+    // diffuse
+    vec3 to_light = -normalize(light_dir);
+    float diff = max(dot(to_light, normal), 0.0);
+    vec3 diffuse = diff * light_color;
+    // specular
+    vec3 view_dir = normalize(view_pos - inter.frag_pos);
+    vec3 halfway_dir = normalize(to_light + view_dir);
+    float spec = pow(max(dot(normal, halfway_dir), 0.0), 64.0);
+    vec3 specular = spec * light_color;
+    // the cascade is the number of splits in front of the fragment
+    float cascade = dot(step(cascade_splits, vec4(inter.view_depth)), vec4(1.0));
+    float shadow = shadowCalculation(cascade, normal, to_light);
+    vec3 lighting = (ambient + (1.0 - shadow) * (diffuse + specular)) * color;
+    if (show_cascades > 0.0) {
+        vec3 tints[4];
+        tints[0] = vec3(1.0, 0.6, 0.6);
+        tints[1] = vec3(0.6, 1.0, 0.6);
+        tints[2] = vec3(0.6, 0.6, 1.0);
+        tints[3] = vec3(1.0, 1.0, 0.6);
+        for (int i = 0; i < 4; ++i) {
+            if (float(i) == cascade)
+                lighting *= tints[i];
+        }
+    }
+
+    frag_color = vec4(lighting, 1.0);
+}
+@end
+
+@fs fs_shadows
+@include_block fs_shadows_body
+@end
+
+@fs fs_shadows_float
+#define FLOAT_DEPTH
+@include_block fs_shadows_body
+@end
+
+@program depth vs_depth fs_depth
+@program depth_float vs_depth fs_depth_float
+@program shadows vs_shadows fs_shadows
+@program shadows_float vs_shadows fs_shadows_float
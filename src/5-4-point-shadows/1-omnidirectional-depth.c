@@ -7,9 +7,13 @@
 #include "1-omnidirectional-depth.glsl.h"
 #define LOPGL_APP_IMPL
 #include "../lopgl_app.h"
+#define LOPGL_SHADOW_FORMAT_IMPL
+#include "../lopgl_shadow_format.h"
 
 static const int SHADOW_WIDTH = 1024;
 static const int SHADOW_HEIGHT = 1024;
+/* shadow map lookups per shaded fragment */
+static const int SHADOW_LOOKUPS = 1;
 
 /* application state */
 static struct {
@@ -26,11 +30,15 @@ static struct {
     } shadows;
     hmm_vec3 light_pos;
     hmm_mat4 light_space_matrix;
+    const lopgl_shadow_format_t* shadow_format;
 } state;
 
 static void init(void) {
     lopgl_setup();
 
+    state.shadow_format = lopgl_shadow_format();
+    const bool packed = state.shadow_format->packed;
+
     state.light_pos = HMM_Vec3(0.f, 0.f, 0.f);
 
     /* create depth cubemap */
@@ -39,7 +47,7 @@ static void init(void) {
         .render_target = true,
         .width = SHADOW_WIDTH,
         .height = SHADOW_HEIGHT,
-        .pixel_format = SG_PIXELFORMAT_RGBA8,
+        .pixel_format = state.shadow_format->pixel_format,
         .min_filter = SG_FILTER_NEAREST,
         .mag_filter = SG_FILTER_NEAREST,
         .wrap_u = SG_WRAP_CLAMP_TO_EDGE,
@@ -120,7 +128,7 @@ static void init(void) {
     state.depth.bind.vertex_buffers[0] = cube_buffer;
     state.shadows.bind.vertex_buffers[0] = cube_buffer;
 
-    sg_shader shd_depth = sg_make_shader(depth_shader_desc());
+    sg_shader shd_depth = sg_make_shader(packed ? depth_shader_desc() : depth_float_shader_desc());
 
     state.depth.pip = sg_make_pipeline(&(sg_pipeline_desc){
         .shader = shd_depth,
@@ -136,13 +144,13 @@ static void init(void) {
             .depth_write_enabled = true,
         },
         .blend = {
-            .color_format = SG_PIXELFORMAT_RGBA8,
+            .color_format = state.shadow_format->pixel_format,
             .depth_format = SG_PIXELFORMAT_DEPTH
         },
         .label = "depth-pipeline"
     });
 
-    sg_shader shd_shadows = sg_make_shader(shadows_shader_desc());
+    sg_shader shd_shadows = sg_make_shader(packed ? shadows_shader_desc() : shadows_float_shader_desc());
 
     state.shadows.pip = sg_make_pipeline(&(sg_pipeline_desc){
         .shader = shd_shadows,
@@ -212,6 +220,16 @@ void draw_cubes() {
     sg_draw(0, 36, 1);
 }
 
+static void render_ui() {
+    sdtx_canvas(sapp_width()*0.5f, sapp_height()*0.5f);
+    sdtx_origin(sapp_width()*0.5f/8.f - 24.f, 0.25f);       // each character occupies a grid fo 8x8
+    sdtx_home();
+
+    sdtx_color4b(0xff, 0x00, 0x00, 0xaf);
+    lopgl_print_shadow_formats(state.shadow_format, 6.0 * SHADOW_WIDTH * SHADOW_HEIGHT, SHADOW_LOOKUPS);
+    sdtx_draw();
+}
+
 void frame(void) {
     lopgl_update();
 
@@ -298,6 +316,10 @@ void frame(void) {
 
     lopgl_render_help();
 
+    if (lopgl_ui_visible()) {
+        render_ui();
+    }
+
     sg_end_pass();
     sg_commit();
 }
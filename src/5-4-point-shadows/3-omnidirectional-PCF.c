@@ -7,10 +7,71 @@
 #include "3-omnidirectional-PCF.glsl.h"
 #define LOPGL_APP_IMPL
 #include "../lopgl_app.h"
+#define LOPGL_BVH_IMPL
+#include "../lopgl_bvh.h"
+#define LOPGL_SHADOW_FORMAT_IMPL
+#include "../lopgl_shadow_format.h"
 
 static const int SHADOW_WIDTH = 1024;
 static const int SHADOW_HEIGHT = 1024;
 
+#define NUM_CASTERS 5
+#define ALL_CASTERS ((1u << NUM_CASTERS) - 1)
+/* the rotated cube can spin to show that only the faces it is in get rendered again */
+#define SPINNING_CASTER 4
+
+static const char* face_names[6] = { "+X", "-X", "+Y", "-Y", "+Z", "-Z" };
+
+/* The 20 cubemap taps of PCF or exponential shadow maps, which are blurred once when a face
+   is rendered and then need a single lookup per fragment. The blur is paid for every face
+   that is rendered again, so the cheaper tiers use smaller maps. The faces are blurred one
+   by one, so the blur stops at their edges. */
+enum {
+    FILTER_PCF,
+    FILTER_ESM_LOW,
+    FILTER_ESM_MEDIUM,
+    FILTER_ESM_HIGH,
+    NUM_FILTERS
+};
+
+static const char* filter_names[NUM_FILTERS] = { "PCF", "ESM low", "ESM medium", "ESM high" };
+/* size of the cubemap faces and taps of the separable blur in each direction */
+static const int filter_sizes[NUM_FILTERS] = { 1024, 256, 512, 1024 };
+static const int filter_taps[NUM_FILTERS] = { 0, 3, 5, 9 };
+/* cubemap lookups per fragment */
+static const int filter_lookups[NUM_FILTERS] = { 20, 1, 1, 1 };
+/* how fast the shadow falls off behind an occluder, in units of the far plane */
+#define ESM_EXPONENT 80.f
+
+typedef struct caster_t {
+    hmm_vec3 position;
+    float scale;
+    float angle;
+    hmm_mat4 model;
+    lopgl_aabb_t bounds;
+    bool moved;                 /* the model changed this frame */
+} caster_t;
+
+/* the cubemap of an ESM tier, with the face that is rendered and blurred into it */
+typedef struct esm_target_t {
+    bool created;
+    sg_image cube_img;
+    sg_pass face_pass;
+    sg_pass blur_pass;              /* horizontal blur */
+    sg_pass cube_pass[6];           /* vertical blur into each cubemap face */
+    sg_bindings bind_h;
+    sg_bindings bind_v;
+} esm_target_t;
+
+/* what a cubemap face was rendered with, it is kept as long as none of it changes */
+typedef struct shadow_face_t {
+    bool valid;
+    hmm_vec3 light_pos;
+    uint32_t casters;           /* one bit per caster drawn into the face */
+    int num_casters;
+    bool rendered;              /* rendered this frame */
+} shadow_face_t;
+
 /* application state */
 static struct {
     struct {
@@ -18,14 +79,38 @@ static struct {
         sg_pass pass[6];
         sg_pipeline pip;
         sg_bindings bind;
+        sg_image color_img;
     } depth;
+    struct {
+        sg_pass_action pass_action;
+        sg_pipeline blur_pip[NUM_FILTERS];
+        sg_buffer quad_buffer;
+        esm_target_t targets[NUM_FILTERS];
+    } esm;
     struct {
         sg_pass_action pass_action;
         sg_pipeline pip;
+        sg_pipeline esm_pip;
         sg_bindings bind;
+        /* the constant PCF sampling disk, built once instead of every frame */
+        fs_sampling_t sampling;
     } shadows;
     hmm_vec3 light_pos;
     hmm_mat4 light_space_matrix;
+    caster_t casters[NUM_CASTERS];
+    shadow_face_t faces[6];
+    bool face_culling;
+    int filter;
+    bool light_paused;
+    bool spinning;
+    float light_time;
+    uint64_t time_stamp;
+    /* shadow passes and caster draws of the last frame */
+    int shadow_passes;
+    int shadow_draws;
+    /* texels written by the blur passes of the last frame */
+    int blurred_texels;
+    const lopgl_shadow_format_t* shadow_format;
     uint8_t file_buffer[2 * 1024 * 1024];
 } state;
 
@@ -35,10 +120,69 @@ static void fail_callback() {
     };
 }
 
+/* updates the model matrix and the world space bounds of the unit cube of the caster */
+static void update_caster(caster_t* caster) {
+    hmm_mat4 model = HMM_Translate(caster->position);
+    if (caster->angle != 0.f) {
+        model = HMM_MultiplyMat4(model, HMM_Rotate(caster->angle, HMM_NormalizeVec3(HMM_Vec3(1.f, 0.f, 1.f))));
+    }
+    model = HMM_MultiplyMat4(model, HMM_Scale(HMM_Vec3(caster->scale, caster->scale, caster->scale)));
+    caster->moved = memcmp(&model, &caster->model, sizeof(hmm_mat4)) != 0;
+    caster->model = model;
+
+    const hmm_vec3 center = HMM_Vec3(model.Elements[3][0], model.Elements[3][1], model.Elements[3][2]);
+    hmm_vec3 extent;
+    for (int i = 0; i < 3; ++i) {
+        extent.Elements[i] = HMM_ABS(model.Elements[0][i]) + HMM_ABS(model.Elements[1][i]) + HMM_ABS(model.Elements[2][i]);
+    }
+    caster->bounds.min = HMM_SubtractVec3(center, extent);
+    caster->bounds.max = HMM_AddVec3(center, extent);
+}
+
 static void init(void) {
     lopgl_setup();
 
+    state.shadow_format = lopgl_shadow_format();
+    const bool packed = state.shadow_format->packed;
+
     state.light_pos = HMM_Vec3(0.f, 0.f, 0.f);
+    state.face_culling = true;
+    state.time_stamp = stm_now();
+
+    state.shadows.sampling = (fs_sampling_t){
+        .grid_sampling_disk[0] = HMM_Vec4( 1.f,  1.f,  1.f, 0.f),
+        .grid_sampling_disk[1] = HMM_Vec4( 1.f, -1.f, 1.f, 0.f),
+        .grid_sampling_disk[2] = HMM_Vec4(-1.f, -1.f,  1.f, 0.f),
+        .grid_sampling_disk[3] = HMM_Vec4(-1.f, 1.f,  1.f, 0.f),
+        .grid_sampling_disk[4] = HMM_Vec4(1.f, 1.f, -1.f, 0.f),
+        .grid_sampling_disk[5] = HMM_Vec4( 1.f, -1.f, -1.f, 0.f),
+        .grid_sampling_disk[6] = HMM_Vec4(-1.f, -1.f, -1.f, 0.f),
+        .grid_sampling_disk[7] = HMM_Vec4(-1.f, 1.f, -1.f, 0.f),
+        .grid_sampling_disk[8] = HMM_Vec4(1.f, 1.f,  0.f, 0.f),
+        .grid_sampling_disk[9] = HMM_Vec4( 1.f, -1.f,  0.f, 0.f),
+        .grid_sampling_disk[10] = HMM_Vec4(-1.f, -1.f,  0.f, 0.f),
+        .grid_sampling_disk[11] = HMM_Vec4(-1.f, 1.f,  0.f, 0.f),
+        .grid_sampling_disk[12] = HMM_Vec4(1.f, 0.f,  1.f, 0.f),
+        .grid_sampling_disk[13] = HMM_Vec4(-1.f,  0.f,  1.f, 0.f),
+        .grid_sampling_disk[14] = HMM_Vec4( 1.f,  0.f, -1.f, 0.f),
+        .grid_sampling_disk[15] = HMM_Vec4(-1.f, 0.f, -1.f, 0.f),
+        .grid_sampling_disk[16] = HMM_Vec4(0.f, 1.f,  1.f, 0.f),
+        .grid_sampling_disk[17] = HMM_Vec4( 0.f, -1.f,  1.f, 0.f),
+        .grid_sampling_disk[18] = HMM_Vec4( 0.f, -1.f, -1.f, 0.f),
+        .grid_sampling_disk[19] = HMM_Vec4( 0.f, 1.f, -1.f, 0.f)
+    };
+
+    const caster_t casters[NUM_CASTERS] = {
+        { .position = { 4.f, -3.5f, 0.f }, .scale = .5f },
+        { .position = { 2.f, 3.f, 1.f }, .scale = .75f },
+        { .position = { -3.f, -1.f, 0.f }, .scale = .5f },
+        { .position = { -1.5f, 1.f, 1.5f }, .scale = .5f },
+        { .position = { -1.5f, 2.f, -3.f }, .scale = .75f, .angle = 60.f }
+    };
+    for (int i = 0; i < NUM_CASTERS; ++i) {
+        state.casters[i] = casters[i];
+        update_caster(&state.casters[i]);
+    }
 
     /* create depth cubemap */
     sg_image_desc img_desc = {
@@ -46,7 +190,7 @@ static void init(void) {
         .render_target = true,
         .width = SHADOW_WIDTH,
         .height = SHADOW_HEIGHT,
-        .pixel_format = SG_PIXELFORMAT_RGBA8,
+        .pixel_format = state.shadow_format->pixel_format,
         .min_filter = SG_FILTER_NEAREST,
         .mag_filter = SG_FILTER_NEAREST,
         .wrap_u = SG_WRAP_CLAMP_TO_EDGE,
@@ -71,7 +215,7 @@ static void init(void) {
 
     // sokol and webgl 1 do not support using the depth map as texture map
     // so instead we write the depth value to the color map
-    state.shadows.bind.fs_images[SLOT_depth_map] = color_img;
+    state.depth.color_img = color_img;
 
     float cube_vertices[] = {
         // back face
@@ -124,10 +268,28 @@ static void init(void) {
         .label = "cube-vertices"
     });
     
+    float quad_vertices[] = { // vertex attributes for a quad that fills the entire screen in Normalized Device Coordinates.
+        // positions   // texCoords
+        -1.0f,  1.0f,  0.0f, 1.0f,
+        -1.0f, -1.0f,  0.0f, 0.0f,
+         1.0f, -1.0f,  1.0f, 0.0f,
+
+        -1.0f,  1.0f,  0.0f, 1.0f,
+         1.0f, -1.0f,  1.0f, 0.0f,
+         1.0f,  1.0f,  1.0f, 1.0f
+    };
+
+    sg_buffer quad_buffer = sg_make_buffer(&(sg_buffer_desc){
+        .size = sizeof(quad_vertices),
+        .content = quad_vertices,
+        .label = "quad-vertices"
+    });
+    
     state.depth.bind.vertex_buffers[0] = cube_buffer;
     state.shadows.bind.vertex_buffers[0] = cube_buffer;
+    state.esm.quad_buffer = quad_buffer;
 
-    sg_shader shd_depth = sg_make_shader(depth_shader_desc());
+    sg_shader shd_depth = sg_make_shader(packed ? depth_shader_desc() : depth_float_shader_desc());
 
     state.depth.pip = sg_make_pipeline(&(sg_pipeline_desc){
         .shader = shd_depth,
@@ -148,16 +310,37 @@ static void init(void) {
             .face_winding = SG_FACEWINDING_CCW
         },
         .blend = {
-            .color_format = SG_PIXELFORMAT_RGBA8,
+            .color_format = state.shadow_format->pixel_format,
             .depth_format = SG_PIXELFORMAT_DEPTH
         },
         .label = "depth-pipeline"
     });
 
-    sg_shader shd_shadows = sg_make_shader(shadows_shader_desc());
+    /* one blur program per number of taps */
+    const sg_shader_desc* blur_shader_descs[NUM_FILTERS] = {
+        [FILTER_ESM_LOW] = packed ? blur_3_shader_desc() : blur_3_float_shader_desc(),
+        [FILTER_ESM_MEDIUM] = packed ? blur_5_shader_desc() : blur_5_float_shader_desc(),
+        [FILTER_ESM_HIGH] = packed ? blur_9_shader_desc() : blur_9_float_shader_desc()
+    };
+    for (int i = FILTER_ESM_LOW; i < NUM_FILTERS; ++i) {
+        state.esm.blur_pip[i] = sg_make_pipeline(&(sg_pipeline_desc){
+            .shader = sg_make_shader(blur_shader_descs[i]),
+            .layout = {
+                .attrs = {
+                    [ATTR_vs_blur_a_pos].format = SG_VERTEXFORMAT_FLOAT2,
+                    [ATTR_vs_blur_a_tex_coords].format = SG_VERTEXFORMAT_FLOAT2
+                }
+            },
+            .blend = {
+                .color_format = state.shadow_format->pixel_format,
+                .depth_format = SG_PIXELFORMAT_NONE
+            },
+            .label = "blur-pipeline"
+        });
+    }
 
-    state.shadows.pip = sg_make_pipeline(&(sg_pipeline_desc){
-        .shader = shd_shadows,
+    sg_pipeline_desc shadows_pip_desc = {
+        .shader = sg_make_shader(packed ? shadows_shader_desc() : shadows_float_shader_desc()),
         .layout = {
             .attrs = {
                 [ATTR_vs_shadows_a_pos].format = SG_VERTEXFORMAT_FLOAT3,
@@ -174,12 +357,22 @@ static void init(void) {
             .face_winding = SG_FACEWINDING_CCW
         },
         .label = "shadows-pipeline"
-    });
+    };
+    state.shadows.pip = sg_make_pipeline(&shadows_pip_desc);
+
+    shadows_pip_desc.shader = sg_make_shader(packed ? shadows_esm_shader_desc() : shadows_esm_float_shader_desc());
+    shadows_pip_desc.label = "shadows-esm-pipeline";
+    state.shadows.esm_pip = sg_make_pipeline(&shadows_pip_desc);
 
     state.depth.pass_action = (sg_pass_action) {
         .colors[0] = { .action=SG_ACTION_CLEAR, .val={1.f, 1.f, 1.f, 1.0f} }
     };
 
+    /* the blur writes every texel */
+    state.esm.pass_action = (sg_pass_action) {
+        .colors[0].action = SG_ACTION_DONTCARE
+    };
+
     state.shadows.pass_action = (sg_pass_action) {
         .colors[0] = { .action=SG_ACTION_CLEAR, .val={0.1f, 0.1f, 0.1f, 1.0f} }
     };
@@ -205,41 +398,191 @@ void draw_room_cube() {
     sg_draw(0, 36, 1);
 }
 
-void draw_cubes() {
-    vs_params_t vs_params;
-    hmm_mat4 translate = HMM_Translate(HMM_Vec3(4.f, -3.5f, 0.f));
-    hmm_mat4 scale = HMM_Scale(HMM_Vec3(.5f, .5f, .5f));
-    vs_params.model = HMM_MultiplyMat4(translate, scale);
-    sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &vs_params, sizeof(vs_params));
-    sg_draw(0, 36, 1);
-    translate = HMM_Translate(HMM_Vec3(2.f, 3.f, 1.f));
-    scale = HMM_Scale(HMM_Vec3(.75f, .75f, .75f));
-    vs_params.model = HMM_MultiplyMat4(translate, scale);
-    sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &vs_params, sizeof(vs_params));
-    sg_draw(0, 36, 1);
-    translate = HMM_Translate(HMM_Vec3(-3.f, -1.f, 0.f));
-    scale = HMM_Scale(HMM_Vec3(.5f, .5f, .5f));
-    vs_params.model = HMM_MultiplyMat4(translate, scale);
-    sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &vs_params, sizeof(vs_params));
-    sg_draw(0, 36, 1);
-    translate = HMM_Translate(HMM_Vec3(-1.5f, 1.f, 1.5f));
-    scale = HMM_Scale(HMM_Vec3(.5f, .5f, .5f));
-    vs_params.model = HMM_MultiplyMat4(translate, scale);
-    sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &vs_params, sizeof(vs_params));
-    sg_draw(0, 36, 1);
-    translate = HMM_Translate(HMM_Vec3(-1.5f, 2.f, -3.f));
-    hmm_mat4 rotate = HMM_Rotate(60.f, HMM_NormalizeVec3(HMM_Vec3(1.f, 0.f, 1.f)));
-    scale = HMM_Scale(HMM_Vec3(.75f, .75f, .75f));
-    vs_params.model = HMM_MultiplyMat4(HMM_MultiplyMat4(translate, rotate), scale);
-    sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &vs_params, sizeof(vs_params));
-    sg_draw(0, 36, 1);
+void draw_cubes(uint32_t casters) {
+    for (int i = 0; i < NUM_CASTERS; ++i) {
+        if (casters & (1u << i)) {
+            vs_params_t vs_params = {
+                .model = state.casters[i].model
+            };
+            sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &vs_params, sizeof(vs_params));
+            sg_draw(0, 36, 1);
+        }
+    }
+}
+
+/* the casters whose bounds intersect the frustum of a cubemap face */
+static uint32_t face_casters(hmm_mat4 light_space_matrix, int* num_casters) {
+    hmm_vec4 planes[6];
+    lopgl_frustum_planes(light_space_matrix, planes);
+    uint32_t casters = 0;
+    *num_casters = 0;
+    for (int i = 0; i < NUM_CASTERS; ++i) {
+        if (lopgl_aabb_in_frustum(&state.casters[i].bounds, planes)) {
+            casters |= 1u << i;
+            ++*num_casters;
+        }
+    }
+    return casters;
+}
+
+/* A face has to be rendered again when its casters or the ones it was rendered with moved,
+   or when the light moved and there is something to cast a shadow. A face without casters
+   keeps the far distance it was cleared to. */
+static bool face_changed(const shadow_face_t* face, uint32_t casters, uint32_t moved_casters) {
+    if (!face->valid || casters != face->casters) {
+        return true;
+    }
+    if (casters & moved_casters) {
+        return true;
+    }
+    return casters != 0 && !HMM_EqualsVec3(state.light_pos, face->light_pos);
+}
+
+/* creates the cubemap and the passes of an ESM tier when it is used for the first time */
+static esm_target_t* esm_target(int filter) {
+    esm_target_t* target = &state.esm.targets[filter];
+    if (target->created) {
+        return target;
+    }
+    target->created = true;
+
+    sg_image_desc img_desc = {
+        .type = SG_IMAGETYPE_CUBE,
+        .render_target = true,
+        .width = filter_sizes[filter],
+        .height = filter_sizes[filter],
+        .pixel_format = state.shadow_format->pixel_format,
+        .min_filter = SG_FILTER_NEAREST,
+        .mag_filter = SG_FILTER_NEAREST,
+        .wrap_u = SG_WRAP_CLAMP_TO_EDGE,
+        .wrap_v = SG_WRAP_CLAMP_TO_EDGE,
+        .wrap_w = SG_WRAP_CLAMP_TO_EDGE,
+        .sample_count = 1,
+        .label = "esm-cube-image"
+    };
+    target->cube_img = sg_make_image(&img_desc);
+
+    /* the face that is being blurred and the result of the horizontal blur */
+    img_desc.type = SG_IMAGETYPE_2D;
+    img_desc.label = "esm-face-color-image";
+    sg_image face_color_img = sg_make_image(&img_desc);
+    img_desc.label = "esm-blur-image";
+    sg_image blur_img = sg_make_image(&img_desc);
+    img_desc.pixel_format = SG_PIXELFORMAT_DEPTH;
+    img_desc.label = "esm-face-depth-image";
+    sg_image face_depth_img = sg_make_image(&img_desc);
+
+    target->face_pass = sg_make_pass(&(sg_pass_desc){
+        .color_attachments[0].image = face_color_img,
+        .depth_stencil_attachment.image = face_depth_img,
+        .label = "esm-face-pass"
+    });
+    target->blur_pass = sg_make_pass(&(sg_pass_desc){
+        .color_attachments[0].image = blur_img,
+        .label = "esm-blur-pass"
+    });
+    for (size_t i = 0; i < 6; ++i) {
+        target->cube_pass[i] = sg_make_pass(&(sg_pass_desc){
+            .color_attachments[0] = { .image = target->cube_img, .slice = i },
+            .label = "esm-cube-pass"
+        });
+    }
+    target->bind_h.vertex_buffers[0] = state.esm.quad_buffer;
+    target->bind_h.fs_images[SLOT_blur_map] = face_color_img;
+    target->bind_v.vertex_buffers[0] = state.esm.quad_buffer;
+    target->bind_v.fs_images[SLOT_blur_map] = blur_img;
+    return target;
+}
+
+/* blurs the exponential depth of the face that was just rendered into its cubemap face */
+static void blur_face(const esm_target_t* target, int face) {
+    const int size = filter_sizes[state.filter];
+    const int taps = filter_taps[state.filter];
+    fs_params_blur_t fs_params_blur = {
+        .esm_exponent = ESM_EXPONENT
+    };
+    /* binomial weights, which are close to a gaussian */
+    float weight = 1.f / (float)(1 << (taps - 1));
+    for (int i = 0; i < taps; ++i) {
+        fs_params_blur.blur_weights[i].X = weight;
+        weight = weight * (float)(taps - 1 - i) / (float)(i + 1);
+    }
+
+    fs_params_blur.offset = HMM_Vec2(1.f / (float)size, 0.f);
+    sg_begin_pass(target->blur_pass, &state.esm.pass_action);
+    sg_apply_pipeline(state.esm.blur_pip[state.filter]);
+    sg_apply_bindings(&target->bind_h);
+    sg_apply_uniforms(SG_SHADERSTAGE_FS, SLOT_fs_params_blur, &fs_params_blur, sizeof(fs_params_blur));
+    sg_draw(0, 6, 1);
+    sg_end_pass();
+
+    fs_params_blur.offset = HMM_Vec2(0.f, 1.f / (float)size);
+    sg_begin_pass(target->cube_pass[face], &state.esm.pass_action);
+    sg_apply_pipeline(state.esm.blur_pip[state.filter]);
+    sg_apply_bindings(&target->bind_v);
+    sg_apply_uniforms(SG_SHADERSTAGE_FS, SLOT_fs_params_blur, &fs_params_blur, sizeof(fs_params_blur));
+    sg_draw(0, 6, 1);
+    sg_end_pass();
+
+    state.shadow_passes += 2;
+    state.blurred_texels += 2 * size * size;
+}
+
+static void render_ui() {
+    const int size = filter_sizes[state.filter];
+
+    sdtx_canvas(sapp_width()*0.5f, sapp_height()*0.5f);
+    sdtx_origin(sapp_width()*0.5f/8.f - 24.f, 0.25f);       // each character occupies a grid fo 8x8
+    sdtx_home();
+
+    sdtx_color4b(0xff, 0x00, 0x00, 0xaf);
+    sdtx_printf("Face culling:\t%s\n", state.face_culling ? "on" : "off");
+    sdtx_printf("Filter:\t\t%s\n", filter_names[state.filter]);
+    sdtx_printf("Lookups:\t%d per fragment\n", filter_lookups[state.filter]);
+    if (state.filter != FILTER_PCF) {
+        sdtx_printf("Faces:\t\t%dx%d\n", size, size);
+        sdtx_printf("Blur:\t\t%d taps, %.2f Mtx\n", filter_taps[state.filter], state.blurred_texels / 1e6);
+    }
+    sdtx_printf("Shadow passes:\t%d/6\n", state.shadow_passes);
+    sdtx_printf("Caster draws:\t%d/%d\n\n", state.shadow_draws, 6 * NUM_CASTERS);
+    for (int i = 0; i < 6; ++i) {
+        const shadow_face_t* face = &state.faces[i];
+        if (state.face_culling) {
+            sdtx_printf("%s:\t%d casters %s\n", face_names[i], face->num_casters, face->rendered ? "drawn" : "cached");
+        } else {
+            sdtx_printf("%s:\t%d casters drawn\n", face_names[i], NUM_CASTERS);
+        }
+    }
+    sdtx_puts("\n");
+    lopgl_print_shadow_formats(state.shadow_format, 6.0 * size * size, filter_lookups[state.filter]);
+    sdtx_puts("\nFace culling:\t'SPACE'\n");
+    sdtx_puts("Filter:\t\t'F'\n");
+    sdtx_printf("%s light:\t'P'\n", state.light_paused ? "Move" : "Stop");
+    sdtx_printf("%s cube:\t'R'", state.spinning ? "Stop" : "Spin");
+    sdtx_draw();
 }
 
 void frame(void) {
     lopgl_update();
 
     /* move light position over time */
-    state.light_pos.Z = HMM_SinF((float)stm_sec(stm_now()) * .5f) * 3.f;
+    const float dt = (float)stm_sec(stm_laptime(&state.time_stamp));
+    if (!state.light_paused) {
+        state.light_time += dt;
+    }
+    state.light_pos.Z = HMM_SinF(state.light_time * .5f) * 3.f;
+
+    caster_t* spinning = &state.casters[SPINNING_CASTER];
+    if (state.spinning) {
+        spinning->angle = fmodf(spinning->angle + dt * 45.f, 360.f);
+    }
+    uint32_t moved_casters = 0;
+    for (int i = 0; i < NUM_CASTERS; ++i) {
+        update_caster(&state.casters[i]);
+        if (state.casters[i].moved) {
+            moved_casters |= 1u << i;
+        }
+    }
 
     /* create light space transform matrices */
     hmm_mat4 light_space_transforms[6];
@@ -265,9 +608,40 @@ void frame(void) {
     lookat = HMM_LookAt(state.light_pos, center, HMM_Vec3(0.f, -1.f,  0.f));
     light_space_transforms[SG_CUBEFACE_NEG_Z] = HMM_MultiplyMat4(shadow_proj, lookat);
 
-    /* render depth of scene to cubemap (from light's perspective) */
+    /* render depth of scene to cubemap (from light's perspective), only the casters in
+       each face and only the faces that changed since they were rendered */
+    state.shadow_passes = 0;
+    state.shadow_draws = 0;
+    state.blurred_texels = 0;
+    const bool esm = state.filter != FILTER_PCF;
+    const esm_target_t* target = esm ? esm_target(state.filter) : 0;
     for (size_t i = 0; i < 6; ++i) {
-        sg_begin_pass(state.depth.pass[i], &state.depth.pass_action);
+        shadow_face_t* face = &state.faces[i];
+        uint32_t casters = ALL_CASTERS;
+        int num_casters = NUM_CASTERS;
+        if (state.face_culling) {
+            casters = face_casters(light_space_transforms[i], &num_casters);
+        }
+        face->rendered = !state.face_culling || face_changed(face, casters, moved_casters);
+        face->num_casters = num_casters;
+        if (!face->rendered) {
+            continue;
+        }
+        /* with culling off the faces are rendered every frame and not kept */
+        face->valid = state.face_culling;
+        face->light_pos = state.light_pos;
+        face->casters = casters;
+        ++state.shadow_passes;
+        state.shadow_draws += num_casters;
+
+        /* a face without casters is at the far distance, with or without a blur */
+        if (esm && num_casters == 0) {
+            sg_begin_pass(target->cube_pass[i], &state.depth.pass_action);
+            sg_end_pass();
+            continue;
+        }
+
+        sg_begin_pass(esm ? target->face_pass : state.depth.pass[i], &state.depth.pass_action);
         sg_apply_pipeline(state.depth.pip);
         sg_apply_bindings(&state.depth.bind);
 
@@ -284,13 +658,18 @@ void frame(void) {
 
         sg_apply_uniforms(SG_SHADERSTAGE_FS, SLOT_fs_params_depth, &fs_params_depth, sizeof(fs_params_depth));
 
-        draw_cubes();
+        draw_cubes(casters);
         sg_end_pass();
+
+        if (esm) {
+            blur_face(target, (int)i);
+        }
     }
 
     /* render scene as normal using the generated depth/shadow map */
     sg_begin_default_pass(&state.shadows.pass_action, sapp_width(), sapp_height());
-    sg_apply_pipeline(state.shadows.pip);
+    sg_apply_pipeline(esm ? state.shadows.esm_pip : state.shadows.pip);
+    state.shadows.bind.fs_images[SLOT_depth_map] = esm ? target->cube_img : state.depth.color_img;
     sg_apply_bindings(&state.shadows.bind);
 
     hmm_mat4 view = lopgl_view_matrix();
@@ -307,37 +686,18 @@ void frame(void) {
     fs_params_shadows_t fs_params_shadows = {
         .light_pos = state.light_pos,
         .view_pos = lopgl_camera_position(),
-        .far_plane = far_plane
+        .far_plane = far_plane,
+        .esm_exponent = ESM_EXPONENT
     };
 
     sg_apply_uniforms(SG_SHADERSTAGE_FS, SLOT_fs_params_shadows, &fs_params_shadows, sizeof(fs_params_shadows));
 
-    fs_sampling_t fs_sampling = {
-        .grid_sampling_disk[0] = HMM_Vec4( 1.f,  1.f,  1.f, 0.f),
-        .grid_sampling_disk[1] = HMM_Vec4( 1.f, -1.f, 1.f, 0.f), 
-        .grid_sampling_disk[2] = HMM_Vec4(-1.f, -1.f,  1.f, 0.f), 
-        .grid_sampling_disk[3] = HMM_Vec4(-1.f, 1.f,  1.f, 0.f),  
-        .grid_sampling_disk[4] = HMM_Vec4(1.f, 1.f, -1.f, 0.f),  
-        .grid_sampling_disk[5] = HMM_Vec4( 1.f, -1.f, -1.f, 0.f),  
-        .grid_sampling_disk[6] = HMM_Vec4(-1.f, -1.f, -1.f, 0.f),  
-        .grid_sampling_disk[7] = HMM_Vec4(-1.f, 1.f, -1.f, 0.f), 
-        .grid_sampling_disk[8] = HMM_Vec4(1.f, 1.f,  0.f, 0.f),  
-        .grid_sampling_disk[9] = HMM_Vec4( 1.f, -1.f,  0.f, 0.f),  
-        .grid_sampling_disk[10] = HMM_Vec4(-1.f, -1.f,  0.f, 0.f),  
-        .grid_sampling_disk[11] = HMM_Vec4(-1.f, 1.f,  0.f, 0.f), 
-        .grid_sampling_disk[12] = HMM_Vec4(1.f, 0.f,  1.f, 0.f),  
-        .grid_sampling_disk[13] = HMM_Vec4(-1.f,  0.f,  1.f, 0.f),  
-        .grid_sampling_disk[14] = HMM_Vec4( 1.f,  0.f, -1.f, 0.f),  
-        .grid_sampling_disk[15] = HMM_Vec4(-1.f, 0.f, -1.f, 0.f), 
-        .grid_sampling_disk[16] = HMM_Vec4(0.f, 1.f,  1.f, 0.f),  
-        .grid_sampling_disk[17] = HMM_Vec4( 0.f, -1.f,  1.f, 0.f),  
-        .grid_sampling_disk[18] = HMM_Vec4( 0.f, -1.f, -1.f, 0.f),  
-        .grid_sampling_disk[19] = HMM_Vec4( 0.f, 1.f, -1.f, 0.f)
-    };
-
-    sg_apply_uniforms(SG_SHADERSTAGE_FS, SLOT_fs_sampling, &fs_sampling, sizeof(fs_sampling));
+    /* only PCF samples the disk */
+    if (!esm) {
+        sg_apply_uniforms(SG_SHADERSTAGE_FS, SLOT_fs_sampling, &state.shadows.sampling, sizeof(state.shadows.sampling));
+    }
 
-    draw_cubes();
+    draw_cubes(ALL_CASTERS);
 
     /* invert the normals for the outer cube */
     vs_params_shadows.normal_multiplier = -1.f;
@@ -347,12 +707,35 @@ void frame(void) {
 
     lopgl_render_help();
 
+    if (lopgl_ui_visible()) {
+        render_ui();
+    }
+
     sg_end_pass();
     sg_commit();
 }
 
 void event(const sapp_event* e) {
     lopgl_handle_input(e);
+
+    if (e->type == SAPP_EVENTTYPE_KEY_DOWN) {
+        if (e->key_code == SAPP_KEYCODE_SPACE) {
+            state.face_culling = !state.face_culling;
+        }
+        else if (e->key_code == SAPP_KEYCODE_P) {
+            state.light_paused = !state.light_paused;
+        }
+        else if (e->key_code == SAPP_KEYCODE_R) {
+            state.spinning = !state.spinning;
+        }
+        else if (e->key_code == SAPP_KEYCODE_F) {
+            state.filter = (state.filter + 1) % NUM_FILTERS;
+            /* the faces hold the depth of the previous filter */
+            for (int i = 0; i < 6; ++i) {
+                state.faces[i].valid = false;
+            }
+        }
+    }
 }
 
 void cleanup(void) {
@@ -5,6 +5,9 @@
 //
 //  http://aras-p.info/blog/2009/07/30/encoding-floats-to-rgba-the-final/
 //
+//  The programs with the _float suffix define FLOAT_DEPTH and are used where
+//  floating point render targets are supported, without the packing.
+//
 
 @ctype vec2 hmm_vec2
 @ctype vec3 hmm_vec3
@@ -17,6 +20,30 @@ uniform vs_params {
 };
 @end
 
+@block depth_packing
+#ifdef FLOAT_DEPTH
+// the float render target holds the depth as it is
+vec4 encodeDepth(float v) {
+    return vec4(v, 0.0, 0.0, 1.0);
+}
+
+float decodeDepth(vec4 rgba) {
+    return rgba.r;
+}
+#else
+vec4 encodeDepth(float v) {
+    vec4 enc = vec4(1.0, 255.0, 65025.0, 16581375.0) * v;
+    enc = fract(enc);
+    enc -= enc.yzww * vec4(1.0/255.0,1.0/255.0,1.0/255.0,0.0);
+    return enc;
+}
+
+float decodeDepth(vec4 rgba) {
+    return dot(rgba, vec4(1.0, 1.0/255.0, 1.0/65025.0, 1.0/16581375.0));
+}
+#endif
+@end
+
 @vs vs_depth
 @include_block vs_params
 in vec3 a_pos;
@@ -32,7 +59,8 @@ void main() {
 }
 @end
 
-@fs fs_depth
+@block fs_depth_body
+@include_block depth_packing
 in vec4 frag_pos;
 out vec4 frag_color;
 
@@ -41,13 +69,6 @@ uniform fs_params_depth {
     float far_plane;
 };
 
-vec4 encodeDepth(float v) {
-    vec4 enc = vec4(1.0, 255.0, 65025.0, 16581375.0) * v;
-    enc = fract(enc);
-    enc -= enc.yzww * vec4(1.0/255.0,1.0/255.0,1.0/255.0,0.0);
-    return enc;
-}
-
 void main() {             
     float light_distance = length(frag_pos.xyz - light_pos);
     
@@ -61,6 +82,94 @@ void main() {
 }
 @end
 
+@fs fs_depth
+@include_block fs_depth_body
+@end
+
+@fs fs_depth_float
+#define FLOAT_DEPTH
+@include_block fs_depth_body
+@end
+
+@vs vs_blur
+in vec2 a_pos;
+in vec2 a_tex_coords;
+out vec2 tex_coords;
+
+void main() {
+    gl_Position = vec4(a_pos, 0.0, 1.0);
+    tex_coords = a_tex_coords;
+}
+@end
+
+@block blur
+@include_block depth_packing
+in vec2 tex_coords;
+out vec4 frag_color;
+
+uniform sampler2D blur_map;
+
+// using arrays of vec4 to avoid alignment issues with cross shader compilation
+uniform fs_params_blur {
+    // one texel along the direction of the blur
+    vec2 offset;
+    float esm_exponent;
+    // weight of each tap in x
+    vec4 blur_weights[9];
+};
+
+// one direction of a separable blur of exp(esm_exponent * depth), which is kept in log space
+// so that the result still fits the encoded depth, relative to the farthest depth so that the
+// exponentials can't overflow
+// the number of taps is a constant so that the loops are unrolled
+void main() {
+    float depths[TAPS];
+    float max_depth = 0.0;
+    for (int i = 0; i < TAPS; ++i) {
+        depths[i] = decodeDepth(texture(blur_map, tex_coords + float(i - TAPS / 2) * offset));
+        max_depth = max(max_depth, depths[i]);
+    }
+    float sum = 0.0;
+    for (int i = 0; i < TAPS; ++i) {
+        sum += blur_weights[i].x * exp(esm_exponent * (depths[i] - max_depth));
+    }
+    frag_color = encodeDepth(clamp(max_depth + log(sum) / esm_exponent, 0.0, 1.0));
+}
+@end
+
+@fs fs_blur_3
+#define TAPS 3
+@include_block blur
+@end
+
+@fs fs_blur_3_float
+#define TAPS 3
+#define FLOAT_DEPTH
+@include_block blur
+@end
+
+@fs fs_blur_5
+#define TAPS 5
+@include_block blur
+@end
+
+@fs fs_blur_5_float
+#define TAPS 5
+#define FLOAT_DEPTH
+@include_block blur
+@end
+
+@fs fs_blur_9
+#define TAPS 9
+@include_block blur
+@end
+
+@fs fs_blur_9_float
+#define TAPS 9
+#define FLOAT_DEPTH
+@include_block blur
+@end
+
 @vs vs_shadows
 @include_block vs_params
 in vec3 a_pos;
@@ -92,7 +201,7 @@ void main() {
 }
 @end
 
-@fs fs_shadows
+@block fs_shadows_inputs
 in INTERFACE {
     vec3 frag_pos;
     vec3 normal;
@@ -108,7 +217,40 @@ uniform fs_params_shadows {
     vec3 light_pos;
     vec3 view_pos;
     float far_plane;
+    // exponent of the exponential shadow map
+    float esm_exponent;
 };
+@end
+
+@block fs_shadows_main
+void main() {           
+    vec3 color = texture(diffuse_texture, inter.tex_coords).rgb;
+    vec3 normal = normalize(inter.normal);
+    vec3 light_color = vec3(0.3);
+    // ambient
+    vec3 ambient = 0.3 * color;
+    // diffuse
+    vec3 light_dir = normalize(light_pos - inter.frag_pos);
+    float diff = max(dot(light_dir, normal), 0.0);
+    vec3 diffuse = diff * light_color;
+    // specular
+    vec3 view_dir = normalize(view_pos - inter.frag_pos);
+    vec3 reflect_dir = reflect(-light_dir, normal);
+    float spec = 0.0;
+    vec3 halfway_dir = normalize(light_dir + view_dir);  
+    spec = pow(max(dot(normal, halfway_dir), 0.0), 64.0);
+    vec3 specular = spec * light_color;    
+    // calculate shadow
+    float shadow = shadowCalculation(inter.frag_pos);                      
+    vec3 lighting = (ambient + (1.0 - shadow) * (diffuse + specular)) * color;    
+    
+    frag_color = vec4(lighting, 1.0);
+}
+@end
+
+@block fs_shadows_body
+@include_block depth_packing
+@include_block fs_shadows_inputs
 
 // using arrays of vec4 to avoid alignment issues with cross shader compilation
 // using a uniform because we can't initialize an arrays at declaration time with webgl 1.0
@@ -117,10 +259,6 @@ uniform fs_sampling {
     vec4 grid_sampling_disk[20];
 };
 
-float decodeDepth(vec4 rgba) {
-    return dot(rgba, vec4(1.0, 1.0/255.0, 1.0/65025.0, 1.0/16581375.0));
-}
-
 float shadowCalculation(vec3 frag_pos) {
     // get vector between fragment position and light position
     vec3 frag_to_light = frag_pos - light_pos;
@@ -144,30 +282,54 @@ float shadowCalculation(vec3 frag_pos) {
     return shadow;
 }
 
-void main() {           
-    vec3 color = texture(diffuse_texture, inter.tex_coords).rgb;
-    vec3 normal = normalize(inter.normal);
-    vec3 light_color = vec3(0.3);
-    // ambient
-    vec3 ambient = 0.3 * color;
-    // diffuse
-    vec3 light_dir = normalize(light_pos - inter.frag_pos);
-    float diff = max(dot(light_dir, normal), 0.0);
-    vec3 diffuse = diff * light_color;
-    // specular
-    vec3 view_dir = normalize(view_pos - inter.frag_pos);
-    vec3 reflect_dir = reflect(-light_dir, normal);
-    float spec = 0.0;
-    vec3 halfway_dir = normalize(light_dir + view_dir);  
-    spec = pow(max(dot(normal, halfway_dir), 0.0), 64.0);
-    vec3 specular = spec * light_color;    
-    // calculate shadow
-    float shadow = shadowCalculation(inter.frag_pos);                      
-    vec3 lighting = (ambient + (1.0 - shadow) * (diffuse + specular)) * color;    
-    
-    frag_color = vec4(lighting, 1.0);
+@include_block fs_shadows_main
+@end
+
+@fs fs_shadows
+@include_block fs_shadows_body
+@end
+
+@fs fs_shadows_float
+#define FLOAT_DEPTH
+@include_block fs_shadows_body
+@end
+
+@block fs_shadows_esm_body
+@include_block depth_packing
+@include_block fs_shadows_inputs
+
+float shadowCalculation(vec3 frag_pos) {
+    vec3 frag_to_light = frag_pos - light_pos;
+    float current_depth = length(frag_to_light);
+    float bias = 0.15;
+    // one lookup of the blurred exponential depth, exp(c * occluder) / exp(c * receiver)
+    // is 1.0 in front of the occluders and falls off quickly behind them
+    float occluder_depth = decodeDepth(texture(depth_map, frag_to_light));
+    float receiver_depth = (current_depth - bias) / far_plane;
+    return 1.0 - clamp(exp(esm_exponent * (occluder_depth - receiver_depth)), 0.0, 1.0);
 }
+
+@include_block fs_shadows_main
+@end
+
+@fs fs_shadows_esm
+@include_block fs_shadows_esm_body
+@end
+
+@fs fs_shadows_esm_float
+#define FLOAT_DEPTH
+@include_block fs_shadows_esm_body
 @end
 
 @program depth vs_depth fs_depth
+@program depth_float vs_depth fs_depth_float
+@program blur_3 vs_blur fs_blur_3
+@program blur_3_float vs_blur fs_blur_3_float
+@program blur_5 vs_blur fs_blur_5
+@program blur_5_float vs_blur fs_blur_5_float
+@program blur_9 vs_blur fs_blur_9
+@program blur_9_float vs_blur fs_blur_9_float
 @program shadows vs_shadows fs_shadows
+@program shadows_float vs_shadows fs_shadows_float
+@program shadows_esm vs_shadows fs_shadows_esm
+@program shadows_esm_float vs_shadows fs_shadows_esm_float
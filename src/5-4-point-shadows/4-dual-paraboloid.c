@@ -0,0 +1,684 @@
+//------------------------------------------------------------------------------
+//  Point Shadows (4)
+//------------------------------------------------------------------------------
+#include "sokol_app.h"
+#include "sokol_gfx.h"
+#include "hmm/HandmadeMath.h"
+#include "4-dual-paraboloid.glsl.h"
+#define LOPGL_APP_IMPL
+#include "../lopgl_app.h"
+#define LOPGL_SHADOW_FORMAT_IMPL
+#include "../lopgl_shadow_format.h"
+
+/*
+    Point shadows with a dual paraboloid map next to the cubemap of the
+    previous examples. The cubemap needs a pass for each of its six faces and
+    draws every caster six times. The paraboloid map covers all directions
+    with two hemispheres, rendered side by side into one texture in a single
+    pass, so every caster is drawn at most twice.
+
+    The paraboloid projection is not linear, it is computed for each vertex
+    and the triangles in between are rasterized as if it was. A straight edge
+    of a caster should be a curve in the map, so its silhouette is off by the
+    sagitta of that curve, which grows with the square of the angle the edge
+    covers as seen from the light. Casters have to be tessellated finer the
+    closer they get to the light, and triangles crossing the plane between the
+    hemispheres can't be projected at all. The edge error is shown in texels
+    for the current tessellation of the casters, keep it below one texel.
+*/
+
+static const int SHADOW_SIZE = 1024;
+/* bytes per texel of the depth buffer, the color bytes depend on the shadow format */
+#define DEPTH_TEXEL_BYTES 4
+
+#define NUM_CASTERS 5
+/* the faces of the casters are split into 1x1 to 8x8 quads */
+#define NUM_TESSELLATIONS 4
+#define MAX_CASTER_VERTICES (36 * (1 + 4 + 16 + 64))
+
+enum {
+    TECHNIQUE_CUBEMAP,
+    TECHNIQUE_PARABOLOID,
+    NUM_TECHNIQUES
+};
+
+static const char* technique_names[NUM_TECHNIQUES] = { "cubemap", "dual paraboloid" };
+
+typedef struct caster_t {
+    hmm_mat4 model;
+    float min_y;                /* the bounds along the axis of the paraboloids */
+    float max_y;
+} caster_t;
+
+/* application state */
+static struct {
+    struct {
+        sg_pass_action pass_action;
+        sg_pass pass[6];
+        sg_pipeline pip;
+        sg_bindings bind;
+    } depth;
+    struct {
+        sg_pass_action pass_action;
+        sg_pass pass;
+        sg_pipeline pip;
+        sg_bindings bind;
+    } paraboloid;
+    struct {
+        sg_pass_action pass_action;
+        sg_pipeline pip;
+        sg_bindings bind;
+        sg_pipeline paraboloid_pip;
+        sg_bindings paraboloid_bind;
+    } shadows;
+    hmm_vec3 light_pos;
+    caster_t casters[NUM_CASTERS];
+    /* positions of the tessellated unit cube, one range for each tessellation */
+    float caster_vertices[MAX_CASTER_VERTICES * 3];
+    int tessellation_first[NUM_TESSELLATIONS];
+    int tessellation_count[NUM_TESSELLATIONS];
+    int tessellation;
+    int technique;
+    uint64_t time_stamp;
+    /* averaged over the frames rendered with each technique */
+    double frame_ms[NUM_TECHNIQUES];
+    /* shadow passes and caster draws of the last frame */
+    int shadow_passes;
+    int shadow_draws;
+    float edge_error;
+    int split_triangles;
+    double edge_error_ms;
+    const lopgl_shadow_format_t* shadow_format;
+    uint8_t file_buffer[2 * 1024 * 1024];
+} state;
+
+static void fail_callback() {
+    state.shadows.pass_action = (sg_pass_action) {
+        .colors[0] = { .action = SG_ACTION_CLEAR, .val = { 1.0f, 0.0f, 0.0f, 1.0f } }
+    };
+}
+
+static void init_caster(caster_t* caster, hmm_mat4 model) {
+    caster->model = model;
+    const float extent = HMM_ABS(model.Elements[0][1]) + HMM_ABS(model.Elements[1][1]) + HMM_ABS(model.Elements[2][1]);
+    caster->min_y = model.Elements[3][1] - extent;
+    caster->max_y = model.Elements[3][1] + extent;
+}
+
+/* appends the unit cube with each face split into n by n quads, counter clockwise from the outside */
+static int tessellate_cube(float* vertices, int n) {
+    static const float faces[6][3][3] = {
+        /* normal, u and v with u x v = normal */
+        { {  1.f, 0.f, 0.f }, { 0.f, 0.f, -1.f }, { 0.f, 1.f, 0.f } },
+        { { -1.f, 0.f, 0.f }, { 0.f, 0.f,  1.f }, { 0.f, 1.f, 0.f } },
+        { { 0.f,  1.f, 0.f }, { 1.f, 0.f, 0.f }, { 0.f, 0.f, -1.f } },
+        { { 0.f, -1.f, 0.f }, { 1.f, 0.f, 0.f }, { 0.f, 0.f,  1.f } },
+        { { 0.f, 0.f,  1.f }, { 1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f } },
+        { { 0.f, 0.f, -1.f }, { -1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f } }
+    };
+    /* the corners of the two triangles of a quad */
+    static const int corners[6][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 0 }, { 1, 1 }, { 0, 1 } };
+    int num_vertices = 0;
+    for (int f = 0; f < 6; ++f) {
+        for (int i = 0; i < n; ++i) {
+            for (int j = 0; j < n; ++j) {
+                for (int c = 0; c < 6; ++c) {
+                    const float u = 2.f * (float)(i + corners[c][0]) / (float)n - 1.f;
+                    const float v = 2.f * (float)(j + corners[c][1]) / (float)n - 1.f;
+                    for (int k = 0; k < 3; ++k) {
+                        *vertices++ = faces[f][0][k] + u * faces[f][1][k] + v * faces[f][2][k];
+                    }
+                    ++num_vertices;
+                }
+            }
+        }
+    }
+    return num_vertices;
+}
+
+/* world to the space of a hemisphere, looking down -y for the front and up +y for the back */
+static hmm_mat4 hemisphere_view(hmm_vec3 light_pos, int back) {
+    const float s = back ? 1.f : -1.f;
+    hmm_mat4 rotate = HMM_Mat4d(1.f);
+    rotate.Elements[1][1] = 0.f;
+    rotate.Elements[2][2] = 0.f;
+    rotate.Elements[2][1] = s;
+    rotate.Elements[1][2] = -s;
+    return HMM_MultiplyMat4(rotate, HMM_Translate(HMM_MultiplyVec3f(light_pos, -1.f)));
+}
+
+/* the same projection as the paraboloid shaders, to [-1, 1] on the half of the map */
+static hmm_vec2 paraboloid_project(hmm_vec3 frag_to_light, int back) {
+    hmm_vec3 dir = back ? HMM_Vec3(frag_to_light.X, frag_to_light.Z, -frag_to_light.Y)
+                        : HMM_Vec3(frag_to_light.X, -frag_to_light.Z, frag_to_light.Y);
+    dir = HMM_NormalizeVec3(dir);
+    return HMM_Vec2(dir.X / (1.f - dir.Z), dir.Y / (1.f - dir.Z));
+}
+
+/* Largest distance in texels of the true projection of an edge midpoint from the straight
+   edge the rasterizer draws, over all caster edges, and the triangles across both hemispheres. */
+static float paraboloid_edge_error(int tessellation, int* split_triangles) {
+    const float* vertices = &state.caster_vertices[state.tessellation_first[tessellation] * 3];
+    const int num_vertices = state.tessellation_count[tessellation];
+    float max_error = 0.f;
+    *split_triangles = 0;
+    for (int c = 0; c < NUM_CASTERS; ++c) {
+        const hmm_mat4 model = state.casters[c].model;
+        for (int t = 0; t < num_vertices; t += 3) {
+            hmm_vec3 d[3];
+            int backs = 0;
+            for (int k = 0; k < 3; ++k) {
+                const float* v = &vertices[(t + k) * 3];
+                const hmm_vec4 world = HMM_MultiplyMat4ByVec4(model, HMM_Vec4(v[0], v[1], v[2], 1.f));
+                d[k] = HMM_SubtractVec3(world.XYZ, state.light_pos);
+                backs += d[k].Y > 0.f;
+            }
+            if (backs != 0 && backs != 3) {
+                ++*split_triangles;
+                continue;
+            }
+            const int back = backs == 3;
+            for (int k = 0; k < 3; ++k) {
+                const hmm_vec3 a = d[k];
+                const hmm_vec3 b = d[(k + 1) % 3];
+                const hmm_vec2 pa = paraboloid_project(a, back);
+                const hmm_vec2 pb = paraboloid_project(b, back);
+                const hmm_vec2 pm = paraboloid_project(HMM_MultiplyVec3f(HMM_AddVec3(a, b), .5f), back);
+                const hmm_vec2 edge = HMM_SubtractVec2(pb, pa);
+                const hmm_vec2 to_mid = HMM_SubtractVec2(pm, pa);
+                const float length = HMM_LengthVec2(edge);
+                /* distance of the midpoint from the line through the projected end points */
+                const float distance = length > 0.f ? HMM_ABS(edge.X * to_mid.Y - edge.Y * to_mid.X) / length : HMM_LengthVec2(to_mid);
+                const float error = distance * .5f * (float)SHADOW_SIZE;
+                if (error > max_error) {
+                    max_error = error;
+                }
+            }
+        }
+    }
+    return max_error;
+}
+
+static void init(void) {
+    lopgl_setup();
+
+    state.shadow_format = lopgl_shadow_format();
+    const bool packed = state.shadow_format->packed;
+
+    state.light_pos = HMM_Vec3(0.f, 0.f, 0.f);
+    state.technique = TECHNIQUE_PARABOLOID;
+    state.tessellation = NUM_TESSELLATIONS - 1;
+    state.time_stamp = stm_now();
+
+    init_caster(&state.casters[0], HMM_MultiplyMat4(HMM_Translate(HMM_Vec3(4.f, -3.5f, 0.f)), HMM_Scale(HMM_Vec3(.5f, .5f, .5f))));
+    init_caster(&state.casters[1], HMM_MultiplyMat4(HMM_Translate(HMM_Vec3(2.f, 3.f, 1.f)), HMM_Scale(HMM_Vec3(.75f, .75f, .75f))));
+    init_caster(&state.casters[2], HMM_MultiplyMat4(HMM_Translate(HMM_Vec3(-3.f, -1.f, 0.f)), HMM_Scale(HMM_Vec3(.5f, .5f, .5f))));
+    init_caster(&state.casters[3], HMM_MultiplyMat4(HMM_Translate(HMM_Vec3(-1.5f, 1.f, 1.5f)), HMM_Scale(HMM_Vec3(.5f, .5f, .5f))));
+    hmm_mat4 rotate = HMM_Rotate(60.f, HMM_NormalizeVec3(HMM_Vec3(1.f, 0.f, 1.f)));
+    init_caster(&state.casters[4], HMM_MultiplyMat4(HMM_MultiplyMat4(HMM_Translate(HMM_Vec3(-1.5f, 2.f, -3.f)), rotate), HMM_Scale(HMM_Vec3(.75f, .75f, .75f))));
+
+    /* create depth cubemap */
+    sg_image_desc img_desc = {
+        .type = SG_IMAGETYPE_CUBE,
+        .render_target = true,
+        .width = SHADOW_SIZE,
+        .height = SHADOW_SIZE,
+        .pixel_format = state.shadow_format->pixel_format,
+        .min_filter = SG_FILTER_NEAREST,
+        .mag_filter = SG_FILTER_NEAREST,
+        .wrap_u = SG_WRAP_CLAMP_TO_EDGE,
+        .wrap_v = SG_WRAP_CLAMP_TO_EDGE,
+        .wrap_w = SG_WRAP_CLAMP_TO_EDGE,
+        .sample_count = 1,
+        .label = "shadow-map-color-image"
+    };
+    sg_image color_img = sg_make_image(&img_desc);
+    img_desc.pixel_format = SG_PIXELFORMAT_DEPTH;
+    img_desc.label = "shadow-map-depth-image";
+    sg_image depth_img = sg_make_image(&img_desc);
+
+    /* one pass for each cubemap face */
+    for (size_t i = 0; i < 6; ++i) {
+        state.depth.pass[i] = sg_make_pass(&(sg_pass_desc){
+            .color_attachments[0] = { .image = color_img, .slice = i },
+            .depth_stencil_attachment = {  .image = depth_img, .slice = i },
+            .label = "shadow-map-pass"
+        });
+    }
+
+    /* both hemispheres side by side in one 2D map */
+    img_desc.type = SG_IMAGETYPE_2D;
+    img_desc.width = 2 * SHADOW_SIZE;
+    img_desc.pixel_format = state.shadow_format->pixel_format;
+    img_desc.label = "paraboloid-map-color-image";
+    sg_image paraboloid_color_img = sg_make_image(&img_desc);
+    img_desc.pixel_format = SG_PIXELFORMAT_DEPTH;
+    img_desc.label = "paraboloid-map-depth-image";
+    sg_image paraboloid_depth_img = sg_make_image(&img_desc);
+
+    state.paraboloid.pass = sg_make_pass(&(sg_pass_desc){
+        .color_attachments[0].image = paraboloid_color_img,
+        .depth_stencil_attachment.image = paraboloid_depth_img,
+        .label = "paraboloid-map-pass"
+    });
+
+    // sokol and webgl 1 do not support using the depth map as texture map
+    // so instead we write the depth value to the color map
+    state.shadows.bind.fs_images[SLOT_depth_map] = color_img;
+    state.shadows.paraboloid_bind.fs_images[SLOT_paraboloid_map] = paraboloid_color_img;
+
+    float cube_vertices[] = {
+        // back face
+        -1.f, -1.f, -1.f,  0.f,  0.f, -1.f, 0.f, 0.f, // bottom-left
+         1.f,  1.f, -1.f,  0.f,  0.f, -1.f, 1.f, 1.f, // top-right
+         1.f, -1.f, -1.f,  0.f,  0.f, -1.f, 1.f, 0.f, // bottom-right         
+         1.f,  1.f, -1.f,  0.f,  0.f, -1.f, 1.f, 1.f, // top-right
+        -1.f, -1.f, -1.f,  0.f,  0.f, -1.f, 0.f, 0.f, // bottom-left
+        -1.f,  1.f, -1.f,  0.f,  0.f, -1.f, 0.f, 1.f, // top-left
+        // front face
+        -1.f, -1.f,  1.f,  0.f,  0.f,  1.f, 0.f, 0.f, // bottom-left
+         1.f, -1.f,  1.f,  0.f,  0.f,  1.f, 1.f, 0.f, // bottom-right
+         1.f,  1.f,  1.f,  0.f,  0.f,  1.f, 1.f, 1.f, // top-right
+         1.f,  1.f,  1.f,  0.f,  0.f,  1.f, 1.f, 1.f, // top-right
+        -1.f,  1.f,  1.f,  0.f,  0.f,  1.f, 0.f, 1.f, // top-left
+        -1.f, -1.f,  1.f,  0.f,  0.f,  1.f, 0.f, 0.f, // bottom-left
+        // left face
+        -1.f,  1.f,  1.f, -1.f,  0.f,  0.f, 1.f, 0.f, // top-right
+        -1.f,  1.f, -1.f, -1.f,  0.f,  0.f, 1.f, 1.f, // top-left
+        -1.f, -1.f, -1.f, -1.f,  0.f,  0.f, 0.f, 1.f, // bottom-left
+        -1.f, -1.f, -1.f, -1.f,  0.f,  0.f, 0.f, 1.f, // bottom-left
+        -1.f, -1.f,  1.f, -1.f,  0.f,  0.f, 0.f, 0.f, // bottom-right
+        -1.f,  1.f,  1.f, -1.f,  0.f,  0.f, 1.f, 0.f, // top-right
+        // right face
+         1.f,  1.f,  1.f,  1.f,  0.f,  0.f, 1.f, 0.f, // top-left
+         1.f, -1.f, -1.f,  1.f,  0.f,  0.f, 0.f, 1.f, // bottom-right
+         1.f,  1.f, -1.f,  1.f,  0.f,  0.f, 1.f, 1.f, // top-right         
+         1.f, -1.f, -1.f,  1.f,  0.f,  0.f, 0.f, 1.f, // bottom-right
+         1.f,  1.f,  1.f,  1.f,  0.f,  0.f, 1.f, 0.f, // top-left
+         1.f, -1.f,  1.f,  1.f,  0.f,  0.f, 0.f, 0.f, // bottom-left     
+        // bottom face
+        -1.f, -1.f, -1.f,  0.f, -1.f,  0.f, 0.f, 1.f, // top-right
+         1.f, -1.f, -1.f,  0.f, -1.f,  0.f, 1.f, 1.f, // top-left
+         1.f, -1.f,  1.f,  0.f, -1.f,  0.f, 1.f, 0.f, // bottom-left
+         1.f, -1.f,  1.f,  0.f, -1.f,  0.f, 1.f, 0.f, // bottom-left
+        -1.f, -1.f,  1.f,  0.f, -1.f,  0.f, 0.f, 0.f, // bottom-right
+        -1.f, -1.f, -1.f,  0.f, -1.f,  0.f, 0.f, 1.f, // top-right
+        // top face
+        -1.f,  1.f, -1.f,  0.f,  1.f,  0.f, 0.f, 1.f, // top-left
+         1.f,  1.f , 1.f,  0.f,  1.f,  0.f, 1.f, 0.f, // bottom-right
+         1.f,  1.f, -1.f,  0.f,  1.f,  0.f, 1.f, 1.f, // top-right     
+         1.f,  1.f,  1.f,  0.f,  1.f,  0.f, 1.f, 0.f, // bottom-right
+        -1.f,  1.f, -1.f,  0.f,  1.f,  0.f, 0.f, 1.f, // top-left
+        -1.f,  1.f,  1.f,  0.f,  1.f,  0.f, 0.f, 0.f  // bottom-left        
+    };
+
+    sg_buffer cube_buffer = sg_make_buffer(&(sg_buffer_desc){
+        .size = sizeof(cube_vertices),
+        .content = cube_vertices,
+        .label = "cube-vertices"
+    });
+
+    state.shadows.bind.vertex_buffers[0] = cube_buffer;
+    state.shadows.paraboloid_bind.vertex_buffers[0] = cube_buffer;
+
+    /* the shadow casters are only drawn into the shadow maps, tessellated for the paraboloids */
+    int num_vertices = 0;
+    for (int i = 0; i < NUM_TESSELLATIONS; ++i) {
+        state.tessellation_first[i] = num_vertices;
+        state.tessellation_count[i] = tessellate_cube(&state.caster_vertices[num_vertices * 3], 1 << i);
+        num_vertices += state.tessellation_count[i];
+    }
+    assert(num_vertices <= MAX_CASTER_VERTICES);
+
+    sg_buffer caster_buffer = sg_make_buffer(&(sg_buffer_desc){
+        .size = num_vertices * 3 * (int)sizeof(float),
+        .content = state.caster_vertices,
+        .label = "caster-vertices"
+    });
+
+    state.depth.bind.vertex_buffers[0] = caster_buffer;
+    state.paraboloid.bind.vertex_buffers[0] = caster_buffer;
+
+    sg_shader shd_depth = sg_make_shader(packed ? depth_shader_desc() : depth_float_shader_desc());
+
+    state.depth.pip = sg_make_pipeline(&(sg_pipeline_desc){
+        .shader = shd_depth,
+        .layout = {
+            .attrs = {
+                [ATTR_vs_depth_a_pos].format = SG_VERTEXFORMAT_FLOAT3,
+            }
+        },
+        .depth_stencil = {
+            .depth_compare_func = SG_COMPAREFUNC_LESS_EQUAL,
+            .depth_write_enabled = true,
+        },
+        /* cull front faces for depth map */
+        .rasterizer = {
+            .cull_mode = SG_CULLMODE_FRONT,
+            .face_winding = SG_FACEWINDING_CCW
+        },
+        .blend = {
+            .color_format = state.shadow_format->pixel_format,
+            .depth_format = SG_PIXELFORMAT_DEPTH
+        },
+        .label = "depth-pipeline"
+    });
+
+    sg_shader shd_paraboloid = sg_make_shader(packed ? paraboloid_shader_desc() : paraboloid_float_shader_desc());
+
+    /* the hemispheres are rotations, so the projection keeps the winding of the casters */
+    state.paraboloid.pip = sg_make_pipeline(&(sg_pipeline_desc){
+        .shader = shd_paraboloid,
+        .layout = {
+            .attrs = {
+                [ATTR_vs_paraboloid_a_pos].format = SG_VERTEXFORMAT_FLOAT3,
+            }
+        },
+        .depth_stencil = {
+            .depth_compare_func = SG_COMPAREFUNC_LESS_EQUAL,
+            .depth_write_enabled = true,
+        },
+        .rasterizer = {
+            .cull_mode = SG_CULLMODE_FRONT,
+            .face_winding = SG_FACEWINDING_CCW
+        },
+        .blend = {
+            .color_format = state.shadow_format->pixel_format,
+            .depth_format = SG_PIXELFORMAT_DEPTH
+        },
+        .label = "paraboloid-pipeline"
+    });
+
+    sg_pipeline_desc shadows_pip_desc = {
+        .shader = sg_make_shader(packed ? shadows_shader_desc() : shadows_float_shader_desc()),
+        .layout = {
+            .attrs = {
+                [ATTR_vs_shadows_a_pos].format = SG_VERTEXFORMAT_FLOAT3,
+                [ATTR_vs_shadows_a_normal].format = SG_VERTEXFORMAT_FLOAT3,
+                [ATTR_vs_shadows_a_tex_coords].format = SG_VERTEXFORMAT_FLOAT2
+            }
+        },
+        .depth_stencil = {
+            .depth_compare_func = SG_COMPAREFUNC_LESS_EQUAL,
+            .depth_write_enabled = true,
+        },
+        .rasterizer = {
+            .cull_mode = SG_CULLMODE_BACK,
+            .face_winding = SG_FACEWINDING_CCW
+        },
+        .label = "shadows-pipeline"
+    };
+    state.shadows.pip = sg_make_pipeline(&shadows_pip_desc);
+
+    shadows_pip_desc.shader = sg_make_shader(packed ? shadows_paraboloid_shader_desc() : shadows_paraboloid_float_shader_desc());
+    shadows_pip_desc.label = "shadows-paraboloid-pipeline";
+    state.shadows.paraboloid_pip = sg_make_pipeline(&shadows_pip_desc);
+
+    state.depth.pass_action = (sg_pass_action) {
+        .colors[0] = { .action=SG_ACTION_CLEAR, .val={1.f, 1.f, 1.f, 1.0f} }
+    };
+    state.paraboloid.pass_action = state.depth.pass_action;
+
+    state.shadows.pass_action = (sg_pass_action) {
+        .colors[0] = { .action=SG_ACTION_CLEAR, .val={0.1f, 0.1f, 0.1f, 1.0f} }
+    };
+
+    sg_image img_id_diffuse = sg_alloc_image();
+    state.shadows.bind.fs_images[SLOT_diffuse_texture] = img_id_diffuse;
+    state.shadows.paraboloid_bind.fs_images[SLOT_diffuse_texture] = img_id_diffuse;
+
+    lopgl_load_image(&(lopgl_image_request_t){
+            .path = "wood.png",
+            .img_id = img_id_diffuse,
+            .buffer_ptr = state.file_buffer,
+            .buffer_size = sizeof(state.file_buffer),
+            .fail_callback = fail_callback
+    });
+}
+
+void draw_room_cube() {
+    vs_params_t vs_params = {
+        /* invert the outer cube so just the inner faces are shown with back culling */
+        .model = HMM_Scale(HMM_Vec3(-5.f, -5.f, -5.f))
+    };
+    sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &vs_params, sizeof(vs_params));
+    sg_draw(0, 36, 1);
+}
+
+void draw_cubes() {
+    for (int i = 0; i < NUM_CASTERS; ++i) {
+        vs_params_t vs_params = {
+            .model = state.casters[i].model
+        };
+        sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &vs_params, sizeof(vs_params));
+        sg_draw(0, 36, 1);
+    }
+}
+
+/* draws the casters with at least a part in the hemisphere into the shadow map */
+static void draw_casters(int tessellation, int back) {
+    for (int i = 0; i < NUM_CASTERS; ++i) {
+        const caster_t* caster = &state.casters[i];
+        if (back ? caster->max_y < state.light_pos.Y : caster->min_y > state.light_pos.Y) {
+            continue;
+        }
+        vs_params_t vs_params = {
+            .model = caster->model
+        };
+        sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &vs_params, sizeof(vs_params));
+        sg_draw(state.tessellation_first[tessellation], state.tessellation_count[tessellation], 1);
+        ++state.shadow_draws;
+    }
+}
+
+static void render_ui() {
+    const double mb = 1.0 / (1024.0 * 1024.0);
+    const double cube_texels = 6.0 * SHADOW_SIZE * SHADOW_SIZE;
+    const double paraboloid_texels = 2.0 * SHADOW_SIZE * SHADOW_SIZE;
+    /* texels per degree where the maps are the coarsest, in the center of a cubemap face
+       and of a paraboloid, where a texel covers twice the angle */
+    const double cube_density = .5 * SHADOW_SIZE * HMM_PI / 180.0;
+    const double paraboloid_density = .25 * SHADOW_SIZE * HMM_PI / 180.0;
+    const bool paraboloid = state.technique == TECHNIQUE_PARABOLOID;
+    const int n = 1 << state.tessellation;
+    const int texel_bytes = state.shadow_format->texel_bytes + DEPTH_TEXEL_BYTES;
+
+    sdtx_canvas(sapp_width()*0.5f, sapp_height()*0.5f);
+    sdtx_origin(sapp_width()*0.5f/8.f - 24.f, 0.25f);       // each character occupies a grid fo 8x8
+    sdtx_home();
+
+    sdtx_color4b(0xff, 0x00, 0x00, 0xaf);
+    sdtx_printf("Technique:\t%s\n", technique_names[state.technique]);
+    sdtx_printf("Shadow passes:\t%d\n", state.shadow_passes);
+    sdtx_printf("Caster draws:\t%d\n", state.shadow_draws);
+    sdtx_printf("Fill:\t\t%.1f Mtx\n", (paraboloid ? paraboloid_texels : cube_texels) / 1e6);
+    sdtx_printf("Memory:\t\t%.0f MB\n", (paraboloid ? paraboloid_texels : cube_texels) * texel_bytes * mb);
+    sdtx_printf("Density:\t%.1f tx/deg\n\n", paraboloid ? paraboloid_density : cube_density);
+    for (int i = 0; i < NUM_TECHNIQUES; ++i) {
+        sdtx_printf("%s:\t%.2f ms\n", technique_names[i], state.frame_ms[i]);
+    }
+    if (paraboloid) {
+        sdtx_printf("\nTessellation:\t%dx%d\n", n, n);
+        sdtx_printf("Edge error:\t%.2f tx\n", state.edge_error);
+        sdtx_printf("Split tris:\t%d\n", state.split_triangles);
+    }
+    sdtx_puts("\n");
+    lopgl_print_shadow_formats(state.shadow_format, paraboloid ? paraboloid_texels : cube_texels, 1);
+    sdtx_puts("\nTechnique:\t'SPACE'\n");
+    sdtx_puts("Tessellation:\t'T'");
+    sdtx_draw();
+}
+
+void frame(void) {
+    lopgl_update();
+
+    /* the edge error is only computed for the ui, it is left out of the frame time */
+    const double frame_ms = stm_ms(stm_laptime(&state.time_stamp)) - state.edge_error_ms;
+    double* average_ms = &state.frame_ms[state.technique];
+    *average_ms = *average_ms > 0.0 ? *average_ms * .95 + frame_ms * .05 : frame_ms;
+
+    /* move light position over time */
+    state.light_pos.Z = HMM_SinF((float)stm_sec(stm_now()) * .5f) * 3.f;
+
+    float near_plane = 1.0f;
+    float far_plane  = 25.0f;
+    state.shadow_passes = 0;
+    state.shadow_draws = 0;
+
+    fs_params_depth_t fs_params_depth = {
+        .light_pos = state.light_pos,
+        .far_plane = far_plane
+    };
+
+    if (state.technique == TECHNIQUE_CUBEMAP) {
+        /* create light space transform matrices */
+        hmm_mat4 light_space_transforms[6];
+        hmm_mat4 shadow_proj = HMM_Perspective(90.0f, 1.0f, near_plane, far_plane);
+        hmm_vec3 center = HMM_AddVec3(state.light_pos, HMM_Vec3(1.f, 0.f, 0.f));
+        hmm_mat4 lookat = HMM_LookAt(state.light_pos, center, HMM_Vec3(0.f, -1.f, 0.f));
+        light_space_transforms[SG_CUBEFACE_POS_X] = HMM_MultiplyMat4(shadow_proj, lookat);
+        center = HMM_AddVec3(state.light_pos, HMM_Vec3(-1.f, 0.f, 0.f));
+        lookat = HMM_LookAt(state.light_pos, center, HMM_Vec3(0.f, -1.f, 0.f));
+        light_space_transforms[SG_CUBEFACE_NEG_X] = HMM_MultiplyMat4(shadow_proj, lookat);
+        center = HMM_AddVec3(state.light_pos, HMM_Vec3(0.f, 1.f, 0.f));
+        lookat = HMM_LookAt(state.light_pos, center, HMM_Vec3(0.f, 0.f, 1.f));
+        light_space_transforms[SG_CUBEFACE_POS_Y] = HMM_MultiplyMat4(shadow_proj, lookat);
+        center = HMM_AddVec3(state.light_pos, HMM_Vec3(0.f, -1.f, 0.f));
+        lookat = HMM_LookAt(state.light_pos, center, HMM_Vec3(0.f, 0.f, -1.f));
+        light_space_transforms[SG_CUBEFACE_NEG_Y] = HMM_MultiplyMat4(shadow_proj, lookat);
+        center = HMM_AddVec3(state.light_pos, HMM_Vec3(0.f, 0.f, 1.f));
+        lookat = HMM_LookAt(state.light_pos, center, HMM_Vec3(0.f, -1.f,  0.f));
+        light_space_transforms[SG_CUBEFACE_POS_Z] = HMM_MultiplyMat4(shadow_proj, lookat);
+        center = HMM_AddVec3(state.light_pos, HMM_Vec3(0.f, 0.f, -1.f));
+        lookat = HMM_LookAt(state.light_pos, center, HMM_Vec3(0.f, -1.f,  0.f));
+        light_space_transforms[SG_CUBEFACE_NEG_Z] = HMM_MultiplyMat4(shadow_proj, lookat);
+
+        /* render depth of scene to cubemap (from light's perspective), the projection is
+           linear so the casters don't need to be tessellated */
+        for (size_t i = 0; i < 6; ++i) {
+            sg_begin_pass(state.depth.pass[i], &state.depth.pass_action);
+            sg_apply_pipeline(state.depth.pip);
+            sg_apply_bindings(&state.depth.bind);
+
+            vs_params_depth_t vs_params_depth = {
+                .light_space_matrix = light_space_transforms[i]
+            };
+            sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params_depth, &vs_params_depth, sizeof(vs_params_depth));
+            sg_apply_uniforms(SG_SHADERSTAGE_FS, SLOT_fs_params_depth, &fs_params_depth, sizeof(fs_params_depth));
+
+            for (int j = 0; j < NUM_CASTERS; ++j) {
+                vs_params_t vs_params = {
+                    .model = state.casters[j].model
+                };
+                sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params, &vs_params, sizeof(vs_params));
+                sg_draw(state.tessellation_first[0], state.tessellation_count[0], 1);
+            }
+            ++state.shadow_passes;
+            state.shadow_draws += NUM_CASTERS;
+            sg_end_pass();
+        }
+    }
+    else {
+        /* render depth of scene to both hemispheres in one pass, the front one on the left */
+        sg_begin_pass(state.paraboloid.pass, &state.paraboloid.pass_action);
+        sg_apply_pipeline(state.paraboloid.pip);
+        sg_apply_bindings(&state.paraboloid.bind);
+        sg_apply_uniforms(SG_SHADERSTAGE_FS, SLOT_fs_params_depth, &fs_params_depth, sizeof(fs_params_depth));
+        for (int back = 0; back < 2; ++back) {
+            sg_apply_viewport(back * SHADOW_SIZE, 0, SHADOW_SIZE, SHADOW_SIZE, false);
+            vs_params_paraboloid_t vs_params_paraboloid = {
+                .light_view = hemisphere_view(state.light_pos, back),
+                .near_plane = near_plane,
+                .far_plane = far_plane
+            };
+            sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params_paraboloid, &vs_params_paraboloid, sizeof(vs_params_paraboloid));
+            draw_casters(state.tessellation, back);
+        }
+        ++state.shadow_passes;
+        sg_end_pass();
+    }
+
+    state.edge_error_ms = 0.0;
+    if (state.technique == TECHNIQUE_PARABOLOID && lopgl_ui_visible()) {
+        const uint64_t start = stm_now();
+        state.edge_error = paraboloid_edge_error(state.tessellation, &state.split_triangles);
+        state.edge_error_ms = stm_ms(stm_since(start));
+    }
+
+    /* render scene as normal using the generated depth/shadow map */
+    sg_begin_default_pass(&state.shadows.pass_action, sapp_width(), sapp_height());
+    if (state.technique == TECHNIQUE_CUBEMAP) {
+        sg_apply_pipeline(state.shadows.pip);
+        sg_apply_bindings(&state.shadows.bind);
+    }
+    else {
+        sg_apply_pipeline(state.shadows.paraboloid_pip);
+        sg_apply_bindings(&state.shadows.paraboloid_bind);
+    }
+
+    hmm_mat4 view = lopgl_view_matrix();
+    hmm_mat4 projection = HMM_Perspective(lopgl_fov(), (float)sapp_width() / (float)sapp_height(), 0.1f, 100.0f);
+
+    vs_params_shadows_t vs_params_shadows = {
+        .projection = projection,
+        .view = view,
+        .normal_multiplier = 1.f
+    };
+
+    sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params_shadows, &vs_params_shadows, sizeof(vs_params_shadows));
+
+    fs_params_shadows_t fs_params_shadows = {
+        .light_pos = state.light_pos,
+        .view_pos = lopgl_camera_position(),
+        .far_plane = far_plane
+    };
+
+    sg_apply_uniforms(SG_SHADERSTAGE_FS, SLOT_fs_params_shadows, &fs_params_shadows, sizeof(fs_params_shadows));
+
+    draw_cubes();
+
+    /* invert the normals for the outer cube */
+    vs_params_shadows.normal_multiplier = -1.f;
+    sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params_shadows, &vs_params_shadows, sizeof(vs_params_shadows));
+
+    draw_room_cube();
+
+    lopgl_render_help();
+
+    if (lopgl_ui_visible()) {
+        render_ui();
+    }
+
+    sg_end_pass();
+    sg_commit();
+}
+
+void event(const sapp_event* e) {
+    lopgl_handle_input(e);
+
+    if (e->type == SAPP_EVENTTYPE_KEY_DOWN) {
+        if (e->key_code == SAPP_KEYCODE_SPACE) {
+            state.technique = (state.technique + 1) % NUM_TECHNIQUES;
+        }
+        else if (e->key_code == SAPP_KEYCODE_T) {
+            state.tessellation = (state.tessellation + 1) % NUM_TESSELLATIONS;
+        }
+    }
+}
+
+void cleanup(void) {
+    lopgl_shutdown();
+}
+
+sapp_desc sokol_main(int argc, char* argv[]) {
+    return (sapp_desc){
+        .init_cb = init,
+        .frame_cb = frame,
+        .cleanup_cb = cleanup,
+        .event_cb = event,
+        .width = 800,
+        .height = 600,
+        .gl_force_gles2 = true,
+        .window_title = "Dual Paraboloid Shadows (LearnOpenGL)",
+    };
+}
@@ -0,0 +1,289 @@
+//------------------------------------------------------------------------------
+//  float/rgba8 encoding/decoding so that we can use an RGBA8
+//  shadow map instead of floating point render targets which might
+//  not be supported everywhere
+//
+//  http://aras-p.info/blog/2009/07/30/encoding-floats-to-rgba-the-final/
+//
+//  The programs with the _float suffix define FLOAT_DEPTH and are used where
+//  floating point render targets are supported, without the packing.
+//
+//  The dual paraboloid map splits the directions around the light at the
+//  plane y = light_pos.y. The front hemisphere looks down -y, the back one
+//  up +y, and each one is projected onto the disk of its half of the map.
+//
+
+@ctype vec3 hmm_vec3
+@ctype mat4 hmm_mat4
+
+@block vs_params
+uniform vs_params {
+    mat4 model;
+};
+@end
+
+@block fs_params_depth
+uniform fs_params_depth {
+    vec3 light_pos;
+    float far_plane;
+};
+@end
+
+@block depth_packing
+#ifdef FLOAT_DEPTH
+// the float render target holds the depth as it is
+vec4 encodeDepth(float v) {
+    return vec4(v, 0.0, 0.0, 1.0);
+}
+
+float decodeDepth(vec4 rgba) {
+    return rgba.r;
+}
+#else
+vec4 encodeDepth(float v) {
+    vec4 enc = vec4(1.0, 255.0, 65025.0, 16581375.0) * v;
+    enc = fract(enc);
+    enc -= enc.yzww * vec4(1.0/255.0,1.0/255.0,1.0/255.0,0.0);
+    return enc;
+}
+
+float decodeDepth(vec4 rgba) {
+    return dot(rgba, vec4(1.0, 1.0/255.0, 1.0/65025.0, 1.0/16581375.0));
+}
+#endif
+@end
+
+@vs vs_depth
+@include_block vs_params
+in vec3 a_pos;
+out vec4 frag_pos;
+
+uniform vs_params_depth {
+    mat4 light_space_matrix;
+};
+
+void main() {
+    frag_pos = model * vec4(a_pos, 1.0);
+    gl_Position = light_space_matrix * frag_pos;
+}
+@end
+
+@block fs_depth_body
+@include_block fs_params_depth
+@include_block depth_packing
+in vec4 frag_pos;
+out vec4 frag_color;
+
+void main() {
+    float light_distance = length(frag_pos.xyz - light_pos);
+
+    // map to [0;1] range by dividing by far_plane
+    light_distance = light_distance / far_plane;
+
+    // write this as modified depth
+    // sokol and webgl 1 do not support using the depth map as texture
+    // so instead we write the depth value to the color map
+    frag_color = encodeDepth(light_distance);
+}
+@end
+
+@fs fs_depth
+@include_block fs_depth_body
+@end
+
+@fs fs_depth_float
+#define FLOAT_DEPTH
+@include_block fs_depth_body
+@end
+
+@vs vs_paraboloid
+@include_block vs_params
+in vec3 a_pos;
+out vec3 frag_pos;
+out float hemisphere_z;
+
+uniform vs_params_paraboloid {
+    // world to the space of the hemisphere, which looks down its -z axis
+    mat4 light_view;
+    float near_plane;
+    float far_plane;
+};
+
+void main() {
+    vec4 world_pos = model * vec4(a_pos, 1.0);
+    frag_pos = world_pos.xyz;
+    vec3 pos = (light_view * world_pos).xyz;
+    float light_distance = length(pos);
+    // the projection is only correct at the vertices, the rasterizer interpolates linearly
+    // between them, so edges have to be short compared to their distance to the light
+    hemisphere_z = pos.z;
+    vec2 paraboloid = pos.xy / max(light_distance - pos.z, 0.0001);
+    gl_Position = vec4(paraboloid, (light_distance - near_plane) / (far_plane - near_plane) * 2.0 - 1.0, 1.0);
+}
+@end
+
+@block fs_paraboloid_body
+@include_block fs_params_depth
+@include_block depth_packing
+in vec3 frag_pos;
+in float hemisphere_z;
+out vec4 frag_color;
+
+void main() {
+    // the other hemisphere is rendered into the other half of the map
+    if (hemisphere_z > 0.0) {
+        discard;
+    }
+    frag_color = encodeDepth(length(frag_pos - light_pos) / far_plane);
+}
+@end
+
+@fs fs_paraboloid
+@include_block fs_paraboloid_body
+@end
+
+@fs fs_paraboloid_float
+#define FLOAT_DEPTH
+@include_block fs_paraboloid_body
+@end
+
+@vs vs_shadows
+@include_block vs_params
+in vec3 a_pos;
+in vec3 a_normal;
+in vec2 a_tex_coords;
+
+out INTERFACE {
+    vec3 frag_pos;
+    vec3 normal;
+    vec2 tex_coords;
+} inter;
+
+uniform vs_params_shadows {
+    mat4 projection;
+    mat4 view;
+    float normal_multiplier;
+};
+
+void main() {
+    inter.frag_pos = vec3(model * vec4(a_pos, 1.0));
+    // inverse tranpose is left out because:
+    // (a) glsl es 1.0 (webgl 1.0) doesn't have inverse and transpose functions
+    // (b) we're not performing non-uniform scale
+    inter.normal = mat3(model) * a_normal;
+    // a slight hack to make sure the outer large cube displays lighting from the 'inside' instead of the default 'outside'.
+    inter.normal = normal_multiplier * inter.normal;
+    inter.tex_coords = a_tex_coords;
+    gl_Position = projection * view * model * vec4(a_pos, 1.0);
+}
+@end
+
+@block fs_shadows_inputs
+@include_block depth_packing
+in INTERFACE {
+    vec3 frag_pos;
+    vec3 normal;
+    vec2 tex_coords;
+} inter;
+
+out vec4 frag_color;
+
+uniform sampler2D diffuse_texture;
+
+uniform fs_params_shadows {
+    vec3 light_pos;
+    vec3 view_pos;
+    float far_plane;
+};
+@end
+
+@block fs_shadows_main
+void main() {
+    vec3 color = texture(diffuse_texture, inter.tex_coords).rgb;
+    vec3 normal = normalize(inter.normal);
+    vec3 light_color = vec3(0.3);
+    // ambient
+    vec3 ambient = 0.3 * color;
+    // diffuse
+    vec3 light_dir = normalize(light_pos - inter.frag_pos);
+    float diff = max(dot(light_dir, normal), 0.0);
+    vec3 diffuse = diff * light_color;
+    // specular
+    vec3 view_dir = normalize(view_pos - inter.frag_pos);
+    vec3 halfway_dir = normalize(light_dir + view_dir);
+    float spec = pow(max(dot(normal, halfway_dir), 0.0), 64.0);
+    vec3 specular = spec * light_color;
+    // calculate shadow
+    float shadow = shadowCalculation(inter.frag_pos);
+    vec3 lighting = (ambient + (1.0 - shadow) * (diffuse + specular)) * color;
+
+    frag_color = vec4(lighting, 1.0);
+}
+@end
+
+@block fs_shadows_body
+@include_block fs_shadows_inputs
+uniform samplerCube depth_map;
+
+float shadowCalculation(vec3 frag_pos) {
+    // get vector between fragment position and light position
+    vec3 frag_to_light = frag_pos - light_pos;
+    // use the fragment to light vector to sample from the depth map
+    float closest_depth = decodeDepth(texture(depth_map, frag_to_light)) * far_plane;
+    float current_depth = length(frag_to_light);
+    float bias = 0.05;
+    return current_depth - bias > closest_depth ? 1.0 : 0.0;
+}
+
+@include_block fs_shadows_main
+@end
+
+@fs fs_shadows
+@include_block fs_shadows_body
+@end
+
+@fs fs_shadows_float
+#define FLOAT_DEPTH
+@include_block fs_shadows_body
+@end
+
+@block fs_shadows_paraboloid_body
+@include_block fs_shadows_inputs
+// the front hemisphere in the left half, the back one in the right half
+uniform sampler2D paraboloid_map;
+
+float shadowCalculation(vec3 frag_pos) {
+    vec3 frag_to_light = frag_pos - light_pos;
+    float current_depth = length(frag_to_light);
+    // rotate into the space of the hemisphere, the same as the light_view matrices
+    float back = frag_to_light.y > 0.0 ? 1.0 : 0.0;
+    vec3 dir = back > 0.0 ? vec3(frag_to_light.x, frag_to_light.z, -frag_to_light.y)
+                          : vec3(frag_to_light.x, -frag_to_light.z, frag_to_light.y);
+    dir /= current_depth;
+    vec2 paraboloid = dir.xy / (1.0 - dir.z);
+    vec2 coords = vec2((paraboloid.x * 0.5 + 0.5 + back) * 0.5, paraboloid.y * 0.5 + 0.5);
+    float closest_depth = decodeDepth(texture(paraboloid_map, coords)) * far_plane;
+    float bias = 0.05;
+    return current_depth - bias > closest_depth ? 1.0 : 0.0;
+}
+
+@include_block fs_shadows_main
+@end
+
+@fs fs_shadows_paraboloid
+@include_block fs_shadows_paraboloid_body
+@end
+
+@fs fs_shadows_paraboloid_float
+#define FLOAT_DEPTH
+@include_block fs_shadows_paraboloid_body
+@end
+
+@program depth vs_depth fs_depth
+@program depth_float vs_depth fs_depth_float
+@program paraboloid vs_paraboloid fs_paraboloid
+@program paraboloid_float vs_paraboloid fs_paraboloid_float
+@program shadows vs_shadows fs_shadows
+@program shadows_float vs_shadows fs_shadows_float
+@program shadows_paraboloid vs_shadows fs_shadows_paraboloid
+@program shadows_paraboloid_float vs_shadows fs_shadows_paraboloid_float
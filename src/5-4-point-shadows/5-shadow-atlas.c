@@ -0,0 +1,667 @@
+//------------------------------------------------------------------------------
+//  Point Shadows (5)
+//------------------------------------------------------------------------------
+#include <stdlib.h>
+#include "sokol_app.h"
+#include "sokol_gfx.h"
+#include "hmm/HandmadeMath.h"
+#include "5-shadow-atlas.glsl.h"
+#define LOPGL_APP_IMPL
+#include "../lopgl_app.h"
+#define LOPGL_SHADOW_FORMAT_IMPL
+#include "../lopgl_shadow_format.h"
+#define LOPGL_SHADOW_ATLAS_IMPL
+#include "../lopgl_shadow_atlas.h"
+
+/*
+    Shadows of many spot and point lights in one shadow atlas. The previous
+    examples give their single light a 1024x1024 map of its own (six of them
+    for the cube map). Here every light gets tiles of one 2048x2048 page
+    instead, a single tile for a spot light and one per cube face for a point
+    light. The page is allocated once, so the memory stays the same no matter
+    how many lights there are.
+
+    The tiles are handed out again every frame, the lights that cover more of
+    the screen first and with larger tiles. Lights whose range is out of view
+    get no tiles. When the page is full the tiles get smaller, and the lights
+    that don't fit at the smallest size are lit without a shadow.
+
+    All tiles are rendered in a single pass, with the viewport and scissor
+    rect set to one tile at a time and only the casters in that tile drawn.
+    The shaders find the tile of a fragment in a uniform array of tile
+    offsets and sizes, indexed by the light and the cube face, which needs
+    GLES3/WebGL2.
+*/
+
+#define NUM_POINT_LIGHTS 8
+#define NUM_SPOT_LIGHTS 24
+#define NUM_LIGHTS (NUM_POINT_LIGHTS + NUM_SPOT_LIGHTS)
+/* the size of the tile array of the shaders */
+#define MAX_TILES (6 * NUM_POINT_LIGHTS + NUM_SPOT_LIGHTS)
+#define ATLAS_SIZE 2048
+/* cubes on a grid over the floor besides the three of the previous examples */
+#define GRID_SIZE 6
+#define NUM_CUBES (3 + GRID_SIZE * GRID_SIZE)
+#define POINT_RANGE 8.f
+#define SPOT_RANGE 14.f
+/* half the cone of the spot lights in degrees */
+#define SPOT_ANGLE 30.f
+#define SHADOW_NEAR .1f
+/* bytes per texel of the depth buffer, the color bytes depend on the shadow format */
+#define DEPTH_TEXEL_BYTES 4
+/* shadow map lookups per light and shaded fragment */
+#define SHADOW_LOOKUPS 1
+/* the size of a map of its own in the previous examples */
+#define SINGLE_MAP_SIZE 1024
+
+typedef struct light_t {
+    bool spot;
+    hmm_vec3 position;
+    hmm_vec3 direction;             /* of spot lights */
+    hmm_vec3 color;
+    float range;
+    float fov;                      /* of the tiles in degrees */
+    float tan_half;                 /* of the field of view of the tiles */
+    int num_tiles;                  /* 1 for spot lights, one per cube face for point lights */
+    float importance;               /* 0 when out of view */
+    int first_tile;                 /* -1 without a shadow */
+} light_t;
+
+/* application state */
+static struct {
+    struct {
+        sg_pass_action pass_action;
+        sg_pass pass;
+        sg_pipeline pip;
+        sg_bindings bind_cube;
+    } depth;
+    struct {
+        sg_pass_action pass_action;
+        sg_pipeline pip;
+        sg_bindings bind_cube;
+        sg_bindings bind_plane;
+    } shadows;
+    struct {
+        sg_pipeline pip;
+        sg_bindings bind;
+    } atlas_view;
+    lopgl_shadow_atlas_t atlas;
+    lopgl_shadow_tile_t tiles[MAX_TILES];
+    int num_tiles;
+    light_t lights[NUM_LIGHTS];
+    /* indices of the lights by importance */
+    int order[NUM_LIGHTS];
+    hmm_mat4 cube_models[NUM_CUBES];
+    hmm_vec3 cube_centers[NUM_CUBES];
+    float cube_radii[NUM_CUBES];
+    bool size_by_importance;
+    bool show_atlas;
+    int caster_draws;
+    double alloc_ms;
+    const lopgl_shadow_format_t* shadow_format;
+    uint8_t file_buffer[2 * 1024 * 1024];
+} state;
+
+static void fail_callback() {
+    state.shadows.pass_action = (sg_pass_action) {
+        .colors[0] = { .action = SG_ACTION_CLEAR, .val = { 1.0f, 0.0f, 0.0f, 1.0f } }
+    };
+}
+
+static void init_cubes(void) {
+    state.cube_models[0] = HMM_MultiplyMat4(HMM_Translate(HMM_Vec3(0.f, 1.5f, 0.f)), HMM_Scale(HMM_Vec3(.5f, .5f, .5f)));
+    state.cube_models[1] = HMM_MultiplyMat4(HMM_Translate(HMM_Vec3(2.f, 0.f, 1.f)), HMM_Scale(HMM_Vec3(.5f, .5f, .5f)));
+    hmm_mat4 rotate = HMM_Rotate(60.f, HMM_NormalizeVec3(HMM_Vec3(1.f, 0.f, 1.f)));
+    state.cube_models[2] = HMM_MultiplyMat4(HMM_MultiplyMat4(HMM_Translate(HMM_Vec3(-1.f, 0.f, 2.f)), rotate), HMM_Scale(HMM_Vec3(.25f, .25f, .25f)));
+
+    for (int i = 0; i < GRID_SIZE * GRID_SIZE; ++i) {
+        const float x = -20.f + 8.f * (float)(i % GRID_SIZE);
+        const float z = -20.f + 8.f * (float)(i / GRID_SIZE);
+        /* a few heights, standing on the floor */
+        const float height = 0.5f + 0.25f * (float)((i * 7) % 5);
+        const hmm_mat4 translate = HMM_Translate(HMM_Vec3(x, height - .5f, z));
+        state.cube_models[3 + i] = HMM_MultiplyMat4(translate, HMM_Scale(HMM_Vec3(.5f, height, .5f)));
+    }
+
+    /* bounding spheres to cull the casters of each tile, the cube vertices are at +-1 so the
+       corners are the sum of the first three columns, which are orthogonal */
+    for (int i = 0; i < NUM_CUBES; ++i) {
+        const float* m = &state.cube_models[i].Elements[0][0];
+        state.cube_centers[i] = HMM_Vec3(m[12], m[13], m[14]);
+        state.cube_radii[i] = HMM_SquareRootF(m[0] * m[0] + m[1] * m[1] + m[2] * m[2] +
+                                              m[4] * m[4] + m[5] * m[5] + m[6] * m[6] +
+                                              m[8] * m[8] + m[9] * m[9] + m[10] * m[10]);
+    }
+}
+
+static void init_lights(void) {
+    for (int i = 0; i < NUM_LIGHTS; ++i) {
+        light_t* light = &state.lights[i];
+        light->spot = i >= NUM_POINT_LIGHTS;
+        light->range = light->spot ? SPOT_RANGE : POINT_RANGE;
+        light->fov = light->spot ? 2.f * SPOT_ANGLE : 90.f;
+        light->tan_half = HMM_TanF(HMM_ToRadians(light->fov * .5f));
+        light->num_tiles = light->spot ? 1 : 6;
+        /* hues around the color wheel */
+        const float hue = (float)i * 0.618f * 2.f * HMM_PI32;
+        light->color = HMM_Vec3(.6f + .4f * HMM_CosF(hue), .6f + .4f * HMM_CosF(hue - 2.094f), .6f + .4f * HMM_CosF(hue + 2.094f));
+        state.order[i] = i;
+    }
+}
+
+static void update_lights(float time) {
+    for (int i = 0; i < NUM_POINT_LIGHTS; ++i) {
+        light_t* light = &state.lights[i];
+        /* two rings going around the center in opposite directions */
+        const float radius = (i % 2) ? 14.f : 6.f;
+        const float angle = (i % 2 ? -.2f : .3f) * time + (float)i * 2.f * HMM_PI32 / NUM_POINT_LIGHTS;
+        light->position = HMM_Vec3(radius * HMM_CosF(angle), 1.5f + .5f * HMM_SinF(time + (float)i), radius * HMM_SinF(angle));
+    }
+    for (int i = 0; i < NUM_SPOT_LIGHTS; ++i) {
+        light_t* light = &state.lights[NUM_POINT_LIGHTS + i];
+        /* between the cubes of the grid, sweeping around */
+        const float x = -16.f + 8.f * (float)(i % 6);
+        const float z = -18.f + 12.f * (float)(i / 6);
+        const float angle = .5f * time + (float)i;
+        light->position = HMM_Vec3(x, 6.f, z);
+        light->direction = HMM_NormalizeVec3(HMM_Vec3(.5f * HMM_CosF(angle), -1.f, .5f * HMM_SinF(angle)));
+    }
+}
+
+/* a sphere at x, y across and z along the axis of a frustum with its apex at the origin */
+static bool sphere_in_frustum(float x, float y, float z, float radius, float tan_x, float tan_y, float far) {
+    if (z < -radius || z - radius > far) {
+        return false;
+    }
+    /* distance to the side planes, which go through the apex */
+    return HMM_ABS(x) - tan_x * z <= radius * HMM_SquareRootF(1.f + tan_x * tan_x) &&
+           HMM_ABS(y) - tan_y * z <= radius * HMM_SquareRootF(1.f + tan_y * tan_y);
+}
+
+/* the radius of the range of a light on screen relative to half the height of the screen */
+static float light_importance(const light_t* light, hmm_mat4 view, float tan_half_fov, float aspect) {
+    const hmm_vec4 p = HMM_MultiplyMat4ByVec4(view, HMM_Vec4v(light->position, 1.f));
+    if (!sphere_in_frustum(p.X, p.Y, -p.Z, light->range, aspect * tan_half_fov, tan_half_fov, 100.f)) {
+        return 0.f;
+    }
+    if (-p.Z <= light->range) {
+        return 1.f;
+    }
+    return HMM_MIN(1.f, light->range / (-p.Z * tan_half_fov));
+}
+
+static int compare_importance(const void* a, const void* b) {
+    const float ia = state.lights[*(const int*)a].importance;
+    const float ib = state.lights[*(const int*)b].importance;
+    return (ia < ib) - (ia > ib);
+}
+
+/* the most important lights get their tiles first, so the largest tiles are packed first */
+static void allocate_tiles(void) {
+    lopgl_clear_shadow_atlas(&state.atlas);
+    state.num_tiles = 0;
+    qsort(state.order, NUM_LIGHTS, sizeof(state.order[0]), compare_importance);
+    for (int i = 0; i < NUM_LIGHTS; ++i) {
+        light_t* light = &state.lights[state.order[i]];
+        light->first_tile = -1;
+        /* nothing of the light can be seen */
+        if (light->importance <= 0.f) {
+            continue;
+        }
+        const int size = state.size_by_importance ? lopgl_shadow_tile_size(&state.atlas, light->importance) : state.atlas.max_tile_size;
+        if (lopgl_alloc_shadow_tiles(&state.atlas, size, light->num_tiles, &state.tiles[state.num_tiles]) > 0) {
+            light->first_tile = state.num_tiles;
+            state.num_tiles += light->num_tiles;
+        }
+    }
+}
+
+/* the direction and up vector of a tile, point lights in the order and with the up vectors of
+   the cube map faces, spot lights with the up vector of the shadows shader */
+static void tile_basis(const light_t* light, int face, hmm_vec3* forward, hmm_vec3* up) {
+    if (light->spot) {
+        *forward = light->direction;
+        *up = HMM_ABS(forward->Y) > .99f ? HMM_Vec3(0.f, 0.f, 1.f) : HMM_Vec3(0.f, 1.f, 0.f);
+        return;
+    }
+    const float s = (face % 2) ? -1.f : 1.f;
+    switch (face / 2) {
+        case 0:
+            *forward = HMM_Vec3(s, 0.f, 0.f);
+            *up = HMM_Vec3(0.f, -1.f, 0.f);
+            break;
+        case 1:
+            *forward = HMM_Vec3(0.f, s, 0.f);
+            *up = HMM_Vec3(0.f, 0.f, s);
+            break;
+        default:
+            *forward = HMM_Vec3(0.f, 0.f, s);
+            *up = HMM_Vec3(0.f, -1.f, 0.f);
+            break;
+    }
+}
+
+static void init(void) {
+    lopgl_setup();
+
+    if (sapp_gles2()) {
+        /* this demo needs GLES3/WebGL because we are indexing the tile array with values that aren't loop indices */
+        return;
+    }
+
+    state.shadow_format = lopgl_shadow_format();
+    const bool packed = state.shadow_format->packed;
+
+    lopgl_orbital_cam_desc_t orbital_desc = lopgl_get_orbital_cam_desc();
+    orbital_desc.distance = 30.f;
+    orbital_desc.pitch = 35.f;
+    lopgl_set_orbital_cam(&orbital_desc);
+
+    lopgl_init_shadow_atlas(&state.atlas, &(lopgl_shadow_atlas_desc_t){
+        .size = ATLAS_SIZE,
+        .min_tile_size = 32,
+        .max_tile_size = 512
+    });
+    state.size_by_importance = true;
+
+    init_cubes();
+    init_lights();
+
+    /* the page of the atlas with a color- and a depth-attachment image, allocated once */
+    sg_image_desc img_desc = {
+        .render_target = true,
+        .width = ATLAS_SIZE,
+        .height = ATLAS_SIZE,
+        .pixel_format = state.shadow_format->pixel_format,
+        .min_filter = SG_FILTER_NEAREST,
+        .mag_filter = SG_FILTER_NEAREST,
+        .wrap_u = SG_WRAP_CLAMP_TO_EDGE,
+        .wrap_v = SG_WRAP_CLAMP_TO_EDGE,
+        .sample_count = 1,
+        .label = "shadow-atlas-color-image"
+    };
+    sg_image color_img = sg_make_image(&img_desc);
+    img_desc.pixel_format = SG_PIXELFORMAT_DEPTH;
+    img_desc.label = "shadow-atlas-depth-image";
+    sg_image depth_img = sg_make_image(&img_desc);
+    state.depth.pass = sg_make_pass(&(sg_pass_desc){
+        .color_attachments[0].image = color_img,
+        .depth_stencil_attachment.image = depth_img,
+        .label = "shadow-atlas-pass"
+    });
+
+    // sokol and webgl 1 do not support using the depth map as texture map
+    // so instead we write the depth value to the color map
+    state.shadows.bind_cube.fs_images[SLOT_shadow_atlas] = color_img;
+    state.shadows.bind_plane.fs_images[SLOT_shadow_atlas] = color_img;
+    state.atlas_view.bind.fs_images[SLOT_atlas_view] = color_img;
+
+    float cube_vertices[] = {
+        // back face
+        -1.f, -1.f, -1.f,  0.f,  0.f, -1.f, 0.f, 0.f, // bottom-left
+         1.f,  1.f, -1.f,  0.f,  0.f, -1.f, 1.f, 1.f, // top-right
+         1.f, -1.f, -1.f,  0.f,  0.f, -1.f, 1.f, 0.f, // bottom-right
+         1.f,  1.f, -1.f,  0.f,  0.f, -1.f, 1.f, 1.f, // top-right
+        -1.f, -1.f, -1.f,  0.f,  0.f, -1.f, 0.f, 0.f, // bottom-left
+        -1.f,  1.f, -1.f,  0.f,  0.f, -1.f, 0.f, 1.f, // top-left
+        // front face
+        -1.f, -1.f,  1.f,  0.f,  0.f,  1.f, 0.f, 0.f, // bottom-left
+         1.f, -1.f,  1.f,  0.f,  0.f,  1.f, 1.f, 0.f, // bottom-right
+         1.f,  1.f,  1.f,  0.f,  0.f,  1.f, 1.f, 1.f, // top-right
+         1.f,  1.f,  1.f,  0.f,  0.f,  1.f, 1.f, 1.f, // top-right
+        -1.f,  1.f,  1.f,  0.f,  0.f,  1.f, 0.f, 1.f, // top-left
+        -1.f, -1.f,  1.f,  0.f,  0.f,  1.f, 0.f, 0.f, // bottom-left
+        // left face
+        -1.f,  1.f,  1.f, -1.f,  0.f,  0.f, 1.f, 0.f, // top-right
+        -1.f,  1.f, -1.f, -1.f,  0.f,  0.f, 1.f, 1.f, // top-left
+        -1.f, -1.f, -1.f, -1.f,  0.f,  0.f, 0.f, 1.f, // bottom-left
+        -1.f, -1.f, -1.f, -1.f,  0.f,  0.f, 0.f, 1.f, // bottom-left
+        -1.f, -1.f,  1.f, -1.f,  0.f,  0.f, 0.f, 0.f, // bottom-right
+        -1.f,  1.f,  1.f, -1.f,  0.f,  0.f, 1.f, 0.f, // top-right
+        // right face
+         1.f,  1.f,  1.f,  1.f,  0.f,  0.f, 1.f, 0.f, // top-left
+         1.f, -1.f, -1.f,  1.f,  0.f,  0.f, 0.f, 1.f, // bottom-right
+         1.f,  1.f, -1.f,  1.f,  0.f,  0.f, 1.f, 1.f, // top-right
+         1.f, -1.f, -1.f,  1.f,  0.f,  0.f, 0.f, 1.f, // bottom-right
+         1.f,  1.f,  1.f,  1.f,  0.f,  0.f, 1.f, 0.f, // top-left
+         1.f, -1.f,  1.f,  1.f,  0.f,  0.f, 0.f, 0.f, // bottom-left
+        // bottom face
+        -1.f, -1.f, -1.f,  0.f, -1.f,  0.f, 0.f, 1.f, // top-right
+         1.f, -1.f, -1.f,  0.f, -1.f,  0.f, 1.f, 1.f, // top-left
+         1.f, -1.f,  1.f,  0.f, -1.f,  0.f, 1.f, 0.f, // bottom-left
+         1.f, -1.f,  1.f,  0.f, -1.f,  0.f, 1.f, 0.f, // bottom-left
+        -1.f, -1.f,  1.f,  0.f, -1.f,  0.f, 0.f, 0.f, // bottom-right
+        -1.f, -1.f, -1.f,  0.f, -1.f,  0.f, 0.f, 1.f, // top-right
+        // top face
+        -1.f,  1.f, -1.f,  0.f,  1.f,  0.f, 0.f, 1.f, // top-left
+         1.f,  1.f , 1.f,  0.f,  1.f,  0.f, 1.f, 0.f, // bottom-right
+         1.f,  1.f, -1.f,  0.f,  1.f,  0.f, 1.f, 1.f, // top-right
+         1.f,  1.f,  1.f,  0.f,  1.f,  0.f, 1.f, 0.f, // bottom-right
+        -1.f,  1.f, -1.f,  0.f,  1.f,  0.f, 0.f, 1.f, // top-left
+        -1.f,  1.f,  1.f,  0.f,  1.f,  0.f, 0.f, 0.f  // bottom-left
+    };
+
+    sg_buffer cube_buffer = sg_make_buffer(&(sg_buffer_desc){
+        .size = sizeof(cube_vertices),
+        .content = cube_vertices,
+        .label = "cube-vertices"
+    });
+
+    state.depth.bind_cube.vertex_buffers[0] = cube_buffer;
+    state.shadows.bind_cube.vertex_buffers[0] = cube_buffer;
+
+    float plane_vertices[] = {
+        // positions         // normals      // texcoords
+         25.f, -.5f,  25.f,  0.f, 1.f, 0.f,  25.f,  0.f,
+        -25.f, -.5f,  25.f,  0.f, 1.f, 0.f,   0.f,  0.f,
+        -25.f, -.5f, -25.f,  0.f, 1.f, 0.f,   0.f, 25.f,
+
+         25.f, -.5f,  25.f,  0.f, 1.f, 0.f,  25.f,  0.f,
+        -25.f, -.5f, -25.f,  0.f, 1.f, 0.f,   0.f, 25.f,
+         25.f, -.5f, -25.f,  0.f, 1.f, 0.f,  25.f, 25.f
+    };
+
+    sg_buffer plane_buffer = sg_make_buffer(&(sg_buffer_desc){
+        .size = sizeof(plane_vertices),
+        .content = plane_vertices,
+        .label = "plane-vertices"
+    });
+
+    state.shadows.bind_plane.vertex_buffers[0] = plane_buffer;
+
+    float quad_vertices[] = {
+        -1.f, -1.f,
+         1.f, -1.f,
+        -1.f,  1.f,
+         1.f,  1.f
+    };
+
+    state.atlas_view.bind.vertex_buffers[0] = sg_make_buffer(&(sg_buffer_desc){
+        .size = sizeof(quad_vertices),
+        .content = quad_vertices,
+        .label = "atlas-view-vertices"
+    });
+
+    sg_shader shd_depth = sg_make_shader(packed ? depth_shader_desc() : depth_float_shader_desc());
+
+    state.depth.pip = sg_make_pipeline(&(sg_pipeline_desc){
+        .shader = shd_depth,
+        .layout = {
+            /* Buffer's normal and texture coords are skipped */
+            .buffers[0].stride = 8 * sizeof(float),
+            .attrs = {
+                [ATTR_vs_depth_a_pos].format = SG_VERTEXFORMAT_FLOAT3,
+            }
+        },
+        .depth_stencil = {
+            .depth_compare_func = SG_COMPAREFUNC_LESS_EQUAL,
+            .depth_write_enabled = true,
+        },
+        /* cull front faces for depth map */
+        .rasterizer = {
+            .cull_mode = SG_CULLMODE_FRONT,
+            .face_winding = SG_FACEWINDING_CCW
+        },
+        .blend = {
+            .color_format = state.shadow_format->pixel_format,
+            .depth_format = SG_PIXELFORMAT_DEPTH
+        },
+        .label = "depth-pipeline"
+    });
+
+    sg_shader shd_shadows = sg_make_shader(packed ? shadows_shader_desc() : shadows_float_shader_desc());
+
+    state.shadows.pip = sg_make_pipeline(&(sg_pipeline_desc){
+        .shader = shd_shadows,
+        .layout = {
+            .attrs = {
+                [ATTR_vs_shadows_a_pos].format = SG_VERTEXFORMAT_FLOAT3,
+                [ATTR_vs_shadows_a_normal].format = SG_VERTEXFORMAT_FLOAT3,
+                [ATTR_vs_shadows_a_tex_coords].format = SG_VERTEXFORMAT_FLOAT2
+            }
+        },
+        .depth_stencil = {
+            .depth_compare_func = SG_COMPAREFUNC_LESS_EQUAL,
+            .depth_write_enabled = true,
+        },
+        .label = "shadows-pipeline"
+    });
+
+    sg_shader shd_atlas = sg_make_shader(packed ? atlas_shader_desc() : atlas_float_shader_desc());
+
+    state.atlas_view.pip = sg_make_pipeline(&(sg_pipeline_desc){
+        .shader = shd_atlas,
+        .primitive_type = SG_PRIMITIVETYPE_TRIANGLE_STRIP,
+        .layout = {
+            .attrs = {
+                [ATTR_vs_atlas_a_pos].format = SG_VERTEXFORMAT_FLOAT2
+            }
+        },
+        .label = "atlas-view-pipeline"
+    });
+
+    /* the page is cleared once, the tiles that aren't used this frame stay at the far plane */
+    state.depth.pass_action = (sg_pass_action) {
+        .colors[0] = { .action=SG_ACTION_CLEAR, .val={1.f, 1.f, 1.f, 1.0f} }
+    };
+
+    state.shadows.pass_action = (sg_pass_action) {
+        .colors[0] = { .action=SG_ACTION_CLEAR, .val={0.1f, 0.1f, 0.1f, 1.0f} }
+    };
+
+    sg_image img_id_diffuse = sg_alloc_image();
+    state.shadows.bind_cube.fs_images[SLOT_diffuse_texture] = img_id_diffuse;
+    state.shadows.bind_plane.fs_images[SLOT_diffuse_texture] = img_id_diffuse;
+
+    lopgl_load_image(&(lopgl_image_request_t){
+            .path = "wood.png",
+            .img_id = img_id_diffuse,
+            .buffer_ptr = state.file_buffer,
+            .buffer_size = sizeof(state.file_buffer),
+            .fail_callback = fail_callback
+    });
+}
+
+/* draws the casters in the frustum of one tile */
+static void draw_tile(const light_t* light, int face) {
+    hmm_vec3 forward, up;
+    tile_basis(light, face, &forward, &up);
+    const hmm_vec3 side = HMM_NormalizeVec3(HMM_Cross(forward, up));
+    const hmm_vec3 tile_up = HMM_Cross(side, forward);
+
+    const hmm_mat4 light_projection = HMM_Perspective(light->fov, 1.f, SHADOW_NEAR, light->range);
+    const hmm_mat4 light_view = HMM_LookAt(light->position, HMM_AddVec3(light->position, forward), up);
+    vs_params_depth_t vs_params = {
+        .light_space_matrix = HMM_MultiplyMat4(light_projection, light_view)
+    };
+
+    for (int i = 0; i < NUM_CUBES; ++i) {
+        const hmm_vec3 d = HMM_SubtractVec3(state.cube_centers[i], light->position);
+        if (!sphere_in_frustum(HMM_DotVec3(side, d), HMM_DotVec3(tile_up, d), HMM_DotVec3(forward, d),
+                               state.cube_radii[i], light->tan_half, light->tan_half, light->range)) {
+            continue;
+        }
+        vs_params.model = state.cube_models[i];
+        sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params_depth, &vs_params, sizeof(vs_params));
+        sg_draw(0, 36, 1);
+        ++state.caster_draws;
+    }
+}
+
+static void render_ui() {
+    const lopgl_shadow_atlas_stats_t* stats = &state.atlas.stats;
+    const double mb = 1.0 / (1024.0 * 1024.0);
+    const int texel_bytes = state.shadow_format->texel_bytes + DEPTH_TEXEL_BYTES;
+    const double atlas_texels = (double)ATLAS_SIZE * ATLAS_SIZE;
+    int in_view = 0;
+    int shadowed = 0;
+    int single_maps = 0;
+    for (int i = 0; i < NUM_LIGHTS; ++i) {
+        in_view += state.lights[i].importance > 0.f ? 1 : 0;
+        shadowed += state.lights[i].first_tile >= 0 ? 1 : 0;
+        single_maps += state.lights[i].num_tiles;
+    }
+
+    sdtx_canvas(sapp_width()*0.5f, sapp_height()*0.5f);
+    sdtx_origin(sapp_width()*0.5f/8.f - 24.f, 0.25f);       // each character occupies a grid fo 8x8
+    sdtx_home();
+
+    sdtx_color4b(0xff, 0x00, 0x00, 0xaf);
+    sdtx_printf("Lights:\t%d spot, %d point\n", NUM_SPOT_LIGHTS, NUM_POINT_LIGHTS);
+    sdtx_printf("In view:\t%d\n", in_view);
+    sdtx_printf("Shadowed:\t%d\n", shadowed);
+    sdtx_printf("Shrunk:\t%d\n", stats->shrunk);
+    sdtx_printf("No tile:\t%d\n", stats->failed);
+    sdtx_printf("Sizes:\t%s\n", state.size_by_importance ? "importance" : "largest");
+    sdtx_printf("\nAtlas:\t%dx%d\n", ATLAS_SIZE, ATLAS_SIZE);
+    sdtx_printf("Memory:\t%.0f MB\n", atlas_texels * texel_bytes * mb);
+    sdtx_printf("Used:\t%.0f%%\n", 100.0 * stats->used_texels / atlas_texels);
+    sdtx_printf("Tiles:\t%d\n", stats->tiles);
+    sdtx_printf("Passes:\t1\n");
+    sdtx_printf("Casters:\t%d draws\n", state.caster_draws);
+    sdtx_printf("Alloc:\t%.3f ms\n", state.alloc_ms);
+    sdtx_printf("\nOwn maps:\t%d of %dx%d\n", single_maps, SINGLE_MAP_SIZE, SINGLE_MAP_SIZE);
+    sdtx_printf("Memory:\t%.0f MB\n\n", (double)single_maps * SINGLE_MAP_SIZE * SINGLE_MAP_SIZE * texel_bytes * mb);
+    lopgl_print_shadow_formats(state.shadow_format, atlas_texels, SHADOW_LOOKUPS);
+    sdtx_puts("\nSizes:\t\t'SPACE'\n");
+    sdtx_puts("Show atlas:\t'V'");
+    sdtx_draw();
+}
+
+void frame(void) {
+    /* can't do anything useful on GLES2/WebGL */
+    if (sapp_gles2()) {
+        lopgl_render_gles2_fallback();
+        return;
+    }
+
+    lopgl_update();
+
+    const float aspect = (float)sapp_width() / (float)sapp_height();
+    hmm_mat4 view = lopgl_view_matrix();
+    hmm_mat4 projection = HMM_Perspective(lopgl_fov(), aspect, 0.1f, 100.0f);
+
+    update_lights((float)stm_sec(stm_now()));
+
+    const uint64_t start = stm_now();
+    const float tan_half_fov = HMM_TanF(HMM_ToRadians(lopgl_fov() * .5f));
+    for (int i = 0; i < NUM_LIGHTS; ++i) {
+        state.lights[i].importance = light_importance(&state.lights[i], view, tan_half_fov, aspect);
+    }
+    allocate_tiles();
+    state.alloc_ms = stm_ms(stm_since(start));
+
+    /* 1. render depth of scene to the tiles of all lights (from light's perspective) in one pass */
+    sg_begin_pass(state.depth.pass, &state.depth.pass_action);
+    sg_apply_pipeline(state.depth.pip);
+    sg_apply_bindings(&state.depth.bind_cube);
+    state.caster_draws = 0;
+    for (int i = 0; i < NUM_LIGHTS; ++i) {
+        const light_t* light = &state.lights[i];
+        if (light->first_tile < 0) {
+            continue;
+        }
+        fs_params_depth_t fs_params_depth = {
+            .light_pos = light->position,
+            .light_range = light->range
+        };
+        sg_apply_uniforms(SG_SHADERSTAGE_FS, SLOT_fs_params_depth, &fs_params_depth, sizeof(fs_params_depth));
+        for (int face = 0; face < light->num_tiles; ++face) {
+            const lopgl_shadow_tile_t* tile = &state.tiles[light->first_tile + face];
+            /* the scissor rect keeps everything drawn inside the tile */
+            sg_apply_viewport(tile->x, tile->y, tile->size, tile->size, false);
+            sg_apply_scissor_rect(tile->x, tile->y, tile->size, tile->size, false);
+            draw_tile(light, face);
+        }
+    }
+    sg_end_pass();
+
+    /* 2. render scene as normal using the tiles of the atlas */
+    sg_begin_default_pass(&state.shadows.pass_action, sapp_width(), sapp_height());
+    sg_apply_pipeline(state.shadows.pip);
+
+    fs_params_shadows_t fs_params_shadows = {
+        .view_pos = lopgl_camera_position(),
+        .num_lights = (float)NUM_LIGHTS
+    };
+    for (int i = 0; i < NUM_LIGHTS; ++i) {
+        const light_t* light = &state.lights[i];
+        fs_params_shadows.light_positions[i] = HMM_Vec4v(light->position, light->range);
+        fs_params_shadows.light_directions[i] = HMM_Vec4v(light->direction, light->spot ? light->tan_half : 0.f);
+        fs_params_shadows.light_colors[i] = HMM_Vec4v(light->color, (float)light->first_tile);
+    }
+    for (int i = 0; i < state.num_tiles; ++i) {
+        const lopgl_shadow_tile_t* tile = &state.tiles[i];
+        fs_params_shadows.tiles[i] = HMM_Vec4((float)tile->x / ATLAS_SIZE, (float)tile->y / ATLAS_SIZE,
+                                              (float)tile->size / ATLAS_SIZE, .5f / (float)tile->size);
+    }
+
+    sg_apply_uniforms(SG_SHADERSTAGE_FS, SLOT_fs_params_shadows, &fs_params_shadows, sizeof(fs_params_shadows));
+
+    vs_params_shadows_t vs_params_shadows = {
+        .projection = projection,
+        .view = view,
+        .model = HMM_Mat4d(1.f)
+    };
+
+    /* plane */
+    sg_apply_bindings(&state.shadows.bind_plane);
+    sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params_shadows, &vs_params_shadows, sizeof(vs_params_shadows));
+    sg_draw(0, 6, 1);
+
+    /* cubes */
+    sg_apply_bindings(&state.shadows.bind_cube);
+    for (int i = 0; i < NUM_CUBES; ++i) {
+        vs_params_shadows.model = state.cube_models[i];
+        sg_apply_uniforms(SG_SHADERSTAGE_VS, SLOT_vs_params_shadows, &vs_params_shadows, sizeof(vs_params_shadows));
+        sg_draw(0, 36, 1);
+    }
+
+    /* the atlas page in the lower right corner */
+    if (state.show_atlas) {
+        const int size = sapp_height() / 3;
+        sg_apply_viewport(sapp_width() - size, 0, size, size, false);
+        sg_apply_pipeline(state.atlas_view.pip);
+        sg_apply_bindings(&state.atlas_view.bind);
+        sg_draw(0, 4, 1);
+        sg_apply_viewport(0, 0, sapp_width(), sapp_height(), false);
+    }
+
+    lopgl_render_help();
+
+    if (lopgl_ui_visible()) {
+        render_ui();
+    }
+
+    sg_end_pass();
+    sg_commit();
+}
+
+void event(const sapp_event* e) {
+    lopgl_handle_input(e);
+
+    if (e->type == SAPP_EVENTTYPE_KEY_DOWN) {
+        if (e->key_code == SAPP_KEYCODE_SPACE) {
+            state.size_by_importance = !state.size_by_importance;
+        }
+        else if (e->key_code == SAPP_KEYCODE_V) {
+            state.show_atlas = !state.show_atlas;
+        }
+    }
+}
+
+void cleanup(void) {
+    lopgl_shutdown();
+}
+
+sapp_desc sokol_main(int argc, char* argv[]) {
+    return (sapp_desc){
+        .init_cb = init,
+        .frame_cb = frame,
+        .cleanup_cb = cleanup,
+        .event_cb = event,
+        .width = 800,
+        .height = 600,
+        .window_title = "Shadow Atlas (LearnOpenGL)",
+    };
+}
@@ -0,0 +1,276 @@
+//------------------------------------------------------------------------------
+//  float/rgba8 encoding/decoding so that we can use an RGBA8
+//  shadow map instead of floating point render targets which might
+//  not be supported everywhere
+//
+//  http://aras-p.info/blog/2009/07/30/encoding-floats-to-rgba-the-final/
+//
+//  The programs with the _float suffix define FLOAT_DEPTH and are used where
+//  floating point render targets are supported, without the packing.
+//
+
+@ctype vec2 hmm_vec2
+@ctype vec3 hmm_vec3
+@ctype vec4 hmm_vec4
+@ctype mat4 hmm_mat4
+
+@block depth_packing
+#ifdef FLOAT_DEPTH
+// the float render target holds the depth as it is
+vec4 encodeDepth(float v) {
+    return vec4(v, 0.0, 0.0, 1.0);
+}
+
+float decodeDepth(vec4 rgba) {
+    return rgba.r;
+}
+#else
+vec4 encodeDepth(float v) {
+    vec4 enc = vec4(1.0, 255.0, 65025.0, 16581375.0) * v;
+    enc = fract(enc);
+    enc -= enc.yzww * vec4(1.0/255.0,1.0/255.0,1.0/255.0,0.0);
+    return enc;
+}
+
+float decodeDepth(vec4 rgba) {
+    return dot(rgba, vec4(1.0, 1.0/255.0, 1.0/65025.0, 1.0/16581375.0));
+}
+#endif
+@end
+
+@vs vs_depth
+in vec3 a_pos;
+out vec3 frag_pos;
+
+uniform vs_params_depth {
+    mat4 light_space_matrix;
+    mat4 model;
+};
+
+void main() {
+    frag_pos = vec3(model * vec4(a_pos, 1.0));
+    gl_Position = light_space_matrix * vec4(frag_pos, 1.0);
+}
+@end
+
+@block fs_depth_body
+@include_block depth_packing
+in vec3 frag_pos;
+out vec4 frag_color;
+
+uniform fs_params_depth {
+    vec3 light_pos;
+    float light_range;
+};
+
+void main() {
+    // the distance to the light for spot lights as well as for the faces of point lights,
+    // so that every tile of the atlas is looked up the same way
+    // sokol and webgl 1 do not support using the depth map as texture
+    // so instead we write the depth value to the color map
+    frag_color = encodeDepth(length(frag_pos - light_pos) / light_range);
+}
+@end
+
+@fs fs_depth
+@include_block fs_depth_body
+@end
+
+@fs fs_depth_float
+#define FLOAT_DEPTH
+@include_block fs_depth_body
+@end
+
+@vs vs_shadows
+in vec3 a_pos;
+in vec3 a_normal;
+in vec2 a_tex_coords;
+
+out INTERFACE {
+    vec3 frag_pos;
+    vec3 normal;
+    vec2 tex_coords;
+} inter;
+
+uniform vs_params_shadows {
+    mat4 projection;
+    mat4 view;
+    mat4 model;
+};
+
+void main() {
+    inter.frag_pos = vec3(model * vec4(a_pos, 1.0));
+    // inverse tranpose is left out because:
+    // (a) glsl es 1.0 (webgl 1.0) doesn't have inverse and transpose functions
+    // (b) we're not performing non-uniform scale
+    inter.normal = mat3(model) * a_normal;
+    inter.tex_coords = a_tex_coords;
+    gl_Position = projection * view * model * vec4(a_pos, 1.0);
+}
+@end
+
+@block fs_shadows_body
+@include_block depth_packing
+in INTERFACE {
+    vec3 frag_pos;
+    vec3 normal;
+    vec2 tex_coords;
+} inter;
+
+out vec4 frag_color;
+
+uniform sampler2D diffuse_texture;
+uniform sampler2D shadow_atlas;
+
+// using arrays of vec4 to avoid alignment issues with cross shader compilation
+// the arrays are indexed with values that aren't loop indices, which needs glsl es 3.0
+uniform fs_params_shadows {
+    vec3 view_pos;
+    float num_lights;
+    // position and range
+    vec4 light_positions[32];
+    // direction and tangent of half the cone of spot lights, the tangent is 0.0 for point lights
+    vec4 light_directions[32];
+    // color and the first tile of the light, -1.0 for lights without a shadow
+    vec4 light_colors[32];
+    // offset and size in the atlas and half a texel of the tile, one tile per spot light
+    // and six per point light in the order of the cube map faces
+    vec4 tiles[72];
+};
+
+float shadowCalculation(vec3 light_to_frag, vec4 direction, float first_tile, float range, float n_dot_l) {
+    vec3 forward;
+    vec3 up;
+    float tan_half;
+    float tile_index = first_tile;
+    if (direction.w > 0.0) {
+        // the up vector the spot light is rendered with
+        forward = direction.xyz;
+        up = abs(forward.y) > 0.99 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+        tan_half = direction.w;
+    }
+    else {
+        // the face of the major axis, with the up vectors of the faces of a cube map
+        vec3 a = abs(light_to_frag);
+        if (a.x >= a.y && a.x >= a.z) {
+            forward = vec3(sign(light_to_frag.x), 0.0, 0.0);
+            up = vec3(0.0, -1.0, 0.0);
+            tile_index += light_to_frag.x > 0.0 ? 0.0 : 1.0;
+        }
+        else if (a.y >= a.z) {
+            forward = vec3(0.0, sign(light_to_frag.y), 0.0);
+            up = vec3(0.0, 0.0, forward.y);
+            tile_index += light_to_frag.y > 0.0 ? 2.0 : 3.0;
+        }
+        else {
+            forward = vec3(0.0, 0.0, sign(light_to_frag.z));
+            up = vec3(0.0, -1.0, 0.0);
+            tile_index += light_to_frag.z > 0.0 ? 4.0 : 5.0;
+        }
+        tan_half = 1.0;
+    }
+    // the projection of the tile, as HMM_LookAt and HMM_Perspective build it
+    vec3 side = normalize(cross(forward, up));
+    vec3 tile_up = cross(side, forward);
+    float depth = dot(forward, light_to_frag);
+    vec2 uv = vec2(dot(side, light_to_frag), dot(tile_up, light_to_frag)) / (tan_half * depth) * 0.5 + 0.5;
+    vec4 tile = tiles[int(tile_index)];
+    // stay half a texel inside the tile so that the neighbours are never sampled
+    uv = clamp(uv, tile.w, 1.0 - tile.w);
+    float closest_depth = decodeDepth(texture(shadow_atlas, tile.xy + uv * tile.z));
+    // one and a half texels at the distance of the fragment, tile.w is 0.5 / texels of the tile
+    float distance = length(light_to_frag);
+    float bias = 6.0 * distance * tan_half * tile.w * (1.0 + 2.0 * (1.0 - n_dot_l));
+    return (distance - bias) / range > closest_depth ? 1.0 : 0.0;
+}
+
+void main() {
+    vec3 color = texture(diffuse_texture, inter.tex_coords).rgb;
+    vec3 normal = normalize(inter.normal);
+    vec3 view_dir = normalize(view_pos - inter.frag_pos);
+    // ambient
+    vec3 lighting = 0.1 * color;
+    for (int i = 0; i < 32; ++i) {
+        if (float(i) >= num_lights)
+            break;
+        vec4 position = light_positions[i];
+        vec4 direction = light_directions[i];
+        vec4 light_color = light_colors[i];
+        vec3 to_light = position.xyz - inter.frag_pos;
+        float distance = length(to_light);
+        if (distance >= position.w)
+            continue;
+        to_light /= distance;
+        // attenuation to 0.0 at the range of the light
+        float attenuation = (1.0 - distance / position.w) * (1.0 - distance / position.w);
+        if (direction.w > 0.0) {
+            // soft edge inside the cone
+            float cos_outer = inversesqrt(1.0 + direction.w * direction.w);
+            attenuation *= smoothstep(cos_outer, mix(cos_outer, 1.0, 0.2), dot(-to_light, direction.xyz));
+        }
+        float n_dot_l = dot(to_light, normal);
+        if (attenuation <= 0.0 || n_dot_l <= 0.0)
+            continue;
+        // diffuse
+        float diff = n_dot_l;
+        // specular
+        vec3 halfway_dir = normalize(to_light + view_dir);
+        float spec = pow(max(dot(normal, halfway_dir), 0.0), 64.0);
+        // calculate shadow
+        float shadow = 0.0;
+        if (light_color.w >= 0.0)
+            shadow = shadowCalculation(-to_light * distance, direction, light_color.w, position.w, n_dot_l);
+        lighting += (1.0 - shadow) * attenuation * (diff + spec) * light_color.rgb * color;
+    }
+
+    frag_color = vec4(lighting, 1.0);
+}
+@end
+
+@fs fs_shadows
+@include_block fs_shadows_body
+@end
+
+@fs fs_shadows_float
+#define FLOAT_DEPTH
+@include_block fs_shadows_body
+@end
+
+@vs vs_atlas
+in vec2 a_pos;
+out vec2 tex_coords;
+
+void main() {
+    gl_Position = vec4(a_pos, 0.0, 1.0);
+    tex_coords = a_pos * 0.5 + 0.5;
+}
+@end
+
+@block fs_atlas_body
+@include_block depth_packing
+in vec2 tex_coords;
+out vec4 frag_color;
+
+uniform sampler2D atlas_view;
+
+void main() {
+    // the cleared texels stay white
+    frag_color = vec4(vec3(decodeDepth(texture(atlas_view, tex_coords))), 1.0);
+}
+@end
+
+@fs fs_atlas
+@include_block fs_atlas_body
+@end
+
+@fs fs_atlas_float
+#define FLOAT_DEPTH
+@include_block fs_atlas_body
+@end
+
+@program depth vs_depth fs_depth
+@program depth_float vs_depth fs_depth_float
+@program shadows vs_shadows fs_shadows
+@program shadows_float vs_shadows fs_shadows_float
+@program atlas vs_atlas fs_atlas
+@program atlas_float vs_atlas fs_atlas_float
@@ -42,7 +42,7 @@ uniform fs_params {
 };
 
 uniform sampler2D diffuse_map;
-uniform sampler2D normal_map;
+uniform sampler2D normal_map;           // RG8, tangent space x and y in .rg
 
 void main() {           
     vec3 color = texture(diffuse_map, inter.tex_coords).rgb;
@@ -51,9 +51,10 @@ void main() {
     // diffuse
     vec3 light_dir = normalize(light_pos - inter.frag_pos);
     // obtain normal from normal map in range [0,1]
-    vec3 normal = texture(normal_map, inter.tex_coords).rgb;
-    // transform normal vector to range [-1,1]
-    normal = normalize(normal * 2.0 - 1.0);
+    vec2 normal_xy = texture(normal_map, inter.tex_coords).rg;
+    // transform normal vector to range [-1,1] and reconstruct z
+    normal_xy = normal_xy * 2.0 - 1.0;
+    vec3 normal = vec3(normal_xy, sqrt(max(1.0 - dot(normal_xy, normal_xy), 0.0)));
     normal = normal_mapping == 1.0 ? normal : normalize(inter.normal);
     float diff = max(dot(light_dir, normal), 0.0);
     vec3 diffuse = diff * color;
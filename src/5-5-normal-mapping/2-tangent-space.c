@@ -119,6 +119,7 @@ static void init(void) {
 
     lopgl_load_image(&(lopgl_image_request_t){
             .path = "brickwall_normal.jpg",
+            .channels = 2,
             .img_id = img_id_normal,
             .buffer_ptr = state.file_buffer,
             .buffer_size = sizeof(state.file_buffer),
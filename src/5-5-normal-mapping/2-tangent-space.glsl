@@ -68,13 +68,14 @@ in INTERFACE {
 out vec4 frag_color;
 
 uniform sampler2D diffuse_map;
-uniform sampler2D normal_map;
+uniform sampler2D normal_map;           // RG8, tangent space x and y in .rg
 
 void main() {           
     // obtain normal from normal map in range [0,1]
-    vec3 normal = texture(normal_map, inter.tex_coords).rgb;
-    // transform normal vector to range [-1,1]
-    normal = normalize(normal * 2.0 - 1.0);  // this normal is in tangent space
+    vec2 normal_xy = texture(normal_map, inter.tex_coords).rg;
+    // transform normal vector to range [-1,1] and reconstruct z
+    normal_xy = normal_xy * 2.0 - 1.0;
+    vec3 normal = vec3(normal_xy, sqrt(max(1.0 - dot(normal_xy, normal_xy), 0.0)));  // this normal is in tangent space
    
     // get diffuse color
     vec3 color = texture(diffuse_map, inter.tex_coords).rgb;
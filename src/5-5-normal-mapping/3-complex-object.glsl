@@ -107,8 +107,8 @@ uniform fs_point_lights {
 } point_lights;
 
 uniform sampler2D diffuse_map;
-uniform sampler2D specular_map;
-uniform sampler2D normal_map;
+uniform sampler2D specular_map;         // R8, gray in .r
+uniform sampler2D normal_map;           // RG8, tangent space x and y in .rg
 
 struct dir_light_t {
     vec3 direction;
@@ -165,7 +165,7 @@ vec3 calc_dir_light(dir_light_t light, vec3 normal, vec3 view_dir) {
     // combine results
     vec3 ambient  = light.ambient  * vec3(texture(diffuse_map, inter.tex_coords));
     vec3 diffuse  = light.diffuse  * diff * vec3(texture(diffuse_map, inter.tex_coords));
-    vec3 specular = light.specular * spec * vec3(texture(specular_map, inter.tex_coords));
+    vec3 specular = light.specular * spec * vec3(texture(specular_map, inter.tex_coords).r);
     return (ambient + diffuse + specular);
 }
 
@@ -184,7 +184,7 @@ vec3 calc_point_light(point_light_t light, vec3 normal, vec3 frag_pos, vec3 view
     // combine results
     vec3 ambient  = light.ambient  * vec3(texture(diffuse_map, inter.tex_coords));
     vec3 diffuse  = light.diffuse  * diff * vec3(texture(diffuse_map, inter.tex_coords));
-    vec3 specular = light.specular * spec * vec3(texture(specular_map, inter.tex_coords));
+    vec3 specular = light.specular * spec * vec3(texture(specular_map, inter.tex_coords).r);
     ambient  *= attenuation;
     diffuse  *= attenuation;
     specular *= attenuation;
@@ -193,9 +193,10 @@ vec3 calc_point_light(point_light_t light, vec3 normal, vec3 frag_pos, vec3 view
 
 void main() {           
     // obtain normal from normal map in range [0,1]
-    vec3 normal = texture(normal_map, inter.tex_coords).rgb;
-    // transform normal vector to range [-1,1]
-    normal = normalize(normal * 2.0 - 1.0);
+    vec2 normal_xy = texture(normal_map, inter.tex_coords).rg;
+    // transform normal vector to range [-1,1] and reconstruct z
+    normal_xy = normal_xy * 2.0 - 1.0;
+    vec3 normal = vec3(normal_xy, sqrt(max(1.0 - dot(normal_xy, normal_xy), 0.0)));
     // set normal to Z+ if normal mapping is disabled
     normal = normal_mapping == 1.0 ? normal : vec3(0.0, 0.0, 1.0);
     vec3 view_dir = normalize(inter.tangent_view_pos - inter.tangent_frag_pos);
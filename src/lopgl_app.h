@@ -62,6 +62,28 @@ typedef struct lopgl_obj_response_t {
 
 typedef void(*lopgl_obj_request_callback_t)(lopgl_obj_response_t*);
 
+/* work item function signature, the user data is memcpy'd into the work queue
+   and can be modified by the work item to store progress between calls,
+   return true when the work item is finished or false to be resumed next frame */
+typedef bool(*lopgl_work_func_t)(void* user_data);
+
+/* maximum size of the user data block passed to lopgl_queue_work() */
+#define LOPGL_MAX_WORK_DATA_SIZE 128
+
+/* frame time histogram collected while assets are loading */
+#define LOPGL_LOAD_HISTOGRAM_BUCKETS 7
+
+typedef struct lopgl_load_stats_t {
+    uint32_t frame_count;                               /* number of frames that were spent loading */
+    uint32_t histogram[LOPGL_LOAD_HISTOGRAM_BUCKETS];   /* frame counts per bucket, see lopgl_load_histogram_bucket_ms() */
+    double max_frame_ms;
+    uint64_t bytes_mapped;                              /* bytes loaded through lopgl_map_file() */
+    uint64_t texture_bytes;                             /* gpu memory of the loaded images */
+    uint64_t texture_bytes_saved;                       /* compared to loading all images as RGBA8 */
+    int pending_fetches;
+    int pending_work;
+} lopgl_load_stats_t;
+
 /* request parameters passed to lopgl_load_image() */
 typedef struct lopgl_image_request_t {
     uint32_t _start_canary;
@@ -69,12 +91,17 @@ typedef struct lopgl_image_request_t {
     sg_image img_id;
     sg_wrap wrap_u;
     sg_wrap wrap_v;
+    int channels;                           /* channels read by the sampling shaders, see below (optional) */
     void* buffer_ptr;                       /* buffer pointer where data will be loaded into */
     uint32_t buffer_size;                   /* buffer size in number of bytes */
     lopgl_fail_callback_t fail_callback;    /* response callback function pointer (required) */
     uint32_t _end_canary;
 } lopgl_image_request_t;
 
+/* Images are uploaded as RGBA8 by default. When the sampling shaders only read
+   .r or .rg, set channels to 1 or 2 to upload the first channels as R8 or RG8,
+   which falls back to RGBA8 when the backend can't sample these formats. */
+
 /* request parameters passed to sfetch_send() */
 typedef struct lopgl_obj_request_t {
     uint32_t _start_canary;
@@ -102,6 +129,218 @@ typedef struct lopgl_cubemap_request_t {
     uint32_t _end_canary;
 } lopgl_cubemap_request_t;
 
+/* handle to an asset requested with lopgl_request_asset(), or a group of assets */
+typedef struct lopgl_asset_handle { uint32_t id; } lopgl_asset_handle;
+
+typedef enum lopgl_asset_state {
+    LOPGL_ASSET_INVALID,
+    LOPGL_ASSET_PENDING,
+    LOPGL_ASSET_READY,
+    LOPGL_ASSET_FAILED
+} lopgl_asset_state;
+
+typedef enum lopgl_asset_type {
+    LOPGL_ASSETTYPE_IMAGE,
+    LOPGL_ASSETTYPE_OBJ,
+    LOPGL_ASSETTYPE_GROUP
+} lopgl_asset_type;
+
+/* request parameters passed to lopgl_request_asset() */
+typedef struct lopgl_asset_desc_t {
+    lopgl_asset_type type;                  /* LOPGL_ASSETTYPE_IMAGE or LOPGL_ASSETTYPE_OBJ (required) */
+    const char* path;                       /* filesystem path or HTTP URL (required) */
+    sg_wrap wrap_u;                         /* image wrap modes (optional) */
+    sg_wrap wrap_v;
+    int channels;                           /* channels read by the sampling shaders, see lopgl_image_request_t (optional) */
+    bool stream;                            /* upload the smallest mip levels first and stream in the rest (optional) */
+} lopgl_asset_desc_t;
+
+/* residency of a streamed image, see lopgl_asset_desc_t.stream */
+typedef struct lopgl_stream_stats_t {
+    int width;                              /* size of the full resolution mip level */
+    int height;
+    int num_levels;
+    int channels;                           /* bytes per texel of the pixel format */
+    int resident_level;                     /* most detailed mip level on the gpu, 0 once fully resident, see lopgl_set_stream_budget() */
+    uint32_t resident_bytes;                /* gpu memory of the resident mip levels */
+    uint32_t total_bytes;                   /* gpu memory of the full mip chain */
+    uint32_t uploaded_bytes;                /* includes lower levels that are uploaded again on each promotion */
+    uint32_t max_frame_bytes;               /* largest step, uploaded in a single frame, at most the stream budget */
+    int stream_frames;                      /* frames it took to become fully resident, or to stop streaming */
+} lopgl_stream_stats_t;
+
+/* maximum number of assets and groups that can be alive at the same time */
+#define LOPGL_MAX_ASSETS 1024
+/* maximum number of handles referenced by all groups together */
+#define LOPGL_MAX_GROUP_HANDLES 4096
+/* size of the shared io buffer used for asset requests, the largest file has to fit */
+#ifndef LOPGL_ASSET_BUFFER_SIZE
+#define LOPGL_ASSET_BUFFER_SIZE (16 * 1024 * 1024)
+#endif
+/* streamed images start out with all mip levels up to this size resident */
+#define LOPGL_STREAM_BASE_SIZE 64
+/* default number of bytes streamed images may upload per frame, fits the mip chain of a 1024x1024 RGBA8 image */
+#define LOPGL_DEFAULT_STREAM_BUDGET (8 * 1024 * 1024)
+
+/* read-only view of a memory-mapped file */
+typedef struct lopgl_file_view_t {
+    const void* ptr;
+    size_t size;
+} lopgl_file_view_t;
+
+/* Native builds map files instead of reading them through sokol-fetch, which saves
+   copying the file into an intermediate buffer. Define LOPGL_NO_MMAP to opt out. */
+#if !defined(LOPGL_NO_MMAP) && !defined(__EMSCRIPTEN__) && (defined(__unix__) || defined(__APPLE__))
+#define LOPGL_USE_MMAP
+#endif
+
+/* initial size of a stream buffer when lopgl_stream_buffer_desc_t.size is 0 */
+#define LOPGL_DEFAULT_STREAM_BUFFER_SIZE (1024 * 1024)
+/* buffers replaced by growing are kept until the next frame, when they are no longer bound */
+#define LOPGL_MAX_RETIRED_STREAM_BUFFERS 8
+
+typedef struct lopgl_stream_buffer_desc_t {
+    int size;                               /* initial size in bytes (optional) */
+    sg_buffer_type type;                    /* vertex buffer by default */
+    const char* label;
+} lopgl_stream_buffer_desc_t;
+
+/* SG_USAGE_STREAM buffer that is appended to in chunks, see lopgl_append_stream_buffer() */
+typedef struct lopgl_stream_buffer_t {
+    sg_buffer buffer;                       /* receives the next append, replaced when growing */
+    int size;
+    int used;                               /* bytes appended in the frame of the last append */
+    int grow_count;
+    sg_buffer_type type;
+    const char* label;
+    uint32_t _frame_index;
+    int _num_retired;
+    sg_buffer _retired[LOPGL_MAX_RETIRED_STREAM_BUFFERS];
+} lopgl_stream_buffer_t;
+
+/* where an append ended up, goes into vertex_buffer_offsets or index_buffer_offset of sg_bindings */
+typedef struct lopgl_stream_range_t {
+    sg_buffer buffer;
+    int offset;
+} lopgl_stream_range_t;
+
+/* maximum number of draws queued before lopgl_queue_draw() flushes on its own */
+#ifndef LOPGL_MAX_QUEUED_DRAWS
+#define LOPGL_MAX_QUEUED_DRAWS (64 * 1024)
+#endif
+/* initial size of the per-instance stream buffer, also the most instance data a single flush stages */
+#ifndef LOPGL_INSTANCE_BUFFER_SIZE
+#define LOPGL_INSTANCE_BUFFER_SIZE (4 * 1024 * 1024)
+#endif
+/* maximum size of the uniform blocks of a draw material */
+#define LOPGL_MAX_DRAW_UNIFORMS_SIZE 256
+/* number of passes queued draws are ordered by, see lopgl_draw_material_t.pass */
+#define LOPGL_MAX_DRAW_PASSES 16
+
+/* geometry of a queued draw */
+typedef struct lopgl_draw_mesh_t {
+    sg_bindings bind;
+    int base_element;
+    int num_elements;
+} lopgl_draw_mesh_t;
+
+/* pipelines and uniforms of a queued draw, the uniform blocks are copied when queued */
+typedef struct lopgl_draw_material_t {
+    sg_pipeline pip;                        /* reads the model matrix from the vertex shader uniforms (required) */
+    sg_pipeline instanced_pip;              /* reads it from a per-instance mat4 as well, see below (optional) */
+    int instance_buffer_index;              /* vertex buffer slot of the per-instance mat4 in instanced_pip */
+    int vs_uniform_slot;
+    const void* vs_uniforms;                /* vertex shader uniform block containing the model matrix (required) */
+    int vs_uniforms_size;
+    int model_offset;                       /* byte offset of the model matrix in vs_uniforms */
+    int fs_uniform_slot;
+    const void* fs_uniforms;                /* fragment shader uniform block (optional) */
+    int fs_uniforms_size;
+    int pass;                               /* draws of lower passes are submitted first (optional) */
+    bool transparent;                       /* drawn back to front after the opaque draws of its pass (optional) */
+} lopgl_draw_material_t;
+
+/* counters of the previous frame, summed over all flushes */
+typedef struct lopgl_draw_stats_t {
+    int queued_draws;
+    int batches;                            /* groups of draws sharing mesh, pipelines and uniforms */
+    int draw_calls;                         /* sg_draw() calls issued */
+    int instanced_draws;                    /* draw calls that merged a batch through the instance buffer */
+    int instances;                          /* draws merged into instanced draw calls */
+    int pipeline_changes;                   /* sg_apply_pipeline() calls issued */
+    int binding_changes;                    /* sg_apply_bindings() calls issued */
+    int uniform_updates;                    /* sg_apply_uniforms() calls issued */
+    double sort_ms;                         /* part of flush_ms spent sorting */
+    double flush_ms;                        /* cpu time spent in lopgl_flush_draws() */
+} lopgl_draw_stats_t;
+
+/* uniform blocks passed to lopgl_apply_uniforms() in the previous frame */
+typedef struct lopgl_uniform_stats_t {
+    int applied;
+    int skipped;                            /* same contents as the block applied last */
+    uint32_t bytes_applied;
+    uint32_t bytes_skipped;
+} lopgl_uniform_stats_t;
+
+/* size of each frame arena buffer */
+#ifndef LOPGL_FRAME_ARENA_SIZE
+#define LOPGL_FRAME_ARENA_SIZE (4 * 1024 * 1024)
+#endif
+/* number of frame arena buffers, which lopgl_update() cycles through */
+#ifndef LOPGL_FRAME_ARENA_BUFFERS
+#define LOPGL_FRAME_ARENA_BUFFERS 2
+#endif
+
+typedef struct lopgl_frame_arena_stats_t {
+    uint32_t used;                          /* bytes allocated in the previous frame, including alignment padding */
+    uint32_t high_water;                    /* most bytes allocated in a single frame so far */
+    uint32_t capacity;                      /* LOPGL_FRAME_ARENA_SIZE */
+    int allocations;
+    int failed;                             /* allocations of the previous frame that didn't fit */
+} lopgl_frame_arena_stats_t;
+
+/* maximum number of threads running jobs, including the main thread */
+#define LOPGL_MAX_JOB_THREADS 16
+/* threads lopgl_setup() runs jobs on, including the main thread, 0 uses one per cpu core */
+#ifndef LOPGL_JOB_THREADS
+#define LOPGL_JOB_THREADS 0
+#endif
+/* jobs each thread can have queued or waiting at once, a power of two.
+   Jobs that don't fit run right away on the thread starting them. */
+#define LOPGL_JOB_QUEUE_SIZE 1024
+
+/* Native builds run jobs on worker threads, web builds run every job right away
+   on the thread starting it. Define LOPGL_NO_THREADS to opt out. */
+#if !defined(LOPGL_NO_THREADS) && !defined(__EMSCRIPTEN__) && (defined(__unix__) || defined(__APPLE__))
+#define LOPGL_USE_THREADS
+#endif
+
+typedef void(*lopgl_job_func_t)(void* user_data);
+
+/* called with a part [begin, end) of the range passed to lopgl_parallel_for() */
+typedef void(*lopgl_range_func_t)(int begin, int end, void* user_data);
+
+/* Counts the unfinished jobs started with it, zero initialize before use. A counter
+   has to stay valid until the jobs counted and the jobs waiting for it are done. */
+typedef struct lopgl_job_counter_t {
+    int count;
+    int _lock;
+    struct _job_t* _waiting;                /* jobs that start when count reaches zero */
+} lopgl_job_counter_t;
+
+typedef struct lopgl_job_desc_t {
+    lopgl_job_func_t func;                  /* required */
+    void* user_data;                        /* has to stay valid until the job is done */
+    lopgl_job_counter_t* counter;           /* incremented now, decremented when the job is done (optional) */
+    lopgl_job_counter_t* after;             /* the job starts once this counter reached zero (optional) */
+} lopgl_job_desc_t;
+
+typedef struct lopgl_job_stats_t {
+    int threads;                            /* threads running jobs, including the main thread */
+    int jobs;                               /* jobs run in the previous frame */
+    int steals;                             /* jobs of the previous frame taken from another thread's queue */
+} lopgl_job_stats_t;
+
 void lopgl_setup();
 
 void lopgl_update();
@@ -132,6 +371,141 @@ void lopgl_load_image(const lopgl_image_request_t* request);
 
 void lopgl_load_obj(const lopgl_obj_request_t* request);
 
+/* set the time in milliseconds lopgl_update() may spend on completing asset requests */
+void lopgl_set_work_budget(float ms);
+
+void lopgl_queue_work(lopgl_work_func_t func, const void* user_data_ptr, uint32_t user_data_size);
+
+lopgl_load_stats_t lopgl_get_load_stats();
+
+/* upper bound in milliseconds of a histogram bucket, the last bucket has no upper bound */
+float lopgl_load_histogram_bucket_ms(int bucket);
+
+/* Requests are queued and handed to sokol-fetch as it has room, so there is no limit
+   on outstanding requests apart from LOPGL_MAX_ASSETS. The state of a handle moves
+   from pending to ready or failed, poll it with lopgl_query_asset(). Requests beyond
+   LOPGL_MAX_ASSETS or LOPGL_MAX_GROUP_HANDLES return a handle that is failed right away. */
+lopgl_asset_handle lopgl_request_asset(const lopgl_asset_desc_t* desc);
+
+/* requests count assets and returns a group handle which completes when all of them do,
+   the individual handles are written to handles_out when provided */
+lopgl_asset_handle lopgl_request_assets(const lopgl_asset_desc_t* descs, int count, lopgl_asset_handle* handles_out);
+
+/* returns a group handle that is ready when all handles are ready, or failed as soon as one fails */
+lopgl_asset_handle lopgl_when_all(const lopgl_asset_handle* handles, int count);
+
+lopgl_asset_state lopgl_query_asset(lopgl_asset_handle handle);
+
+/* A streamed image is replaced by a more detailed one whenever mip levels are
+   promoted and the previous image is destroyed, so ids kept from an earlier
+   frame become invalid, query it every frame. */
+sg_image lopgl_asset_image(lopgl_asset_handle handle);
+
+/* the mesh is owned by the asset and destroyed by lopgl_release_asset() */
+fastObjMesh* lopgl_asset_mesh(lopgl_asset_handle handle);
+
+/* releases the asset slot, images stay alive and remain owned by the caller,
+   streamed images stop streaming at their current mip level, images released
+   before they were uploaded are destroyed */
+void lopgl_release_asset(lopgl_asset_handle handle);
+
+/* Streamed images become ready as soon as their mip levels up to LOPGL_STREAM_BASE_SIZE
+   are uploaded. lopgl_update() then promotes them one mip level at a time, uploading
+   at most bytes per frame. A step uploads the new level together with all smaller
+   ones, images whose next step doesn't fit into bytes stop streaming at the level
+   they reached, so set the budget before requesting large images. */
+void lopgl_set_stream_budget(uint32_t bytes);
+
+lopgl_stream_stats_t lopgl_stream_stats(lopgl_asset_handle handle);
+
+/* Maps a file read-only so it can be handed straight to a decoder or sg_make_buffer().
+   Returns a view with a null pointer on failure and on builds without LOPGL_USE_MMAP. */
+lopgl_file_view_t lopgl_map_file(const char* path);
+
+void lopgl_unmap_file(lopgl_file_view_t* view);
+
+/* Queues a draw of mesh with material. Draws are grouped by mesh, pipelines and
+   uniform blocks (ignoring the model matrix) and submitted by lopgl_flush_draws().
+   A group of more than one draw becomes a single instanced draw when the material
+   has an instanced_pip: its vertex shader uses the same uniform block, where the
+   model matrix is set to identity, and reads the model matrices of the group from
+   a per-instance buffer bound at instance_buffer_index. Everything else falls back
+   to one draw per model matrix.
+   The draws are submitted in the order of a 64-bit sort key: pass, opaque before
+   transparent, then pipeline, bindings and distance to the camera for opaque draws,
+   front to back, and distance, pipeline and bindings for transparent draws, back to
+   front. Transparent draws are never merged. Pipelines and bindings are only applied
+   when they change between two draws. */
+void lopgl_queue_draw(const lopgl_draw_mesh_t* mesh, const lopgl_draw_material_t* material, hmm_mat4 model);
+
+/* submits the queued draws, must be called inside a pass */
+void lopgl_flush_draws();
+
+lopgl_draw_stats_t lopgl_get_draw_stats();
+
+/* applies a pipeline, see lopgl_apply_uniforms() */
+void lopgl_apply_pipeline(sg_pipeline pip);
+
+/* Applies a uniform block unless the same bytes are still applied to this stage and
+   slot of the current pipeline, blocks are compared by a 64-bit hash. Returns true
+   when sg_apply_uniforms() was called.
+   The GL and D3D11 backends keep uniforms per shader, so a block stays applied until
+   any pipeline applies another block to the same stage and slot. The other backends
+   forget all blocks whenever a pipeline is applied. This only holds if pipelines are
+   applied with lopgl_apply_pipeline() and all their uniforms with this function. */
+bool lopgl_apply_uniforms(sg_shader_stage stage, int ub_index, const void* data, int num_bytes);
+
+/* the cache is enabled by default, when disabled every block is applied */
+void lopgl_set_uniform_cache(bool enabled);
+
+lopgl_uniform_stats_t lopgl_get_uniform_stats();
+
+/* Allocates transient memory from the frame arena, align has to be a power of two
+   or 0 for 16 bytes. There is no free: lopgl_update() switches to the next arena
+   buffer and releases everything allocated into it, so memory allocated during a
+   frame stays valid until the end of the following LOPGL_FRAME_ARENA_BUFFERS - 1
+   frames. Returns NULL when the current buffer is full.
+   Main thread only, the bump isn't synchronized: jobs get their memory from the
+   thread that starts them, e.g. one block split into their parts. */
+void* lopgl_frame_alloc(size_t size, size_t align);
+
+lopgl_frame_arena_stats_t lopgl_get_frame_arena_stats();
+
+void lopgl_make_stream_buffer(lopgl_stream_buffer_t* stream, const lopgl_stream_buffer_desc_t* desc);
+
+/* Appends num_bytes to the stream buffer and returns the buffer and offset to bind
+   them with. The first append of a frame starts over at the beginning, sokol-gfx
+   cycles through several copies of the buffer internally so that the gpu can still
+   read the previous frames. When the data doesn't fit, the stream buffer is replaced
+   by one of at least twice the size, which logs a warning. Ranges returned earlier
+   in the frame stay valid, the old buffer is destroyed during the next frame. */
+lopgl_stream_range_t lopgl_append_stream_buffer(lopgl_stream_buffer_t* stream, const void* data, int num_bytes);
+
+void lopgl_destroy_stream_buffer(lopgl_stream_buffer_t* stream);
+
+/* Starts a job on the job system. Jobs can be started from the main thread and
+   from other jobs, they are queued on the starting thread and idle threads steal
+   them from there. */
+void lopgl_run_job(const lopgl_job_desc_t* desc);
+
+/* Runs queued jobs on the calling thread until the counter reaches zero, so a
+   waiting thread helps instead of blocking. */
+void lopgl_wait_jobs(lopgl_job_counter_t* counter);
+
+/* Splits [0, count) into parts of at most grain_size elements, runs func for them
+   on all job threads and returns when every part is done. A grain_size of 0 makes
+   a few parts per thread. Without worker threads func is called once for the whole
+   range, so it has to handle ranges of any size. */
+void lopgl_parallel_for(int count, int grain_size, lopgl_range_func_t func, void* user_data);
+
+/* number of threads running jobs, including the main thread */
+int lopgl_job_threads();
+
+/* index of the calling thread in [0, lopgl_job_threads()), 0 on the main thread */
+int lopgl_job_thread_index();
+
+lopgl_job_stats_t lopgl_get_job_stats();
+
 #endif /*LOPGL_APP_INCLUDED*/
 
 
@@ -168,6 +542,26 @@ void lopgl_load_obj(const lopgl_obj_request_t* request);
 #undef FAST_OBJ_IMPLEMENTATION
 
 #include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+
+#ifndef LOPGL_LOG
+#include <stdio.h>
+#define LOPGL_LOG(s) puts(s)
+#endif
+
+#ifdef LOPGL_USE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef LOPGL_USE_THREADS
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
 
 /*=== ORBITAL CAM ==================================================*/
 
@@ -232,6 +626,258 @@ void handle_input_fp(struct fp_cam* camera, const sapp_event* e, hmm_vec2 mouse_
 void update_fp_camera(struct fp_cam* camera, float delta_time);
 const char* help_fp();
 
+/*=== WORK QUEUE ===================================================*/
+
+#define LOPGL_MAX_WORK_ITEMS 64
+
+typedef struct _work_item_t {
+    lopgl_work_func_t func;
+    union {
+        uint64_t _align;
+        uint8_t data[LOPGL_MAX_WORK_DATA_SIZE];
+    } user_data;
+} _work_item_t;
+
+typedef struct _work_queue_t {
+    _work_item_t items[LOPGL_MAX_WORK_ITEMS];
+    int head;
+    int count;
+    float budget_ms;
+} _work_queue_t;
+
+static void process_work_queue(_work_queue_t* queue);
+
+/*=== MAPPED FILES =================================================*/
+
+#define LOPGL_MAX_MAPPED_REQUESTS 64
+/* files mapped at the same time, requests beyond that fail until earlier ones are released */
+#define LOPGL_MAX_MAPPINGS 64
+
+/* a fetch request that is served with lopgl_map_file() instead of sokol-fetch */
+typedef struct _mapped_request_t {
+    char path[256];
+    void (*callback)(const sfetch_response_t*);
+    union {
+        uint64_t _align;
+        uint8_t data[LOPGL_MAX_WORK_DATA_SIZE];
+    } user_data;
+} _mapped_request_t;
+
+typedef struct _mapped_files_t {
+    _mapped_request_t requests[LOPGL_MAX_MAPPED_REQUESTS];
+    int head;
+    int count;
+    /* mappings handed out as fetch buffers, unmapped by release_fetch_buffer() */
+    lopgl_file_view_t views[LOPGL_MAX_MAPPINGS];
+} _mapped_files_t;
+
+static void release_fetch_buffer(const void* ptr);
+
+/*=== ASSETS =======================================================*/
+
+typedef struct _asset_t {
+    uint32_t id;
+    lopgl_asset_type type;
+    lopgl_asset_state state;
+    // request
+    char path[128];
+    sg_wrap wrap_u;
+    sg_wrap wrap_v;
+    int channels;
+    // results
+    sg_image img_id;
+    fastObjMesh* mesh;
+    int pending_mtllibs;
+    bool mtllib_failed;
+    bool released;
+    // streaming
+    bool stream;
+    uint8_t* levels;                /* mip pyramid on the cpu, freed once fully resident */
+    lopgl_stream_stats_t stream_stats;
+    // group
+    int first_handle;
+    int handle_count;
+    // queue of requests that haven't been sent yet
+    int next_unsent;
+} _asset_t;
+
+typedef struct _asset_pool_t {
+    _asset_t assets[LOPGL_MAX_ASSETS];
+    lopgl_asset_handle group_handles[LOPGL_MAX_GROUP_HANDLES];
+    int num_group_handles;
+    int num_groups;
+    // slot index + 1 of the first and last unsent request, zero when empty
+    int first_unsent;
+    int last_unsent;
+    int num_unsent;
+    uint32_t generation;
+    uint8_t* buffer;
+    // images that are still streaming in mip levels
+    int num_streaming;
+    uint32_t stream_budget;
+    int stream_cursor;                                      /* asset the promotions of the last frame started at */
+} _asset_pool_t;
+
+static void send_assets(_asset_pool_t* pool);
+static void stream_images(_asset_pool_t* pool);
+static _asset_t* lookup_asset(uint32_t id);
+static void complete_asset(uint32_t id, bool ok);
+static void finish_asset_mtllib(uint32_t id, bool ok);
+
+/*=== DRAW QUEUE ===================================================*/
+
+/* batch indices and bindings ids take up 11 bits of the sort keys each */
+#define LOPGL_MAX_DRAW_BATCHES 1024
+#define LOPGL_DRAW_HASH_SIZE (2 * LOPGL_MAX_DRAW_BATCHES)
+#define LOPGL_DRAW_CACHE_SIZE 256
+
+typedef struct _draw_batch_t {
+    uint32_t hash;
+    lopgl_draw_mesh_t mesh;
+    sg_pipeline pip;
+    sg_pipeline instanced_pip;
+    int instance_buffer_index;
+    int vs_uniform_slot;
+    int vs_uniforms_size;
+    int model_offset;
+    int fs_uniform_slot;
+    int fs_uniforms_size;
+    int pass;
+    bool transparent;
+    uint32_t bindings_hash;
+    int bindings_id;                                        /* shared by the batches with the same bindings */
+    uint8_t vs_uniforms[LOPGL_MAX_DRAW_UNIFORMS_SIZE];      /* with the model matrix set to identity */
+    uint8_t fs_uniforms[LOPGL_MAX_DRAW_UNIFORMS_SIZE];
+    // list of queued draws
+    int first_draw;
+    int last_draw;
+    int num_draws;
+    int first_instance;                                     /* -1 when drawn without instancing */
+} _draw_batch_t;
+
+typedef struct _queued_draw_t {
+    hmm_mat4 model;
+    int batch;
+    int next;
+} _queued_draw_t;
+
+/* sort items either reference a queued draw or an instanced batch */
+#define LOPGL_SORT_ITEM_BATCH 0x80000000u
+
+typedef struct _draw_queue_t {
+    // allocated on first use
+    _queued_draw_t* draws;
+    _draw_batch_t* batches;
+    hmm_mat4* instances;
+    uint64_t* keys[2];
+    uint32_t* items[2];
+    int num_draws;
+    int num_batches;
+    int num_bindings;
+    // batch index + 1 of the last draw queued with a pair of mesh and material pointers
+    int recent_batches[LOPGL_DRAW_CACHE_SIZE];
+    // batch index + 1, zero when empty
+    int table[LOPGL_DRAW_HASH_SIZE];
+    lopgl_stream_buffer_t instance_buffer;
+    lopgl_draw_stats_t stats;
+    lopgl_draw_stats_t frame_stats;
+} _draw_queue_t;
+
+static void reset_draw_stats(_draw_queue_t* queue);
+static void destroy_draw_queue(_draw_queue_t* queue);
+
+/*=== UNIFORM CACHE ================================================*/
+
+/* the block last applied to a stage and slot */
+typedef struct _applied_uniforms_t {
+    uint32_t pip_id;                                        /* SG_INVALID_ID when unknown */
+    int size;
+    uint64_t hash;
+} _applied_uniforms_t;
+
+typedef struct _uniform_cache_t {
+    _applied_uniforms_t applied[SG_NUM_SHADER_STAGES][SG_MAX_SHADERSTAGE_UBS];
+    uint32_t pip_id;
+    bool disabled;
+    bool persistent;                                        /* uniforms survive applying other pipelines */
+    lopgl_uniform_stats_t stats;
+    lopgl_uniform_stats_t frame_stats;
+} _uniform_cache_t;
+
+static void reset_uniform_cache(_uniform_cache_t* cache);
+static void forget_uniforms(_uniform_cache_t* cache, sg_shader_stage stage, int ub_index);
+
+/*=== FRAME ARENA ==================================================*/
+
+typedef struct _frame_arena_t {
+    // allocated on first use
+    uint8_t* buffers[LOPGL_FRAME_ARENA_BUFFERS];
+    int current;
+    size_t offset;                                          /* bytes allocated from the current buffer */
+    lopgl_frame_arena_stats_t stats;
+    lopgl_frame_arena_stats_t frame_stats;
+} _frame_arena_t;
+
+static void reset_frame_arena(_frame_arena_t* arena);
+static void destroy_frame_arena(_frame_arena_t* arena);
+
+/*=== JOB SYSTEM ===================================================*/
+
+typedef struct _job_t {
+    lopgl_job_func_t func;
+    lopgl_range_func_t range_func;                          /* parallel-for parts, split further while larger than grain */
+    void* user_data;
+    int begin;
+    int end;
+    int grain;
+    int busy;                                               /* the pool slot stays taken until the job is done */
+    lopgl_job_counter_t* counter;
+    struct _job_t* next;                                    /* in the waiting list of a counter */
+} _job_t;
+
+/* Chase-Lev deque: the owning thread pushes and pops at the bottom, the other
+   threads steal from the top. top and bottom are kept on separate cache lines. */
+typedef struct _job_deque_t {
+    int64_t top;
+    uint8_t _pad0[56];
+    int64_t bottom;
+    uint8_t _pad1[56];
+    _job_t* entries[LOPGL_JOB_QUEUE_SIZE];
+} _job_deque_t;
+
+typedef struct _job_thread_t {
+    _job_deque_t deque;
+    // jobs started on this thread
+    _job_t pool[LOPGL_JOB_QUEUE_SIZE];
+    uint32_t next_job;
+    // totals, only written by this thread
+    int executed;
+    int stolen;
+#ifdef LOPGL_USE_THREADS
+    pthread_t thread;
+#endif
+} _job_thread_t;
+
+typedef struct _job_system_t {
+    int num_threads;                                        /* configured, threads[] has one entry for each */
+    int num_started;                                        /* running jobs, the main thread and the workers that started */
+    _job_thread_t* threads;                                 /* index 0 is the main thread */
+    int queued;                                             /* jobs in all deques */
+    int executed;                                           /* totals at the start of the frame */
+    int stolen;
+    lopgl_job_stats_t stats;
+#ifdef LOPGL_USE_THREADS
+    int sleeping;                                           /* workers waiting for work_cond */
+    bool quit;
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond;
+#endif
+} _job_system_t;
+
+static void start_jobs(_job_system_t* jobs);
+static void stop_jobs(_job_system_t* jobs);
+static void update_job_stats(_job_system_t* jobs);
+
 /*=== APP ==========================================================*/
 
 typedef struct _cubemap_request_t {
@@ -242,6 +888,12 @@ typedef struct _cubemap_request_t {
     int finished_requests;
     bool failed;
     lopgl_fail_callback_t fail_callback;
+    const uint8_t* face_ptrs[6];
+    // decode state
+    int decoded_faces;
+    int img_widths[6];
+    int img_heights[6];
+    stbi_uc* pixels_ptrs[6];
 } _cubemap_request_t;
 
 typedef struct {
@@ -256,6 +908,18 @@ typedef struct {
     uint64_t time_stamp;
     uint64_t frame_time;
     _cubemap_request_t cubemap_req;
+    _work_queue_t work_queue;
+    _asset_pool_t assets;
+    _mapped_files_t mapped_files;
+    _draw_queue_t draw_queue;
+    _uniform_cache_t uniform_cache;
+    _frame_arena_t frame_arena;
+    _job_system_t jobs;
+    uint32_t frame_index;
+    int pending_fetches;
+    int max_fetches;
+    bool loading;
+    lopgl_load_stats_t load_stats;
 } lopgl_state_t;
 
 static lopgl_state_t _lopgl;
@@ -277,8 +941,9 @@ void lopgl_setup() {
     /* setup sokol-fetch
         The 1 channel and 1 lane configuration essentially serializes
         IO requests. Which is just fine for this example. */
+    _lopgl.max_fetches = 8;
     sfetch_setup(&(sfetch_desc_t){
-        .max_requests = 8,
+        .max_requests = _lopgl.max_fetches,
         .num_channels = 1,
         .num_lanes = 1
     });
@@ -319,12 +984,66 @@ void lopgl_setup() {
     _lopgl.first_mouse = true;
     _lopgl.show_help = false;
     _lopgl.hide_ui = false;
+
+    _lopgl.work_queue.budget_ms = 2.f;
+
+    const sg_backend backend = sg_query_backend();
+    _lopgl.uniform_cache.persistent = backend == SG_BACKEND_GLCORE33 || backend == SG_BACKEND_GLES2 ||
+                                      backend == SG_BACKEND_GLES3 || backend == SG_BACKEND_D3D11;
+    _lopgl.assets.stream_budget = LOPGL_DEFAULT_STREAM_BUDGET;
+
+    start_jobs(&_lopgl.jobs);
 }
 
-void lopgl_update() {
-    sfetch_dowork();
+static void dispatch_mapped_requests(_mapped_files_t* files);
+
+static void record_load_frame(double frame_ms) {
+    lopgl_load_stats_t* stats = &_lopgl.load_stats;
+    int bucket = 0;
+    while (bucket < LOPGL_LOAD_HISTOGRAM_BUCKETS - 1 && frame_ms >= lopgl_load_histogram_bucket_ms(bucket)) {
+        ++bucket;
+    }
+    ++stats->histogram[bucket];
+    ++stats->frame_count;
+    if (frame_ms > stats->max_frame_ms) {
+        stats->max_frame_ms = frame_ms;
+    }
+}
 
+void lopgl_update() {
     _lopgl.frame_time = stm_laptime(&_lopgl.time_stamp);
+    ++_lopgl.frame_index;
+
+    /* the previous frame was (partially) spent completing asset requests */
+    if (_lopgl.loading) {
+        record_load_frame(stm_ms(_lopgl.frame_time));
+    }
+
+    /* Completion work (decoding, parsing, uploading) still references the
+       fetch buffers, which are shared between requests in most examples.
+       sokol-fetch only starts a new request into a lane's buffer from within
+       sfetch_dowork(), so new io is held back until the queue has drained. */
+    if (_lopgl.work_queue.count == 0) {
+        send_assets(&_lopgl.assets);
+        sfetch_dowork();
+    }
+
+    /* mapped files don't share buffers, so they can be dispatched at any time */
+    dispatch_mapped_requests(&_lopgl.mapped_files);
+
+    /* promoted before new images are completed, so that each image is
+       drawn with its smallest levels for at least one frame */
+    stream_images(&_lopgl.assets);
+
+    process_work_queue(&_lopgl.work_queue);
+
+    reset_draw_stats(&_lopgl.draw_queue);
+    reset_uniform_cache(&_lopgl.uniform_cache);
+    reset_frame_arena(&_lopgl.frame_arena);
+    update_job_stats(&_lopgl.jobs);
+
+    _lopgl.loading = _lopgl.pending_fetches > 0 || _lopgl.assets.num_unsent > 0 || _lopgl.work_queue.count > 0 ||
+                     _lopgl.assets.num_streaming > 0;
     
     if (_lopgl.fp_enabled) {
         update_fp_camera(&_lopgl.fp_cam, stm_ms(_lopgl.frame_time));
@@ -332,6 +1051,10 @@ void lopgl_update() {
 }
 
 void lopgl_shutdown() {
+    stop_jobs(&_lopgl.jobs);
+    free(_lopgl.assets.buffer);
+    destroy_draw_queue(&_lopgl.draw_queue);
+    destroy_frame_arena(&_lopgl.frame_arena);
     sg_shutdown();
 }
 
@@ -488,6 +1211,26 @@ bool lopgl_ui_visible() {
     return !_lopgl.hide_ui;
 }
 
+static void render_load_stats(const lopgl_load_stats_t* stats) {
+    sdtx_printf("Load Frames:\t%d (max %.1f ms)\n", stats->frame_count, stats->max_frame_ms);
+    if (stats->bytes_mapped > 0) {
+        sdtx_printf("Mapped:\t\t%.1f MB\n", (double)stats->bytes_mapped / (1024.0 * 1024.0));
+    }
+    if (stats->texture_bytes > 0) {
+        sdtx_printf("Textures:\t%.1f MB (%.1f MB saved)\n", (double)stats->texture_bytes / (1024.0 * 1024.0),
+                    (double)stats->texture_bytes_saved / (1024.0 * 1024.0));
+    }
+    for (int i = 0; i < LOPGL_LOAD_HISTOGRAM_BUCKETS; ++i) {
+        if (i < LOPGL_LOAD_HISTOGRAM_BUCKETS - 1) {
+            sdtx_printf(" <%3.0f ms:\t%d\n", lopgl_load_histogram_bucket_ms(i), stats->histogram[i]);
+        }
+        else {
+            sdtx_printf(">=%3.0f ms:\t%d\n", lopgl_load_histogram_bucket_ms(i - 1), stats->histogram[i]);
+        }
+    }
+    sdtx_puts("\n");
+}
+
 void lopgl_render_help() {
     if (_lopgl.hide_ui) {
         return;
@@ -505,6 +1248,17 @@ void lopgl_render_help() {
         sdtx_color4b(0x00, 0xff, 0x00, 0xaf);
         sdtx_puts(  "Hide help:\t'H'\n\n");
         sdtx_printf("Frame Time:\t%.3f\n\n", stm_ms(_lopgl.frame_time));
+        if (_lopgl.load_stats.frame_count > 0) {
+            render_load_stats(&_lopgl.load_stats);
+        }
+        if (_lopgl.frame_arena.stats.high_water > 0) {
+            const lopgl_frame_arena_stats_t* arena = &_lopgl.frame_arena.stats;
+            sdtx_printf("Frame Arena:\t%.1f KB (max %.1f KB)\n\n", arena->used / 1024.0, arena->high_water / 1024.0);
+        }
+        if (_lopgl.jobs.stats.jobs > 0) {
+            const lopgl_job_stats_t* jobs = &_lopgl.jobs.stats;
+            sdtx_printf("Jobs:\t\t%d (%d stolen, %d threads)\n\n", jobs->jobs, jobs->steals, jobs->threads);
+        }
         sdtx_printf("Orbital Cam\t[%c]\n", _lopgl.fp_enabled ? ' ': '*');
         sdtx_printf("FP Cam\t\t[%c]\n\n", _lopgl.fp_enabled ? '*' : ' ');
         sdtx_puts("Switch Cam:\t'C'\n\n");
@@ -540,13 +1294,226 @@ void lopgl_render_gles2_fallback(void) {
     sg_commit();
 }
 
+/*=== WORK QUEUE IMPLEMENTATION ===================================================*/
+
+void lopgl_set_work_budget(float ms) {
+    _lopgl.work_queue.budget_ms = ms;
+}
+
+void lopgl_queue_work(lopgl_work_func_t func, const void* user_data_ptr, uint32_t user_data_size) {
+    _work_queue_t* queue = &_lopgl.work_queue;
+    assert(user_data_size <= LOPGL_MAX_WORK_DATA_SIZE);
+
+    /* A full queue runs the item right away, all of its steps, instead of wrapping
+       over pending items. Growing the ring isn't an option, the item being processed
+       hands its user data to the work function that might queue this one. */
+    if (queue->count == LOPGL_MAX_WORK_ITEMS) {
+        _work_item_t inline_item = { .func = func };
+        if (user_data_ptr && user_data_size > 0) {
+            memcpy(inline_item.user_data.data, user_data_ptr, user_data_size);
+        }
+        while (!inline_item.func(inline_item.user_data.data)) {
+        }
+        return;
+    }
+
+    _work_item_t* item = &queue->items[(queue->head + queue->count) % LOPGL_MAX_WORK_ITEMS];
+    item->func = func;
+    if (user_data_ptr && user_data_size > 0) {
+        memcpy(item->user_data.data, user_data_ptr, user_data_size);
+    }
+    ++queue->count;
+}
+
+/* Runs work items in order until the frame budget is spent. A work item that
+   returns false is resumed first thing next frame, so the steps of a single
+   request never overtake each other. At least one step runs each frame to
+   guarantee progress, even with a budget of zero. */
+static void process_work_queue(_work_queue_t* queue) {
+    const uint64_t start = stm_now();
+
+    while (queue->count > 0) {
+        _work_item_t* item = &queue->items[queue->head];
+        /* the work function might queue new work, which can't overwrite
+           the current item because it is still counted */
+        if (item->func(item->user_data.data)) {
+            queue->head = (queue->head + 1) % LOPGL_MAX_WORK_ITEMS;
+            --queue->count;
+        }
+
+        if (stm_ms(stm_since(start)) >= queue->budget_ms) {
+            break;
+        }
+    }
+}
+
+lopgl_load_stats_t lopgl_get_load_stats() {
+    lopgl_load_stats_t stats = _lopgl.load_stats;
+    /* asset requests that are still queued count as pending io */
+    stats.pending_fetches = _lopgl.pending_fetches + _lopgl.assets.num_unsent;
+    stats.pending_work = _lopgl.work_queue.count;
+    return stats;
+}
+
+float lopgl_load_histogram_bucket_ms(int bucket) {
+    static const float bucket_ms[LOPGL_LOAD_HISTOGRAM_BUCKETS - 1] = {
+        4.f, 8.f, 17.f, 33.f, 50.f, 100.f
+    };
+    assert(bucket >= 0 && bucket < LOPGL_LOAD_HISTOGRAM_BUCKETS - 1);
+    return bucket_ms[bucket];
+}
+
+/*=== LOAD IMAGE/OBJ IMPLEMENTATION ===================================================*/
+
+/* all fetches are sent through here to keep track of outstanding io */
+static void send_fetch(const sfetch_request_t* request) {
+    ++_lopgl.pending_fetches;
+
+#ifdef LOPGL_USE_MMAP
+    /* the response is delivered from lopgl_update(), like sokol-fetch does */
+    _mapped_files_t* files = &_lopgl.mapped_files;
+    /* requests that don't fit fail right away, like a fetch without a buffer */
+    if (files->count == LOPGL_MAX_MAPPED_REQUESTS || request->user_data_size > LOPGL_MAX_WORK_DATA_SIZE ||
+        strlen(request->path) >= sizeof(files->requests[0].path)) {
+        LOPGL_LOG("Failed to queue a mapped file request");
+        /* a copy, like sokol-fetch hands out, unless it's too large to copy */
+        _mapped_request_t failed = { 0 };
+        void* user_data = (void*)request->user_data_ptr;
+        if (request->user_data_size <= LOPGL_MAX_WORK_DATA_SIZE) {
+            memcpy(failed.user_data.data, request->user_data_ptr, request->user_data_size);
+            user_data = failed.user_data.data;
+        }
+        request->callback(&(sfetch_response_t){
+            .failed = true,
+            .finished = true,
+            .error_code = SFETCH_ERROR_NO_BUFFER,
+            .path = request->path,
+            .user_data = user_data
+        });
+        return;
+    }
+
+    _mapped_request_t* mapped = &files->requests[(files->head + files->count) % LOPGL_MAX_MAPPED_REQUESTS];
+    strncpy(mapped->path, request->path, sizeof(mapped->path) - 1);
+    mapped->path[sizeof(mapped->path) - 1] = 0;
+    mapped->callback = request->callback;
+    memcpy(mapped->user_data.data, request->user_data_ptr, request->user_data_size);
+    ++files->count;
+#else
+    sfetch_send(request);
+#endif
+}
+
+static void finish_fetch(const sfetch_response_t* response) {
+    if (response->finished) {
+        --_lopgl.pending_fetches;
+    }
+}
+
 typedef struct {
     sg_image img_id;
     sg_wrap wrap_u;
     sg_wrap wrap_v;
     lopgl_fail_callback_t fail_callback;
+    uint32_t asset_id;
+    int channels;
+    bool stream;
+    // completion state
+    const void* buffer_ptr;
+    uint32_t fetched_size;
+    stbi_uc* pixels;
+    int width;
+    int height;
 } lopgl_img_request_data;
 
+static bool stream_image_work(lopgl_img_request_data* req_data);
+
+static sg_pixel_format image_pixel_format(int channels) {
+    switch (channels) {
+        case 1: return SG_PIXELFORMAT_R8;
+        case 2: return SG_PIXELFORMAT_RG8;
+        default: return SG_PIXELFORMAT_RGBA8;
+    }
+}
+
+/* Keeps the first channels of each RGBA8 texel, returns the number of channels
+   kept, which is 4 unless the backend can sample and filter the smaller format. */
+static int pack_image_channels(uint8_t* pixels, int num_texels, int channels) {
+    if (channels != 1 && channels != 2) {
+        return 4;
+    }
+    const sg_pixelformat_info info = sg_query_pixelformat(image_pixel_format(channels));
+    if (!info.sample || !info.filter) {
+        return 4;
+    }
+
+    /* in place, each texel moves to a lower or the same address */
+    for (int i = 0; i < num_texels; ++i) {
+        for (int c = 0; c < channels; ++c) {
+            pixels[i * channels + c] = pixels[i * 4 + c];
+        }
+    }
+    return channels;
+}
+
+static void count_texture_bytes(uint32_t num_texels, int channels) {
+    _lopgl.load_stats.texture_bytes += (uint64_t)num_texels * channels;
+    _lopgl.load_stats.texture_bytes_saved += (uint64_t)num_texels * (4 - channels);
+}
+
+/* Decoding and uploading run as two separate steps so that the upload of
+   a large image doesn't land in the same frame as its decode. */
+static bool image_work(void* user_data) {
+    lopgl_img_request_data* req_data = (lopgl_img_request_data*)user_data;
+
+    if (!req_data->pixels) {
+        int num_channels;
+        const int desired_channels = 4;
+        req_data->pixels = stbi_load_from_memory(
+            req_data->buffer_ptr,
+            (int)req_data->fetched_size,
+            &req_data->width, &req_data->height,
+            &num_channels, desired_channels);
+        release_fetch_buffer(req_data->buffer_ptr);
+        if (!req_data->pixels) {
+            complete_asset(req_data->asset_id, false);
+            return true;
+        }
+        req_data->channels = pack_image_channels(req_data->pixels, req_data->width * req_data->height, req_data->channels);
+        return false;
+    }
+
+    if (req_data->stream) {
+        return stream_image_work(req_data);
+    }
+
+    /* initialize the sokol-gfx texture */
+    sg_init_image(req_data->img_id, &(sg_image_desc){
+        .width = req_data->width,
+        .height = req_data->height,
+        .pixel_format = image_pixel_format(req_data->channels),
+        .wrap_u = req_data->wrap_u,
+        .wrap_v = req_data->wrap_v,
+        .min_filter = SG_FILTER_LINEAR,
+        .mag_filter = SG_FILTER_LINEAR,
+        .content.subimage[0][0] = {
+            .ptr = req_data->pixels,
+            .size = req_data->width * req_data->height * req_data->channels,
+        }
+    });
+    count_texture_bytes((uint32_t)(req_data->width * req_data->height), req_data->channels);
+    stbi_image_free(req_data->pixels);
+    complete_asset(req_data->asset_id, true);
+    return true;
+}
+
+static void fail_request(lopgl_fail_callback_t fail_callback, uint32_t asset_id) {
+    if (fail_callback) {
+        fail_callback();
+    }
+    complete_asset(asset_id, false);
+}
+
 /* The fetch-callback is called by sokol_fetch.h when the data is loaded,
    or when an error has occurred.
 */
@@ -555,37 +1522,18 @@ static void image_fetch_callback(const sfetch_response_t* response) {
 
     if (response->fetched) {
         /* the file data has been fetched, since we provided a big-enough
-           buffer we can be sure that all data has been loaded here
+           buffer we can be sure that all data has been loaded here,
+           decoding is deferred to the work queue
         */
-        int img_width, img_height, num_channels;
-        const int desired_channels = 4;
-        stbi_uc* pixels = stbi_load_from_memory(
-            response->buffer_ptr,
-            (int)response->fetched_size,
-            &img_width, &img_height,
-            &num_channels, desired_channels);
-        if (pixels) {
-            /* initialize the sokol-gfx texture */
-            sg_init_image(req_data.img_id, &(sg_image_desc){
-                .width = img_width,
-                .height = img_height,
-                /* set pixel_format to RGBA8 for WebGL */
-                .pixel_format = SG_PIXELFORMAT_RGBA8,
-                .wrap_u = req_data.wrap_u,
-                .wrap_v = req_data.wrap_v,
-                .min_filter = SG_FILTER_LINEAR,
-                .mag_filter = SG_FILTER_LINEAR,
-                .content.subimage[0][0] = {
-                    .ptr = pixels,
-                    .size = img_width * img_height * desired_channels,
-                }
-            });
-            stbi_image_free(pixels);
-        }
+        req_data.buffer_ptr = response->buffer_ptr;
+        req_data.fetched_size = response->fetched_size;
+        lopgl_queue_work(image_work, &req_data, sizeof(req_data));
     }
     else if (response->failed) {
-        req_data.fail_callback();
+        fail_request(req_data.fail_callback, req_data.asset_id);
     }
+
+    finish_fetch(response);
 }
 
 typedef struct {
@@ -595,23 +1543,88 @@ typedef struct {
     void* buffer_ptr;
     uint32_t buffer_size;
     void* user_data_ptr;
+    uint32_t asset_id;
+    // completion state
+    const void* data_ptr;
+    uint32_t fetched_size;
+    bool parsed;
 } lopgl_obj_request_data;
 
+static void mtl_fetch_callback(const sfetch_response_t* response);
+
+/* parses the material library and hands the mesh to the user in a separate step */
+static bool mtl_work(void* user_data) {
+    lopgl_obj_request_data* req_data = (lopgl_obj_request_data*)user_data;
+
+    if (!req_data->parsed) {
+        fast_obj_mtllib_read(req_data->mesh, req_data->data_ptr, req_data->fetched_size);
+        release_fetch_buffer(req_data->data_ptr);
+        req_data->parsed = true;
+        return false;
+    }
+
+    if (req_data->asset_id) {
+        /* the mesh is owned by the asset */
+        finish_asset_mtllib(req_data->asset_id, true);
+        return true;
+    }
+
+    req_data->callback(&(lopgl_obj_response_t){
+        .mesh = req_data->mesh,
+        .user_data_ptr = req_data->user_data_ptr
+    });
+    fast_obj_destroy(req_data->mesh);
+    return true;
+}
+
+static bool obj_work(void* user_data) {
+    lopgl_obj_request_data* req_data = (lopgl_obj_request_data*)user_data;
+    req_data->mesh = fast_obj_read(req_data->data_ptr, req_data->fetched_size);
+    release_fetch_buffer(req_data->data_ptr);
+
+    if (req_data->asset_id) {
+        _asset_t* asset = lookup_asset(req_data->asset_id);
+        asset->mesh = req_data->mesh;
+        asset->pending_mtllibs = req_data->mesh ? (int)req_data->mesh->mtllib_count : 0;
+        if (asset->pending_mtllibs == 0) {
+            complete_asset(req_data->asset_id, req_data->mesh != NULL);
+            return true;
+        }
+    }
+
+    for (unsigned int i = 0; i < req_data->mesh->mtllib_count; ++i) {
+        send_fetch(&(sfetch_request_t){
+            .path = req_data->mesh->mtllibs[i],
+            .callback = mtl_fetch_callback,
+            .buffer_ptr = req_data->buffer_ptr,
+            .buffer_size = req_data->buffer_size,
+            .user_data_ptr = req_data,
+            .user_data_size = sizeof(*req_data)
+        });
+    }
+
+    return true;
+}
+
 static void mtl_fetch_callback(const sfetch_response_t* response) {
     lopgl_obj_request_data req_data = *(lopgl_obj_request_data*)response->user_data;
 
     if (response->fetched) {
-        fast_obj_mtllib_read(req_data.mesh, response->buffer_ptr, response->fetched_size);
-        req_data.callback(&(lopgl_obj_response_t){
-            .mesh = req_data.mesh,
-            .user_data_ptr = req_data.user_data_ptr
-        });
+        req_data.data_ptr = response->buffer_ptr;
+        req_data.fetched_size = response->fetched_size;
+        lopgl_queue_work(mtl_work, &req_data, sizeof(req_data));
     }
     else if (response->failed) {
-        req_data.fail_callback();
+        if (req_data.asset_id) {
+            finish_asset_mtllib(req_data.asset_id, false);
+        }
+        else {
+            req_data.fail_callback();
+            fast_obj_destroy(req_data.mesh);
+        }
     }
 
-    fast_obj_destroy(req_data.mesh);
+    finish_fetch(response);
 }
 
 static void obj_fetch_callback(const sfetch_response_t* response) {
@@ -619,24 +1632,18 @@ static void obj_fetch_callback(const sfetch_response_t* response) {
 
     if (response->fetched) {
         /* the file data has been fetched, since we provided a big-enough
-           buffer we can be sure that all data has been loaded here
+           buffer we can be sure that all data has been loaded here,
+           parsing is deferred to the work queue
         */
-        req_data.mesh = fast_obj_read(response->buffer_ptr, response->fetched_size);
-
-        for (unsigned int i = 0; i < req_data.mesh->mtllib_count; ++i) {
-            sfetch_send(&(sfetch_request_t){
-                .path = req_data.mesh->mtllibs[i],
-                .callback = mtl_fetch_callback,
-                .buffer_ptr = req_data.buffer_ptr,
-                .buffer_size = req_data.buffer_size,
-                .user_data_ptr = &req_data,
-                .user_data_size = sizeof(req_data)
-            });
-        }
+        req_data.data_ptr = response->buffer_ptr;
+        req_data.fetched_size = response->fetched_size;
+        lopgl_queue_work(obj_work, &req_data, sizeof(req_data));
     }
     else if (response->failed) {
-        req_data.fail_callback();
+        fail_request(req_data.fail_callback, req_data.asset_id);
     }
+
+    finish_fetch(response);
 }
 
 void lopgl_load_image(const lopgl_image_request_t* request) {
@@ -644,10 +1651,11 @@ void lopgl_load_image(const lopgl_image_request_t* request) {
         .img_id = request->img_id,
         .wrap_u = request->wrap_u,
         .wrap_v = request->wrap_v,
+        .channels = request->channels,
         .fail_callback = request->fail_callback
     };
 
-    sfetch_send(&(sfetch_request_t){
+    send_fetch(&(sfetch_request_t){
         .path = request->path,
         .callback = image_fetch_callback,
         .buffer_ptr = request->buffer_ptr,
@@ -664,10 +1672,10 @@ void lopgl_load_obj(const lopgl_obj_request_t* request) {
         .fail_callback = request->fail_callback,
         .buffer_ptr = request->buffer_ptr,
         .buffer_size = request->buffer_size,
-        .user_data_ptr = request->user_data_ptr
+        .user_data_ptr = (void*)request->user_data_ptr
     };
 
-    sfetch_send(&(sfetch_request_t){
+    send_fetch(&(sfetch_request_t){
         .path = request->path,
         .callback = obj_fetch_callback,
         .buffer_ptr = request->buffer_ptr,
@@ -677,99 +1685,680 @@ void lopgl_load_obj(const lopgl_obj_request_t* request) {
     });
 }
 
-/*=== LOAD CUBEMAP IMPLEMENTATION ==================================================*/
+/*=== MAPPED FILE IMPLEMENTATION ==================================================*/
 
-typedef struct _cubemap_request_instance_t {
-    int index;
-    _cubemap_request_t* request;
-} _cubemap_request_instance_t;
+lopgl_file_view_t lopgl_map_file(const char* path) {
+    lopgl_file_view_t view = { 0 };
+#ifdef LOPGL_USE_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return view;
+    }
 
-static bool load_cubemap(_cubemap_request_t* request) {
-    const int desired_channels = 4;
-    int img_widths[6], img_heights[6];
-    stbi_uc* pixels_ptrs[6];
-    sg_image_content img_content;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* ptr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr != MAP_FAILED) {
+            /* files are decoded front to back, start reading ahead right away */
+            posix_madvise(ptr, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+            posix_madvise(ptr, (size_t)st.st_size, POSIX_MADV_WILLNEED);
+            view.ptr = ptr;
+            view.size = (size_t)st.st_size;
+            _lopgl.load_stats.bytes_mapped += view.size;
+        }
+    }
 
-    for (int i = 0; i < 6; ++i) {
-        int num_channel;
-        pixels_ptrs[i] = stbi_load_from_memory(
-            request->buffer + (i * request->buffer_offset),
-            request->fetched_sizes[i],
-            &img_widths[i], &img_heights[i],
-            &num_channel, desired_channels);    
+    /* the mapping stays valid after closing the file descriptor */
+    close(fd);
+#else
+    (void)path;
+#endif
+    return view;
+}
 
-        img_content.subimage[i][0].ptr = pixels_ptrs[i];
-        img_content.subimage[i][0].size = img_widths[i] * img_heights[i] * desired_channels;
+void lopgl_unmap_file(lopgl_file_view_t* view) {
+#ifdef LOPGL_USE_MMAP
+    if (view->ptr) {
+        munmap((void*)view->ptr, view->size);
     }
+#endif
+    *view = (lopgl_file_view_t){ 0 };
+}
 
-    bool valid = img_widths[0] > 0 && img_heights[0] > 0;
-
-    for (int i = 1; i < 6; ++i) {
-        if (img_widths[i] != img_widths[0] || img_heights[i] != img_heights[0]) {
-            valid = false;
-            break;
+/* unmaps a buffer that was handed to a fetch callback, no-op for sokol-fetch buffers */
+static void release_fetch_buffer(const void* ptr) {
+    _mapped_files_t* files = &_lopgl.mapped_files;
+    for (int i = 0; ptr && i < LOPGL_MAX_MAPPINGS; ++i) {
+        if (files->views[i].ptr == ptr) {
+            lopgl_unmap_file(&files->views[i]);
+            return;
         }
     }
-    
-    if (valid) {
-        /* initialize the sokol-gfx texture */
-        sg_init_image(request->img_id, &(sg_image_desc){
-            .type = SG_IMAGETYPE_CUBE,
-            .width = img_widths[0],
-            .height = img_heights[0],
-            /* set pixel_format to RGBA8 for WebGL */
-            .pixel_format = SG_PIXELFORMAT_RGBA8,
-            .wrap_u = SG_WRAP_CLAMP_TO_EDGE,
-            .wrap_v = SG_WRAP_CLAMP_TO_EDGE,
-            .wrap_w = SG_WRAP_CLAMP_TO_EDGE,
-            .min_filter = SG_FILTER_LINEAR,
-            .mag_filter = SG_FILTER_LINEAR,
-            .content = img_content
+}
+
+/* Serves queued requests with mapped files. The mapping is passed as the response
+   buffer, so the fetch callbacks and completion work don't know the difference. */
+static void dispatch_mapped_requests(_mapped_files_t* files) {
+    while (files->count > 0) {
+        /* copy, the callback might queue new requests */
+        _mapped_request_t request = files->requests[files->head];
+        files->head = (files->head + 1) % LOPGL_MAX_MAPPED_REQUESTS;
+        --files->count;
+
+        /* the request fails when all mappings are still in use, like a fetch without a buffer */
+        int slot = 0;
+        while (slot < LOPGL_MAX_MAPPINGS && files->views[slot].ptr) {
+            ++slot;
+        }
+        sfetch_error_t error_code = SFETCH_ERROR_NO_BUFFER;
+        lopgl_file_view_t view = { 0 };
+        if (slot < LOPGL_MAX_MAPPINGS) {
+            view = lopgl_map_file(request.path);
+            files->views[slot] = view;
+            error_code = view.ptr ? SFETCH_ERROR_NO_ERROR : SFETCH_ERROR_FILE_NOT_FOUND;
+        }
+
+        request.callback(&(sfetch_response_t){
+            .fetched = view.ptr != NULL,
+            .failed = view.ptr == NULL,
+            .finished = true,
+            .error_code = error_code,
+            .path = request.path,
+            .user_data = request.user_data.data,
+            .fetched_size = (uint32_t)view.size,
+            .buffer_ptr = (void*)view.ptr,
+            .buffer_size = (uint32_t)view.size
         });
     }
+}
 
-    for (int i = 0; i < 6; ++i) {
-        stbi_image_free(pixels_ptrs[i]);
+/*=== ASSET IMPLEMENTATION ==================================================*/
+
+static int asset_index(uint32_t id) {
+    return (int)(id & 0xFFFF) - 1;
+}
+
+/* returns the asset for an id, including released assets that are still in flight */
+static _asset_t* lookup_asset(uint32_t id) {
+    const int index = asset_index(id);
+    if (index < 0 || index >= LOPGL_MAX_ASSETS || _lopgl.assets.assets[index].id != id) {
+        return NULL;
     }
-    
-    return valid;
+    return &_lopgl.assets.assets[index];
 }
 
-static void cubemap_fetch_callback(const sfetch_response_t* response) {
-    _cubemap_request_instance_t req_inst = *(_cubemap_request_instance_t*)response->user_data;
-    _cubemap_request_t* request = req_inst.request;
+static _asset_t* lookup_live_asset(lopgl_asset_handle handle) {
+    _asset_t* asset = lookup_asset(handle.id);
+    return (asset && !asset->released) ? asset : NULL;
+}
 
-    if (response->fetched) {
-        request->fetched_sizes[req_inst.index] = response->fetched_size;
-        ++request->finished_requests;
+static void free_asset(_asset_t* asset) {
+    if (asset->mesh) {
+        fast_obj_destroy(asset->mesh);
     }
-    else if (response->failed) {
-        request->failed = true;
-        ++request->finished_requests;
+    if (asset->levels) {
+        free(asset->levels);
+        --_lopgl.assets.num_streaming;
     }
+    *asset = (_asset_t){ 0 };
+}
 
-    if (request->finished_requests == 6) {
-        if (!request->failed) {
-            request->failed = !load_cubemap(request);
+static void complete_asset(uint32_t id, bool ok) {
+    _asset_t* asset = lookup_asset(id);
+    if (!asset) {
+        return;
+    }
+
+    if (asset->released) {
+        /* the id from sg_alloc_image() never got initialized and would leak */
+        if (!ok && asset->img_id.id != SG_INVALID_ID) {
+            sg_destroy_image(asset->img_id);
         }
-        
-        if (request->failed) {
-            request->fail_callback();
+        free_asset(asset);
+    }
+    else {
+        asset->state = ok ? LOPGL_ASSET_READY : LOPGL_ASSET_FAILED;
+    }
+}
+
+/* an obj asset completes once all of its material libraries have been read */
+static void finish_asset_mtllib(uint32_t id, bool ok) {
+    _asset_t* asset = lookup_asset(id);
+    asset->mtllib_failed |= !ok;
+    if (--asset->pending_mtllibs == 0) {
+        complete_asset(id, !asset->mtllib_failed);
+    }
+}
+
+static _asset_t* alloc_asset(_asset_pool_t* pool, lopgl_asset_type type) {
+    for (int i = 0; i < LOPGL_MAX_ASSETS; ++i) {
+        _asset_t* asset = &pool->assets[i];
+        if (asset->id == 0) {
+            asset->id = ((++pool->generation & 0xFFFF) << 16) | (uint32_t)(i + 1);
+            asset->type = type;
+            asset->state = LOPGL_ASSET_PENDING;
+            return asset;
         }
     }
+    LOPGL_LOG("Out of asset slots, increase LOPGL_MAX_ASSETS");
+    return NULL;
 }
 
-void lopgl_load_cubemap(lopgl_cubemap_request_t* request) {
-    // TODO: cleanup and limit cubemap requests
-    _lopgl.cubemap_req = (_cubemap_request_t) {
-        .img_id = request->img_id,
-        .buffer = request->buffer_ptr,
-        .buffer_offset = request->buffer_offset,
-        .fail_callback = request->fail_callback
-    };
+/* handle of a request that couldn't get an asset slot or group handles, it queries as failed */
+#define _LOPGL_FAILED_ASSET_ID 0xFFFFFFFFu
 
-    const char* cubemap[6] = {
-        request->path_right,
+static bool reserve_group_handles(_asset_pool_t* pool, int count) {
+    if (pool->num_group_handles + count > LOPGL_MAX_GROUP_HANDLES) {
+        LOPGL_LOG("Out of group handles, increase LOPGL_MAX_GROUP_HANDLES");
+        return false;
+    }
+    return true;
+}
+
+static void send_asset(_asset_pool_t* pool, _asset_t* asset) {
+    if (!pool->buffer) {
+        pool->buffer = (uint8_t*)malloc(LOPGL_ASSET_BUFFER_SIZE);
+    }
+
+    /* all asset requests share one buffer, this is safe because there's a single
+       io lane and completion work has to finish before the next request starts */
+    if (asset->type == LOPGL_ASSETTYPE_IMAGE) {
+        lopgl_img_request_data req_data = {
+            .img_id = asset->img_id,
+            .wrap_u = asset->wrap_u,
+            .wrap_v = asset->wrap_v,
+            .asset_id = asset->id,
+            .channels = asset->channels,
+            .stream = asset->stream
+        };
+
+        send_fetch(&(sfetch_request_t){
+            .path = asset->path,
+            .callback = image_fetch_callback,
+            .buffer_ptr = pool->buffer,
+            .buffer_size = LOPGL_ASSET_BUFFER_SIZE,
+            .user_data_ptr = &req_data,
+            .user_data_size = sizeof(req_data)
+        });
+    }
+    else {
+        lopgl_obj_request_data req_data = {
+            .buffer_ptr = pool->buffer,
+            .buffer_size = LOPGL_ASSET_BUFFER_SIZE,
+            .asset_id = asset->id
+        };
+
+        send_fetch(&(sfetch_request_t){
+            .path = asset->path,
+            .callback = obj_fetch_callback,
+            .buffer_ptr = pool->buffer,
+            .buffer_size = LOPGL_ASSET_BUFFER_SIZE,
+            .user_data_ptr = &req_data,
+            .user_data_size = sizeof(req_data)
+        });
+    }
+}
+
+/* Feeds queued requests to sokol-fetch while it has free request slots. A couple
+   of slots are left free for the material libraries requested while parsing objs. */
+static void send_assets(_asset_pool_t* pool) {
+    while (pool->first_unsent && _lopgl.pending_fetches < _lopgl.max_fetches - 2) {
+        _asset_t* asset = &pool->assets[pool->first_unsent - 1];
+        pool->first_unsent = asset->next_unsent;
+        if (!pool->first_unsent) {
+            pool->last_unsent = 0;
+        }
+        --pool->num_unsent;
+
+        if (asset->released) {
+            free_asset(asset);
+        }
+        else {
+            send_asset(pool, asset);
+        }
+    }
+}
+
+lopgl_asset_handle lopgl_request_asset(const lopgl_asset_desc_t* desc) {
+    assert(desc->type == LOPGL_ASSETTYPE_IMAGE || desc->type == LOPGL_ASSETTYPE_OBJ);
+    assert(desc->path && strlen(desc->path) < sizeof(((_asset_t*)0)->path));
+
+    _asset_pool_t* pool = &_lopgl.assets;
+    _asset_t* asset = alloc_asset(pool, desc->type);
+    if (!asset) {
+        return (lopgl_asset_handle){ _LOPGL_FAILED_ASSET_ID };
+    }
+    strncpy(asset->path, desc->path, sizeof(asset->path) - 1);
+    asset->wrap_u = desc->wrap_u;
+    asset->wrap_v = desc->wrap_v;
+    asset->channels = desc->channels;
+    asset->stream = desc->stream;
+
+    if (desc->type == LOPGL_ASSETTYPE_IMAGE) {
+        /* the image id is valid right away, sokol-gfx skips draws with it until it's loaded */
+        asset->img_id = sg_alloc_image();
+    }
+
+    const int slot = asset_index(asset->id) + 1;
+    if (pool->last_unsent) {
+        pool->assets[pool->last_unsent - 1].next_unsent = slot;
+    }
+    else {
+        pool->first_unsent = slot;
+    }
+    pool->last_unsent = slot;
+    ++pool->num_unsent;
+
+    return (lopgl_asset_handle){ asset->id };
+}
+
+lopgl_asset_handle lopgl_request_assets(const lopgl_asset_desc_t* descs, int count, lopgl_asset_handle* handles_out) {
+    _asset_pool_t* pool = &_lopgl.assets;
+    if (!reserve_group_handles(pool, count)) {
+        for (int i = 0; handles_out && i < count; ++i) {
+            handles_out[i] = (lopgl_asset_handle){ _LOPGL_FAILED_ASSET_ID };
+        }
+        return (lopgl_asset_handle){ _LOPGL_FAILED_ASSET_ID };
+    }
+
+    /* request straight into the group's handle range to avoid a temporary array */
+    lopgl_asset_handle* handles = &pool->group_handles[pool->num_group_handles];
+    for (int i = 0; i < count; ++i) {
+        handles[i] = lopgl_request_asset(&descs[i]);
+        if (handles_out) {
+            handles_out[i] = handles[i];
+        }
+    }
+
+    _asset_t* group = alloc_asset(pool, LOPGL_ASSETTYPE_GROUP);
+    if (!group) {
+        return (lopgl_asset_handle){ _LOPGL_FAILED_ASSET_ID };
+    }
+    group->first_handle = pool->num_group_handles;
+    group->handle_count = count;
+    pool->num_group_handles += count;
+    ++pool->num_groups;
+
+    return (lopgl_asset_handle){ group->id };
+}
+
+lopgl_asset_handle lopgl_when_all(const lopgl_asset_handle* handles, int count) {
+    _asset_pool_t* pool = &_lopgl.assets;
+    _asset_t* group = reserve_group_handles(pool, count) ? alloc_asset(pool, LOPGL_ASSETTYPE_GROUP) : NULL;
+    if (!group) {
+        return (lopgl_asset_handle){ _LOPGL_FAILED_ASSET_ID };
+    }
+    group->first_handle = pool->num_group_handles;
+    group->handle_count = count;
+    memcpy(&pool->group_handles[pool->num_group_handles], handles, count * sizeof(lopgl_asset_handle));
+    pool->num_group_handles += count;
+    ++pool->num_groups;
+
+    return (lopgl_asset_handle){ group->id };
+}
+
+lopgl_asset_state lopgl_query_asset(lopgl_asset_handle handle) {
+    _asset_t* asset = lookup_live_asset(handle);
+    if (!asset) {
+        return handle.id == _LOPGL_FAILED_ASSET_ID ? LOPGL_ASSET_FAILED : LOPGL_ASSET_INVALID;
+    }
+
+    if (asset->type == LOPGL_ASSETTYPE_GROUP && asset->state == LOPGL_ASSET_PENDING) {
+        lopgl_asset_state state = LOPGL_ASSET_READY;
+        for (int i = 0; i < asset->handle_count; ++i) {
+            lopgl_asset_state child = lopgl_query_asset(_lopgl.assets.group_handles[asset->first_handle + i]);
+            if (child == LOPGL_ASSET_FAILED || child == LOPGL_ASSET_INVALID) {
+                state = LOPGL_ASSET_FAILED;
+                break;
+            }
+            else if (child == LOPGL_ASSET_PENDING) {
+                state = LOPGL_ASSET_PENDING;
+            }
+        }
+        /* groups don't change state once they completed */
+        asset->state = state;
+    }
+
+    return asset->state;
+}
+
+sg_image lopgl_asset_image(lopgl_asset_handle handle) {
+    _asset_t* asset = lookup_live_asset(handle);
+    return asset ? asset->img_id : (sg_image){ SG_INVALID_ID };
+}
+
+fastObjMesh* lopgl_asset_mesh(lopgl_asset_handle handle) {
+    _asset_t* asset = lookup_live_asset(handle);
+    return (asset && asset->state == LOPGL_ASSET_READY) ? asset->mesh : NULL;
+}
+
+void lopgl_release_asset(lopgl_asset_handle handle) {
+    _asset_pool_t* pool = &_lopgl.assets;
+    _asset_t* asset = lookup_live_asset(handle);
+    if (!asset) {
+        return;
+    }
+
+    if (asset->type == LOPGL_ASSETTYPE_GROUP) {
+        /* handle ranges are reclaimed once no group references them anymore */
+        if (--pool->num_groups == 0) {
+            pool->num_group_handles = 0;
+        }
+        free_asset(asset);
+    }
+    else if (asset->state == LOPGL_ASSET_PENDING) {
+        /* still referenced by io or completion work, freed when it completes */
+        asset->released = true;
+    }
+    else {
+        free_asset(asset);
+    }
+}
+
+/*=== STREAMED IMAGE IMPLEMENTATION ==================================================*/
+
+static int mip_level_dim(int dim, int level) {
+    dim >>= level;
+    return dim > 0 ? dim : 1;
+}
+
+static uint32_t mip_level_size(const lopgl_stream_stats_t* stats, int level) {
+    return (uint32_t)(mip_level_dim(stats->width, level) * mip_level_dim(stats->height, level) * stats->channels);
+}
+
+/* size of the mip chain from level down to the smallest level */
+static uint32_t mip_chain_size(const lopgl_stream_stats_t* stats, int level) {
+    uint32_t size = 0;
+    for (int i = level; i < stats->num_levels; ++i) {
+        size += mip_level_size(stats, i);
+    }
+    return size;
+}
+
+/* box filters each mip level from the previous one, odd edges are clamped */
+static void build_mip_pyramid(uint8_t* levels, const lopgl_stream_stats_t* stats) {
+    const int bpp = stats->channels;
+    const uint8_t* src = levels;
+    for (int level = 1; level < stats->num_levels; ++level) {
+        const int src_w = mip_level_dim(stats->width, level - 1);
+        const int src_h = mip_level_dim(stats->height, level - 1);
+        const int dst_w = mip_level_dim(stats->width, level);
+        const int dst_h = mip_level_dim(stats->height, level);
+        uint8_t* dst = (uint8_t*)src + src_w * src_h * bpp;
+
+        for (int y = 0; y < dst_h; ++y) {
+            const uint8_t* row0 = src + (2 * y) * src_w * bpp;
+            const uint8_t* row1 = src + (2 * y + 1 < src_h ? 2 * y + 1 : src_h - 1) * src_w * bpp;
+            for (int x = 0; x < dst_w; ++x) {
+                const int x0 = 2 * x * bpp;
+                const int x1 = (2 * x + 1 < src_w ? 2 * x + 1 : src_w - 1) * bpp;
+                for (int c = 0; c < bpp; ++c) {
+                    const int sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+                    *dst++ = (uint8_t)((sum + 2) >> 2);
+                }
+            }
+        }
+        src += src_w * src_h * bpp;
+    }
+}
+
+/* describes an image holding the mip levels from level down to the smallest one */
+static sg_image_desc stream_image_desc(const _asset_t* asset, int level) {
+    const lopgl_stream_stats_t* stats = &asset->stream_stats;
+    sg_image_desc desc = {
+        .width = mip_level_dim(stats->width, level),
+        .height = mip_level_dim(stats->height, level),
+        .num_mipmaps = stats->num_levels - level,
+        .pixel_format = image_pixel_format(stats->channels),
+        .wrap_u = asset->wrap_u,
+        .wrap_v = asset->wrap_v,
+        .min_filter = SG_FILTER_LINEAR_MIPMAP_LINEAR,
+        .mag_filter = SG_FILTER_LINEAR
+    };
+
+    const uint8_t* ptr = asset->levels + (stats->total_bytes - mip_chain_size(stats, level));
+    for (int i = 0; i < desc.num_mipmaps; ++i) {
+        const int size = (int)mip_level_size(stats, level + i);
+        desc.content.subimage[0][i] = (sg_subimage_content){ .ptr = ptr, .size = size };
+        ptr += size;
+    }
+    return desc;
+}
+
+/* frees the mip pyramid, the image keeps the levels that are resident */
+static void stop_streaming(_asset_t* asset) {
+    free(asset->levels);
+    asset->levels = NULL;
+    --_lopgl.assets.num_streaming;
+}
+
+static void set_resident_level(_asset_t* asset, int level) {
+    lopgl_stream_stats_t* stats = &asset->stream_stats;
+    stats->resident_level = level;
+    stats->resident_bytes = mip_chain_size(stats, level);
+    stats->uploaded_bytes += stats->resident_bytes;
+
+    if (level == 0) {
+        stop_streaming(asset);
+    }
+}
+
+/* Streamed images build their mip pyramid in one step and upload the smallest
+   levels in the next, stream_images() takes care of the remaining levels. */
+static bool stream_image_work(lopgl_img_request_data* req_data) {
+    _asset_t* asset = lookup_asset(req_data->asset_id);
+    lopgl_stream_stats_t* stats = &asset->stream_stats;
+
+    if (!asset->levels) {
+        stats->width = req_data->width;
+        stats->height = req_data->height;
+        stats->channels = req_data->channels;
+        stats->num_levels = 1;
+        while (stats->num_levels < SG_MAX_MIPMAPS &&
+               ((req_data->width >> stats->num_levels) > 0 || (req_data->height >> stats->num_levels) > 0)) {
+            ++stats->num_levels;
+        }
+        stats->total_bytes = mip_chain_size(stats, 0);
+
+        asset->levels = (uint8_t*)malloc(stats->total_bytes);
+        ++_lopgl.assets.num_streaming;
+        memcpy(asset->levels, req_data->pixels, mip_level_size(stats, 0));
+        build_mip_pyramid(asset->levels, stats);
+        return false;
+    }
+
+    stbi_image_free(req_data->pixels);
+    if (asset->released) {
+        complete_asset(req_data->asset_id, false);
+        return true;
+    }
+
+    int level = 0;
+    while (mip_level_dim(stats->width, level) > LOPGL_STREAM_BASE_SIZE ||
+           mip_level_dim(stats->height, level) > LOPGL_STREAM_BASE_SIZE) {
+        ++level;
+    }
+    const sg_image_desc desc = stream_image_desc(asset, level);
+    sg_init_image(asset->img_id, &desc);
+    /* counts the full mip chain, that's what ends up on the gpu */
+    count_texture_bytes(stats->total_bytes / stats->channels, stats->channels);
+    set_resident_level(asset, level);
+    stats->max_frame_bytes = stats->resident_bytes;
+    complete_asset(req_data->asset_id, true);
+    return true;
+}
+
+/* Promotes streamed images one mip level per step, each step is charged against
+   the upload budget of the frame. sg_update_image() can only replace all mip levels
+   of an image at once, so a step creates a new image holding the next level and
+   the ones below it, uploads all of them and destroys the old image. Images whose
+   next step is larger than the whole budget stop streaming at their current level,
+   otherwise a single step would break the budget. The walk starts at another image
+   each frame, so the budget is shared between the images. */
+static void stream_images(_asset_pool_t* pool) {
+    if (pool->num_streaming == 0) {
+        return;
+    }
+
+    uint32_t budget = pool->stream_budget;
+    pool->stream_cursor = (pool->stream_cursor + 1) % LOPGL_MAX_ASSETS;
+    for (int n = 0; n < LOPGL_MAX_ASSETS; ++n) {
+        _asset_t* asset = &pool->assets[(pool->stream_cursor + n) % LOPGL_MAX_ASSETS];
+        if (!asset->levels || asset->state != LOPGL_ASSET_READY) {
+            continue;
+        }
+
+        lopgl_stream_stats_t* stats = &asset->stream_stats;
+        ++stats->stream_frames;
+
+        const int level = stats->resident_level - 1;
+        const uint32_t step_bytes = mip_chain_size(stats, level);
+        if (step_bytes > pool->stream_budget) {
+            stop_streaming(asset);
+            continue;
+        }
+        if (step_bytes > budget) {
+            continue;
+        }
+
+        const sg_image_desc desc = stream_image_desc(asset, level);
+        sg_image img_id = sg_make_image(&desc);
+        sg_destroy_image(asset->img_id);
+        asset->img_id = img_id;
+        budget -= step_bytes;
+        set_resident_level(asset, level);
+        if (step_bytes > stats->max_frame_bytes) {
+            stats->max_frame_bytes = step_bytes;
+        }
+    }
+}
+
+void lopgl_set_stream_budget(uint32_t bytes) {
+    _lopgl.assets.stream_budget = bytes;
+}
+
+lopgl_stream_stats_t lopgl_stream_stats(lopgl_asset_handle handle) {
+    _asset_t* asset = lookup_live_asset(handle);
+    return asset ? asset->stream_stats : (lopgl_stream_stats_t){ 0 };
+}
+
+/*=== LOAD CUBEMAP IMPLEMENTATION ==================================================*/
+
+typedef struct _cubemap_request_instance_t {
+    int index;
+    _cubemap_request_t* request;
+} _cubemap_request_instance_t;
+
+static bool validate_cubemap(_cubemap_request_t* request) {
+    bool valid = request->img_widths[0] > 0 && request->img_heights[0] > 0;
+
+    for (int i = 0; i < 6; ++i) {
+        if (!request->pixels_ptrs[i] ||
+            request->img_widths[i] != request->img_widths[0] ||
+            request->img_heights[i] != request->img_heights[0]) {
+            valid = false;
+            break;
+        }
+    }
+
+    return valid;
+}
+
+/* Decodes one face per call, the upload of all six faces happens in a final step. */
+static bool cubemap_work(void* user_data) {
+    _cubemap_request_t* request = *(_cubemap_request_t**)user_data;
+    const int desired_channels = 4;
+
+    if (request->decoded_faces < 6) {
+        const int i = request->decoded_faces++;
+        int num_channel;
+        request->pixels_ptrs[i] = stbi_load_from_memory(
+            request->face_ptrs[i],
+            request->fetched_sizes[i],
+            &request->img_widths[i], &request->img_heights[i],
+            &num_channel, desired_channels);
+        release_fetch_buffer(request->face_ptrs[i]);
+        return false;
+    }
+
+    request->failed = !validate_cubemap(request);
+
+    if (!request->failed) {
+        sg_image_content img_content = { 0 };
+        for (int i = 0; i < 6; ++i) {
+            img_content.subimage[i][0].ptr = request->pixels_ptrs[i];
+            img_content.subimage[i][0].size = request->img_widths[i] * request->img_heights[i] * desired_channels;
+        }
+
+        /* initialize the sokol-gfx texture */
+        sg_init_image(request->img_id, &(sg_image_desc){
+            .type = SG_IMAGETYPE_CUBE,
+            .width = request->img_widths[0],
+            .height = request->img_heights[0],
+            /* set pixel_format to RGBA8 for WebGL */
+            .pixel_format = SG_PIXELFORMAT_RGBA8,
+            .wrap_u = SG_WRAP_CLAMP_TO_EDGE,
+            .wrap_v = SG_WRAP_CLAMP_TO_EDGE,
+            .wrap_w = SG_WRAP_CLAMP_TO_EDGE,
+            .min_filter = SG_FILTER_LINEAR,
+            .mag_filter = SG_FILTER_LINEAR,
+            .content = img_content
+        });
+        count_texture_bytes((uint32_t)(6 * request->img_widths[0] * request->img_heights[0]), desired_channels);
+    }
+
+    for (int i = 0; i < 6; ++i) {
+        stbi_image_free(request->pixels_ptrs[i]);
+        request->pixels_ptrs[i] = NULL;
+    }
+
+    if (request->failed) {
+        request->fail_callback();
+    }
+
+    return true;
+}
+
+static void cubemap_fetch_callback(const sfetch_response_t* response) {
+    _cubemap_request_instance_t req_inst = *(_cubemap_request_instance_t*)response->user_data;
+    _cubemap_request_t* request = req_inst.request;
+
+    if (response->fetched) {
+        request->fetched_sizes[req_inst.index] = response->fetched_size;
+        request->face_ptrs[req_inst.index] = response->buffer_ptr;
+        ++request->finished_requests;
+    }
+    else if (response->failed) {
+        request->failed = true;
+        ++request->finished_requests;
+    }
+
+    if (request->finished_requests == 6 && (response->fetched || response->failed)) {
+        if (!request->failed) {
+            lopgl_queue_work(cubemap_work, &request, sizeof(request));
+        }
+        else {
+            for (int i = 0; i < 6; ++i) {
+                release_fetch_buffer(request->face_ptrs[i]);
+            }
+            request->fail_callback();
+        }
+    }
+
+    finish_fetch(response);
+}
+
+void lopgl_load_cubemap(lopgl_cubemap_request_t* request) {
+    // TODO: cleanup and limit cubemap requests
+    _lopgl.cubemap_req = (_cubemap_request_t) {
+        .img_id = request->img_id,
+        .buffer = request->buffer_ptr,
+        .buffer_offset = request->buffer_offset,
+        .fail_callback = request->fail_callback
+    };
+
+    const char* cubemap[6] = {
+        request->path_right,
         request->path_left,
         request->path_top,
         request->path_bottom,
@@ -782,7 +2371,7 @@ void lopgl_load_cubemap(lopgl_cubemap_request_t* request) {
             .index = i,
             .request = &_lopgl.cubemap_req
         };
-        sfetch_send(&(sfetch_request_t){
+        send_fetch(&(sfetch_request_t){
             .path = cubemap[i],
             .callback = cubemap_fetch_callback,
             .buffer_ptr = request->buffer_ptr + (i * request->buffer_offset),
@@ -793,6 +2382,1031 @@ void lopgl_load_cubemap(lopgl_cubemap_request_t* request) {
     }
 }
 
+/*=== STREAM BUFFER IMPLEMENTATION ==================================================*/
+
+static sg_buffer make_stream_buffer(const lopgl_stream_buffer_t* stream) {
+    return sg_make_buffer(&(sg_buffer_desc){
+        .size = stream->size,
+        .type = stream->type,
+        .usage = SG_USAGE_STREAM,
+        .label = stream->label
+    });
+}
+
+static void destroy_retired_stream_buffers(lopgl_stream_buffer_t* stream) {
+    for (int i = 0; i < stream->_num_retired; ++i) {
+        sg_destroy_buffer(stream->_retired[i]);
+    }
+    stream->_num_retired = 0;
+}
+
+void lopgl_make_stream_buffer(lopgl_stream_buffer_t* stream, const lopgl_stream_buffer_desc_t* desc) {
+    *stream = (lopgl_stream_buffer_t) {
+        .size = desc->size > 0 ? desc->size : LOPGL_DEFAULT_STREAM_BUFFER_SIZE,
+        .type = desc->type,
+        .label = desc->label,
+        ._frame_index = _lopgl.frame_index
+    };
+    stream->buffer = make_stream_buffer(stream);
+}
+
+/* sokol-gfx keeps appends 4-byte aligned */
+static int stream_append_size(int num_bytes) {
+    return (num_bytes + 3) & ~3;
+}
+
+static void grow_stream_buffer(lopgl_stream_buffer_t* stream, int num_bytes) {
+    /* large enough for everything appended this frame, which is likely to be appended again next frame */
+    const int required = stream->used + stream_append_size(num_bytes);
+    int size = stream->size * 2;
+    while (size < required) {
+        size *= 2;
+    }
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "lopgl: stream buffer '%s' grew from %d to %d bytes",
+             stream->label ? stream->label : "", stream->size, size);
+    LOPGL_LOG(msg);
+
+    /* draws of this frame may still reference the old buffer */
+    if (stream->_num_retired == LOPGL_MAX_RETIRED_STREAM_BUFFERS) {
+        destroy_retired_stream_buffers(stream);
+    }
+    stream->_retired[stream->_num_retired++] = stream->buffer;
+
+    stream->size = size;
+    stream->buffer = make_stream_buffer(stream);
+    stream->used = 0;
+    ++stream->grow_count;
+}
+
+lopgl_stream_range_t lopgl_append_stream_buffer(lopgl_stream_buffer_t* stream, const void* data, int num_bytes) {
+    assert(stream->buffer.id != SG_INVALID_ID && num_bytes > 0);
+    if (stream->_frame_index != _lopgl.frame_index) {
+        stream->_frame_index = _lopgl.frame_index;
+        stream->used = 0;
+        destroy_retired_stream_buffers(stream);
+    }
+
+    if (stream->used + stream_append_size(num_bytes) > stream->size) {
+        grow_stream_buffer(stream, num_bytes);
+    }
+
+    const lopgl_stream_range_t range = {
+        .buffer = stream->buffer,
+        .offset = sg_append_buffer(stream->buffer, data, num_bytes)
+    };
+    stream->used = range.offset + stream_append_size(num_bytes);
+    return range;
+}
+
+void lopgl_destroy_stream_buffer(lopgl_stream_buffer_t* stream) {
+    destroy_retired_stream_buffers(stream);
+    if (stream->buffer.id != SG_INVALID_ID) {
+        sg_destroy_buffer(stream->buffer);
+        stream->buffer.id = SG_INVALID_ID;
+    }
+}
+
+/*=== DRAW QUEUE IMPLEMENTATION ==================================================*/
+
+/* FNV-1a over 32-bit words, in four interleaved lanes to shorten the dependency chain */
+static uint32_t hash_words(uint32_t hash, const void* ptr, int size) {
+    const uint8_t* bytes = (const uint8_t*) ptr;
+    uint32_t lanes[4] = { hash, hash ^ 1u, hash ^ 2u, hash ^ 3u };
+    int i = 0;
+    for (; i + 16 <= size; i += 16) {
+        uint32_t words[4];
+        memcpy(words, bytes + i, 16);
+        for (int lane = 0; lane < 4; ++lane) {
+            lanes[lane] = (lanes[lane] ^ words[lane]) * 16777619u;
+        }
+    }
+    for (; i + 4 <= size; i += 4) {
+        uint32_t word;
+        memcpy(&word, bytes + i, 4);
+        lanes[0] = (lanes[0] ^ word) * 16777619u;
+    }
+    return ((lanes[0] * 16777619u ^ lanes[1]) * 16777619u ^ lanes[2]) * 16777619u ^ lanes[3];
+}
+
+static uint32_t hash_draw(const lopgl_draw_mesh_t* mesh, const lopgl_draw_material_t* material) {
+    const uint8_t* vs_uniforms = (const uint8_t*) material->vs_uniforms;
+    const int model_end = material->model_offset + (int)sizeof(hmm_mat4);
+
+    uint32_t hash = 2166136261u;
+    hash = hash_words(hash, mesh, sizeof(lopgl_draw_mesh_t));
+    hash = hash_words(hash, &material->pip.id, sizeof(uint32_t));
+    hash = hash_words(hash, &material->instanced_pip.id, sizeof(uint32_t));
+    hash = hash_words(hash, &material->pass, sizeof(int));
+    /* the model matrix differs between the draws of a batch */
+    hash = hash_words(hash, vs_uniforms, material->model_offset);
+    hash = hash_words(hash, vs_uniforms + model_end, material->vs_uniforms_size - model_end);
+    if (material->fs_uniforms) {
+        hash = hash_words(hash, material->fs_uniforms, material->fs_uniforms_size);
+    }
+    return hash;
+}
+
+static bool batch_matches(const _draw_batch_t* batch, const lopgl_draw_mesh_t* mesh, const lopgl_draw_material_t* material) {
+    const uint8_t* vs_uniforms = (const uint8_t*) material->vs_uniforms;
+    const int model_end = material->model_offset + (int)sizeof(hmm_mat4);
+    const int fs_uniforms_size = material->fs_uniforms ? material->fs_uniforms_size : 0;
+
+    return batch->pip.id == material->pip.id &&
+           batch->instanced_pip.id == material->instanced_pip.id &&
+           batch->instance_buffer_index == material->instance_buffer_index &&
+           batch->vs_uniform_slot == material->vs_uniform_slot &&
+           batch->vs_uniforms_size == material->vs_uniforms_size &&
+           batch->model_offset == material->model_offset &&
+           batch->fs_uniform_slot == material->fs_uniform_slot &&
+           batch->fs_uniforms_size == fs_uniforms_size &&
+           batch->pass == material->pass &&
+           batch->transparent == material->transparent &&
+           memcmp(&batch->mesh, mesh, sizeof(lopgl_draw_mesh_t)) == 0 &&
+           memcmp(batch->vs_uniforms, vs_uniforms, material->model_offset) == 0 &&
+           memcmp(batch->vs_uniforms + model_end, vs_uniforms + model_end, material->vs_uniforms_size - model_end) == 0 &&
+           (fs_uniforms_size == 0 || memcmp(batch->fs_uniforms, material->fs_uniforms, fs_uniforms_size) == 0);
+}
+
+static _draw_batch_t* add_batch(_draw_queue_t* queue, uint32_t hash, const lopgl_draw_mesh_t* mesh, const lopgl_draw_material_t* material) {
+    _draw_batch_t* batch = &queue->batches[queue->num_batches++];
+    const hmm_mat4 identity = HMM_Mat4d(1.f);
+
+    batch->hash = hash;
+    batch->mesh = *mesh;
+    batch->pip = material->pip;
+    batch->instanced_pip = material->instanced_pip;
+    batch->instance_buffer_index = material->instance_buffer_index;
+    batch->vs_uniform_slot = material->vs_uniform_slot;
+    batch->vs_uniforms_size = material->vs_uniforms_size;
+    batch->model_offset = material->model_offset;
+    batch->fs_uniform_slot = material->fs_uniform_slot;
+    batch->fs_uniforms_size = material->fs_uniforms ? material->fs_uniforms_size : 0;
+    batch->pass = material->pass;
+    batch->transparent = material->transparent;
+    batch->bindings_hash = hash_words(2166136261u, &mesh->bind, sizeof(sg_bindings));
+    batch->bindings_id = queue->num_bindings;
+    for (int i = 0; i < queue->num_batches - 1; ++i) {
+        const _draw_batch_t* other = &queue->batches[i];
+        if (other->bindings_hash == batch->bindings_hash && memcmp(&other->mesh.bind, &mesh->bind, sizeof(sg_bindings)) == 0) {
+            batch->bindings_id = other->bindings_id;
+            break;
+        }
+    }
+    if (batch->bindings_id == queue->num_bindings) {
+        ++queue->num_bindings;
+    }
+    memcpy(batch->vs_uniforms, material->vs_uniforms, material->vs_uniforms_size);
+    memcpy(batch->vs_uniforms + material->model_offset, &identity, sizeof(hmm_mat4));
+    if (batch->fs_uniforms_size > 0) {
+        memcpy(batch->fs_uniforms, material->fs_uniforms, batch->fs_uniforms_size);
+    }
+    batch->first_draw = -1;
+    batch->last_draw = -1;
+    batch->num_draws = 0;
+    return batch;
+}
+
+static _draw_batch_t* find_batch(_draw_queue_t* queue, const lopgl_draw_mesh_t* mesh, const lopgl_draw_material_t* material) {
+    /* draws queued with the same descs mostly share their batch, which is cheaper to
+       compare against than to hash the descs */
+    const uint32_t recent = (uint32_t)(((uintptr_t)mesh >> 4) * 31 + ((uintptr_t)material >> 4)) % LOPGL_DRAW_CACHE_SIZE;
+    if (queue->recent_batches[recent] > 0) {
+        _draw_batch_t* batch = &queue->batches[queue->recent_batches[recent] - 1];
+        if (batch_matches(batch, mesh, material)) {
+            return batch;
+        }
+    }
+
+    const uint32_t hash = hash_draw(mesh, material);
+    uint32_t slot = hash % LOPGL_DRAW_HASH_SIZE;
+    while (queue->table[slot] != 0) {
+        const int index = queue->table[slot] - 1;
+        _draw_batch_t* batch = &queue->batches[index];
+        if (batch->hash == hash && batch_matches(batch, mesh, material)) {
+            queue->recent_batches[recent] = index + 1;
+            return batch;
+        }
+        slot = (slot + 1) % LOPGL_DRAW_HASH_SIZE;
+    }
+
+    if (queue->num_batches == LOPGL_MAX_DRAW_BATCHES) {
+        lopgl_flush_draws();
+        slot = hash % LOPGL_DRAW_HASH_SIZE;
+    }
+
+    queue->recent_batches[recent] = queue->num_batches + 1;
+    queue->table[slot] = queue->num_batches + 1;
+    return add_batch(queue, hash, mesh, material);
+}
+
+void lopgl_queue_draw(const lopgl_draw_mesh_t* mesh, const lopgl_draw_material_t* material, hmm_mat4 model) {
+    _draw_queue_t* queue = &_lopgl.draw_queue;
+    assert(material->vs_uniforms && material->vs_uniforms_size <= LOPGL_MAX_DRAW_UNIFORMS_SIZE);
+    assert(material->model_offset >= 0 && material->model_offset + (int)sizeof(hmm_mat4) <= material->vs_uniforms_size);
+    assert(!material->fs_uniforms || material->fs_uniforms_size <= LOPGL_MAX_DRAW_UNIFORMS_SIZE);
+    assert(material->pass >= 0 && material->pass < LOPGL_MAX_DRAW_PASSES);
+
+    if (!queue->draws) {
+        queue->draws = (_queued_draw_t*)malloc(LOPGL_MAX_QUEUED_DRAWS * sizeof(_queued_draw_t));
+        queue->batches = (_draw_batch_t*)malloc(LOPGL_MAX_DRAW_BATCHES * sizeof(_draw_batch_t));
+        queue->instances = (hmm_mat4*)malloc(LOPGL_INSTANCE_BUFFER_SIZE);
+        for (int i = 0; i < 2; ++i) {
+            queue->keys[i] = (uint64_t*)malloc(LOPGL_MAX_QUEUED_DRAWS * sizeof(uint64_t));
+            queue->items[i] = (uint32_t*)malloc(LOPGL_MAX_QUEUED_DRAWS * sizeof(uint32_t));
+        }
+    }
+
+    if (queue->num_draws == LOPGL_MAX_QUEUED_DRAWS) {
+        lopgl_flush_draws();
+    }
+
+    _draw_batch_t* batch = find_batch(queue, mesh, material);
+
+    const int index = queue->num_draws++;
+    queue->draws[index].model = model;
+    queue->draws[index].batch = (int)(batch - queue->batches);
+    queue->draws[index].next = -1;
+    if (batch->last_draw >= 0) {
+        queue->draws[batch->last_draw].next = index;
+    } else {
+        batch->first_draw = index;
+    }
+    batch->last_draw = index;
+    ++batch->num_draws;
+}
+
+/* Copies the model matrices of the batches that are drawn instanced next to each
+   other, so they are appended to the instance buffer at once. Batches that don't
+   fit into the staging memory are drawn one by one. */
+static int gather_instances(_draw_queue_t* queue) {
+    const bool instancing = sg_query_features().instancing;
+    const int max_instances = LOPGL_INSTANCE_BUFFER_SIZE / (int)sizeof(hmm_mat4);
+    int num_instances = 0;
+
+    for (int i = 0; i < queue->num_batches; ++i) {
+        _draw_batch_t* batch = &queue->batches[i];
+        batch->first_instance = -1;
+        if (!instancing || batch->transparent || batch->instanced_pip.id == SG_INVALID_ID || batch->num_draws < 2 ||
+            num_instances + batch->num_draws > max_instances) {
+            continue;
+        }
+
+        batch->first_instance = num_instances;
+        for (int draw = batch->first_draw; draw >= 0; draw = queue->draws[draw].next) {
+            queue->instances[num_instances++] = queue->draws[draw].model;
+        }
+    }
+    return num_instances;
+}
+
+/* Opaque draws are sorted by state and front to back where the state is the same,
+   transparent draws back to front first. The batch separates draws that share
+   pipeline and bindings but not their uniforms. Bindings and batches are numbered
+   per flush, so the upper bytes mostly match and are skipped by the radix sort.
+   The sort is stable, draws with equal keys keep their queue order. */
+static uint64_t draw_sort_key(const _draw_batch_t* batch, int batch_index, sg_pipeline pip, uint32_t depth) {
+    const uint64_t pass = (uint64_t)batch->pass << 55;
+    const uint64_t pip_index = pip.id & 0xFFFF;
+    const uint64_t bindings = (uint64_t)batch->bindings_id;
+
+    if (batch->transparent) {
+        return pass | (1ull << 54) | (uint64_t)(0xFFFF - depth) << 38 | pip_index << 22 | bindings << 11 | (uint64_t)batch_index;
+    }
+    return pass | pip_index << 38 | bindings << 27 | (uint64_t)batch_index << 16 | depth;
+}
+
+static float draw_distance_squared(const hmm_mat4* model, hmm_vec3 camera_pos) {
+    const float dx = model->Elements[3][0] - camera_pos.X;
+    const float dy = model->Elements[3][1] - camera_pos.Y;
+    const float dz = model->Elements[3][2] - camera_pos.Z;
+    return dx * dx + dy * dy + dz * dz;
+}
+
+/* one sort item per instanced batch and per draw of the other batches */
+static int build_sort_items(_draw_queue_t* queue) {
+    const hmm_vec3 camera_pos = lopgl_camera_position();
+    uint64_t* keys = queue->keys[0];
+    uint32_t* items = queue->items[0];
+    int num_items = 0;
+
+    for (int i = 0; i < queue->num_batches; ++i) {
+        const _draw_batch_t* batch = &queue->batches[i];
+        if (batch->first_instance >= 0) {
+            keys[num_items] = draw_sort_key(batch, i, batch->instanced_pip, 0);
+            items[num_items++] = LOPGL_SORT_ITEM_BATCH | (uint32_t)i;
+        }
+    }
+
+    /* distances are quantized relative to the farthest draw that isn't instanced */
+    float max_distance_squared = 0.f;
+    for (int i = 0; i < queue->num_draws; ++i) {
+        const _queued_draw_t* draw = &queue->draws[i];
+        if (queue->batches[draw->batch].first_instance < 0) {
+            const float distance_squared = draw_distance_squared(&draw->model, camera_pos);
+            if (distance_squared > max_distance_squared) {
+                max_distance_squared = distance_squared;
+            }
+        }
+    }
+    const float depth_scale = max_distance_squared > 0.f ? 65535.f / HMM_SquareRootF(max_distance_squared) : 0.f;
+
+    for (int i = 0; i < queue->num_draws; ++i) {
+        const _queued_draw_t* draw = &queue->draws[i];
+        const _draw_batch_t* batch = &queue->batches[draw->batch];
+        if (batch->first_instance < 0) {
+            const float distance = HMM_SquareRootF(draw_distance_squared(&draw->model, camera_pos));
+            keys[num_items] = draw_sort_key(batch, draw->batch, batch->pip, (uint32_t)(distance * depth_scale));
+            items[num_items++] = (uint32_t)i;
+        }
+    }
+    return num_items;
+}
+
+/* LSD radix sort of the keys and their items a byte at a time, bytes that are
+   the same in all keys are skipped. Returns the index of the sorted buffers. */
+static int radix_sort_items(_draw_queue_t* queue, int count) {
+    uint32_t histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
+
+    const uint64_t* keys = queue->keys[0];
+    for (int i = 0; i < count; ++i) {
+        const uint64_t key = keys[i];
+        for (int byte = 0; byte < 8; ++byte) {
+            ++histograms[byte][(key >> (byte * 8)) & 0xFF];
+        }
+    }
+
+    int src = 0;
+    for (int byte = 0; byte < 8; ++byte) {
+        const int shift = byte * 8;
+        uint32_t* histogram = histograms[byte];
+        if (histogram[(queue->keys[src][0] >> shift) & 0xFF] == (uint32_t)count) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (int digit = 0; digit < 256; ++digit) {
+            const uint32_t digit_count = histogram[digit];
+            histogram[digit] = offset;
+            offset += digit_count;
+        }
+
+        const uint64_t* src_keys = queue->keys[src];
+        const uint32_t* src_items = queue->items[src];
+        uint64_t* dst_keys = queue->keys[1 - src];
+        uint32_t* dst_items = queue->items[1 - src];
+        for (int i = 0; i < count; ++i) {
+            const uint32_t dst = histogram[(src_keys[i] >> shift) & 0xFF]++;
+            dst_keys[dst] = src_keys[i];
+            dst_items[dst] = src_items[i];
+        }
+        src = 1 - src;
+    }
+    return src;
+}
+
+void lopgl_flush_draws() {
+    _draw_queue_t* queue = &_lopgl.draw_queue;
+    if (queue->num_draws == 0) {
+        return;
+    }
+    const uint64_t start = stm_now();
+
+    lopgl_stream_range_t instances = {0};
+    const int num_instances = gather_instances(queue);
+    if (num_instances > 0) {
+        if (queue->instance_buffer.buffer.id == SG_INVALID_ID) {
+            lopgl_make_stream_buffer(&queue->instance_buffer, &(lopgl_stream_buffer_desc_t){
+                .size = LOPGL_INSTANCE_BUFFER_SIZE,
+                .label = "lopgl-instances"
+            });
+        }
+        instances = lopgl_append_stream_buffer(&queue->instance_buffer, queue->instances, num_instances * (int)sizeof(hmm_mat4));
+    }
+
+    lopgl_draw_stats_t* stats = &queue->frame_stats;
+
+    const uint64_t sort_start = stm_now();
+    const int num_items = build_sort_items(queue);
+    const int sorted = radix_sort_items(queue, num_items);
+    const uint32_t* items = queue->items[sorted];
+    stats->sort_ms += stm_ms(stm_since(sort_start));
+
+    uint32_t applied_pip = SG_INVALID_ID;
+    /* batch whose bindings and fragment shader uniforms are applied, -1 if none */
+    int bound_batch = -1;
+    int fs_uniforms_batch = -1;
+
+    for (int i = 0; i < num_items; ++i) {
+        const bool instanced = (items[i] & LOPGL_SORT_ITEM_BATCH) != 0;
+        const _queued_draw_t* draw = instanced ? NULL : &queue->draws[items[i]];
+        const int batch_index = instanced ? (int)(items[i] & ~LOPGL_SORT_ITEM_BATCH) : draw->batch;
+        _draw_batch_t* batch = &queue->batches[batch_index];
+        const sg_pipeline pip = instanced ? batch->instanced_pip : batch->pip;
+
+        /* applying a pipeline resets the bindings and uniforms */
+        if (pip.id != applied_pip) {
+            lopgl_apply_pipeline(pip);
+            applied_pip = pip.id;
+            bound_batch = -1;
+            fs_uniforms_batch = -1;
+            ++stats->pipeline_changes;
+        }
+
+        if (instanced) {
+            sg_bindings bind = batch->mesh.bind;
+            bind.vertex_buffers[batch->instance_buffer_index] = instances.buffer;
+            bind.vertex_buffer_offsets[batch->instance_buffer_index] = instances.offset + batch->first_instance * (int)sizeof(hmm_mat4);
+            sg_apply_bindings(&bind);
+            bound_batch = -1;
+            ++stats->binding_changes;
+        } else if (bound_batch < 0 || (bound_batch != batch_index &&
+                   memcmp(&queue->batches[bound_batch].mesh.bind, &batch->mesh.bind, sizeof(sg_bindings)) != 0)) {
+            sg_apply_bindings(&batch->mesh.bind);
+            bound_batch = batch_index;
+            ++stats->binding_changes;
+        }
+
+        /* different batches often share their fragment shader uniforms */
+        if (batch->fs_uniforms_size > 0 && fs_uniforms_batch != batch_index) {
+            if (lopgl_apply_uniforms(SG_SHADERSTAGE_FS, batch->fs_uniform_slot, batch->fs_uniforms, batch->fs_uniforms_size)) {
+                ++stats->uniform_updates;
+            }
+            fs_uniforms_batch = batch_index;
+        }
+
+        if (instanced) {
+            if (lopgl_apply_uniforms(SG_SHADERSTAGE_VS, batch->vs_uniform_slot, batch->vs_uniforms, batch->vs_uniforms_size)) {
+                ++stats->uniform_updates;
+            }
+            sg_draw(batch->mesh.base_element, batch->mesh.num_elements, batch->num_draws);
+            ++stats->instanced_draws;
+            stats->instances += batch->num_draws;
+        } else {
+            /* the model matrix differs for every draw, which isn't worth hashing */
+            memcpy(batch->vs_uniforms + batch->model_offset, &draw->model, sizeof(hmm_mat4));
+            sg_apply_uniforms(SG_SHADERSTAGE_VS, batch->vs_uniform_slot, batch->vs_uniforms, batch->vs_uniforms_size);
+            forget_uniforms(&_lopgl.uniform_cache, SG_SHADERSTAGE_VS, batch->vs_uniform_slot);
+            sg_draw(batch->mesh.base_element, batch->mesh.num_elements, 1);
+            ++stats->uniform_updates;
+        }
+        ++stats->draw_calls;
+    }
+
+    stats->queued_draws += queue->num_draws;
+    stats->batches += queue->num_batches;
+
+    queue->num_draws = 0;
+    queue->num_batches = 0;
+    queue->num_bindings = 0;
+    memset(queue->table, 0, sizeof(queue->table));
+    memset(queue->recent_batches, 0, sizeof(queue->recent_batches));
+
+    stats->flush_ms += stm_ms(stm_since(start));
+}
+
+lopgl_draw_stats_t lopgl_get_draw_stats() {
+    return _lopgl.draw_queue.stats;
+}
+
+static void reset_draw_stats(_draw_queue_t* queue) {
+    queue->stats = queue->frame_stats;
+    memset(&queue->frame_stats, 0, sizeof(queue->frame_stats));
+}
+
+static void destroy_draw_queue(_draw_queue_t* queue) {
+    free(queue->draws);
+    free(queue->batches);
+    free(queue->instances);
+    for (int i = 0; i < 2; ++i) {
+        free(queue->keys[i]);
+        free(queue->items[i]);
+    }
+    lopgl_destroy_stream_buffer(&queue->instance_buffer);
+}
+
+/*=== UNIFORM CACHE IMPLEMENTATION ==================================================*/
+
+/* FNV-1a over 64-bit words in four interleaved lanes */
+static uint64_t hash_uniforms(const void* data, int num_bytes) {
+    const uint64_t prime = 1099511628211ull;
+    const uint8_t* bytes = (const uint8_t*) data;
+    uint64_t lanes[4] = {
+        14695981039346656037ull, 14695981039346656037ull ^ 1u,
+        14695981039346656037ull ^ 2u, 14695981039346656037ull ^ 3u
+    };
+    int i = 0;
+    for (; i + 32 <= num_bytes; i += 32) {
+        uint64_t words[4];
+        memcpy(words, bytes + i, 32);
+        for (int lane = 0; lane < 4; ++lane) {
+            lanes[lane] = (lanes[lane] ^ words[lane]) * prime;
+        }
+    }
+    for (; i < num_bytes; ++i) {
+        lanes[0] = (lanes[0] ^ bytes[i]) * prime;
+    }
+    return ((lanes[0] * prime ^ lanes[1]) * prime ^ lanes[2]) * prime ^ lanes[3];
+}
+
+static void forget_uniforms(_uniform_cache_t* cache, sg_shader_stage stage, int ub_index) {
+    cache->applied[stage][ub_index].pip_id = SG_INVALID_ID;
+}
+
+static void forget_all_uniforms(_uniform_cache_t* cache) {
+    for (int stage = 0; stage < SG_NUM_SHADER_STAGES; ++stage) {
+        for (int ub_index = 0; ub_index < SG_MAX_SHADERSTAGE_UBS; ++ub_index) {
+            forget_uniforms(cache, stage, ub_index);
+        }
+    }
+}
+
+void lopgl_apply_pipeline(sg_pipeline pip) {
+    _uniform_cache_t* cache = &_lopgl.uniform_cache;
+    sg_apply_pipeline(pip);
+    cache->pip_id = pip.id;
+    if (!cache->persistent) {
+        forget_all_uniforms(cache);
+    }
+}
+
+bool lopgl_apply_uniforms(sg_shader_stage stage, int ub_index, const void* data, int num_bytes) {
+    _uniform_cache_t* cache = &_lopgl.uniform_cache;
+    assert((int)stage < SG_NUM_SHADER_STAGES && ub_index >= 0 && ub_index < SG_MAX_SHADERSTAGE_UBS);
+    _applied_uniforms_t* applied = &cache->applied[stage][ub_index];
+
+    const uint64_t hash = cache->disabled ? 0 : hash_uniforms(data, num_bytes);
+    if (!cache->disabled && applied->pip_id == cache->pip_id && applied->size == num_bytes && applied->hash == hash) {
+        ++cache->frame_stats.skipped;
+        cache->frame_stats.bytes_skipped += (uint32_t)num_bytes;
+        return false;
+    }
+
+    sg_apply_uniforms(stage, ub_index, data, num_bytes);
+    /* replaces what was applied to this slot through any other pipeline, which might share the shader */
+    applied->pip_id = cache->disabled ? SG_INVALID_ID : cache->pip_id;
+    applied->size = num_bytes;
+    applied->hash = hash;
+
+    ++cache->frame_stats.applied;
+    cache->frame_stats.bytes_applied += (uint32_t)num_bytes;
+    return true;
+}
+
+void lopgl_set_uniform_cache(bool enabled) {
+    _lopgl.uniform_cache.disabled = !enabled;
+}
+
+lopgl_uniform_stats_t lopgl_get_uniform_stats() {
+    return _lopgl.uniform_cache.stats;
+}
+
+/* frames end with a new pass, which has to apply its pipelines again */
+static void reset_uniform_cache(_uniform_cache_t* cache) {
+    cache->stats = cache->frame_stats;
+    memset(&cache->frame_stats, 0, sizeof(cache->frame_stats));
+    if (!cache->persistent) {
+        forget_all_uniforms(cache);
+    }
+}
+
+/*=== FRAME ARENA IMPLEMENTATION ==================================================*/
+
+void* lopgl_frame_alloc(size_t size, size_t align) {
+    _frame_arena_t* arena = &_lopgl.frame_arena;
+    assert(lopgl_job_thread_index() == 0);
+    if (align == 0) {
+        align = 16;
+    }
+    assert((align & (align - 1)) == 0);
+
+    uint8_t* buffer = arena->buffers[arena->current];
+    if (!buffer) {
+        buffer = (uint8_t*)malloc(LOPGL_FRAME_ARENA_SIZE);
+        arena->buffers[arena->current] = buffer;
+    }
+
+    /* aligns the address rather than the offset, so alignments beyond malloc's work as well */
+    const uintptr_t base = (uintptr_t)buffer;
+    const size_t offset = ((base + arena->offset + align - 1) & ~(uintptr_t)(align - 1)) - base;
+    if (offset > LOPGL_FRAME_ARENA_SIZE || size > LOPGL_FRAME_ARENA_SIZE - offset) {
+        ++arena->frame_stats.failed;
+        return NULL;
+    }
+
+    arena->offset = offset + size;
+    ++arena->frame_stats.allocations;
+    arena->frame_stats.used = (uint32_t)arena->offset;
+    if (arena->frame_stats.used > arena->frame_stats.high_water) {
+        arena->frame_stats.high_water = arena->frame_stats.used;
+    }
+    return buffer + offset;
+}
+
+lopgl_frame_arena_stats_t lopgl_get_frame_arena_stats() {
+    return _lopgl.frame_arena.stats;
+}
+
+static void reset_frame_arena(_frame_arena_t* arena) {
+    arena->stats = arena->frame_stats;
+    arena->stats.capacity = LOPGL_FRAME_ARENA_SIZE;
+    arena->frame_stats.used = 0;
+    arena->frame_stats.allocations = 0;
+    arena->frame_stats.failed = 0;
+
+    arena->current = (arena->current + 1) % LOPGL_FRAME_ARENA_BUFFERS;
+    arena->offset = 0;
+}
+
+static void destroy_frame_arena(_frame_arena_t* arena) {
+    for (int i = 0; i < LOPGL_FRAME_ARENA_BUFFERS; ++i) {
+        free(arena->buffers[i]);
+        arena->buffers[i] = NULL;
+    }
+}
+
+/*=== JOB SYSTEM IMPLEMENTATION ==================================================*/
+
+#ifdef LOPGL_USE_THREADS
+
+static __thread int _job_thread_index;
+
+static inline int job_atomic_load(int* ptr) { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
+static inline void job_atomic_store(int* ptr, int value) { __atomic_store_n(ptr, value, __ATOMIC_SEQ_CST); }
+static inline int job_atomic_add(int* ptr, int value) { return __atomic_add_fetch(ptr, value, __ATOMIC_SEQ_CST); }
+
+static inline void job_lock(int* lock) {
+    while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE)) {
+        while (__atomic_load_n(lock, __ATOMIC_RELAXED)) {}
+    }
+}
+
+static inline void job_unlock(int* lock) {
+    __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+/* returns false when the deque is full */
+static bool push_job(_job_deque_t* deque, _job_t* job) {
+    const int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_SEQ_CST);
+    const int64_t top = __atomic_load_n(&deque->top, __ATOMIC_SEQ_CST);
+    if (bottom - top >= LOPGL_JOB_QUEUE_SIZE) {
+        return false;
+    }
+    __atomic_store_n(&deque->entries[bottom & (LOPGL_JOB_QUEUE_SIZE - 1)], job, __ATOMIC_RELAXED);
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_SEQ_CST);
+    return true;
+}
+
+/* takes the job pushed last, only called by the owning thread */
+static _job_t* pop_job(_job_deque_t* deque) {
+    const int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_SEQ_CST) - 1;
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_SEQ_CST);
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_SEQ_CST);
+    if (top > bottom) {
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_SEQ_CST);
+        return NULL;
+    }
+    _job_t* job = __atomic_load_n(&deque->entries[bottom & (LOPGL_JOB_QUEUE_SIZE - 1)], __ATOMIC_RELAXED);
+    if (top == bottom) {
+        /* the last job, thieves may be taking it at the same time */
+        if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+            job = NULL;
+        }
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_SEQ_CST);
+    }
+    return job;
+}
+
+/* takes the job pushed first, returns NULL when empty or when another thread was faster */
+static _job_t* steal_job(_job_deque_t* deque) {
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_SEQ_CST);
+    const int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_SEQ_CST);
+    if (top >= bottom) {
+        return NULL;
+    }
+    _job_t* job = __atomic_load_n(&deque->entries[top & (LOPGL_JOB_QUEUE_SIZE - 1)], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        return NULL;
+    }
+    return job;
+}
+
+/* own jobs first, newest first so that they are still in the cache, then the oldest job of another thread */
+static _job_t* next_job(_job_system_t* jobs) {
+    _job_thread_t* self = &jobs->threads[_job_thread_index];
+    _job_t* job = pop_job(&self->deque);
+    for (int i = 1; !job && i < jobs->num_threads; ++i) {
+        job = steal_job(&jobs->threads[(_job_thread_index + i) % jobs->num_threads].deque);
+        if (job) {
+            job_atomic_add(&self->stolen, 1);
+        }
+    }
+    if (job) {
+        job_atomic_add(&jobs->queued, -1);
+    }
+    return job;
+}
+
+#else
+
+static const int _job_thread_index = 0;
+
+static inline int job_atomic_load(int* ptr) { return *ptr; }
+static inline void job_atomic_store(int* ptr, int value) { *ptr = value; }
+static inline int job_atomic_add(int* ptr, int value) { return *ptr += value; }
+static inline void job_lock(int* lock) { (void)lock; }
+static inline void job_unlock(int* lock) { (void)lock; }
+
+#endif
+
+static void execute_job(_job_system_t* jobs, _job_t* job);
+
+/* returns NULL when all pool slots of the calling thread are taken */
+static _job_t* alloc_job(_job_system_t* jobs) {
+    _job_thread_t* self = &jobs->threads[_job_thread_index];
+    _job_t* job = &self->pool[self->next_job & (LOPGL_JOB_QUEUE_SIZE - 1)];
+    if (job_atomic_load(&job->busy)) {
+        return NULL;
+    }
+    ++self->next_job;
+    job_atomic_store(&job->busy, 1);
+    return job;
+}
+
+static void queue_job(_job_system_t* jobs, _job_t* job) {
+#ifdef LOPGL_USE_THREADS
+    if (jobs->num_started > 1 && push_job(&jobs->threads[_job_thread_index].deque, job)) {
+        /* sleeping is raised before a worker checks queued, so either the worker
+           sees the new job or this thread sees the worker and wakes it */
+        job_atomic_add(&jobs->queued, 1);
+        if (job_atomic_load(&jobs->sleeping) > 0) {
+            pthread_mutex_lock(&jobs->mutex);
+            pthread_cond_signal(&jobs->work_cond);
+            pthread_mutex_unlock(&jobs->mutex);
+        }
+        return;
+    }
+#endif
+    /* single threaded or the deque is full */
+    execute_job(jobs, job);
+}
+
+/* Decrements the counter under its lock, which lopgl_wait_jobs() takes once
+   before returning, so the counter isn't touched after the waiter moved on. */
+static void signal_counter(_job_system_t* jobs, lopgl_job_counter_t* counter) {
+    job_lock(&counter->_lock);
+    _job_t* waiting = NULL;
+    if (job_atomic_add(&counter->count, -1) == 0) {
+        waiting = counter->_waiting;
+        counter->_waiting = NULL;
+    }
+    job_unlock(&counter->_lock);
+
+    while (waiting) {
+        _job_t* next = waiting->next;
+        queue_job(jobs, waiting);
+        waiting = next;
+    }
+}
+
+/* adds the job to the waiting list of the counter, returns false when the counter already reached zero */
+static bool defer_job(lopgl_job_counter_t* after, _job_t* job) {
+    job_lock(&after->_lock);
+    const bool pending = job_atomic_load(&after->count) > 0;
+    if (pending) {
+        job->next = after->_waiting;
+        after->_waiting = job;
+    }
+    job_unlock(&after->_lock);
+    return pending;
+}
+
+/* splits off the upper half while the range is larger than the grain, then runs the rest */
+static void run_range(_job_system_t* jobs, const _job_t* job) {
+    int end = job->end;
+    while (end - job->begin > job->grain) {
+        _job_t* part = alloc_job(jobs);
+        if (!part) {
+            /* no free pool slot, run the remaining parts here */
+            for (int begin = job->begin; begin < end; begin += job->grain) {
+                job->range_func(begin, HMM_MIN(begin + job->grain, end), job->user_data);
+            }
+            return;
+        }
+        const int mid = job->begin + (end - job->begin) / 2;
+        part->func = NULL;
+        part->range_func = job->range_func;
+        part->user_data = job->user_data;
+        part->begin = mid;
+        part->end = end;
+        part->grain = job->grain;
+        part->counter = job->counter;
+        part->next = NULL;
+        job_atomic_add(&job->counter->count, 1);
+        queue_job(jobs, part);
+        end = mid;
+    }
+    job->range_func(job->begin, end, job->user_data);
+}
+
+static void execute_job(_job_system_t* jobs, _job_t* job) {
+    if (job->range_func) {
+        run_range(jobs, job);
+    }
+    else {
+        job->func(job->user_data);
+    }
+    lopgl_job_counter_t* counter = job->counter;
+    job_atomic_store(&job->busy, 0);
+    job_atomic_add(&jobs->threads[_job_thread_index].executed, 1);
+    if (counter) {
+        signal_counter(jobs, counter);
+    }
+}
+
+void lopgl_run_job(const lopgl_job_desc_t* desc) {
+    assert(desc->func);
+    _job_system_t* jobs = &_lopgl.jobs;
+    if (desc->counter) {
+        job_atomic_add(&desc->counter->count, 1);
+    }
+
+    _job_t* job = alloc_job(jobs);
+    if (!job) {
+        /* every pool slot of this thread is taken, run the job right away */
+        if (desc->after) {
+            lopgl_wait_jobs(desc->after);
+        }
+        desc->func(desc->user_data);
+        job_atomic_add(&jobs->threads[_job_thread_index].executed, 1);
+        if (desc->counter) {
+            signal_counter(jobs, desc->counter);
+        }
+        return;
+    }
+
+    job->func = desc->func;
+    job->range_func = NULL;
+    job->user_data = desc->user_data;
+    job->counter = desc->counter;
+    job->next = NULL;
+    if (desc->after && defer_job(desc->after, job)) {
+        return;
+    }
+    queue_job(jobs, job);
+}
+
+void lopgl_wait_jobs(lopgl_job_counter_t* counter) {
+#ifdef LOPGL_USE_THREADS
+    _job_system_t* jobs = &_lopgl.jobs;
+    if (jobs->num_started > 1) {
+        while (job_atomic_load(&counter->count) > 0) {
+            /* the jobs counted may be in this thread's deque, or stolen ones may still run elsewhere */
+            _job_t* job = next_job(jobs);
+            if (job) {
+                execute_job(jobs, job);
+            }
+            else {
+                sched_yield();
+            }
+        }
+    }
+#endif
+    /* without worker threads every job ran when it was started or when the counter it waited for reached zero */
+    assert(job_atomic_load(&counter->count) == 0);
+    /* the thread that signalled the counter last may still hold its lock */
+    job_lock(&counter->_lock);
+    job_unlock(&counter->_lock);
+}
+
+void lopgl_parallel_for(int count, int grain_size, lopgl_range_func_t func, void* user_data) {
+    _job_system_t* jobs = &_lopgl.jobs;
+    if (count <= 0) {
+        return;
+    }
+    if (grain_size <= 0) {
+        /* a few parts per thread, so that threads finishing early can steal the rest */
+        const int num_parts = jobs->num_started * 4;
+        grain_size = (count + num_parts - 1) / num_parts;
+    }
+    if (jobs->num_started == 1 || count <= grain_size) {
+        func(0, count, user_data);
+        return;
+    }
+
+    /* the calling thread runs the first part and helps with the others */
+    lopgl_job_counter_t counter = { 0 };
+    run_range(jobs, &(_job_t){
+        .range_func = func,
+        .user_data = user_data,
+        .begin = 0,
+        .end = count,
+        .grain = grain_size,
+        .counter = &counter
+    });
+    lopgl_wait_jobs(&counter);
+}
+
+int lopgl_job_threads() {
+    return _lopgl.jobs.num_started;
+}
+
+int lopgl_job_thread_index() {
+    return _job_thread_index;
+}
+
+lopgl_job_stats_t lopgl_get_job_stats() {
+    return _lopgl.jobs.stats;
+}
+
+#ifdef LOPGL_USE_THREADS
+
+static void* job_worker_main(void* arg) {
+    _job_system_t* jobs = &_lopgl.jobs;
+    _job_thread_index = (int)(intptr_t)arg;
+
+    for (;;) {
+        _job_t* job = next_job(jobs);
+        if (job) {
+            execute_job(jobs, job);
+            continue;
+        }
+
+        pthread_mutex_lock(&jobs->mutex);
+        job_atomic_add(&jobs->sleeping, 1);
+        while (job_atomic_load(&jobs->queued) <= 0 && !jobs->quit) {
+            pthread_cond_wait(&jobs->work_cond, &jobs->mutex);
+        }
+        job_atomic_add(&jobs->sleeping, -1);
+        const bool quit = jobs->quit;
+        pthread_mutex_unlock(&jobs->mutex);
+        if (quit) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+#endif
+
+static void start_jobs(_job_system_t* jobs) {
+    int num_threads = 1;
+#ifdef LOPGL_USE_THREADS
+    num_threads = LOPGL_JOB_THREADS > 0 ? LOPGL_JOB_THREADS : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = HMM_Clamp(1, num_threads, LOPGL_MAX_JOB_THREADS);
+#endif
+    jobs->threads = (_job_thread_t*)calloc((size_t)num_threads, sizeof(_job_thread_t));
+    jobs->num_threads = num_threads;
+    jobs->num_started = 1;
+
+#ifdef LOPGL_USE_THREADS
+    pthread_mutex_init(&jobs->mutex, NULL);
+    pthread_cond_init(&jobs->work_cond, NULL);
+    for (int i = 1; i < num_threads; ++i) {
+        if (pthread_create(&jobs->threads[i].thread, NULL, job_worker_main, (void*)(intptr_t)i) != 0) {
+            /* the deques of the missing threads stay empty, the others run all jobs */
+            LOPGL_LOG("Failed to start all job threads");
+            break;
+        }
+        ++jobs->num_started;
+    }
+#endif
+    /* the workers start in order, so the indices of the running threads are below num_started */
+    jobs->stats.threads = jobs->num_started;
+}
+
+static void stop_jobs(_job_system_t* jobs) {
+#ifdef LOPGL_USE_THREADS
+    pthread_mutex_lock(&jobs->mutex);
+    jobs->quit = true;
+    pthread_cond_broadcast(&jobs->work_cond);
+    pthread_mutex_unlock(&jobs->mutex);
+
+    for (int i = 1; i < jobs->num_started; ++i) {
+        pthread_join(jobs->threads[i].thread, NULL);
+    }
+    pthread_cond_destroy(&jobs->work_cond);
+    pthread_mutex_destroy(&jobs->mutex);
+#endif
+    free(jobs->threads);
+    memset(jobs, 0, sizeof(_job_system_t));
+}
+
+static void update_job_stats(_job_system_t* jobs) {
+    int executed = 0;
+    int stolen = 0;
+    for (int i = 0; i < jobs->num_threads; ++i) {
+        executed += job_atomic_load(&jobs->threads[i].executed);
+        stolen += job_atomic_load(&jobs->threads[i].stolen);
+    }
+    jobs->stats.jobs = executed - jobs->executed;
+    jobs->stats.steals = stolen - jobs->stolen;
+    jobs->executed = executed;
+    jobs->stolen = stolen;
+}
+
 /*=== ORBITAL CAM IMPLEMENTATION ==================================================*/
 
 static void update_orbital_cam_vectors(struct orbital_cam* camera) {
@@ -0,0 +1,576 @@
+#ifndef LOPGL_BVH_INCLUDED
+#define LOPGL_BVH_INCLUDED
+
+#include <stdbool.h>
+#include "../libs/hmm/HandmadeMath.h"
+/* for lopgl_frustum_planes() */
+#include "lopgl_transforms.h"
+
+/*
+    Bounding volume hierarchy over the axis aligned bounding boxes of scene
+    objects, for frustum culling, picking with rays and finding the objects
+    within a light's radius without walking all of them.
+
+    The tree is built top down with the surface area heuristic, evaluated
+    over 16 bins of the object centroids per axis. The nodes live in one
+    flat array of 32 byte nodes, the two children of a node are next to each
+    other and always come after their parent. That makes a refit a single
+    backwards pass over the array, which keeps the tree usable while the
+    objects move. The tree gets worse the farther the objects move from where
+    they were when it was built, rebuild it from time to time.
+
+    Nothing here depends on sokol, the queries only read the tree so they can
+    run on several threads at once.
+
+    Define LOPGL_BVH_IMPL in one file before including this header.
+*/
+
+typedef struct lopgl_aabb_t {
+    hmm_vec3 min;
+    hmm_vec3 max;
+} lopgl_aabb_t;
+
+typedef struct lopgl_bvh_desc_t {
+    int capacity;                   /* maximum number of objects (required) */
+} lopgl_bvh_desc_t;
+
+typedef struct lopgl_bvh_node_t {
+    hmm_vec3 min;
+    int first;                      /* first child of inner nodes, first object of leaves */
+    hmm_vec3 max;
+    int count;                      /* objects of leaves, 0 for inner nodes */
+} lopgl_bvh_node_t;
+
+typedef struct lopgl_bvh_t {
+    int count;
+    int capacity;
+    int num_nodes;
+    int depth;                      /* levels of the last build */
+    lopgl_bvh_node_t* nodes;        /* the root is the first node */
+    int* indices;                   /* object indices in leaf order */
+    lopgl_aabb_t* _bounds;          /* object bounds in leaf order */
+    hmm_vec3* _centroids;
+} lopgl_bvh_t;
+
+/* nearest object hit by a ray */
+typedef struct lopgl_bvh_hit_t {
+    int object;
+    float t;                        /* distance along the ray in multiples of its direction */
+} lopgl_bvh_hit_t;
+
+void lopgl_init_bvh(lopgl_bvh_t* bvh, const lopgl_bvh_desc_t* desc);
+
+void lopgl_destroy_bvh(lopgl_bvh_t* bvh);
+
+/* builds the tree over count objects */
+void lopgl_build_bvh(lopgl_bvh_t* bvh, const lopgl_aabb_t* bounds, int count);
+
+/* updates the tree to the new bounds of the objects it was built over */
+void lopgl_refit_bvh(lopgl_bvh_t* bvh, const lopgl_aabb_t* bounds);
+
+/* Writes the indices of the objects that intersect the view frustum to out and returns
+   their number, at most max_out. The boxes are tested against the planes of the
+   frustum, a few boxes close to its edges can be outside of it. */
+int lopgl_query_bvh_frustum(const lopgl_bvh_t* bvh, hmm_mat4 view_projection, int* out, int max_out);
+
+/* writes the indices of the objects that intersect the sphere to out and returns their number, at most max_out */
+int lopgl_query_bvh_sphere(const lopgl_bvh_t* bvh, hmm_vec3 center, float radius, int* out, int max_out);
+
+/* finds the nearest object box hit by the ray up to max_t, returns false when there is none */
+bool lopgl_raycast_bvh(const lopgl_bvh_t* bvh, hmm_vec3 origin, hmm_vec3 direction, float max_t, lopgl_bvh_hit_t* hit);
+
+/* The tests the queries use on each object box, for walking objects without a tree.
+   The planes come from lopgl_frustum_planes() of lopgl_transforms.h. */
+bool lopgl_aabb_in_frustum(const lopgl_aabb_t* box, const hmm_vec4 planes[6]);
+
+bool lopgl_aabb_in_sphere(const lopgl_aabb_t* box, hmm_vec3 center, float radius);
+
+/* returns the distance to the box along the ray, or a negative value when the ray misses it */
+float lopgl_ray_aabb(const lopgl_aabb_t* box, hmm_vec3 origin, hmm_vec3 inv_direction, float max_t);
+
+#endif /*LOPGL_BVH_INCLUDED*/
+
+
+/*--- IMPLEMENTATION ---------------------------------------------------------*/
+#ifdef LOPGL_BVH_IMPL
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <assert.h>
+
+#define _LOPGL_BVH_BINS 16
+/* Nodes with up to this many objects are leaves, testing a few boxes stored next to
+   each other costs about as much as testing the two children of a node. */
+#define _LOPGL_BVH_MIN_LEAF_SIZE 4
+/* nodes with more objects are always split */
+#define _LOPGL_BVH_MAX_LEAF_SIZE 8
+/* cost of visiting a node relative to testing an object */
+#define _LOPGL_BVH_TRAVERSAL_COST 1.0f
+/* Deeper nodes are split in the middle, which bounds the depth to this plus
+   log2 of the capacity and keeps the traversal stacks small. */
+#define _LOPGL_BVH_SAH_DEPTH 40
+#define _LOPGL_BVH_STACK_SIZE 96
+
+/*=== BOUNDS =======================================================*/
+
+static inline lopgl_aabb_t empty_aabb(void) {
+    return (lopgl_aabb_t){ HMM_Vec3(FLT_MAX, FLT_MAX, FLT_MAX), HMM_Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX) };
+}
+
+static inline void grow_aabb(lopgl_aabb_t* box, hmm_vec3 min, hmm_vec3 max) {
+    box->min = HMM_Vec3(HMM_MIN(box->min.X, min.X), HMM_MIN(box->min.Y, min.Y), HMM_MIN(box->min.Z, min.Z));
+    box->max = HMM_Vec3(HMM_MAX(box->max.X, max.X), HMM_MAX(box->max.Y, max.Y), HMM_MAX(box->max.Z, max.Z));
+}
+
+/* half the surface area, which is all the heuristic needs */
+static inline float aabb_area(const lopgl_aabb_t* box) {
+    const hmm_vec3 e = HMM_SubtractVec3(box->max, box->min);
+    return e.X < 0.0f ? 0.0f : e.X * e.Y + e.Y * e.Z + e.Z * e.X;
+}
+
+/* the corner of the box farthest along the plane normal */
+static inline float plane_distance_max(const hmm_vec4* plane, const hmm_vec3* min, const hmm_vec3* max) {
+    return plane->X * (plane->X > 0.0f ? max->X : min->X) + plane->Y * (plane->Y > 0.0f ? max->Y : min->Y) +
+           plane->Z * (plane->Z > 0.0f ? max->Z : min->Z) + plane->W;
+}
+
+static inline float plane_distance_min(const hmm_vec4* plane, const hmm_vec3* min, const hmm_vec3* max) {
+    return plane->X * (plane->X > 0.0f ? min->X : max->X) + plane->Y * (plane->Y > 0.0f ? min->Y : max->Y) +
+           plane->Z * (plane->Z > 0.0f ? min->Z : max->Z) + plane->W;
+}
+
+bool lopgl_aabb_in_frustum(const lopgl_aabb_t* box, const hmm_vec4 planes[6]) {
+    for (int i = 0; i < 6; ++i) {
+        if (plane_distance_max(&planes[i], &box->min, &box->max) < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline float distance_squared_aabb(const hmm_vec3* min, const hmm_vec3* max, hmm_vec3 p) {
+    const float dx = HMM_MAX(HMM_MAX(min->X - p.X, p.X - max->X), 0.0f);
+    const float dy = HMM_MAX(HMM_MAX(min->Y - p.Y, p.Y - max->Y), 0.0f);
+    const float dz = HMM_MAX(HMM_MAX(min->Z - p.Z, p.Z - max->Z), 0.0f);
+    return dx * dx + dy * dy + dz * dz;
+}
+
+bool lopgl_aabb_in_sphere(const lopgl_aabb_t* box, hmm_vec3 center, float radius) {
+    return distance_squared_aabb(&box->min, &box->max, center) <= radius * radius;
+}
+
+static inline float ray_box(const hmm_vec3* min, const hmm_vec3* max, hmm_vec3 origin, hmm_vec3 inv_direction, float max_t) {
+    const float tx0 = (min->X - origin.X) * inv_direction.X;
+    const float tx1 = (max->X - origin.X) * inv_direction.X;
+    const float ty0 = (min->Y - origin.Y) * inv_direction.Y;
+    const float ty1 = (max->Y - origin.Y) * inv_direction.Y;
+    const float tz0 = (min->Z - origin.Z) * inv_direction.Z;
+    const float tz1 = (max->Z - origin.Z) * inv_direction.Z;
+    const float t_enter = HMM_MAX(HMM_MAX(HMM_MIN(tx0, tx1), HMM_MIN(ty0, ty1)), HMM_MAX(HMM_MIN(tz0, tz1), 0.0f));
+    const float t_exit = HMM_MIN(HMM_MIN(HMM_MAX(tx0, tx1), HMM_MAX(ty0, ty1)), HMM_MIN(HMM_MAX(tz0, tz1), max_t));
+    return t_enter <= t_exit ? t_enter : -1.0f;
+}
+
+float lopgl_ray_aabb(const lopgl_aabb_t* box, hmm_vec3 origin, hmm_vec3 inv_direction, float max_t) {
+    return ray_box(&box->min, &box->max, origin, inv_direction, max_t);
+}
+
+/*=== BUILD ========================================================*/
+
+typedef struct _lopgl_bvh_bin_t {
+    lopgl_aabb_t bounds;
+    int count;
+} _lopgl_bvh_bin_t;
+
+static inline int bin_index(float centroid, float min, float scale) {
+    const int bin = (int)((centroid - min) * scale);
+    return bin < _LOPGL_BVH_BINS - 1 ? bin : _LOPGL_BVH_BINS - 1;
+}
+
+static void set_node_bounds(lopgl_bvh_node_t* node, const lopgl_aabb_t* box) {
+    node->min = box->min;
+    node->max = box->max;
+}
+
+/* splits the node into two children appended to the nodes, or leaves it a leaf */
+static void split_node(lopgl_bvh_t* bvh, int node_index, bool sah) {
+    lopgl_bvh_node_t* node = &bvh->nodes[node_index];
+    const int first = node->first;
+    const int count = node->count;
+    if (count <= _LOPGL_BVH_MIN_LEAF_SIZE) {
+        return;
+    }
+
+    lopgl_aabb_t centroid_bounds = empty_aabb();
+    for (int i = first; i < first + count; ++i) {
+        grow_aabb(&centroid_bounds, bvh->_centroids[i], bvh->_centroids[i]);
+    }
+
+    /* best split over the bins of all axes, cost relative to testing all objects of the node */
+    const lopgl_aabb_t node_bounds = { node->min, node->max };
+    const float node_area = aabb_area(&node_bounds);
+    float best_cost = FLT_MAX;
+    int best_axis = -1;
+    int best_bin = 0;
+    lopgl_aabb_t best_left = empty_aabb(), best_right = empty_aabb();
+    if (sah) {
+        /* all three axes are binned in one pass over the objects */
+        _lopgl_bvh_bin_t bins[3][_LOPGL_BVH_BINS];
+        float scales[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            const float extent = centroid_bounds.max.Elements[axis] - centroid_bounds.min.Elements[axis];
+            scales[axis] = extent > 0.0f ? _LOPGL_BVH_BINS / extent : 0.0f;
+            for (int b = 0; b < _LOPGL_BVH_BINS; ++b) {
+                bins[axis][b] = (_lopgl_bvh_bin_t){ empty_aabb(), 0 };
+            }
+        }
+        for (int i = first; i < first + count; ++i) {
+            const lopgl_aabb_t* box = &bvh->_bounds[i];
+            for (int axis = 0; axis < 3; ++axis) {
+                _lopgl_bvh_bin_t* bin = &bins[axis][bin_index(bvh->_centroids[i].Elements[axis], centroid_bounds.min.Elements[axis], scales[axis])];
+                grow_aabb(&bin->bounds, box->min, box->max);
+                ++bin->count;
+            }
+        }
+
+        for (int axis = 0; axis < 3; ++axis) {
+            if (scales[axis] == 0.0f) {
+                continue;
+            }
+            /* sweep from the right to get the cost of the right side of each split, then from the left */
+            lopgl_aabb_t right_bounds[_LOPGL_BVH_BINS - 1];
+            float right_costs[_LOPGL_BVH_BINS - 1];
+            lopgl_aabb_t sweep = empty_aabb();
+            int sweep_count = 0;
+            for (int b = _LOPGL_BVH_BINS - 1; b > 0; --b) {
+                grow_aabb(&sweep, bins[axis][b].bounds.min, bins[axis][b].bounds.max);
+                sweep_count += bins[axis][b].count;
+                right_bounds[b - 1] = sweep;
+                right_costs[b - 1] = (float)sweep_count * aabb_area(&sweep);
+            }
+            sweep = empty_aabb();
+            sweep_count = 0;
+            for (int b = 0; b < _LOPGL_BVH_BINS - 1; ++b) {
+                grow_aabb(&sweep, bins[axis][b].bounds.min, bins[axis][b].bounds.max);
+                sweep_count += bins[axis][b].count;
+                if (sweep_count == 0 || sweep_count == count) {
+                    continue;
+                }
+                const float cost = (float)sweep_count * aabb_area(&sweep) + right_costs[b];
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_bin = b;
+                    best_left = sweep;
+                    best_right = right_bounds[b];
+                }
+            }
+        }
+    }
+
+    int left_count = 0;
+    if (best_axis >= 0) {
+        const float split_cost = _LOPGL_BVH_TRAVERSAL_COST + best_cost / node_area;
+        if (count <= _LOPGL_BVH_MAX_LEAF_SIZE && split_cost >= (float)count) {
+            return;
+        }
+        /* partition the objects of the node, the leaf order arrays are swapped along */
+        const float min = centroid_bounds.min.Elements[best_axis];
+        const float scale = _LOPGL_BVH_BINS / (centroid_bounds.max.Elements[best_axis] - min);
+        int i = first;
+        int j = first + count - 1;
+        while (i <= j) {
+            if (bin_index(bvh->_centroids[i].Elements[best_axis], min, scale) <= best_bin) {
+                ++i;
+            }
+            else {
+                const int index = bvh->indices[i];
+                bvh->indices[i] = bvh->indices[j];
+                bvh->indices[j] = index;
+                const hmm_vec3 centroid = bvh->_centroids[i];
+                bvh->_centroids[i] = bvh->_centroids[j];
+                bvh->_centroids[j] = centroid;
+                const lopgl_aabb_t bounds = bvh->_bounds[i];
+                bvh->_bounds[i] = bvh->_bounds[j];
+                bvh->_bounds[j] = bounds;
+                --j;
+            }
+        }
+        left_count = i - first;
+    }
+    else {
+        /* the centroids are all in one place or the node is too deep, split the objects in order */
+        if (count <= _LOPGL_BVH_MAX_LEAF_SIZE) {
+            return;
+        }
+        left_count = count / 2;
+        for (int i = first; i < first + left_count; ++i) {
+            grow_aabb(&best_left, bvh->_bounds[i].min, bvh->_bounds[i].max);
+        }
+        for (int i = first + left_count; i < first + count; ++i) {
+            grow_aabb(&best_right, bvh->_bounds[i].min, bvh->_bounds[i].max);
+        }
+    }
+
+    const int child = bvh->num_nodes;
+    bvh->num_nodes += 2;
+    lopgl_bvh_node_t* left = &bvh->nodes[child];
+    lopgl_bvh_node_t* right = &bvh->nodes[child + 1];
+    *left = (lopgl_bvh_node_t){ .first = first, .count = left_count };
+    *right = (lopgl_bvh_node_t){ .first = first + left_count, .count = count - left_count };
+    set_node_bounds(left, &best_left);
+    set_node_bounds(right, &best_right);
+    node->first = child;
+    node->count = 0;
+}
+
+/*=== BVH ==========================================================*/
+
+void lopgl_init_bvh(lopgl_bvh_t* bvh, const lopgl_bvh_desc_t* desc) {
+    assert(desc->capacity > 0);
+    memset(bvh, 0, sizeof(lopgl_bvh_t));
+    bvh->capacity = desc->capacity;
+    /* a binary tree with one object per leaf has fewer than twice as many nodes as objects */
+    bvh->nodes = malloc((size_t)desc->capacity * 2 * sizeof(lopgl_bvh_node_t));
+    bvh->indices = malloc((size_t)desc->capacity * sizeof(int));
+    bvh->_bounds = malloc((size_t)desc->capacity * sizeof(lopgl_aabb_t));
+    bvh->_centroids = malloc((size_t)desc->capacity * sizeof(hmm_vec3));
+}
+
+void lopgl_destroy_bvh(lopgl_bvh_t* bvh) {
+    free(bvh->nodes);
+    free(bvh->indices);
+    free(bvh->_bounds);
+    free(bvh->_centroids);
+    memset(bvh, 0, sizeof(lopgl_bvh_t));
+}
+
+void lopgl_build_bvh(lopgl_bvh_t* bvh, const lopgl_aabb_t* bounds, int count) {
+    assert(count >= 0 && count <= bvh->capacity);
+    bvh->count = count;
+    bvh->num_nodes = 0;
+    bvh->depth = 0;
+    if (count == 0) {
+        return;
+    }
+
+    lopgl_aabb_t root_bounds = empty_aabb();
+    for (int i = 0; i < count; ++i) {
+        bvh->indices[i] = i;
+        bvh->_bounds[i] = bounds[i];
+        bvh->_centroids[i] = HMM_MultiplyVec3f(HMM_AddVec3(bounds[i].min, bounds[i].max), 0.5f);
+        grow_aabb(&root_bounds, bounds[i].min, bounds[i].max);
+    }
+    bvh->nodes[0] = (lopgl_bvh_node_t){ .first = 0, .count = count };
+    set_node_bounds(&bvh->nodes[0], &root_bounds);
+    bvh->num_nodes = 1;
+
+    /* The children are appended behind the nodes still to be split, so the nodes are
+       split level by level and each level ends where the nodes of the level before did. */
+    int level_end = 1;
+    bvh->depth = 1;
+    for (int n = 0; n < bvh->num_nodes; ++n) {
+        if (n == level_end) {
+            level_end = bvh->num_nodes;
+            ++bvh->depth;
+        }
+        split_node(bvh, n, bvh->depth < _LOPGL_BVH_SAH_DEPTH);
+    }
+    assert(bvh->depth < _LOPGL_BVH_STACK_SIZE);
+}
+
+void lopgl_refit_bvh(lopgl_bvh_t* bvh, const lopgl_aabb_t* bounds) {
+    for (int i = 0; i < bvh->count; ++i) {
+        bvh->_bounds[i] = bounds[bvh->indices[i]];
+    }
+    /* children come after their parents */
+    for (int n = bvh->num_nodes - 1; n >= 0; --n) {
+        lopgl_bvh_node_t* node = &bvh->nodes[n];
+        lopgl_aabb_t box = empty_aabb();
+        if (node->count > 0) {
+            for (int i = node->first; i < node->first + node->count; ++i) {
+                grow_aabb(&box, bvh->_bounds[i].min, bvh->_bounds[i].max);
+            }
+        }
+        else {
+            const lopgl_bvh_node_t* left = &bvh->nodes[node->first];
+            const lopgl_bvh_node_t* right = left + 1;
+            grow_aabb(&box, left->min, left->max);
+            grow_aabb(&box, right->min, right->max);
+        }
+        set_node_bounds(node, &box);
+    }
+}
+
+/*=== QUERIES ======================================================*/
+
+/* appends all objects below the node without testing them */
+static int append_subtree(const lopgl_bvh_t* bvh, int node_index, int* out, int num_out, int max_out) {
+    int stack[_LOPGL_BVH_STACK_SIZE];
+    int top = 0;
+    stack[top++] = node_index;
+    while (top > 0 && num_out < max_out) {
+        const lopgl_bvh_node_t* node = &bvh->nodes[stack[--top]];
+        if (node->count > 0) {
+            for (int i = node->first; i < node->first + node->count && num_out < max_out; ++i) {
+                out[num_out++] = bvh->indices[i];
+            }
+        }
+        else {
+            stack[top++] = node->first + 1;
+            stack[top++] = node->first;
+        }
+    }
+    return num_out;
+}
+
+int lopgl_query_bvh_frustum(const lopgl_bvh_t* bvh, hmm_mat4 view_projection, int* out, int max_out) {
+    if (bvh->num_nodes == 0) {
+        return 0;
+    }
+    hmm_vec4 planes[6];
+    lopgl_frustum_planes(view_projection, planes);
+
+    /* each entry keeps the planes its node isn't known to be inside of, one bit per plane */
+    int stack[_LOPGL_BVH_STACK_SIZE];
+    int masks[_LOPGL_BVH_STACK_SIZE];
+    int top = 0;
+    int num_out = 0;
+    stack[top] = 0;
+    masks[top++] = 0x3f;
+    while (top > 0 && num_out < max_out) {
+        --top;
+        const int node_index = stack[top];
+        const lopgl_bvh_node_t* node = &bvh->nodes[node_index];
+        int mask = masks[top];
+        bool outside = false;
+        for (int i = 0; i < 6; ++i) {
+            if (!(mask & (1 << i))) {
+                continue;
+            }
+            if (plane_distance_max(&planes[i], &node->min, &node->max) < 0.0f) {
+                outside = true;
+                break;
+            }
+            if (plane_distance_min(&planes[i], &node->min, &node->max) >= 0.0f) {
+                mask &= ~(1 << i);
+            }
+        }
+        if (outside) {
+            continue;
+        }
+        if (mask == 0) {
+            num_out = append_subtree(bvh, node_index, out, num_out, max_out);
+        }
+        else if (node->count > 0) {
+            for (int i = node->first; i < node->first + node->count && num_out < max_out; ++i) {
+                if (lopgl_aabb_in_frustum(&bvh->_bounds[i], planes)) {
+                    out[num_out++] = bvh->indices[i];
+                }
+            }
+        }
+        else {
+            stack[top] = node->first + 1;
+            masks[top++] = mask;
+            stack[top] = node->first;
+            masks[top++] = mask;
+        }
+    }
+    return num_out;
+}
+
+int lopgl_query_bvh_sphere(const lopgl_bvh_t* bvh, hmm_vec3 center, float radius, int* out, int max_out) {
+    if (bvh->num_nodes == 0) {
+        return 0;
+    }
+    const float radius_squared = radius * radius;
+    int stack[_LOPGL_BVH_STACK_SIZE];
+    int top = 0;
+    int num_out = 0;
+    stack[top++] = 0;
+    while (top > 0 && num_out < max_out) {
+        const lopgl_bvh_node_t* node = &bvh->nodes[stack[--top]];
+        if (distance_squared_aabb(&node->min, &node->max, center) > radius_squared) {
+            continue;
+        }
+        if (node->count > 0) {
+            for (int i = node->first; i < node->first + node->count && num_out < max_out; ++i) {
+                if (distance_squared_aabb(&bvh->_bounds[i].min, &bvh->_bounds[i].max, center) <= radius_squared) {
+                    out[num_out++] = bvh->indices[i];
+                }
+            }
+        }
+        else {
+            stack[top++] = node->first + 1;
+            stack[top++] = node->first;
+        }
+    }
+    return num_out;
+}
+
+bool lopgl_raycast_bvh(const lopgl_bvh_t* bvh, hmm_vec3 origin, hmm_vec3 direction, float max_t, lopgl_bvh_hit_t* hit) {
+    if (bvh->num_nodes == 0) {
+        return false;
+    }
+    const hmm_vec3 inv_direction = HMM_Vec3(1.0f / direction.X, 1.0f / direction.Y, 1.0f / direction.Z);
+    const lopgl_bvh_node_t* root = &bvh->nodes[0];
+    float root_t = ray_box(&root->min, &root->max, origin, inv_direction, max_t);
+    if (root_t < 0.0f) {
+        return false;
+    }
+
+    /* the nearer child is visited first, nodes farther than the nearest hit so far are skipped */
+    int stack[_LOPGL_BVH_STACK_SIZE];
+    float stack_t[_LOPGL_BVH_STACK_SIZE];
+    int top = 0;
+    stack[top] = 0;
+    stack_t[top++] = root_t;
+    hit->object = -1;
+    hit->t = max_t;
+    while (top > 0) {
+        --top;
+        if (stack_t[top] > hit->t) {
+            continue;
+        }
+        const lopgl_bvh_node_t* node = &bvh->nodes[stack[top]];
+        if (node->count > 0) {
+            for (int i = node->first; i < node->first + node->count; ++i) {
+                const float t = ray_box(&bvh->_bounds[i].min, &bvh->_bounds[i].max, origin, inv_direction, hit->t);
+                if (t >= 0.0f && (t < hit->t || hit->object < 0)) {
+                    hit->object = bvh->indices[i];
+                    hit->t = t;
+                }
+            }
+            continue;
+        }
+
+        const lopgl_bvh_node_t* left = &bvh->nodes[node->first];
+        const lopgl_bvh_node_t* right = left + 1;
+        const float left_t = ray_box(&left->min, &left->max, origin, inv_direction, hit->t);
+        const float right_t = ray_box(&right->min, &right->max, origin, inv_direction, hit->t);
+        const bool left_first = left_t >= 0.0f && (right_t < 0.0f || left_t <= right_t);
+        if (left_first) {
+            if (right_t >= 0.0f) {
+                stack[top] = node->first + 1;
+                stack_t[top++] = right_t;
+            }
+            stack[top] = node->first;
+            stack_t[top++] = left_t;
+        }
+        else {
+            if (left_t >= 0.0f) {
+                stack[top] = node->first;
+                stack_t[top++] = left_t;
+            }
+            if (right_t >= 0.0f) {
+                stack[top] = node->first + 1;
+                stack_t[top++] = right_t;
+            }
+        }
+    }
+    return hit->object >= 0;
+}
+
+#endif /* LOPGL_BVH_IMPL */
@@ -0,0 +1,209 @@
+#ifndef LOPGL_CASCADES_INCLUDED
+#define LOPGL_CASCADES_INCLUDED
+
+#include <stdbool.h>
+#include "../libs/hmm/HandmadeMath.h"
+
+/*
+    Cascaded shadow maps for a directional light. The view frustum is split
+    along the view direction into 2 to 4 slices, between uniform and
+    logarithmic split distances (the practical split scheme), and each slice
+    gets its own orthographic light projection and a tile of one shadow atlas.
+
+    Each projection is fitted to the bounding sphere of its slice, so its size
+    doesn't change while the camera turns, and its center is snapped to whole
+    shadow map texels in light space, so the texels don't crawl over the scene
+    while the camera moves. Together that keeps the shadow edges from
+    shimmering, at the cost of the area the sphere covers outside the slice.
+
+    The tiles are laid out two by two, the first one in the bottom left of the
+    atlas. Render all cascades in one pass over the atlas with a viewport for
+    each tile.
+
+    Define LOPGL_CASCADES_IMPL in one file before including this header.
+*/
+
+#define LOPGL_MAX_CASCADES 4
+
+typedef struct lopgl_cascades_desc_t {
+    int num_cascades;               /* 2 to 4, defaults to 4, the atlas is sized for this many */
+    int tile_size;                  /* width and height of the tile of each cascade in texels, defaults to 1024 */
+    float split_lambda;             /* 0 splits the view range uniformly, 1 logarithmically, negative for the default of 0.75 */
+    float caster_distance;          /* distance towards the light casters outside of a slice are kept in, defaults to 20 */
+} lopgl_cascades_desc_t;
+
+typedef struct lopgl_cascade_t {
+    hmm_mat4 light_space_matrix;    /* world to the clip space of the cascade, for rendering into its tile */
+    hmm_mat4 atlas_matrix;          /* world to atlas texture coordinates and depth in [0, 1] */
+    float split_near;               /* view depth range of the slice */
+    float split_far;
+    float texel_size;               /* world units per texel */
+    float depth_range;              /* world units from depth 0 to 1 */
+    int x;                          /* tile in the atlas in texels, from the bottom left */
+    int y;
+} lopgl_cascade_t;
+
+/* in texels, to compare against one shadow map over the whole range with the texel size of the first cascade */
+typedef struct lopgl_cascades_stats_t {
+    int atlas_texels;
+    int fill_texels;                /* texels of the tiles in use, rendered every frame */
+    int single_map_size;            /* width and height of the single map */
+    double single_map_texels;
+} lopgl_cascades_stats_t;
+
+typedef struct lopgl_cascades_t {
+    int num_cascades;               /* can be lowered after init */
+    int tile_size;
+    int atlas_width;
+    int atlas_height;
+    float split_lambda;
+    float caster_distance;
+    bool snap;                      /* snap to whole texels, on by default */
+    lopgl_cascade_t cascades[LOPGL_MAX_CASCADES];
+    lopgl_cascades_stats_t stats;
+    int _max_cascades;
+} lopgl_cascades_t;
+
+void lopgl_init_cascades(lopgl_cascades_t* cascades, const lopgl_cascades_desc_t* desc);
+
+/* fits the cascades to the view between the view depths near_depth and far_depth, light_dir is the direction the light shines in */
+void lopgl_update_cascades(lopgl_cascades_t* cascades, hmm_mat4 view, float fov, float aspect, float near_depth, float far_depth, hmm_vec3 light_dir);
+
+#endif /*LOPGL_CASCADES_INCLUDED*/
+
+
+/*--- IMPLEMENTATION ---------------------------------------------------------*/
+#ifdef LOPGL_CASCADES_IMPL
+
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+/* texels kept free around the sphere of a slice, for the filter taps and the snapping */
+#define _LOPGL_CASCADE_BORDER 2
+
+/*=== FITTING ======================================================*/
+
+/* Center on the view axis and radius of the smallest sphere around the slice between the depths
+   n and f, whose corners are at a and b from the axis. */
+static void slice_sphere(float n, float f, float a, float b, float* center, float* radius) {
+    /* equally far from the near and the far corners, or at the far plane when those are wider */
+    float t = (f * f + b * b - n * n - a * a) / (2.0f * (f - n));
+    if (t > f) {
+        t = f;
+    }
+    const float near_corner = (t - n) * (t - n) + a * a;
+    const float far_corner = (f - t) * (f - t) + b * b;
+    *center = t;
+    *radius = sqrtf(near_corner > far_corner ? near_corner : far_corner);
+}
+
+/* the view matrix is a rotation and a translation, so its inverse is the transposed rotation */
+static hmm_vec3 view_to_world(hmm_mat4 view, hmm_vec3 p) {
+    const hmm_vec3 d = HMM_SubtractVec3(p, HMM_Vec3(view.Elements[3][0], view.Elements[3][1], view.Elements[3][2]));
+    hmm_vec3 world;
+    for (int j = 0; j < 3; ++j) {
+        world.Elements[j] = view.Elements[j][0] * d.X + view.Elements[j][1] * d.Y + view.Elements[j][2] * d.Z;
+    }
+    return world;
+}
+
+static void fit_cascade(lopgl_cascades_t* c, lopgl_cascade_t* cascade, hmm_mat4 view, hmm_mat4 light_view, float tan_half_fov, float aspect) {
+    const float n = cascade->split_near;
+    const float f = cascade->split_far;
+    const float corner_n = n * tan_half_fov * sqrtf(1.0f + aspect * aspect);
+    const float corner_f = f * tan_half_fov * sqrtf(1.0f + aspect * aspect);
+    float center_depth, radius;
+    slice_sphere(n, f, corner_n, corner_f, &center_depth, &radius);
+    /* the radius only depends on the splits, rounding it keeps float noise from resizing the texels */
+    radius = ceilf(radius * 16.0f) / 16.0f;
+
+    const float half_size = radius * (float)c->tile_size / (float)(c->tile_size - 2 * _LOPGL_CASCADE_BORDER);
+    cascade->texel_size = 2.0f * half_size / (float)c->tile_size;
+
+    const hmm_vec3 center = view_to_world(view, HMM_Vec3(0.0f, 0.0f, -center_depth));
+    hmm_vec4 light_center = HMM_MultiplyMat4ByVec4(light_view, HMM_Vec4(center.X, center.Y, center.Z, 1.0f));
+    if (c->snap) {
+        light_center.X = floorf(light_center.X / cascade->texel_size) * cascade->texel_size;
+        light_center.Y = floorf(light_center.Y / cascade->texel_size) * cascade->texel_size;
+    }
+
+    /* the light looks down its negative z axis, casters between the light and the slice are kept */
+    const float depth = -light_center.Z;
+    const float near_plane = depth - radius - c->caster_distance;
+    const float far_plane = depth + radius;
+    cascade->depth_range = far_plane - near_plane;
+    const hmm_mat4 projection = HMM_Orthographic(light_center.X - half_size, light_center.X + half_size,
+                                                 light_center.Y - half_size, light_center.Y + half_size,
+                                                 near_plane, far_plane);
+    cascade->light_space_matrix = HMM_MultiplyMat4(projection, light_view);
+
+    /* clip space to the tile and depth to [0, 1] */
+    const float scale_x = (float)c->tile_size / (float)c->atlas_width;
+    const float scale_y = (float)c->tile_size / (float)c->atlas_height;
+    hmm_mat4 bias = HMM_Mat4d(1.0f);
+    bias.Elements[0][0] = 0.5f * scale_x;
+    bias.Elements[1][1] = 0.5f * scale_y;
+    bias.Elements[2][2] = 0.5f;
+    bias.Elements[3][0] = 0.5f * scale_x + (float)cascade->x / (float)c->atlas_width;
+    bias.Elements[3][1] = 0.5f * scale_y + (float)cascade->y / (float)c->atlas_height;
+    bias.Elements[3][2] = 0.5f;
+    cascade->atlas_matrix = HMM_MultiplyMat4(bias, cascade->light_space_matrix);
+}
+
+/*=== CASCADES =====================================================*/
+
+void lopgl_init_cascades(lopgl_cascades_t* c, const lopgl_cascades_desc_t* desc) {
+    memset(c, 0, sizeof(lopgl_cascades_t));
+    c->_max_cascades = desc->num_cascades > 0 ? desc->num_cascades : LOPGL_MAX_CASCADES;
+    assert(c->_max_cascades >= 2 && c->_max_cascades <= LOPGL_MAX_CASCADES);
+    c->num_cascades = c->_max_cascades;
+    c->tile_size = desc->tile_size > 0 ? desc->tile_size : 1024;
+    assert(c->tile_size > 4 * _LOPGL_CASCADE_BORDER);
+    /* 0 is a valid blend, the uniform split, so only negative values pick the default */
+    c->split_lambda = desc->split_lambda >= 0.0f ? desc->split_lambda : 0.75f;
+    c->caster_distance = desc->caster_distance > 0.0f ? desc->caster_distance : 20.0f;
+    c->snap = true;
+    c->atlas_width = 2 * c->tile_size;
+    c->atlas_height = (c->_max_cascades > 2 ? 2 : 1) * c->tile_size;
+    for (int i = 0; i < LOPGL_MAX_CASCADES; ++i) {
+        c->cascades[i].x = (i % 2) * c->tile_size;
+        c->cascades[i].y = (i / 2) * c->tile_size;
+    }
+}
+
+void lopgl_update_cascades(lopgl_cascades_t* c, hmm_mat4 view, float fov, float aspect, float near_depth, float far_depth, hmm_vec3 light_dir) {
+    assert(c->num_cascades >= 1 && c->num_cascades <= c->_max_cascades);
+    assert(near_depth > 0.0f && far_depth > near_depth);
+
+    const hmm_vec3 dir = HMM_NormalizeVec3(light_dir);
+    const hmm_vec3 up = fabsf(dir.Y) > 0.99f ? HMM_Vec3(1.0f, 0.0f, 0.0f) : HMM_Vec3(0.0f, 1.0f, 0.0f);
+    const hmm_mat4 light_view = HMM_LookAt(HMM_Vec3(0.0f, 0.0f, 0.0f), dir, up);
+    const float tan_half_fov = HMM_TanF(HMM_ToRadians(fov) * 0.5f);
+
+    float split_near = near_depth;
+    for (int i = 0; i < c->num_cascades; ++i) {
+        /* practical split, a blend of the logarithmic and the uniform split */
+        const float s = (float)(i + 1) / (float)c->num_cascades;
+        const float log_split = near_depth * powf(far_depth / near_depth, s);
+        const float uniform_split = near_depth + (far_depth - near_depth) * s;
+        lopgl_cascade_t* cascade = &c->cascades[i];
+        cascade->split_near = split_near;
+        cascade->split_far = c->split_lambda * log_split + (1.0f - c->split_lambda) * uniform_split;
+        fit_cascade(c, cascade, view, light_view, tan_half_fov, aspect);
+        split_near = cascade->split_far;
+    }
+
+    float center_depth, radius;
+    const float corner = tan_half_fov * sqrtf(1.0f + aspect * aspect);
+    slice_sphere(near_depth, far_depth, near_depth * corner, far_depth * corner, &center_depth, &radius);
+    const double single_map_size = ceil(2.0 * radius / c->cascades[0].texel_size);
+    c->stats = (lopgl_cascades_stats_t){
+        .atlas_texels = c->atlas_width * c->atlas_height,
+        .fill_texels = c->num_cascades * c->tile_size * c->tile_size,
+        .single_map_size = (int)single_map_size,
+        .single_map_texels = single_map_size * single_map_size
+    };
+}
+
+#endif /* LOPGL_CASCADES_IMPL */
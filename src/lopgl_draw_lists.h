@@ -0,0 +1,289 @@
+#ifndef LOPGL_DRAW_LISTS_INCLUDED
+#define LOPGL_DRAW_LISTS_INCLUDED
+
+/*
+    Draw lists record draws on the job threads and submit them later on the
+    thread that owns sokol-gfx. Recording only copies a compact packet
+    (pipeline, bindings pointer, uniform blocks and draw arguments) into the
+    list being recorded, so the per-object work in front of it (building
+    matrices, culling, packing uniforms) runs in parallel.
+
+    lopgl_record_draw_lists() splits a range of objects into one contiguous
+    part per list and records the lists with the job system of lopgl_app.h,
+    lopgl_replay_draw_lists() submits them in list order, which is the same
+    order a single thread would have recorded.
+
+    Define LOPGL_DRAW_LISTS_IMPL in the file that also defines LOPGL_APP_IMPL.
+*/
+
+/* maximum number of lists a recording is split into */
+#define LOPGL_MAX_DRAW_LIST_THREADS 16
+/* initial size of the packet memory of each list, grows when needed */
+#define LOPGL_DRAW_LIST_SIZE (1024 * 1024)
+
+typedef struct lopgl_draw_lists_desc_t {
+    int max_threads;                /* lists recorded in parallel at most, 0 uses one per job thread */
+} lopgl_draw_lists_desc_t;
+
+/* a recorded draw, the uniform blocks are copied */
+typedef struct lopgl_draw_desc_t {
+    sg_pipeline pip;
+    const sg_bindings* bindings;    /* not copied, has to stay valid until replayed */
+    int base_element;
+    int num_elements;
+    int num_instances;              /* defaults to 1 */
+    int vs_uniform_slot;
+    const void* vs_uniforms;        /* optional */
+    int vs_uniforms_size;
+    int fs_uniform_slot;
+    const void* fs_uniforms;        /* optional */
+    int fs_uniforms_size;
+} lopgl_draw_desc_t;
+
+#if defined(_MSC_VER)
+#define _LOPGL_CACHE_ALIGNED __declspec(align(64))
+#else
+#define _LOPGL_CACHE_ALIGNED __attribute__((aligned(64)))
+#endif
+
+/* Packet memory of one part, aligned to a cache line so lists recorded on different
+   threads don't share one. That holds for lopgl_draw_lists_t in static or automatic
+   storage, malloc() only guarantees a smaller alignment. */
+typedef struct _LOPGL_CACHE_ALIGNED lopgl_draw_list_t {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+    int num_packets;
+} lopgl_draw_list_t;
+
+/* counters of the last recording and replay */
+typedef struct lopgl_draw_list_stats_t {
+    int packets;
+    size_t bytes;                   /* packet memory used by all lists */
+    int pipeline_changes;
+    int binding_changes;
+    int uniform_updates;            /* uniform blocks the uniform cache did not skip */
+    double record_ms;
+    double replay_ms;
+} lopgl_draw_list_stats_t;
+
+typedef struct lopgl_draw_lists_t {
+    int num_threads;                /* lists the next recording is split into, up to max_threads */
+    int max_threads;
+    lopgl_draw_list_t lists[LOPGL_MAX_DRAW_LIST_THREADS];
+    lopgl_draw_list_stats_t stats;
+} lopgl_draw_lists_t;
+
+/* called on a job thread with a list and its part of the range passed to lopgl_record_draw_lists() */
+typedef void(*lopgl_record_func_t)(lopgl_draw_list_t* list, int begin, int end, void* user_data);
+
+void lopgl_init_draw_lists(lopgl_draw_lists_t* lists, const lopgl_draw_lists_desc_t* desc);
+
+void lopgl_destroy_draw_lists(lopgl_draw_lists_t* lists);
+
+/* Clears the lists and calls func for the range [0, count) split into num_threads
+   lists, which are recorded on the job threads. Returns when all of them are done. */
+void lopgl_record_draw_lists(lopgl_draw_lists_t* lists, int count, lopgl_record_func_t func, void* user_data);
+
+/* appends a draw to a list, only the call the list was passed to may record into it */
+void lopgl_record_draw(lopgl_draw_list_t* list, const lopgl_draw_desc_t* draw);
+
+/* Submits the recorded draws, must be called inside a pass on the sokol-gfx thread.
+   Pipelines, bindings and uniform blocks are only applied when they differ from
+   the previous draw. */
+void lopgl_replay_draw_lists(lopgl_draw_lists_t* lists);
+
+#endif /*LOPGL_DRAW_LISTS_INCLUDED*/
+
+
+/*--- IMPLEMENTATION ---------------------------------------------------------*/
+#ifdef LOPGL_DRAW_LISTS_IMPL
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/* header of a recorded draw, followed by the vertex and fragment shader uniforms */
+typedef struct _lopgl_draw_packet_t {
+    uint32_t pip_id;
+    uint16_t vs_uniform_slot;
+    uint16_t vs_uniforms_size;
+    uint16_t fs_uniform_slot;
+    uint16_t fs_uniforms_size;
+    int base_element;
+    int num_elements;
+    int num_instances;
+    const sg_bindings* bindings;
+} _lopgl_draw_packet_t;
+
+/* packets and uniform blocks start at multiples of this */
+#define _LOPGL_DRAW_PACKET_ALIGN 16
+
+static inline size_t draw_packet_align(size_t size) {
+    return (size + _LOPGL_DRAW_PACKET_ALIGN - 1) & ~(size_t)(_LOPGL_DRAW_PACKET_ALIGN - 1);
+}
+
+/*=== RECORDING ====================================================*/
+
+void lopgl_record_draw(lopgl_draw_list_t* list, const lopgl_draw_desc_t* draw) {
+    assert(draw->vs_uniforms_size >= 0 && draw->vs_uniforms_size <= UINT16_MAX);
+    assert(draw->fs_uniforms_size >= 0 && draw->fs_uniforms_size <= UINT16_MAX);
+    const int vs_size = draw->vs_uniforms ? draw->vs_uniforms_size : 0;
+    const int fs_size = draw->fs_uniforms ? draw->fs_uniforms_size : 0;
+    const size_t vs_offset = draw_packet_align(sizeof(_lopgl_draw_packet_t));
+    const size_t fs_offset = vs_offset + draw_packet_align((size_t)vs_size);
+    const size_t packet_size = fs_offset + draw_packet_align((size_t)fs_size);
+
+    if (list->size + packet_size > list->capacity) {
+        size_t capacity = list->capacity > 0 ? list->capacity * 2 : LOPGL_DRAW_LIST_SIZE;
+        while (capacity < list->size + packet_size) {
+            capacity *= 2;
+        }
+        uint8_t* data = (uint8_t*)realloc(list->data, capacity);
+        if (!data) {
+            /* the list keeps the packets recorded so far */
+            LOPGL_LOG("Out of memory for a draw list, dropping the draw");
+            return;
+        }
+        list->data = data;
+        list->capacity = capacity;
+    }
+
+    uint8_t* ptr = list->data + list->size;
+    *(_lopgl_draw_packet_t*)ptr = (_lopgl_draw_packet_t){
+        .pip_id = draw->pip.id,
+        .vs_uniform_slot = (uint16_t)draw->vs_uniform_slot,
+        .vs_uniforms_size = (uint16_t)vs_size,
+        .fs_uniform_slot = (uint16_t)draw->fs_uniform_slot,
+        .fs_uniforms_size = (uint16_t)fs_size,
+        .base_element = draw->base_element,
+        .num_elements = draw->num_elements,
+        .num_instances = draw->num_instances > 0 ? draw->num_instances : 1,
+        .bindings = draw->bindings
+    };
+    if (vs_size > 0) {
+        memcpy(ptr + vs_offset, draw->vs_uniforms, (size_t)vs_size);
+    }
+    if (fs_size > 0) {
+        memcpy(ptr + fs_offset, draw->fs_uniforms, (size_t)fs_size);
+    }
+
+    list->size += packet_size;
+    ++list->num_packets;
+}
+
+/* part of the range recorded into list index out of num_threads */
+static void record_range(int count, int index, int num_threads, int* begin, int* end) {
+    *begin = (int)((int64_t)count * index / num_threads);
+    *end = (int)((int64_t)count * (index + 1) / num_threads);
+}
+
+/*=== JOBS =========================================================*/
+
+typedef struct _lopgl_draw_list_run_t {
+    lopgl_draw_lists_t* lists;
+    lopgl_record_func_t func;
+    void* user_data;
+    int count;
+} _lopgl_draw_list_run_t;
+
+static void record_parts(int begin, int end, void* user_data) {
+    const _lopgl_draw_list_run_t* run = user_data;
+    for (int i = begin; i < end; ++i) {
+        int first, last;
+        record_range(run->count, i, run->lists->num_threads, &first, &last);
+        run->func(&run->lists->lists[i], first, last, run->user_data);
+    }
+}
+
+/*=== DRAW LISTS ===================================================*/
+
+void lopgl_init_draw_lists(lopgl_draw_lists_t* lists, const lopgl_draw_lists_desc_t* desc) {
+    memset(lists, 0, sizeof(lopgl_draw_lists_t));
+
+    const int max_threads = desc->max_threads > 0 ? desc->max_threads : lopgl_job_threads();
+    lists->max_threads = HMM_Clamp(1, max_threads, LOPGL_MAX_DRAW_LIST_THREADS);
+    lists->num_threads = lists->max_threads;
+}
+
+void lopgl_destroy_draw_lists(lopgl_draw_lists_t* lists) {
+    for (int i = 0; i < LOPGL_MAX_DRAW_LIST_THREADS; ++i) {
+        free(lists->lists[i].data);
+    }
+    memset(lists, 0, sizeof(lopgl_draw_lists_t));
+}
+
+void lopgl_record_draw_lists(lopgl_draw_lists_t* lists, int count, lopgl_record_func_t func, void* user_data) {
+    const uint64_t start = stm_now();
+    lists->num_threads = HMM_Clamp(1, lists->num_threads, lists->max_threads);
+    for (int i = 0; i < LOPGL_MAX_DRAW_LIST_THREADS; ++i) {
+        lists->lists[i].size = 0;
+        lists->lists[i].num_packets = 0;
+    }
+
+    lopgl_parallel_for(lists->num_threads, 1, record_parts, &(_lopgl_draw_list_run_t){
+        .lists = lists,
+        .func = func,
+        .user_data = user_data,
+        .count = count
+    });
+
+    lists->stats.packets = 0;
+    lists->stats.bytes = 0;
+    for (int i = 0; i < lists->num_threads; ++i) {
+        lists->stats.packets += lists->lists[i].num_packets;
+        lists->stats.bytes += lists->lists[i].size;
+    }
+    lists->stats.record_ms = stm_ms(stm_since(start));
+}
+
+/*=== REPLAY =======================================================*/
+
+/* through the uniform cache of lopgl_app.h, which then knows what the replay left applied */
+static bool replay_uniforms(sg_shader_stage stage, int slot, const uint8_t* data, int size) {
+    return size > 0 && lopgl_apply_uniforms(stage, slot, data, size);
+}
+
+void lopgl_replay_draw_lists(lopgl_draw_lists_t* lists) {
+    const uint64_t start = stm_now();
+    lopgl_draw_list_stats_t* stats = &lists->stats;
+    stats->pipeline_changes = 0;
+    stats->binding_changes = 0;
+    stats->uniform_updates = 0;
+
+    uint32_t applied_pip = SG_INVALID_ID;
+    const sg_bindings* applied_bindings = NULL;
+
+    for (int i = 0; i < lists->num_threads; ++i) {
+        const lopgl_draw_list_t* list = &lists->lists[i];
+        const uint8_t* ptr = list->data;
+        for (int p = 0; p < list->num_packets; ++p) {
+            const _lopgl_draw_packet_t* packet = (const _lopgl_draw_packet_t*)ptr;
+            const uint8_t* vs_uniforms = ptr + draw_packet_align(sizeof(_lopgl_draw_packet_t));
+            const uint8_t* fs_uniforms = vs_uniforms + draw_packet_align(packet->vs_uniforms_size);
+            ptr = fs_uniforms + draw_packet_align(packet->fs_uniforms_size);
+
+            /* applying a pipeline resets the bindings, the uniform cache forgets the uniforms where needed */
+            if (packet->pip_id != applied_pip) {
+                lopgl_apply_pipeline((sg_pipeline){ packet->pip_id });
+                applied_pip = packet->pip_id;
+                applied_bindings = NULL;
+                ++stats->pipeline_changes;
+            }
+            if (packet->bindings != applied_bindings) {
+                sg_apply_bindings(packet->bindings);
+                applied_bindings = packet->bindings;
+                ++stats->binding_changes;
+            }
+            stats->uniform_updates += replay_uniforms(SG_SHADERSTAGE_VS, packet->vs_uniform_slot, vs_uniforms, packet->vs_uniforms_size);
+            stats->uniform_updates += replay_uniforms(SG_SHADERSTAGE_FS, packet->fs_uniform_slot, fs_uniforms, packet->fs_uniforms_size);
+            sg_draw(packet->base_element, packet->num_elements, packet->num_instances);
+        }
+    }
+
+    stats->replay_ms = stm_ms(stm_since(start));
+}
+
+#endif /* LOPGL_DRAW_LISTS_IMPL */
@@ -0,0 +1,92 @@
+#ifndef LOPGL_FLOAT4_INCLUDED
+#define LOPGL_FLOAT4_INCLUDED
+
+/*
+    Four wide float operations for the implementations of the lopgl modules,
+    SSE2 on x86-64, NEON on arm64 and plain loops elsewhere, including
+    emscripten. The masks are lane wise comparison results, turn them into
+    bits with mask4_bits() to branch on them.
+*/
+
+#include <stdbool.h>
+#include <string.h>
+
+#if !defined(__EMSCRIPTEN__) && (defined(__x86_64__) || defined(_M_X64))
+#include <emmintrin.h>
+
+typedef __m128 _f4_t;
+typedef __m128 _mask4_t;
+
+static inline _f4_t f4_load(const float* p) { return _mm_loadu_ps(p); }
+static inline void f4_store(float* p, _f4_t a) { _mm_storeu_ps(p, a); }
+static inline _f4_t f4_set(float a) { return _mm_set1_ps(a); }
+static inline _f4_t f4_set4(float a, float b, float c, float d) { return _mm_setr_ps(a, b, c, d); }
+static inline _f4_t f4_add(_f4_t a, _f4_t b) { return _mm_add_ps(a, b); }
+static inline _f4_t f4_sub(_f4_t a, _f4_t b) { return _mm_sub_ps(a, b); }
+static inline _f4_t f4_mul(_f4_t a, _f4_t b) { return _mm_mul_ps(a, b); }
+static inline _f4_t f4_div(_f4_t a, _f4_t b) { return _mm_div_ps(a, b); }
+static inline _mask4_t f4_gt(_f4_t a, _f4_t b) { return _mm_cmpgt_ps(a, b); }
+static inline _f4_t f4_max(_f4_t a, _f4_t b) { return _mm_max_ps(a, b); }
+static inline _f4_t f4_min(_f4_t a, _f4_t b) { return _mm_min_ps(a, b); }
+static inline _mask4_t f4_lt(_f4_t a, _f4_t b) { return _mm_cmplt_ps(a, b); }
+static inline _mask4_t f4_ge(_f4_t a, _f4_t b) { return _mm_cmpge_ps(a, b); }
+static inline _mask4_t f4_le(_f4_t a, _f4_t b) { return _mm_cmple_ps(a, b); }
+static inline _mask4_t mask4_and(_mask4_t a, _mask4_t b) { return _mm_and_ps(a, b); }
+static inline _mask4_t mask4_or(_mask4_t a, _mask4_t b) { return _mm_or_ps(a, b); }
+/* one bit per lane, lane 0 in the lowest bit */
+static inline int mask4_bits(_mask4_t mask) { return _mm_movemask_ps(mask); }
+/* returns a where the mask is set and b elsewhere */
+static inline _f4_t f4_select(_mask4_t mask, _f4_t a, _f4_t b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+#elif !defined(__EMSCRIPTEN__) && (defined(__aarch64__) || defined(_M_ARM64))
+#include <arm_neon.h>
+
+typedef float32x4_t _f4_t;
+typedef uint32x4_t _mask4_t;
+
+static inline _f4_t f4_load(const float* p) { return vld1q_f32(p); }
+static inline void f4_store(float* p, _f4_t a) { vst1q_f32(p, a); }
+static inline _f4_t f4_set(float a) { return vdupq_n_f32(a); }
+static inline _f4_t f4_set4(float a, float b, float c, float d) { const float v[4] = { a, b, c, d }; return vld1q_f32(v); }
+static inline _f4_t f4_add(_f4_t a, _f4_t b) { return vaddq_f32(a, b); }
+static inline _f4_t f4_sub(_f4_t a, _f4_t b) { return vsubq_f32(a, b); }
+static inline _f4_t f4_mul(_f4_t a, _f4_t b) { return vmulq_f32(a, b); }
+static inline _f4_t f4_div(_f4_t a, _f4_t b) { return vdivq_f32(a, b); }
+static inline _mask4_t f4_gt(_f4_t a, _f4_t b) { return vcgtq_f32(a, b); }
+static inline _f4_t f4_max(_f4_t a, _f4_t b) { return vmaxq_f32(a, b); }
+static inline _f4_t f4_min(_f4_t a, _f4_t b) { return vminq_f32(a, b); }
+static inline _mask4_t f4_lt(_f4_t a, _f4_t b) { return vcltq_f32(a, b); }
+static inline _mask4_t f4_ge(_f4_t a, _f4_t b) { return vcgeq_f32(a, b); }
+static inline _mask4_t f4_le(_f4_t a, _f4_t b) { return vcleq_f32(a, b); }
+static inline _mask4_t mask4_and(_mask4_t a, _mask4_t b) { return vandq_u32(a, b); }
+static inline _mask4_t mask4_or(_mask4_t a, _mask4_t b) { return vorrq_u32(a, b); }
+static inline int mask4_bits(_mask4_t mask) { const uint32x4_t bits = { 1, 2, 4, 8 }; return (int)vaddvq_u32(vandq_u32(mask, bits)); }
+static inline _f4_t f4_select(_mask4_t mask, _f4_t a, _f4_t b) { return vbslq_f32(mask, a, b); }
+
+#else
+
+typedef struct { float v[4]; } _f4_t;
+typedef struct { bool v[4]; } _mask4_t;
+
+static inline _f4_t f4_load(const float* p) { _f4_t r; memcpy(r.v, p, sizeof(r.v)); return r; }
+static inline void f4_store(float* p, _f4_t a) { memcpy(p, a.v, sizeof(a.v)); }
+static inline _f4_t f4_set(float a) { return (_f4_t){ { a, a, a, a } }; }
+static inline _f4_t f4_set4(float a, float b, float c, float d) { return (_f4_t){ { a, b, c, d } }; }
+static inline _f4_t f4_add(_f4_t a, _f4_t b) { for (int i = 0; i < 4; ++i) a.v[i] += b.v[i]; return a; }
+static inline _f4_t f4_sub(_f4_t a, _f4_t b) { for (int i = 0; i < 4; ++i) a.v[i] -= b.v[i]; return a; }
+static inline _f4_t f4_mul(_f4_t a, _f4_t b) { for (int i = 0; i < 4; ++i) a.v[i] *= b.v[i]; return a; }
+static inline _f4_t f4_div(_f4_t a, _f4_t b) { for (int i = 0; i < 4; ++i) a.v[i] /= b.v[i]; return a; }
+static inline _mask4_t f4_gt(_f4_t a, _f4_t b) { _mask4_t r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] > b.v[i]; return r; }
+static inline _f4_t f4_max(_f4_t a, _f4_t b) { for (int i = 0; i < 4; ++i) a.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return a; }
+static inline _f4_t f4_min(_f4_t a, _f4_t b) { for (int i = 0; i < 4; ++i) a.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return a; }
+static inline _mask4_t f4_lt(_f4_t a, _f4_t b) { _mask4_t r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] < b.v[i]; return r; }
+static inline _mask4_t f4_ge(_f4_t a, _f4_t b) { _mask4_t r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] >= b.v[i]; return r; }
+static inline _mask4_t f4_le(_f4_t a, _f4_t b) { _mask4_t r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] <= b.v[i]; return r; }
+static inline _mask4_t mask4_and(_mask4_t a, _mask4_t b) { for (int i = 0; i < 4; ++i) a.v[i] = a.v[i] && b.v[i]; return a; }
+static inline _mask4_t mask4_or(_mask4_t a, _mask4_t b) { for (int i = 0; i < 4; ++i) a.v[i] = a.v[i] || b.v[i]; return a; }
+static inline int mask4_bits(_mask4_t mask) { return mask.v[0] | mask.v[1] << 1 | mask.v[2] << 2 | mask.v[3] << 3; }
+static inline _f4_t f4_select(_mask4_t mask, _f4_t a, _f4_t b) { for (int i = 0; i < 4; ++i) if (!mask.v[i]) a.v[i] = b.v[i]; return a; }
+
+#endif
+
+#endif /*LOPGL_FLOAT4_INCLUDED*/
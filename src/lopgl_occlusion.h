@@ -0,0 +1,417 @@
+#ifndef LOPGL_OCCLUSION_INCLUDED
+#define LOPGL_OCCLUSION_INCLUDED
+
+#include <stdbool.h>
+#include "../libs/hmm/HandmadeMath.h"
+
+/*
+    Software occlusion culling. A few large occluders are rasterized into a
+    small depth buffer on the CPU, four pixels at a time with SSE2 or NEON,
+    and the bounding boxes of the objects are tested against it before their
+    draws are queued.
+
+    The buffer stores 1/w of the nearest occluder, which is linear in screen
+    space, and 0 where there is none. A second level keeps the farthest depth
+    of every 8x4 pixel tile, so a box is usually found to be occluded by
+    looking at a few tiles, and only the tiles that are partly behind it are
+    tested pixel by pixel.
+
+    Occluders cover the pixels whose centers they cover, with the farthest
+    depth of their plane within the pixel, so the triangles of one mesh
+    leave no gaps between them. A box is occluded when the nearest of its
+    corners is behind the occluders at every pixel of its screen rectangle
+    grown by one pixel on each side. A box that is visible next to the edge
+    of an occluder is visible at the center of one of those pixels, so the
+    test doesn't cull boxes an occluder only partly covers. It can still
+    cull a box that is only visible through a gap between two occluders
+    narrower than a pixel. Boxes that cross the near plane are always
+    visible.
+
+    Nothing here depends on sokol, so the culling also runs headless.
+
+    Define LOPGL_OCCLUSION_IMPL in one file before including this header.
+*/
+
+typedef struct lopgl_occlusion_desc_t {
+    int width;                      /* defaults to 256, rounded up to a multiple of 8 */
+    int height;                     /* defaults to 128, rounded up to a multiple of 4 */
+} lopgl_occlusion_desc_t;
+
+/* counters since the last lopgl_begin_occlusion() */
+typedef struct lopgl_occlusion_stats_t {
+    int occluders;
+    int triangles;                  /* rasterized triangles, after back face, frustum and near plane culling */
+    int tested;                     /* boxes */
+    int frustum_culled;             /* boxes outside the view frustum */
+    int occluded;                   /* boxes hidden by the occluders */
+} lopgl_occlusion_stats_t;
+
+typedef struct lopgl_occlusion_t {
+    int width;
+    int height;
+    hmm_mat4 view_projection;
+    float* depth;                   /* 1/w of the nearest occluder, rows from the bottom of the screen */
+    float* tile_depth;              /* farthest depth of each tile, updated by the first test after rasterizing */
+    lopgl_occlusion_stats_t stats;
+    int _tiles_x;
+    int _tiles_y;
+    bool _tiles_dirty;
+} lopgl_occlusion_t;
+
+void lopgl_init_occlusion(lopgl_occlusion_t* occlusion, const lopgl_occlusion_desc_t* desc);
+
+void lopgl_destroy_occlusion(lopgl_occlusion_t* occlusion);
+
+/* clears the depth buffer and the stats for a new view */
+void lopgl_begin_occlusion(lopgl_occlusion_t* occlusion, hmm_mat4 view_projection);
+
+/* Rasterizes the triangles of an occluder, num_vertices positions of three floats
+   stride bytes apart, three per triangle with counter clockwise front faces. */
+void lopgl_rasterize_occluder(lopgl_occlusion_t* occlusion, const float* positions, int stride, int num_vertices, hmm_mat4 model);
+
+/* returns false when the world space box is outside the view frustum or hidden by the occluders */
+bool lopgl_test_occlusion(lopgl_occlusion_t* occlusion, hmm_vec3 min, hmm_vec3 max);
+
+#endif /*LOPGL_OCCLUSION_INCLUDED*/
+
+
+/*--- IMPLEMENTATION ---------------------------------------------------------*/
+#ifdef LOPGL_OCCLUSION_IMPL
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "lopgl_float4.h"
+
+#define _LOPGL_OCCLUSION_TILE_WIDTH 8
+#define _LOPGL_OCCLUSION_TILE_HEIGHT 4
+/* triangles are clipped at this w, just in front of the eye */
+#define _LOPGL_OCCLUSION_MIN_W 1e-3f
+
+/*=== RASTERIZER ===================================================*/
+
+/* screen position in pixels and 1/w */
+typedef struct _lopgl_screen_vertex_t {
+    float x;
+    float y;
+    float z;
+} _lopgl_screen_vertex_t;
+
+static _lopgl_screen_vertex_t to_screen(const lopgl_occlusion_t* o, hmm_vec4 clip) {
+    const float inv_w = 1.0f / clip.W;
+    return (_lopgl_screen_vertex_t){
+        .x = (clip.X * inv_w * 0.5f + 0.5f) * (float)o->width,
+        .y = (clip.Y * inv_w * 0.5f + 0.5f) * (float)o->height,
+        .z = inv_w
+    };
+}
+
+/* edge function of the edge from a to b, positive on the inside of counter clockwise triangles */
+typedef struct _lopgl_edge_t {
+    float a;
+    float b;
+    float c;
+} _lopgl_edge_t;
+
+static inline _lopgl_edge_t make_edge(const _lopgl_screen_vertex_t* from, const _lopgl_screen_vertex_t* to) {
+    const float a = from->y - to->y;
+    const float b = to->x - from->x;
+    return (_lopgl_edge_t){ a, b, -(a * from->x + b * from->y) };
+}
+
+static void rasterize_triangle(lopgl_occlusion_t* o, const _lopgl_screen_vertex_t* v0, const _lopgl_screen_vertex_t* v1, const _lopgl_screen_vertex_t* v2) {
+    const float area = (v1->x - v0->x) * (v2->y - v0->y) - (v2->x - v0->x) * (v1->y - v0->y);
+    if (area <= 0.0f) {
+        /* back facing or degenerate */
+        return;
+    }
+
+    /* pixels whose centers may be covered, the bounds are clamped before the conversion to int */
+    const float min_x = HMM_MAX(HMM_MIN(v0->x, HMM_MIN(v1->x, v2->x)), 0.0f);
+    const float max_x = HMM_MIN(HMM_MAX(v0->x, HMM_MAX(v1->x, v2->x)), (float)o->width);
+    const float min_y = HMM_MAX(HMM_MIN(v0->y, HMM_MIN(v1->y, v2->y)), 0.0f);
+    const float max_y = HMM_MIN(HMM_MAX(v0->y, HMM_MAX(v1->y, v2->y)), (float)o->height);
+    const int x0 = (int)ceilf(min_x - 0.5f);
+    const int x1 = (int)floorf(max_x - 0.5f);
+    const int y0 = (int)ceilf(min_y - 0.5f);
+    const int y1 = (int)floorf(max_y - 0.5f);
+    if (x0 > x1 || y0 > y1) {
+        return;
+    }
+    ++o->stats.triangles;
+
+    const _lopgl_edge_t edges[3] = { make_edge(v1, v2), make_edge(v2, v0), make_edge(v0, v1) };
+    const float dzdx = ((v1->z - v0->z) * (v2->y - v0->y) - (v2->z - v0->z) * (v1->y - v0->y)) / area;
+    const float dzdy = ((v2->z - v0->z) * (v1->x - v0->x) - (v1->z - v0->z) * (v2->x - v0->x)) / area;
+    /* the farthest depth of the plane within the pixel instead of the depth at its center */
+    const float z_offset = v0->z - 0.5f * (fabsf(dzdx) + fabsf(dzdy));
+
+    /* rows start at a multiple of four pixels, lanes outside the triangle fail the edge tests */
+    const int start_x = x0 & ~3;
+    const _f4_t px = f4_add(f4_set((float)start_x), f4_set4(0.5f, 1.5f, 2.5f, 3.5f));
+    const _f4_t zero = f4_set(0.0f);
+    const _f4_t step_e0 = f4_set(edges[0].a * 4.0f);
+    const _f4_t step_e1 = f4_set(edges[1].a * 4.0f);
+    const _f4_t step_e2 = f4_set(edges[2].a * 4.0f);
+    const _f4_t step_z = f4_set(dzdx * 4.0f);
+
+    for (int y = y0; y <= y1; ++y) {
+        const float py = (float)y + 0.5f;
+        _f4_t e0 = f4_add(f4_mul(f4_set(edges[0].a), px), f4_set(edges[0].b * py + edges[0].c));
+        _f4_t e1 = f4_add(f4_mul(f4_set(edges[1].a), px), f4_set(edges[1].b * py + edges[1].c));
+        _f4_t e2 = f4_add(f4_mul(f4_set(edges[2].a), px), f4_set(edges[2].b * py + edges[2].c));
+        _f4_t z = f4_add(f4_mul(f4_set(dzdx), f4_sub(px, f4_set(v0->x))), f4_set(z_offset + dzdy * (py - v0->y)));
+
+        float* row = o->depth + y * o->width;
+        for (int x = start_x; x <= x1; x += 4) {
+            const _mask4_t inside = mask4_and(mask4_and(f4_ge(e0, zero), f4_ge(e1, zero)), f4_ge(e2, zero));
+            if (mask4_bits(inside)) {
+                const _f4_t old = f4_load(row + x);
+                f4_store(row + x, f4_select(inside, f4_max(old, z), old));
+            }
+            e0 = f4_add(e0, step_e0);
+            e1 = f4_add(e1, step_e1);
+            e2 = f4_add(e2, step_e2);
+            z = f4_add(z, step_z);
+        }
+    }
+}
+
+/* outside bits of a clip space position, a triangle is culled when all its vertices share one */
+static inline int clip_outcode(hmm_vec4 v) {
+    return (v.X < -v.W) | (v.X > v.W) << 1 | (v.Y < -v.W) << 2 | (v.Y > v.W) << 3 | (v.Z > v.W) << 4 |
+           (v.W < _LOPGL_OCCLUSION_MIN_W) << 5;
+}
+
+/* clips the triangle at the minimum w, which leaves up to four vertices */
+static int clip_triangle(const hmm_vec4* in, hmm_vec4* out) {
+    int count = 0;
+    for (int i = 0; i < 3; ++i) {
+        const hmm_vec4 a = in[i];
+        const hmm_vec4 b = in[(i + 1) % 3];
+        const bool a_inside = a.W >= _LOPGL_OCCLUSION_MIN_W;
+        const bool b_inside = b.W >= _LOPGL_OCCLUSION_MIN_W;
+        if (a_inside) {
+            out[count++] = a;
+        }
+        if (a_inside != b_inside) {
+            const float t = (_LOPGL_OCCLUSION_MIN_W - a.W) / (b.W - a.W);
+            out[count++] = HMM_AddVec4(a, HMM_MultiplyVec4f(HMM_SubtractVec4(b, a), t));
+        }
+    }
+    return count;
+}
+
+/*=== TILES ========================================================*/
+
+static void update_tiles(lopgl_occlusion_t* o) {
+    for (int ty = 0; ty < o->_tiles_y; ++ty) {
+        for (int tx = 0; tx < o->_tiles_x; ++tx) {
+            const float* tile = o->depth + ty * _LOPGL_OCCLUSION_TILE_HEIGHT * o->width + tx * _LOPGL_OCCLUSION_TILE_WIDTH;
+            _f4_t farthest = f4_load(tile);
+            for (int y = 0; y < _LOPGL_OCCLUSION_TILE_HEIGHT; ++y) {
+                for (int x = 0; x < _LOPGL_OCCLUSION_TILE_WIDTH; x += 4) {
+                    farthest = f4_min(farthest, f4_load(tile + y * o->width + x));
+                }
+            }
+            float lanes[4];
+            f4_store(lanes, farthest);
+            o->tile_depth[ty * o->_tiles_x + tx] = HMM_MIN(HMM_MIN(lanes[0], lanes[1]), HMM_MIN(lanes[2], lanes[3]));
+        }
+    }
+    o->_tiles_dirty = false;
+}
+
+/* true when the occluders are in front of the depth at all pixels of the rectangle */
+static bool pixels_occlude(const lopgl_occlusion_t* o, int x0, int x1, int y0, int y1, float depth) {
+    const _f4_t box_depth = f4_set(depth);
+    const _f4_t first = f4_set((float)x0);
+    const _f4_t last = f4_set((float)x1);
+    for (int y = y0; y <= y1; ++y) {
+        const float* row = o->depth + y * o->width;
+        for (int x = x0 & ~3; x <= x1; x += 4) {
+            const _f4_t lane_x = f4_add(f4_set((float)x), f4_set4(0.0f, 1.0f, 2.0f, 3.0f));
+            const _mask4_t in_rect = mask4_and(f4_ge(lane_x, first), f4_le(lane_x, last));
+            if (mask4_bits(mask4_and(in_rect, f4_le(f4_load(row + x), box_depth)))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*=== BOXES ========================================================*/
+
+static inline _f4_t transform_row(const hmm_mat4* m, int row, _f4_t x, _f4_t y, _f4_t z) {
+    return f4_add(f4_add(f4_mul(f4_set(m->Elements[0][row]), x), f4_mul(f4_set(m->Elements[1][row]), y)),
+                  f4_add(f4_mul(f4_set(m->Elements[2][row]), z), f4_set(m->Elements[3][row])));
+}
+
+static inline float min_lane(_f4_t a) {
+    float lanes[4];
+    f4_store(lanes, a);
+    return HMM_MIN(HMM_MIN(lanes[0], lanes[1]), HMM_MIN(lanes[2], lanes[3]));
+}
+
+static inline float max_lane(_f4_t a) {
+    float lanes[4];
+    f4_store(lanes, a);
+    return HMM_MAX(HMM_MAX(lanes[0], lanes[1]), HMM_MAX(lanes[2], lanes[3]));
+}
+
+/*=== OCCLUSION ====================================================*/
+
+void lopgl_init_occlusion(lopgl_occlusion_t* o, const lopgl_occlusion_desc_t* desc) {
+    memset(o, 0, sizeof(lopgl_occlusion_t));
+    const int width = desc->width > 0 ? desc->width : 256;
+    const int height = desc->height > 0 ? desc->height : 128;
+    o->_tiles_x = (width + _LOPGL_OCCLUSION_TILE_WIDTH - 1) / _LOPGL_OCCLUSION_TILE_WIDTH;
+    o->_tiles_y = (height + _LOPGL_OCCLUSION_TILE_HEIGHT - 1) / _LOPGL_OCCLUSION_TILE_HEIGHT;
+    o->width = o->_tiles_x * _LOPGL_OCCLUSION_TILE_WIDTH;
+    o->height = o->_tiles_y * _LOPGL_OCCLUSION_TILE_HEIGHT;
+    o->depth = calloc((size_t)o->width * (size_t)o->height, sizeof(float));
+    o->tile_depth = calloc((size_t)o->_tiles_x * (size_t)o->_tiles_y, sizeof(float));
+    o->view_projection = HMM_Mat4d(1.0f);
+}
+
+void lopgl_destroy_occlusion(lopgl_occlusion_t* o) {
+    free(o->depth);
+    free(o->tile_depth);
+    memset(o, 0, sizeof(lopgl_occlusion_t));
+}
+
+void lopgl_begin_occlusion(lopgl_occlusion_t* o, hmm_mat4 view_projection) {
+    o->view_projection = view_projection;
+    memset(o->depth, 0, (size_t)o->width * (size_t)o->height * sizeof(float));
+    memset(&o->stats, 0, sizeof(o->stats));
+    o->_tiles_dirty = true;
+}
+
+void lopgl_rasterize_occluder(lopgl_occlusion_t* o, const float* positions, int stride, int num_vertices, hmm_mat4 model) {
+    assert(num_vertices % 3 == 0);
+    ++o->stats.occluders;
+    o->_tiles_dirty = true;
+
+    const hmm_mat4 mvp = HMM_MultiplyMat4(o->view_projection, model);
+    const uint8_t* ptr = (const uint8_t*)positions;
+    for (int i = 0; i < num_vertices; i += 3) {
+        hmm_vec4 clip[3];
+        int outside = ~0;
+        int crossing = 0;
+        for (int v = 0; v < 3; ++v) {
+            const float* p = (const float*)(ptr + (size_t)(i + v) * (size_t)stride);
+            clip[v] = HMM_MultiplyMat4ByVec4(mvp, HMM_Vec4(p[0], p[1], p[2], 1.0f));
+            const int outcode = clip_outcode(clip[v]);
+            outside &= outcode;
+            crossing |= outcode;
+        }
+        if (outside) {
+            continue;
+        }
+
+        if (crossing & (1 << 5)) {
+            hmm_vec4 clipped[4];
+            const int count = clip_triangle(clip, clipped);
+            _lopgl_screen_vertex_t screen[4];
+            for (int v = 0; v < count; ++v) {
+                screen[v] = to_screen(o, clipped[v]);
+            }
+            for (int v = 2; v < count; ++v) {
+                rasterize_triangle(o, &screen[0], &screen[v - 1], &screen[v]);
+            }
+        }
+        else {
+            const _lopgl_screen_vertex_t screen[3] = { to_screen(o, clip[0]), to_screen(o, clip[1]), to_screen(o, clip[2]) };
+            rasterize_triangle(o, &screen[0], &screen[1], &screen[2]);
+        }
+    }
+}
+
+bool lopgl_test_occlusion(lopgl_occlusion_t* o, hmm_vec3 min, hmm_vec3 max) {
+    ++o->stats.tested;
+
+    /* the eight corners in two groups of four, at the near and at the far z */
+    const hmm_mat4* m = &o->view_projection;
+    const _f4_t xs = f4_set4(min.X, max.X, min.X, max.X);
+    const _f4_t ys = f4_set4(min.Y, min.Y, max.Y, max.Y);
+    _f4_t cx[2], cy[2], cz[2], cw[2];
+    for (int i = 0; i < 2; ++i) {
+        const _f4_t zs = f4_set(i == 0 ? min.Z : max.Z);
+        cx[i] = transform_row(m, 0, xs, ys, zs);
+        cy[i] = transform_row(m, 1, xs, ys, zs);
+        cz[i] = transform_row(m, 2, xs, ys, zs);
+        cw[i] = transform_row(m, 3, xs, ys, zs);
+    }
+
+    /* the box is outside when all corners are outside the same plane, one bit per corner */
+    const _f4_t zero = f4_set(0.0f);
+    const _f4_t min_w = f4_set(_LOPGL_OCCLUSION_MIN_W);
+    int left = 0, right = 0, bottom = 0, top = 0, beyond = 0, behind = 0;
+    for (int i = 0; i < 2; ++i) {
+        const _f4_t neg_w = f4_sub(zero, cw[i]);
+        const int shift = i * 4;
+        left |= mask4_bits(f4_lt(cx[i], neg_w)) << shift;
+        right |= mask4_bits(f4_gt(cx[i], cw[i])) << shift;
+        bottom |= mask4_bits(f4_lt(cy[i], neg_w)) << shift;
+        top |= mask4_bits(f4_gt(cy[i], cw[i])) << shift;
+        beyond |= mask4_bits(f4_gt(cz[i], cw[i])) << shift;
+        behind |= mask4_bits(f4_lt(cw[i], min_w)) << shift;
+    }
+    if (left == 0xff || right == 0xff || bottom == 0xff || top == 0xff || beyond == 0xff || behind == 0xff) {
+        ++o->stats.frustum_culled;
+        return false;
+    }
+    if (behind != 0 || o->stats.triangles == 0) {
+        return true;
+    }
+
+    /* screen rectangle and depth of the nearest corner */
+    const _f4_t one = f4_set(1.0f);
+    const _f4_t half_width = f4_set((float)o->width * 0.5f);
+    const _f4_t half_height = f4_set((float)o->height * 0.5f);
+    _f4_t sx[2], sy[2], sz[2];
+    for (int i = 0; i < 2; ++i) {
+        sz[i] = f4_div(one, cw[i]);
+        sx[i] = f4_mul(f4_add(f4_mul(cx[i], sz[i]), one), half_width);
+        sy[i] = f4_mul(f4_add(f4_mul(cy[i], sz[i]), one), half_height);
+    }
+    const float min_x = min_lane(f4_min(sx[0], sx[1]));
+    const float max_x = max_lane(f4_max(sx[0], sx[1]));
+    const float min_y = min_lane(f4_min(sy[0], sy[1]));
+    const float max_y = max_lane(f4_max(sy[0], sy[1]));
+    if (min_x >= (float)o->width || max_x < 0.0f || min_y >= (float)o->height || max_y < 0.0f) {
+        ++o->stats.frustum_culled;
+        return false;
+    }
+    /* one more pixel on each side, for the parts of the box next to the edges of occluders */
+    const int x0 = (int)HMM_MAX(min_x - 1.0f, 0.0f);
+    const int x1 = (int)HMM_MIN(max_x + 1.0f, (float)(o->width - 1));
+    const int y0 = (int)HMM_MAX(min_y - 1.0f, 0.0f);
+    const int y1 = (int)HMM_MIN(max_y + 1.0f, (float)(o->height - 1));
+    const float depth = max_lane(f4_max(sz[0], sz[1]));
+
+    if (o->_tiles_dirty) {
+        update_tiles(o);
+    }
+    for (int ty = y0 / _LOPGL_OCCLUSION_TILE_HEIGHT; ty <= y1 / _LOPGL_OCCLUSION_TILE_HEIGHT; ++ty) {
+        for (int tx = x0 / _LOPGL_OCCLUSION_TILE_WIDTH; tx <= x1 / _LOPGL_OCCLUSION_TILE_WIDTH; ++tx) {
+            if (o->tile_depth[ty * o->_tiles_x + tx] > depth) {
+                continue;
+            }
+            /* the tile isn't fully in front of the box, test the pixels it shares with the rectangle */
+            const int tile_x = tx * _LOPGL_OCCLUSION_TILE_WIDTH;
+            const int tile_y = ty * _LOPGL_OCCLUSION_TILE_HEIGHT;
+            if (!pixels_occlude(o, HMM_MAX(x0, tile_x), HMM_MIN(x1, tile_x + _LOPGL_OCCLUSION_TILE_WIDTH - 1),
+                                HMM_MAX(y0, tile_y), HMM_MIN(y1, tile_y + _LOPGL_OCCLUSION_TILE_HEIGHT - 1), depth)) {
+                return true;
+            }
+        }
+    }
+    ++o->stats.occluded;
+    return false;
+}
+
+#endif /* LOPGL_OCCLUSION_IMPL */
@@ -0,0 +1,228 @@
+#ifndef LOPGL_SHADOW_ATLAS_INCLUDED
+#define LOPGL_SHADOW_ATLAS_INCLUDED
+
+#include <stdint.h>
+
+/*
+    A shadow atlas that hands out square tiles of one page, so many lights
+    can share a single render target that is allocated once up front.
+
+    The page is a quadtree. Every tile is a node of it with a power of two
+    size between the smallest and the largest tile size, and a node that is
+    split hands out its four quarters. Allocating the largest tiles first
+    packs the page without gaps, so request the tiles in order of importance.
+    When no tile of the requested size is free the request falls back to the
+    next smaller size, until the smallest one.
+
+    The tiles are laid out from the bottom left of the page, like the
+    viewports that render into them.
+
+    Define LOPGL_SHADOW_ATLAS_IMPL in one file before including this header.
+*/
+
+/* size of the page over the smallest tile size, up to 2^(levels - 1) */
+#define LOPGL_SHADOW_ATLAS_MAX_LEVELS 8
+#define LOPGL_SHADOW_ATLAS_MAX_NODES (((1 << (2 * LOPGL_SHADOW_ATLAS_MAX_LEVELS)) - 1) / 3)
+
+typedef struct lopgl_shadow_atlas_desc_t {
+    int size;                       /* width and height of the page in texels, a power of two, defaults to 2048 */
+    int min_tile_size;              /* defaults to 32 */
+    int max_tile_size;              /* defaults to a quarter of the page size */
+} lopgl_shadow_atlas_desc_t;
+
+typedef struct lopgl_shadow_tile_t {
+    int x;                          /* in texels from the bottom left of the page */
+    int y;
+    int size;                       /* 0 when the page is full */
+} lopgl_shadow_tile_t;
+
+typedef struct lopgl_shadow_atlas_stats_t {
+    int tiles;
+    int used_texels;
+    int shrunk;                     /* requests that got a smaller tile than they asked for */
+    int failed;                     /* requests that got no tile */
+} lopgl_shadow_atlas_stats_t;
+
+typedef struct lopgl_shadow_atlas_t {
+    int size;
+    int min_tile_size;
+    int max_tile_size;
+    int levels;
+    lopgl_shadow_atlas_stats_t stats;
+    uint8_t _nodes[LOPGL_SHADOW_ATLAS_MAX_NODES];
+} lopgl_shadow_atlas_t;
+
+void lopgl_init_shadow_atlas(lopgl_shadow_atlas_t* atlas, const lopgl_shadow_atlas_desc_t* desc);
+
+/* frees all tiles and resets the stats */
+void lopgl_clear_shadow_atlas(lopgl_shadow_atlas_t* atlas);
+
+/* the tile size for an importance between 0 and 1, the largest tile size at 1 */
+int lopgl_shadow_tile_size(const lopgl_shadow_atlas_t* atlas, float importance);
+
+/* count tiles of the same size, the largest size up to size that all of them fit in, returns that size or 0 */
+int lopgl_alloc_shadow_tiles(lopgl_shadow_atlas_t* atlas, int size, int count, lopgl_shadow_tile_t* tiles);
+
+void lopgl_free_shadow_tile(lopgl_shadow_atlas_t* atlas, const lopgl_shadow_tile_t* tile);
+
+#endif /*LOPGL_SHADOW_ATLAS_INCLUDED*/
+
+
+/*--- IMPLEMENTATION ---------------------------------------------------------*/
+#ifdef LOPGL_SHADOW_ATLAS_IMPL
+
+#include <string.h>
+#include <assert.h>
+
+#define _LOPGL_TILE_FREE 0
+#define _LOPGL_TILE_SPLIT 1
+#define _LOPGL_TILE_USED 2
+
+#define _lopgl_atlas_def(val, def) (((val) == 0) ? (def) : (val))
+
+/*=== QUADTREE ======================================================*/
+
+/* the nodes are stored level by level, the children of node i of a level are 4i to 4i + 3 of the next one */
+static int node_offset(int level) {
+    return ((1 << (2 * level)) - 1) / 3;
+}
+
+static int tile_level(const lopgl_shadow_atlas_t* atlas, int size) {
+    int level = 0;
+    while ((atlas->size >> level) > size) {
+        ++level;
+    }
+    return level;
+}
+
+/* the bits of the index of a node alternate between x and y, from the coarsest level down */
+static lopgl_shadow_tile_t node_tile(const lopgl_shadow_atlas_t* atlas, int level, int index) {
+    const int size = atlas->size >> level;
+    lopgl_shadow_tile_t tile = { 0, 0, size };
+    for (int l = 0; l < level; ++l) {
+        const int quadrant = (index >> (2 * (level - 1 - l))) & 3;
+        const int half = atlas->size >> (l + 1);
+        tile.x += (quadrant & 1) * half;
+        tile.y += (quadrant >> 1) * half;
+    }
+    return tile;
+}
+
+static int node_index(const lopgl_shadow_atlas_t* atlas, const lopgl_shadow_tile_t* tile, int level) {
+    int index = 0;
+    for (int l = 0; l < level; ++l) {
+        const int half = atlas->size >> (l + 1);
+        index = 4 * index + ((tile->x / half) & 1) + 2 * ((tile->y / half) & 1);
+    }
+    return index;
+}
+
+/* the first free node of the target level below this node in morton order, or -1 */
+static int alloc_node(lopgl_shadow_atlas_t* atlas, int level, int index, int target) {
+    uint8_t* node = &atlas->_nodes[node_offset(level) + index];
+    if (*node == _LOPGL_TILE_USED) {
+        return -1;
+    }
+    if (level == target) {
+        if (*node == _LOPGL_TILE_SPLIT) {
+            return -1;
+        }
+        *node = _LOPGL_TILE_USED;
+        return index;
+    }
+    /* the children of a free node are free */
+    *node = _LOPGL_TILE_SPLIT;
+    for (int i = 0; i < 4; ++i) {
+        const int found = alloc_node(atlas, level + 1, 4 * index + i, target);
+        if (found >= 0) {
+            return found;
+        }
+    }
+    return -1;
+}
+
+static void free_node(lopgl_shadow_atlas_t* atlas, int level, int index) {
+    atlas->_nodes[node_offset(level) + index] = _LOPGL_TILE_FREE;
+    /* merge the parent once all of its quarters are free again */
+    while (level > 0) {
+        const int first = node_offset(level) + (index & ~3);
+        for (int i = 0; i < 4; ++i) {
+            if (atlas->_nodes[first + i] != _LOPGL_TILE_FREE) {
+                return;
+            }
+        }
+        --level;
+        index >>= 2;
+        atlas->_nodes[node_offset(level) + index] = _LOPGL_TILE_FREE;
+    }
+}
+
+/*=== ATLAS ======================================================*/
+
+void lopgl_init_shadow_atlas(lopgl_shadow_atlas_t* atlas, const lopgl_shadow_atlas_desc_t* desc) {
+    memset(atlas, 0, sizeof(*atlas));
+    atlas->size = _lopgl_atlas_def(desc->size, 2048);
+    atlas->min_tile_size = _lopgl_atlas_def(desc->min_tile_size, 32);
+    atlas->max_tile_size = _lopgl_atlas_def(desc->max_tile_size, atlas->size / 4);
+    assert((atlas->size & (atlas->size - 1)) == 0);
+    assert(atlas->min_tile_size <= atlas->max_tile_size && atlas->max_tile_size <= atlas->size);
+    atlas->levels = tile_level(atlas, atlas->min_tile_size) + 1;
+    assert(atlas->levels <= LOPGL_SHADOW_ATLAS_MAX_LEVELS);
+}
+
+void lopgl_clear_shadow_atlas(lopgl_shadow_atlas_t* atlas) {
+    memset(atlas->_nodes, _LOPGL_TILE_FREE, (size_t)node_offset(atlas->levels));
+    memset(&atlas->stats, 0, sizeof(atlas->stats));
+}
+
+int lopgl_shadow_tile_size(const lopgl_shadow_atlas_t* atlas, float importance) {
+    int size = atlas->min_tile_size;
+    while (size < atlas->max_tile_size && (float)size < importance * (float)atlas->max_tile_size) {
+        size *= 2;
+    }
+    return size;
+}
+
+int lopgl_alloc_shadow_tiles(lopgl_shadow_atlas_t* atlas, int size, int count, lopgl_shadow_tile_t* tiles) {
+    if (size > atlas->max_tile_size) {
+        size = atlas->max_tile_size;
+    }
+    for (int tile_size = size; tile_size >= atlas->min_tile_size; tile_size /= 2) {
+        const int level = tile_level(atlas, tile_size);
+        int allocated = 0;
+        for (; allocated < count; ++allocated) {
+            const int index = alloc_node(atlas, 0, 0, level);
+            if (index < 0) {
+                break;
+            }
+            tiles[allocated] = node_tile(atlas, level, index);
+        }
+        if (allocated == count) {
+            atlas->stats.tiles += count;
+            atlas->stats.used_texels += count * tile_size * tile_size;
+            atlas->stats.shrunk += tile_size < size ? 1 : 0;
+            return tile_size;
+        }
+        /* all of them or none, the next size down might fit them all */
+        for (int i = 0; i < allocated; ++i) {
+            free_node(atlas, level, node_index(atlas, &tiles[i], level));
+        }
+    }
+    for (int i = 0; i < count; ++i) {
+        tiles[i] = (lopgl_shadow_tile_t){ 0, 0, 0 };
+    }
+    ++atlas->stats.failed;
+    return 0;
+}
+
+void lopgl_free_shadow_tile(lopgl_shadow_atlas_t* atlas, const lopgl_shadow_tile_t* tile) {
+    if (tile->size == 0) {
+        return;
+    }
+    const int level = tile_level(atlas, tile->size);
+    free_node(atlas, level, node_index(atlas, tile, level));
+    atlas->stats.tiles -= 1;
+    atlas->stats.used_texels -= tile->size * tile->size;
+}
+
+#endif /* LOPGL_SHADOW_ATLAS_IMPL */
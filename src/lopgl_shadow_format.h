@@ -0,0 +1,89 @@
+#ifndef LOPGL_SHADOW_FORMAT_INCLUDED
+#define LOPGL_SHADOW_FORMAT_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "sokol_gfx.h"
+
+/*
+    The pixel format the shadow maps are rendered to, picked at runtime with
+    sg_query_pixelformat.
+
+    Sokol can't sample depth render targets, so the depth is always written to
+    a color attachment. Where float render targets can be sampled that is a
+    single R32F or R16F channel which holds the depth as it is. Everywhere else
+    (WebGL 1, GLES2) it stays RGBA8, with the depth packed into the four
+    channels by encodeDepth in the depth pass and unpacked by decodeDepth for
+    every lookup.
+
+    The shaders compile each program that touches the shadow map twice, once
+    with FLOAT_DEPTH defined, which turns encodeDepth and decodeDepth into
+    plain writes and reads of the red channel. Use the float variant unless
+    the format is packed.
+
+    There is no hardware depth comparison, the shaders compare the depth
+    themselves on every path.
+
+    Call lopgl_shadow_format() after sg_setup().
+
+    Define LOPGL_SHADOW_FORMAT_IMPL in one file before including this header.
+*/
+
+typedef struct lopgl_shadow_format_t {
+    sg_pixel_format pixel_format;
+    const char* name;
+    bool packed;                    /* RGBA8 through encodeDepth and decodeDepth */
+    int texel_bytes;                /* of the color attachment, the depth buffer is the same on every path */
+    int write_alu;                  /* vector instructions to write the depth of a fragment */
+    int read_alu;                   /* vector instructions per lookup */
+} lopgl_shadow_format_t;
+
+/* the most precise format that can be rendered to and sampled, R32F, R16F or RGBA8 */
+const lopgl_shadow_format_t* lopgl_shadow_format(void);
+
+/* prints the memory and ALU of every path for a shadow map of texels with lookups per shaded fragment */
+void lopgl_print_shadow_formats(const lopgl_shadow_format_t* format, double texels, int lookups);
+
+#endif /*LOPGL_SHADOW_FORMAT_INCLUDED*/
+
+
+/*--- IMPLEMENTATION ---------------------------------------------------------*/
+#ifdef LOPGL_SHADOW_FORMAT_IMPL
+
+#include "sokol_debugtext.h"
+
+/* in order of preference, RGBA8 is supported everywhere */
+static const lopgl_shadow_format_t _lopgl_shadow_formats[] = {
+    /* encodeDepth: a multiply, fract, a multiply and a subtract, decodeDepth: a dot product */
+    { SG_PIXELFORMAT_R32F,  "R32F",  false, 4, 0, 0 },
+    { SG_PIXELFORMAT_R16F,  "R16F",  false, 2, 0, 0 },
+    { SG_PIXELFORMAT_RGBA8, "RGBA8", true,  4, 4, 1 }
+};
+
+#define _LOPGL_NUM_SHADOW_FORMATS (int)(sizeof(_lopgl_shadow_formats) / sizeof(_lopgl_shadow_formats[0]))
+
+static bool shadow_format_supported(const lopgl_shadow_format_t* format) {
+    const sg_pixelformat_info info = sg_query_pixelformat(format->pixel_format);
+    return info.render && info.sample;
+}
+
+const lopgl_shadow_format_t* lopgl_shadow_format(void) {
+    for (int i = 0; i < _LOPGL_NUM_SHADOW_FORMATS - 1; ++i) {
+        if (shadow_format_supported(&_lopgl_shadow_formats[i])) {
+            return &_lopgl_shadow_formats[i];
+        }
+    }
+    return &_lopgl_shadow_formats[_LOPGL_NUM_SHADOW_FORMATS - 1];
+}
+
+void lopgl_print_shadow_formats(const lopgl_shadow_format_t* format, double texels, int lookups) {
+    sdtx_printf("Shadow map:\t%s\n", format->name);
+    for (int i = 0; i < _LOPGL_NUM_SHADOW_FORMATS; ++i) {
+        const lopgl_shadow_format_t* f = &_lopgl_shadow_formats[i];
+        const char mark = f == format ? '*' : (shadow_format_supported(f) ? ' ' : '-');
+        sdtx_printf("%c%s\t%4.1f MB, %d+%d ALU\n", mark, f->name, texels * f->texel_bytes / (1024.0 * 1024.0),
+                    f->write_alu, f->read_alu * lookups);
+    }
+}
+
+#endif /* LOPGL_SHADOW_FORMAT_IMPL */
@@ -0,0 +1,498 @@
+#ifndef LOPGL_TRANSFORMS_INCLUDED
+#define LOPGL_TRANSFORMS_INCLUDED
+
+#include "../libs/hmm/HandmadeMath.h"
+#include "../libs/hmm/lopgl_hmm_batch.h"
+
+/*
+    Transform store for large numbers of animated instances. The components
+    are kept in separate arrays (structure of arrays), which lets the update
+    process four instances at once with SSE2 or NEON and hand the arrays
+    straight to HMM_BatchTRS() to build the instance matrices.
+
+    Instances orbit around the y axis and spin around their own axis.
+    lopgl_animate_transforms() splits the instances into ranges that are
+    processed in parallel by the job system of lopgl_app.h, so the transforms
+    have to be initialized after lopgl_setup().
+
+    Define LOPGL_TRANSFORMS_IMPL in the file that also defines LOPGL_APP_IMPL.
+*/
+
+/* maximum number of parts the instances are split into */
+#define LOPGL_MAX_TRANSFORM_THREADS 16
+
+typedef struct lopgl_transforms_desc_t {
+    int capacity;                   /* maximum number of instances (required) */
+    int num_threads;                /* parts the instances are split into, 0 uses one per job thread */
+} lopgl_transforms_desc_t;
+
+typedef struct lopgl_transform_desc_t {
+    float orbit_radius;
+    float orbit_angle;              /* radians, 0 is on the positive z axis */
+    float orbit_speed;              /* radians per second, up to 2 PI */
+    float height;
+    hmm_vec3 spin_axis;             /* normalized */
+    float spin_angle;               /* radians */
+    float spin_speed;               /* radians per second, up to 2 PI */
+    hmm_vec3 scale;
+} lopgl_transform_desc_t;
+
+typedef struct lopgl_transforms_t {
+    int count;
+    int capacity;
+    int num_threads;
+    /* transform components, the quaternions are kept normalized */
+    float* px;
+    float* py;
+    float* pz;
+    float* qx;
+    float* qy;
+    float* qz;
+    float* qw;
+    float* sx;
+    float* sy;
+    float* sz;
+    /* animation components */
+    float* orbit_radius;
+    float* orbit_angle;
+    float* orbit_speed;
+    float* spin_axis_x;
+    float* spin_axis_y;
+    float* spin_axis_z;
+    float* spin_angle;
+    float* spin_speed;
+    /* allocated by the first lopgl_cull_transforms() */
+    int* _visible;
+    float* _gathered;
+} lopgl_transforms_t;
+
+/* Instance data written for the vertex shader. The compact encodings store the
+   rotation as a quaternion and a uniform scale, taken from the x scale component,
+   the vertex shader has to rebuild the model matrix. */
+typedef enum lopgl_instance_encoding {
+    LOPGL_INSTANCE_MAT4,            /* hmm_mat4, 64 bytes */
+    LOPGL_INSTANCE_COMPACT24,       /* FLOAT4 position and scale, SHORT4N quaternion, 24 bytes */
+    LOPGL_INSTANCE_COMPACT16,       /* SHORT4N position and scale divided by their ranges, SHORT4N quaternion, 16 bytes */
+    LOPGL_NUM_INSTANCE_ENCODINGS
+} lopgl_instance_encoding;
+
+typedef struct lopgl_instance_format_t {
+    lopgl_instance_encoding encoding;
+    float position_range;           /* COMPACT16, largest absolute position component */
+    float scale_range;              /* COMPACT16, largest scale */
+} lopgl_instance_format_t;
+
+typedef struct lopgl_cull_desc_t {
+    hmm_mat4 view_projection;
+    float radius;                   /* bounding sphere radius around the mesh origin at scale 1 (required) */
+    lopgl_instance_format_t format; /* instance data written for the visible instances, defaults to mat4 */
+} lopgl_cull_desc_t;
+
+void lopgl_init_transforms(lopgl_transforms_t* transforms, const lopgl_transforms_desc_t* desc);
+
+void lopgl_destroy_transforms(lopgl_transforms_t* transforms);
+
+/* returns the index of the new instance, or -1 when the store is full */
+int lopgl_add_transform(lopgl_transforms_t* transforms, const lopgl_transform_desc_t* desc);
+
+/* Advances the animation by dt seconds. When out isn't null, the model matrices of
+   all instances are written to it, e.g. the staging memory of a stream buffer. */
+void lopgl_animate_transforms(lopgl_transforms_t* transforms, float dt, hmm_mat4* out);
+
+/* writes the instance data of all instances to out */
+void lopgl_write_instances(lopgl_transforms_t* transforms, const lopgl_instance_format_t* format, void* out);
+
+/* Tests the bounding spheres of the instances against the view frustum and writes the
+   instance data of the visible ones to the start of out, returns their number.
+   The bounding spheres are scaled by the largest scale component of each instance. */
+int lopgl_cull_transforms(lopgl_transforms_t* transforms, const lopgl_cull_desc_t* desc, void* out);
+
+/* size in bytes of the instance data of one instance */
+int lopgl_instance_size(lopgl_instance_encoding encoding);
+
+/* Gribb/Hartmann plane extraction, the normalized planes point into the frustum. With
+   OpenGL clip space z the near plane is conservative for backends with a [0, 1] depth
+   range. Header only, so it needs no LOPGL_TRANSFORMS_IMPL. */
+static inline void lopgl_frustum_planes(hmm_mat4 view_projection, hmm_vec4 planes[6]) {
+    for (int i = 0; i < 6; ++i) {
+        const int row = i / 2;
+        const float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+        hmm_vec4 plane;
+        for (int col = 0; col < 4; ++col) {
+            plane.Elements[col] = view_projection.Elements[col][3] + sign * view_projection.Elements[col][row];
+        }
+        planes[i] = HMM_DivideVec4f(plane, HMM_LengthVec3(plane.XYZ));
+    }
+}
+
+#endif /*LOPGL_TRANSFORMS_INCLUDED*/
+
+
+/*--- IMPLEMENTATION ---------------------------------------------------------*/
+#ifdef LOPGL_TRANSFORMS_IMPL
+
+#define HMM_BATCH_IMPLEMENTATION
+#include "../libs/hmm/lopgl_hmm_batch.h"
+#undef HMM_BATCH_IMPLEMENTATION
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "lopgl_float4.h"
+
+/* the arrays are padded to a multiple of this, so the update never needs a scalar tail */
+#define _LOPGL_TRANSFORM_BLOCK 8
+#define _LOPGL_TRANSFORM_ARRAYS 18
+/* components gathered for the visible instances */
+#define _LOPGL_GATHERED_ARRAYS 10
+
+/*=== TRIGONOMETRY =================================================*/
+
+/* wraps angles that left [-PI, PI] by less than a full turn back into the range */
+static inline _f4_t f4_wrap_angle(_f4_t a) {
+    const _f4_t pi = f4_set(HMM_PI32);
+    const _f4_t neg_pi = f4_set(-HMM_PI32);
+    const _f4_t zero = f4_set(0.0f);
+    const _f4_t two_pi = f4_set(2.0f * HMM_PI32);
+    a = f4_sub(a, f4_select(f4_gt(a, pi), two_pi, zero));
+    return f4_add(a, f4_select(f4_lt(a, neg_pi), two_pi, zero));
+}
+
+/* sine for angles in [-PI, PI], mirrored into [-PI/2, PI/2] for the taylor series */
+static inline _f4_t f4_sin(_f4_t a) {
+    const _f4_t half_pi = f4_set(HMM_PI32 * 0.5f);
+    const _f4_t neg_half_pi = f4_set(HMM_PI32 * -0.5f);
+    a = f4_select(f4_gt(a, half_pi), f4_sub(f4_set(HMM_PI32), a), a);
+    a = f4_select(f4_lt(a, neg_half_pi), f4_sub(f4_set(-HMM_PI32), a), a);
+
+    const _f4_t a2 = f4_mul(a, a);
+    _f4_t p = f4_set(-1.0f / 39916800.0f);
+    p = f4_add(f4_set(1.0f / 362880.0f), f4_mul(a2, p));
+    p = f4_add(f4_set(-1.0f / 5040.0f), f4_mul(a2, p));
+    p = f4_add(f4_set(1.0f / 120.0f), f4_mul(a2, p));
+    p = f4_add(f4_set(-1.0f / 6.0f), f4_mul(a2, p));
+    p = f4_add(f4_set(1.0f), f4_mul(a2, p));
+    return f4_mul(a, p);
+}
+
+static inline _f4_t f4_cos(_f4_t a) {
+    return f4_sin(f4_wrap_angle(f4_add(a, f4_set(HMM_PI32 * 0.5f))));
+}
+
+/*=== ANIMATION ====================================================*/
+
+typedef struct _lopgl_transform_job_t _lopgl_transform_job_t;
+
+/* processes the instances in [begin, end), which are multiples of _LOPGL_TRANSFORM_BLOCK */
+typedef void(*_lopgl_transform_job_func_t)(lopgl_transforms_t* t, _lopgl_transform_job_t* job, int begin, int end, int part);
+
+struct _lopgl_transform_job_t {
+    _lopgl_transform_job_func_t func;
+    float dt;
+    void* out;
+    lopgl_instance_format_t format;
+    /* culling, normalized planes with the normals pointing inside */
+    hmm_vec4 planes[6];
+    float radius;
+    int visible_count[LOPGL_MAX_TRANSFORM_THREADS];
+    int visible_offset[LOPGL_MAX_TRANSFORM_THREADS];
+};
+
+static inline int16_t encode_snorm16(float v) {
+    v = HMM_Clamp(-1.0f, v, 1.0f) * 32767.0f;
+    return (int16_t)(v >= 0.0f ? v + 0.5f : v - 0.5f);
+}
+
+/* writes the instance data of count instances, the components don't need to be padded */
+static void write_instances(const hmm_batch_trs* trs, int count, const lopgl_instance_format_t* format, void* out) {
+    switch (format->encoding) {
+        case LOPGL_INSTANCE_COMPACT24: {
+            uint8_t* dst = out;
+            for (int i = 0; i < count; ++i, dst += 24) {
+                const float position_scale[4] = { trs->px[i], trs->py[i], trs->pz[i], trs->sx[i] };
+                const int16_t rotation[4] = {
+                    encode_snorm16(trs->qx[i]), encode_snorm16(trs->qy[i]), encode_snorm16(trs->qz[i]), encode_snorm16(trs->qw[i])
+                };
+                memcpy(dst, position_scale, sizeof(position_scale));
+                memcpy(dst + 16, rotation, sizeof(rotation));
+            }
+        } break;
+        case LOPGL_INSTANCE_COMPACT16: {
+            assert(format->position_range > 0.0f && format->scale_range > 0.0f);
+            const float position_scale = 1.0f / format->position_range;
+            const float scale_scale = 1.0f / format->scale_range;
+            int16_t* dst = out;
+            for (int i = 0; i < count; ++i, dst += 8) {
+                dst[0] = encode_snorm16(trs->px[i] * position_scale);
+                dst[1] = encode_snorm16(trs->py[i] * position_scale);
+                dst[2] = encode_snorm16(trs->pz[i] * position_scale);
+                dst[3] = encode_snorm16(trs->sx[i] * scale_scale);
+                dst[4] = encode_snorm16(trs->qx[i]);
+                dst[5] = encode_snorm16(trs->qy[i]);
+                dst[6] = encode_snorm16(trs->qz[i]);
+                dst[7] = encode_snorm16(trs->qw[i]);
+            }
+        } break;
+        default:
+            HMM_BatchTRS(out, trs, count);
+            break;
+    }
+}
+
+/* writes the instance data of the instances in the range to the same range of the output */
+static void write_range(lopgl_transforms_t* t, _lopgl_transform_job_t* job, int begin, int end, int part) {
+    if (begin >= t->count) {
+        return;
+    }
+    const int count = (end < t->count ? end : t->count) - begin;
+    write_instances(&(hmm_batch_trs){
+        t->px + begin, t->py + begin, t->pz + begin,
+        t->qx + begin, t->qy + begin, t->qz + begin, t->qw + begin,
+        t->sx + begin, t->sy + begin, t->sz + begin
+    }, count, &job->format, (uint8_t*)job->out + (size_t)begin * lopgl_instance_size(job->format.encoding));
+}
+
+static void animate_range(lopgl_transforms_t* t, _lopgl_transform_job_t* job, int begin, int end, int part) {
+    const float dt = job->dt;
+    const _f4_t dt4 = f4_set(dt);
+    const _f4_t half = f4_set(0.5f);
+
+    for (int i = begin; i < end; i += 4) {
+        const _f4_t orbit_angle = f4_wrap_angle(f4_add(f4_load(t->orbit_angle + i), f4_mul(f4_load(t->orbit_speed + i), dt4)));
+        const _f4_t orbit_radius = f4_load(t->orbit_radius + i);
+        f4_store(t->orbit_angle + i, orbit_angle);
+        f4_store(t->px + i, f4_mul(f4_sin(orbit_angle), orbit_radius));
+        f4_store(t->pz + i, f4_mul(f4_cos(orbit_angle), orbit_radius));
+
+        const _f4_t spin_angle = f4_wrap_angle(f4_add(f4_load(t->spin_angle + i), f4_mul(f4_load(t->spin_speed + i), dt4)));
+        f4_store(t->spin_angle + i, spin_angle);
+        const _f4_t half_angle = f4_mul(spin_angle, half);
+        const _f4_t s = f4_sin(half_angle);
+        f4_store(t->qx + i, f4_mul(f4_load(t->spin_axis_x + i), s));
+        f4_store(t->qy + i, f4_mul(f4_load(t->spin_axis_y + i), s));
+        f4_store(t->qz + i, f4_mul(f4_load(t->spin_axis_z + i), s));
+        f4_store(t->qw + i, f4_cos(half_angle));
+    }
+
+    if (job->out) {
+        write_range(t, job, begin, end, part);
+    }
+}
+
+/*=== CULLING ======================================================*/
+
+/* writes the indices of the visible instances to the start of the range in _visible */
+static void cull_range(lopgl_transforms_t* t, _lopgl_transform_job_t* job, int begin, int end, int part) {
+    _f4_t nx[6], ny[6], nz[6], d[6];
+    for (int p = 0; p < 6; ++p) {
+        nx[p] = f4_set(job->planes[p].X);
+        ny[p] = f4_set(job->planes[p].Y);
+        nz[p] = f4_set(job->planes[p].Z);
+        d[p] = f4_set(job->planes[p].W);
+    }
+    const _f4_t neg_radius = f4_set(-job->radius);
+    int* visible = t->_visible + begin;
+    int num_visible = 0;
+
+    for (int i = begin; i < end; i += 4) {
+        const _f4_t px = f4_load(t->px + i);
+        const _f4_t py = f4_load(t->py + i);
+        const _f4_t pz = f4_load(t->pz + i);
+        const _f4_t scale = f4_max(f4_max(f4_load(t->sx + i), f4_load(t->sy + i)), f4_load(t->sz + i));
+        const _f4_t min_dist = f4_mul(scale, neg_radius);
+
+        _mask4_t inside = f4_ge(f4_add(f4_add(f4_add(f4_mul(nx[0], px), f4_mul(ny[0], py)), f4_mul(nz[0], pz)), d[0]), min_dist);
+        for (int p = 1; p < 6; ++p) {
+            const _f4_t dist = f4_add(f4_add(f4_add(f4_mul(nx[p], px), f4_mul(ny[p], py)), f4_mul(nz[p], pz)), d[p]);
+            inside = mask4_and(inside, f4_ge(dist, min_dist));
+        }
+
+        int bits = mask4_bits(inside);
+        if (i + 4 > t->count) {
+            /* drop the padding */
+            const int num_valid = t->count - i;
+            bits &= num_valid > 0 ? (1 << num_valid) - 1 : 0;
+        }
+        /* branchless compaction, every lane is written and kept if its bit is set */
+        for (int lane = 0; lane < 4; ++lane) {
+            visible[num_visible] = i + lane;
+            num_visible += (bits >> lane) & 1;
+        }
+    }
+    job->visible_count[part] = num_visible;
+}
+
+/* gathers the components of the visible instances in the range and writes their instance data */
+static void gather_range(lopgl_transforms_t* t, _lopgl_transform_job_t* job, int begin, int end, int part) {
+    const int num_visible = job->visible_count[part];
+    if (num_visible == 0) {
+        return;
+    }
+    const size_t padded = (size_t)(t->capacity + _LOPGL_TRANSFORM_BLOCK - 1) / _LOPGL_TRANSFORM_BLOCK * _LOPGL_TRANSFORM_BLOCK;
+    const float* components[_LOPGL_GATHERED_ARRAYS] = {
+        t->px, t->py, t->pz, t->qx, t->qy, t->qz, t->qw, t->sx, t->sy, t->sz
+    };
+    float* gathered[_LOPGL_GATHERED_ARRAYS];
+    const int* visible = t->_visible + begin;
+
+    for (int c = 0; c < _LOPGL_GATHERED_ARRAYS; ++c) {
+        gathered[c] = t->_gathered + padded * c + begin;
+        for (int i = 0; i < num_visible; ++i) {
+            gathered[c][i] = components[c][visible[i]];
+        }
+    }
+
+    write_instances(&(hmm_batch_trs){
+        gathered[0], gathered[1], gathered[2],
+        gathered[3], gathered[4], gathered[5], gathered[6],
+        gathered[7], gathered[8], gathered[9]
+    }, num_visible, &job->format, (uint8_t*)job->out + (size_t)job->visible_offset[part] * lopgl_instance_size(job->format.encoding));
+}
+
+/* range of part index out of num_parts, in whole blocks */
+static void part_range(const lopgl_transforms_t* t, int index, int num_parts, int* begin, int* end) {
+    const int num_blocks = (t->count + _LOPGL_TRANSFORM_BLOCK - 1) / _LOPGL_TRANSFORM_BLOCK;
+    *begin = (int)((int64_t)num_blocks * index / num_parts) * _LOPGL_TRANSFORM_BLOCK;
+    *end = (int)((int64_t)num_blocks * (index + 1) / num_parts) * _LOPGL_TRANSFORM_BLOCK;
+}
+
+/*=== JOBS =========================================================*/
+
+typedef struct _lopgl_transform_run_t {
+    lopgl_transforms_t* transforms;
+    _lopgl_transform_job_t* job;
+} _lopgl_transform_run_t;
+
+static void run_parts(int begin, int end, void* user_data) {
+    const _lopgl_transform_run_t* run = user_data;
+    for (int part = begin; part < end; ++part) {
+        int first, last;
+        part_range(run->transforms, part, run->transforms->num_threads, &first, &last);
+        run->job->func(run->transforms, run->job, first, last, part);
+    }
+}
+
+/* runs the job on all parts with the job system and returns when they are done */
+static void run_job(lopgl_transforms_t* t, _lopgl_transform_job_t* job) {
+    lopgl_parallel_for(t->num_threads, 1, run_parts, &(_lopgl_transform_run_t){ t, job });
+}
+
+/*=== TRANSFORMS ===================================================*/
+
+void lopgl_init_transforms(lopgl_transforms_t* t, const lopgl_transforms_desc_t* desc) {
+    assert(desc->capacity > 0);
+    memset(t, 0, sizeof(lopgl_transforms_t));
+
+    t->capacity = desc->capacity;
+    const int padded = (desc->capacity + _LOPGL_TRANSFORM_BLOCK - 1) / _LOPGL_TRANSFORM_BLOCK * _LOPGL_TRANSFORM_BLOCK;
+    /* the padding is updated along with the instances and has to hold valid floats */
+    float* data = calloc((size_t)padded * _LOPGL_TRANSFORM_ARRAYS, sizeof(float));
+    float** arrays[_LOPGL_TRANSFORM_ARRAYS] = {
+        &t->px, &t->py, &t->pz, &t->qx, &t->qy, &t->qz, &t->qw, &t->sx, &t->sy, &t->sz,
+        &t->orbit_radius, &t->orbit_angle, &t->orbit_speed,
+        &t->spin_axis_x, &t->spin_axis_y, &t->spin_axis_z, &t->spin_angle, &t->spin_speed
+    };
+    for (int i = 0; i < _LOPGL_TRANSFORM_ARRAYS; ++i) {
+        *arrays[i] = data + (size_t)padded * i;
+    }
+
+    const int num_threads = desc->num_threads > 0 ? desc->num_threads : lopgl_job_threads();
+    t->num_threads = HMM_Clamp(1, num_threads, LOPGL_MAX_TRANSFORM_THREADS);
+}
+
+void lopgl_destroy_transforms(lopgl_transforms_t* t) {
+    /* px is the start of the allocation */
+    free(t->px);
+    free(t->_visible);
+    free(t->_gathered);
+    memset(t, 0, sizeof(lopgl_transforms_t));
+}
+
+int lopgl_add_transform(lopgl_transforms_t* t, const lopgl_transform_desc_t* desc) {
+    if (t->count == t->capacity) {
+        return -1;
+    }
+    const int i = t->count++;
+
+    t->orbit_radius[i] = desc->orbit_radius;
+    t->orbit_angle[i] = desc->orbit_angle;
+    t->orbit_speed[i] = desc->orbit_speed;
+    t->spin_axis_x[i] = desc->spin_axis.X;
+    t->spin_axis_y[i] = desc->spin_axis.Y;
+    t->spin_axis_z[i] = desc->spin_axis.Z;
+    t->spin_angle[i] = desc->spin_angle;
+    t->spin_speed[i] = desc->spin_speed;
+
+    t->px[i] = HMM_SinF(desc->orbit_angle) * desc->orbit_radius;
+    t->py[i] = desc->height;
+    t->pz[i] = HMM_CosF(desc->orbit_angle) * desc->orbit_radius;
+    const float s = HMM_SinF(desc->spin_angle * 0.5f);
+    t->qx[i] = desc->spin_axis.X * s;
+    t->qy[i] = desc->spin_axis.Y * s;
+    t->qz[i] = desc->spin_axis.Z * s;
+    t->qw[i] = HMM_CosF(desc->spin_angle * 0.5f);
+    t->sx[i] = desc->scale.X;
+    t->sy[i] = desc->scale.Y;
+    t->sz[i] = desc->scale.Z;
+
+    return i;
+}
+
+void lopgl_animate_transforms(lopgl_transforms_t* t, float dt, hmm_mat4* out) {
+    run_job(t, &(_lopgl_transform_job_t){
+        .func = animate_range,
+        .dt = dt,
+        .out = out
+    });
+}
+
+void lopgl_write_instances(lopgl_transforms_t* t, const lopgl_instance_format_t* format, void* out) {
+    run_job(t, &(_lopgl_transform_job_t){
+        .func = write_range,
+        .out = out,
+        .format = *format
+    });
+}
+
+int lopgl_cull_transforms(lopgl_transforms_t* t, const lopgl_cull_desc_t* desc, void* out) {
+    assert(desc->radius > 0.0f);
+    if (!t->_visible) {
+        const size_t padded = (size_t)(t->capacity + _LOPGL_TRANSFORM_BLOCK - 1) / _LOPGL_TRANSFORM_BLOCK * _LOPGL_TRANSFORM_BLOCK;
+        t->_visible = malloc(padded * sizeof(int));
+        t->_gathered = malloc(padded * _LOPGL_GATHERED_ARRAYS * sizeof(float));
+    }
+
+    /* the parts cull their range, then gather the visible instances once
+       the offsets of their ranges in the packed output are known */
+    _lopgl_transform_job_t job = {
+        .func = cull_range,
+        .out = out,
+        .format = desc->format,
+        .radius = desc->radius
+    };
+    lopgl_frustum_planes(desc->view_projection, job.planes);
+    run_job(t, &job);
+
+    int num_visible = 0;
+    for (int i = 0; i < t->num_threads; ++i) {
+        job.visible_offset[i] = num_visible;
+        num_visible += job.visible_count[i];
+    }
+
+    job.func = gather_range;
+    run_job(t, &job);
+    return num_visible;
+}
+
+int lopgl_instance_size(lopgl_instance_encoding encoding) {
+    switch (encoding) {
+        case LOPGL_INSTANCE_COMPACT24: return 24;
+        case LOPGL_INSTANCE_COMPACT16: return 16;
+        default: return (int)sizeof(hmm_mat4);
+    }
+}
+
+#endif /* LOPGL_TRANSFORMS_IMPL */
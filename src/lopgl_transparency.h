@@ -0,0 +1,285 @@
+#ifndef LOPGL_TRANSPARENCY_INCLUDED
+#define LOPGL_TRANSPARENCY_INCLUDED
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "../libs/hmm/HandmadeMath.h"
+
+/*
+    Back to front sorting of transparent objects by their distance to the
+    camera, for blending them in a single instanced draw.
+
+    A cold sort is a radix sort over the squared distances, which are positive
+    floats and keep their order when their bits are compared as integers.
+    While the camera moves little between frames the order of the previous
+    frame is almost right, so it is refined with an insertion sort instead.
+    The refinement gives up and falls back to the radix sort when it has to
+    move too many objects, and isn't tried again for a few sorts. Both sorts
+    are stable, so objects at the same distance don't swap places from frame
+    to frame.
+
+    The distances are computed on the job threads of lopgl_app.h.
+
+    Define LOPGL_TRANSPARENCY_IMPL in the file that also defines LOPGL_APP_IMPL.
+*/
+
+typedef enum lopgl_sort_mode {
+    LOPGL_SORT_COHERENT,            /* refine the previous order while the camera moves little, the default */
+    LOPGL_SORT_RADIX,               /* radix sort every frame */
+    LOPGL_NUM_SORT_MODES
+} lopgl_sort_mode;
+
+typedef struct lopgl_transparency_desc_t {
+    int capacity;                   /* maximum number of objects (required) */
+    float coherent_distance;        /* camera movement between two sorts up to which the previous order is refined, defaults to 1 */
+} lopgl_transparency_desc_t;
+
+/* counters of the last sort */
+typedef struct lopgl_transparency_stats_t {
+    bool refined;                   /* the previous order was refined */
+    int shifts;                     /* places the refinement moved objects by */
+    int fallbacks;                  /* refinements that gave up for a radix sort, since init */
+    double key_ms;
+    double sort_ms;
+} lopgl_transparency_stats_t;
+
+typedef struct lopgl_transparency_t {
+    int count;
+    int capacity;
+    lopgl_sort_mode mode;
+    float coherent_distance;
+    uint32_t* order;                /* indices of the objects, back to front */
+    lopgl_transparency_stats_t stats;
+    uint32_t* _keys;
+    uint32_t* _tmp_keys;
+    uint32_t* _tmp_order;
+    hmm_vec3 _eye;
+    bool _sorted;
+    int _backoff;                   /* sorts left until the next refinement after a fallback */
+} lopgl_transparency_t;
+
+void lopgl_init_transparency(lopgl_transparency_t* transparency, const lopgl_transparency_desc_t* desc);
+
+void lopgl_destroy_transparency(lopgl_transparency_t* transparency);
+
+/* sorts count objects at the positions back to front as seen from eye, the result is in order */
+void lopgl_sort_transparency(lopgl_transparency_t* transparency, const hmm_vec3* positions, int count, hmm_vec3 eye);
+
+/* copies the elements of src, stride bytes each, to dst in the order of the last sort */
+void lopgl_gather_transparency(const lopgl_transparency_t* transparency, const void* src, int stride, void* dst);
+
+#endif /*LOPGL_TRANSPARENCY_INCLUDED*/
+
+
+/*--- IMPLEMENTATION ---------------------------------------------------------*/
+#ifdef LOPGL_TRANSPARENCY_IMPL
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/* three passes of 11 bits cover the 32 bit keys */
+#define _LOPGL_RADIX_BITS 11
+#define _LOPGL_RADIX_SIZE (1 << _LOPGL_RADIX_BITS)
+#define _LOPGL_RADIX_PASSES 3
+/* up to this many objects an insertion sort beats the radix histograms */
+#define _LOPGL_SMALL_SORT 64
+/* The refinement gives up after moving the objects by this many places per object,
+   a shift costs a few ns and a radix sort about as much as five shifts per object. */
+#define _LOPGL_MAX_REFINE_SHIFTS 2
+/* sorts after a fallback that go straight to the radix sort */
+#define _LOPGL_REFINE_BACKOFF 8
+/* objects per job when computing the keys and gathering */
+#define _LOPGL_TRANSPARENCY_GRAIN 4096
+
+/*=== KEYS =========================================================*/
+
+/* back to front is descending distance, the bits are inverted so that both sorts are ascending */
+static inline uint32_t transparency_key(hmm_vec3 position, hmm_vec3 eye) {
+    const hmm_vec3 d = HMM_SubtractVec3(position, eye);
+    const float dist = HMM_DotVec3(d, d);
+    uint32_t bits;
+    memcpy(&bits, &dist, sizeof(bits));
+    return ~bits;
+}
+
+typedef struct _lopgl_key_job_t {
+    lopgl_transparency_t* t;
+    const hmm_vec3* positions;
+    hmm_vec3 eye;
+} _lopgl_key_job_t;
+
+/* the keys are computed in the current order, which is the previous one when refining */
+static void compute_keys(int begin, int end, void* user_data) {
+    const _lopgl_key_job_t* job = user_data;
+    const uint32_t* order = job->t->order;
+    uint32_t* keys = job->t->_keys;
+    for (int i = begin; i < end; ++i) {
+        keys[i] = transparency_key(job->positions[order[i]], job->eye);
+    }
+}
+
+/*=== SORTS ========================================================*/
+
+/* Stable insertion sort of the keys along with the order. Returns false when it
+   moved the objects by more than max_shifts places, the arrays are still a valid
+   permutation then. */
+static bool insertion_sort(uint32_t* keys, uint32_t* order, int count, int64_t max_shifts, int64_t* shifts) {
+    *shifts = 0;
+    for (int i = 1; i < count; ++i) {
+        const uint32_t key = keys[i];
+        if (keys[i - 1] <= key) {
+            continue;
+        }
+        const uint32_t index = order[i];
+        int j = i - 1;
+        while (j >= 0 && keys[j] > key) {
+            keys[j + 1] = keys[j];
+            order[j + 1] = order[j];
+            --j;
+        }
+        keys[j + 1] = key;
+        order[j + 1] = index;
+        *shifts += i - 1 - j;
+        if (*shifts > max_shifts) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* stable LSD radix sort, passes where all keys share the digit are skipped */
+static void radix_sort(lopgl_transparency_t* t) {
+    uint32_t histograms[_LOPGL_RADIX_PASSES][_LOPGL_RADIX_SIZE] = { { 0 } };
+    const int count = t->count;
+    for (int i = 0; i < count; ++i) {
+        const uint32_t key = t->_keys[i];
+        ++histograms[0][key & (_LOPGL_RADIX_SIZE - 1)];
+        ++histograms[1][(key >> _LOPGL_RADIX_BITS) & (_LOPGL_RADIX_SIZE - 1)];
+        ++histograms[2][key >> (2 * _LOPGL_RADIX_BITS)];
+    }
+
+    for (int pass = 0; pass < _LOPGL_RADIX_PASSES; ++pass) {
+        uint32_t* histogram = histograms[pass];
+        const int shift = pass * _LOPGL_RADIX_BITS;
+        if (histogram[(t->_keys[0] >> shift) & (_LOPGL_RADIX_SIZE - 1)] == (uint32_t)count) {
+            continue;
+        }
+
+        /* histogram to offsets */
+        uint32_t offset = 0;
+        for (int i = 0; i < _LOPGL_RADIX_SIZE; ++i) {
+            const uint32_t n = histogram[i];
+            histogram[i] = offset;
+            offset += n;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            const uint32_t key = t->_keys[i];
+            const uint32_t dst = histogram[(key >> shift) & (_LOPGL_RADIX_SIZE - 1)]++;
+            t->_tmp_keys[dst] = key;
+            t->_tmp_order[dst] = t->order[i];
+        }
+
+        uint32_t* keys = t->_keys;
+        t->_keys = t->_tmp_keys;
+        t->_tmp_keys = keys;
+        uint32_t* order = t->order;
+        t->order = t->_tmp_order;
+        t->_tmp_order = order;
+    }
+}
+
+/*=== TRANSPARENCY =================================================*/
+
+void lopgl_init_transparency(lopgl_transparency_t* t, const lopgl_transparency_desc_t* desc) {
+    assert(desc->capacity > 0);
+    memset(t, 0, sizeof(lopgl_transparency_t));
+    t->capacity = desc->capacity;
+    t->coherent_distance = desc->coherent_distance > 0.0f ? desc->coherent_distance : 1.0f;
+    t->order = malloc((size_t)desc->capacity * sizeof(uint32_t));
+    t->_keys = malloc((size_t)desc->capacity * sizeof(uint32_t));
+    t->_tmp_keys = malloc((size_t)desc->capacity * sizeof(uint32_t));
+    t->_tmp_order = malloc((size_t)desc->capacity * sizeof(uint32_t));
+}
+
+void lopgl_destroy_transparency(lopgl_transparency_t* t) {
+    free(t->order);
+    free(t->_keys);
+    free(t->_tmp_keys);
+    free(t->_tmp_order);
+    memset(t, 0, sizeof(lopgl_transparency_t));
+}
+
+void lopgl_sort_transparency(lopgl_transparency_t* t, const hmm_vec3* positions, int count, hmm_vec3 eye) {
+    assert(count >= 0 && count <= t->capacity);
+    uint64_t start = stm_now();
+    const float max_move = t->coherent_distance * t->coherent_distance;
+    const bool coherent = t->mode == LOPGL_SORT_COHERENT && t->_sorted && count == t->count && t->_backoff == 0 &&
+                          HMM_LengthSquaredVec3(HMM_SubtractVec3(eye, t->_eye)) <= max_move;
+    if (t->_backoff > 0) {
+        --t->_backoff;
+    }
+
+    t->count = count;
+    t->_eye = eye;
+    t->_sorted = true;
+    if (!coherent) {
+        for (int i = 0; i < count; ++i) {
+            t->order[i] = (uint32_t)i;
+        }
+    }
+    lopgl_parallel_for(count, _LOPGL_TRANSPARENCY_GRAIN, compute_keys, &(_lopgl_key_job_t){
+        .t = t,
+        .positions = positions,
+        .eye = eye
+    });
+    t->stats.key_ms = stm_ms(stm_since(start));
+
+    start = stm_now();
+    int64_t shifts = 0;
+    t->stats.refined = false;
+    if (coherent) {
+        t->stats.refined = insertion_sort(t->_keys, t->order, count, (int64_t)count * _LOPGL_MAX_REFINE_SHIFTS, &shifts);
+        if (!t->stats.refined) {
+            ++t->stats.fallbacks;
+            t->_backoff = _LOPGL_REFINE_BACKOFF;
+        }
+    }
+    if (!t->stats.refined) {
+        if (count <= _LOPGL_SMALL_SORT) {
+            insertion_sort(t->_keys, t->order, count, INT64_MAX, &shifts);
+        }
+        else if (count > 0) {
+            radix_sort(t);
+        }
+    }
+    t->stats.shifts = (int)shifts;
+    t->stats.sort_ms = stm_ms(stm_since(start));
+}
+
+typedef struct _lopgl_gather_job_t {
+    const uint32_t* order;
+    const uint8_t* src;
+    uint8_t* dst;
+    size_t stride;
+} _lopgl_gather_job_t;
+
+static void gather_sorted(int begin, int end, void* user_data) {
+    const _lopgl_gather_job_t* job = user_data;
+    for (int i = begin; i < end; ++i) {
+        memcpy(job->dst + (size_t)i * job->stride, job->src + (size_t)job->order[i] * job->stride, job->stride);
+    }
+}
+
+void lopgl_gather_transparency(const lopgl_transparency_t* t, const void* src, int stride, void* dst) {
+    assert(stride > 0);
+    lopgl_parallel_for(t->count, _LOPGL_TRANSPARENCY_GRAIN, gather_sorted, &(_lopgl_gather_job_t){
+        .order = t->order,
+        .src = src,
+        .dst = dst,
+        .stride = (size_t)stride
+    });
+}
+
+#endif /* LOPGL_TRANSPARENCY_IMPL */